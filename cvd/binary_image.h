@@ -0,0 +1,207 @@
+//-*- c++ -*-
+#ifndef CVD_INC_BINARY_IMAGE_H
+#define CVD_INC_BINARY_IMAGE_H
+
+#include <cvd/byte.h>
+#include <cvd/image.h>
+#include <cvd/image_ref.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace CVD
+{
+
+#ifndef DOXYGEN_IGNORE_INTERNAL
+namespace Internal
+{
+	/// The number of set bits in a word
+	inline int popcount(uint64_t w)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return __builtin_popcountll(w);
+#else
+		w = w - ((w >> 1) & 0x5555555555555555ull);
+		w = (w & 0x3333333333333333ull) + ((w >> 2) & 0x3333333333333333ull);
+		w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0full;
+		return static_cast<int>((w * 0x0101010101010101ull) >> 56);
+#endif
+	}
+
+	/// The index of the lowest set bit of a non-zero word
+	inline int lowest_bit(uint64_t w)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return __builtin_ctzll(w);
+#else
+		return popcount((w & (0 - w)) - 1);
+#endif
+	}
+}
+#endif
+
+/// A binary image stored with one bit per pixel. Pixel x of a row is bit x%64 of
+/// word x/64 of the row, and each row is padded to a whole number of words, so
+/// logical operations, morphology and counting work on 64 pixels at a time.
+/// The padding bits are always zero.
+///
+/// Unlike Image, a BinaryImage owns its data and copies are deep.
+/// @ingroup gImage
+class BinaryImage
+{
+	public:
+	typedef uint64_t word;
+	static const int bits_per_word = 64;
+
+	/// An empty image
+	BinaryImage()
+	    : my_size(0, 0)
+	    , my_words(0)
+	{
+	}
+
+	/// An image of the given size with all pixels cleared
+	explicit BinaryImage(const ImageRef& size)
+	{
+		resize(size);
+	}
+
+	/// Make a binary image by thresholding. See binary_threshold().
+	explicit BinaryImage(const BasicImage<byte>& in, byte threshold = 0);
+
+	/// Resize the image. All pixels are cleared.
+	void resize(const ImageRef& size)
+	{
+		my_size = size;
+		my_words = (size.x + bits_per_word - 1) / bits_per_word;
+		my_data.assign(static_cast<size_t>(my_words) * size.y, 0);
+	}
+
+	const ImageRef& size() const
+	{
+		return my_size;
+	}
+
+	/// The number of words in each row, including the padding.
+	int words_per_row() const
+	{
+		return my_words;
+	}
+
+	word* row(int y)
+	{
+		return my_data.data() + static_cast<size_t>(y) * my_words;
+	}
+
+	const word* row(int y) const
+	{
+		return my_data.data() + static_cast<size_t>(y) * my_words;
+	}
+
+	bool in_image(const ImageRef& p) const
+	{
+		return p.x >= 0 && p.y >= 0 && p.x < my_size.x && p.y < my_size.y;
+	}
+
+	bool operator[](const ImageRef& p) const
+	{
+		return (row(p.y)[p.x / bits_per_word] >> (p.x % bits_per_word)) & 1;
+	}
+
+	void set(const ImageRef& p, bool value = true)
+	{
+		word& w = row(p.y)[p.x / bits_per_word];
+		const word bit = word(1) << (p.x % bits_per_word);
+		w = value ? (w | bit) : (w & ~bit);
+	}
+
+	/// Set every pixel to the given value.
+	void fill(bool value);
+
+	/// The number of pixels which are set.
+	size_t count() const;
+
+	/// The mask of the bits in the last word of each row which are pixels.
+	word last_word_mask() const
+	{
+		const int r = my_size.x % bits_per_word;
+		return r ? (word(1) << r) - 1 : ~word(0);
+	}
+
+	BinaryImage& operator&=(const BinaryImage& b);
+	BinaryImage& operator|=(const BinaryImage& b);
+	BinaryImage& operator^=(const BinaryImage& b);
+
+	/// Invert every pixel.
+	void invert();
+
+	private:
+	ImageRef my_size;
+	int my_words;
+	std::vector<word> my_data;
+};
+
+inline BinaryImage operator&(BinaryImage a, const BinaryImage& b)
+{
+	return a &= b;
+}
+
+inline BinaryImage operator|(BinaryImage a, const BinaryImage& b)
+{
+	return a |= b;
+}
+
+inline BinaryImage operator^(BinaryImage a, const BinaryImage& b)
+{
+	return a ^= b;
+}
+
+inline BinaryImage operator~(BinaryImage a)
+{
+	a.invert();
+	return a;
+}
+
+/// Threshold a greyscale image to a binary image. Pixels greater than the
+/// threshold are set.
+/// @param in The source image
+/// @param threshold The threshold
+/// @param out The destination image, which is resized to match the source
+/// @ingroup gVision
+void binary_threshold(const BasicImage<byte>& in, byte threshold, BinaryImage& out);
+
+/// Convert a binary image to a greyscale image.
+/// @param in The source image
+/// @param out The destination image, which must be the same size
+/// @param on The value written for pixels which are set
+/// @param off The value written for pixels which are clear
+/// @ingroup gVision
+void binary_unpack(const BinaryImage& in, BasicImage<byte>& out, byte on = 255, byte off = 0);
+
+/// Binary erosion with a rectangular structuring element, working on the 64 pixels
+/// in each word at once. The rectangle covers the offsets from @p lo to @p hi
+/// inclusive and is cropped at the edge of the image, exactly as with the greyscale
+/// erodeRectangle(). The cost grows with the logarithm of the size of the rectangle.
+/// @param in The source image.
+/// @param lo The top left offset of the rectangle
+/// @param hi The bottom right offset of the rectangle
+/// @param out The destination image, which is resized to match the source. It may be the source image.
+/// @ingroup gVision
+void erodeRectangle(const BinaryImage& in, ImageRef lo, ImageRef hi, BinaryImage& out);
+
+/// Binary dilation with a rectangular structuring element. See erodeRectangle().
+/// @ingroup gVision
+void dilateRectangle(const BinaryImage& in, ImageRef lo, ImageRef hi, BinaryImage& out);
+
+/// Binary opening with a rectangular structuring element. See erodeRectangle().
+/// @ingroup gVision
+void openRectangle(const BinaryImage& in, ImageRef lo, ImageRef hi, BinaryImage& out);
+
+/// Binary closing with a rectangular structuring element. See erodeRectangle().
+/// @ingroup gVision
+void closeRectangle(const BinaryImage& in, ImageRef lo, ImageRef hi, BinaryImage& out);
+
+}
+
+#endif
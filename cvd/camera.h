@@ -3,6 +3,7 @@
 
 #include <TooN/TooN.h>
 #include <TooN/helpers.h>
+#include <algorithm>
 #include <cmath>
 
 namespace CVD
@@ -14,6 +15,110 @@ inline T SAT(T x) { return (x < -1.0 / 3 ? -1e9 : x); }
 /// @ingroup gVision
 namespace Camera
 {
+	namespace Internal
+	{
+		typedef TooN::DefaultPrecision Precision;
+
+		// Batches of points are processed in blocks through local arrays, so
+		// that the loops are vectorised and the outputs may be the inputs.
+		const int batch_block = 64;
+
+		// The radial models take a point x in the camera frame to
+		// f x s(|x|^2) + c in the image, where f is the focal lengths and c the
+		// optic axis. The derivative is diag(f) (s I + 2 s' x x^T). The scale
+		// and slope are functions of |x|^2 giving s and s'.
+		template <class Scale, class Slope>
+		void radial_project(Precision fu, Precision fv, Precision u0, Precision v0, const Scale& scale, const Slope& slope,
+		    const Precision* x, const Precision* y, int n, Precision* u, Precision* v, Precision* J)
+		{
+			for(int i0 = 0; i0 < n; i0 += batch_block)
+			{
+				const int m = std::min(batch_block, n - i0);
+				Precision bx[batch_block], by[batch_block], bu[batch_block], bv[batch_block];
+				std::copy(x + i0, x + i0 + m, bx);
+				std::copy(y + i0, y + i0 + m, by);
+
+				for(int i = 0; i < m; i++)
+				{
+					const Precision s = scale(bx[i] * bx[i] + by[i] * by[i]);
+					bu[i] = fu * (bx[i] * s) + u0;
+					bv[i] = fv * (by[i] * s) + v0;
+				}
+
+				if(J)
+				{
+					Precision j00[batch_block], j01[batch_block], j10[batch_block], j11[batch_block];
+					for(int i = 0; i < m; i++)
+					{
+						const Precision r2 = bx[i] * bx[i] + by[i] * by[i];
+						const Precision s = scale(r2), d = 2 * slope(r2);
+						j00[i] = fu * (s + d * bx[i] * bx[i]);
+						j01[i] = fu * d * bx[i] * by[i];
+						j10[i] = fv * d * bx[i] * by[i];
+						j11[i] = fv * (s + d * by[i] * by[i]);
+					}
+					std::copy(j00, j00 + m, J + i0);
+					std::copy(j01, j01 + m, J + n + i0);
+					std::copy(j10, j10 + m, J + 2 * n + i0);
+					std::copy(j11, j11 + m, J + 3 * n + i0);
+				}
+
+				std::copy(bu, bu + m, u + i0);
+				std::copy(bv, bv + m, v + i0);
+			}
+		}
+
+		// Unprojection takes the image point to m = (u - c) / f, then to
+		// x = m / s, where the inverse gives s at x as a function of |m|^2. The
+		// derivative is the inverse of the derivative of projection at x.
+		template <class Scale, class Slope, class Inverse>
+		void radial_unproject(Precision fu, Precision fv, Precision u0, Precision v0, const Scale& scale, const Slope& slope, const Inverse& inverse,
+		    const Precision* u, const Precision* v, int n, Precision* x, Precision* y, Precision* J)
+		{
+			for(int i0 = 0; i0 < n; i0 += batch_block)
+			{
+				const int m = std::min(batch_block, n - i0);
+				Precision bx[batch_block], by[batch_block];
+				std::copy(u + i0, u + i0 + m, bx);
+				std::copy(v + i0, v + i0 + m, by);
+
+				for(int i = 0; i < m; i++)
+				{
+					const Precision mx = (bx[i] - u0) / fu;
+					const Precision my = (by[i] - v0) / fv;
+					const Precision s = inverse(mx * mx + my * my);
+					bx[i] = mx / s;
+					by[i] = my / s;
+				}
+
+				if(J)
+				{
+					Precision j00[batch_block], j01[batch_block], j10[batch_block], j11[batch_block];
+					for(int i = 0; i < m; i++)
+					{
+						const Precision r2 = bx[i] * bx[i] + by[i] * by[i];
+						const Precision s = scale(r2), d = 2 * slope(r2);
+						const Precision a = fu * (s + d * bx[i] * bx[i]);
+						const Precision b = fu * d * bx[i] * by[i];
+						const Precision c = fv * d * bx[i] * by[i];
+						const Precision e = fv * (s + d * by[i] * by[i]);
+						const Precision rdet = 1 / (a * e - b * c);
+						j00[i] = rdet * e;
+						j01[i] = -rdet * b;
+						j10[i] = -rdet * c;
+						j11[i] = rdet * a;
+					}
+					std::copy(j00, j00 + m, J + i0);
+					std::copy(j01, j01 + m, J + n + i0);
+					std::copy(j10, j10 + m, J + 2 * n + i0);
+					std::copy(j11, j11 + m, J + 3 * n + i0);
+				}
+
+				std::copy(bx, bx + m, x + i0);
+				std::copy(by, by + m, y + i0);
+			}
+		}
+	}
 
 	/// A linear camera with zero skew
 	/// @ingroup gVision
@@ -55,6 +160,46 @@ namespace Camera
 			return my_last_camframe;
 		}
 
+		/// Project n points from the Euclidean camera frame to the image plane. The points
+		/// are given and returned as separate arrays of each coordinate, which may be the
+		/// same arrays, and the loops over them are vectorised.
+		/// @param x The x coordinates of the points in the camera frame
+		/// @param y The y coordinates of the points in the camera frame
+		/// @param n The number of points
+		/// @param u Returns the x coordinates of the points in the image plane
+		/// @param v Returns the y coordinates of the points in the image plane
+		/// @param J If not null, returns the derivatives of the image points with respect to
+		///          the camera points as 4n values: the n values of each of du/dx, du/dy,
+		///          dv/dx and dv/dy in turn
+		inline void project(const TooN::DefaultPrecision* x, const TooN::DefaultPrecision* y, int n, TooN::DefaultPrecision* u, TooN::DefaultPrecision* v, TooN::DefaultPrecision* J = nullptr) const
+		{
+			Internal::radial_project(my_camera_parameters[0], my_camera_parameters[1], my_camera_parameters[2], my_camera_parameters[3],
+			    [](Internal::Precision) { return Internal::Precision(1); },
+			    [](Internal::Precision) { return Internal::Precision(0); },
+			    x, y, n, u, v, J);
+		}
+
+		/// Project n points from the image plane to the Euclidean camera frame, with the
+		/// same fixed number of iterations for each point as unproject() of one point.
+		/// The points are given and returned as separate arrays of each coordinate, which
+		/// may be the same arrays, and the loops over them are vectorised.
+		/// @param u The x coordinates of the points in the image plane
+		/// @param v The y coordinates of the points in the image plane
+		/// @param n The number of points
+		/// @param x Returns the x coordinates of the points in the camera frame
+		/// @param y Returns the y coordinates of the points in the camera frame
+		/// @param J If not null, returns the derivatives of the camera points with respect to
+		///          the image points as 4n values: the n values of each of dx/du, dx/dv,
+		///          dy/du and dy/dv in turn
+		inline void unproject(const TooN::DefaultPrecision* u, const TooN::DefaultPrecision* v, int n, TooN::DefaultPrecision* x, TooN::DefaultPrecision* y, TooN::DefaultPrecision* J = nullptr) const
+		{
+			Internal::radial_unproject(my_camera_parameters[0], my_camera_parameters[1], my_camera_parameters[2], my_camera_parameters[3],
+			    [](Internal::Precision) { return Internal::Precision(1); },
+			    [](Internal::Precision) { return Internal::Precision(0); },
+			    [](Internal::Precision) { return Internal::Precision(1); },
+			    u, v, n, x, y, J);
+		}
+
 		/// Get the derivative of image frame wrt camera frame
 		/// in the form \f$ \begin{bmatrix} \frac{\partial \text{im1}}{\partial \text{cam1}} & \frac{\partial \text{im1}}{\partial \text{cam2}} \\ \frac{\partial \text{im2}}{\partial \text{cam1}} & \frac{\partial \text{im2}}{\partial \text{cam2}} \end{bmatrix} \f$
 		TooN::Matrix<2, 2> get_derivative_at(const TooN::Vector<2>&) const
@@ -133,6 +278,11 @@ namespace Camera
 		/// Project from image plane to a Euclidean camera
 		inline TooN::Vector<2> unproject(const TooN::Vector<2>& imframe) const;
 
+		/// @copydoc Linear::project(const TooN::DefaultPrecision*, const TooN::DefaultPrecision*, int, TooN::DefaultPrecision*, TooN::DefaultPrecision*, TooN::DefaultPrecision*) const
+		inline void project(const TooN::DefaultPrecision* x, const TooN::DefaultPrecision* y, int n, TooN::DefaultPrecision* u, TooN::DefaultPrecision* v, TooN::DefaultPrecision* J = nullptr) const;
+		/// @copydoc Linear::unproject(const TooN::DefaultPrecision*, const TooN::DefaultPrecision*, int, TooN::DefaultPrecision*, TooN::DefaultPrecision*, TooN::DefaultPrecision*) const
+		inline void unproject(const TooN::DefaultPrecision* u, const TooN::DefaultPrecision* v, int n, TooN::DefaultPrecision* x, TooN::DefaultPrecision* y, TooN::DefaultPrecision* J = nullptr) const;
+
 		/// Get the derivative of image frame wrt camera frame at the last computed projection
 		/// in the form \f$ \begin{bmatrix} \frac{\partial \text{im1}}{\partial \text{cam1}} & \frac{\partial \text{im1}}{\partial \text{cam2}} \\ \frac{\partial \text{im2}}{\partial \text{cam1}} & \frac{\partial \text{im2}}{\partial \text{cam2}} \end{bmatrix} \f$
 		inline TooN::Matrix<2, 2> get_derivative_at(const TooN::Vector<2>&) const;
@@ -204,6 +354,11 @@ namespace Camera
 
 		inline std::pair<TooN::Vector<2>, TooN::Matrix<2>> unproject(const TooN::Vector<2>& imframe, const TooN::Matrix<2>& R) const;
 
+		/// @copydoc Linear::project(const TooN::DefaultPrecision*, const TooN::DefaultPrecision*, int, TooN::DefaultPrecision*, TooN::DefaultPrecision*, TooN::DefaultPrecision*) const
+		inline void project(const TooN::DefaultPrecision* x, const TooN::DefaultPrecision* y, int n, TooN::DefaultPrecision* u, TooN::DefaultPrecision* v, TooN::DefaultPrecision* J = nullptr) const;
+		/// @copydoc Linear::unproject(const TooN::DefaultPrecision*, const TooN::DefaultPrecision*, int, TooN::DefaultPrecision*, TooN::DefaultPrecision*, TooN::DefaultPrecision*) const
+		inline void unproject(const TooN::DefaultPrecision* u, const TooN::DefaultPrecision* v, int n, TooN::DefaultPrecision* x, TooN::DefaultPrecision* y, TooN::DefaultPrecision* J = nullptr) const;
+
 		/// Get the derivative of image frame wrt camera frame at the last computed projection
 		/// in the form \f$ \begin{bmatrix} \frac{\partial \text{im1}}{\partial \text{cam1}} & \frac{\partial \text{im1}}{\partial \text{cam2}} \\ \frac{\partial \text{im2}}{\partial \text{cam1}} & \frac{\partial \text{im2}}{\partial \text{cam2}} \end{bmatrix} \f$
 		inline TooN::Matrix<2, 2> get_derivative() const;
@@ -309,6 +464,27 @@ namespace Camera
 			return mod_camframe / sqrt(1 - my_camera_parameters[4] * rprime2);
 		}
 
+		/// @copydoc Linear::project(const TooN::DefaultPrecision*, const TooN::DefaultPrecision*, int, TooN::DefaultPrecision*, TooN::DefaultPrecision*, TooN::DefaultPrecision*) const
+		inline void project(const TooN::DefaultPrecision* x, const TooN::DefaultPrecision* y, int n, TooN::DefaultPrecision* u, TooN::DefaultPrecision* v, TooN::DefaultPrecision* J = nullptr) const
+		{
+			const Internal::Precision a = my_camera_parameters[4];
+			Internal::radial_project(my_camera_parameters[0], my_camera_parameters[1], my_camera_parameters[2], my_camera_parameters[3],
+			    [a](Internal::Precision r2) { return 1 / sqrt(1 + a * r2); },
+			    [a](Internal::Precision r2) { const Internal::Precision g = 1 / sqrt(1 + a * r2); return -a / 2 * g * g * g; },
+			    x, y, n, u, v, J);
+		}
+
+		/// @copydoc Linear::unproject(const TooN::DefaultPrecision*, const TooN::DefaultPrecision*, int, TooN::DefaultPrecision*, TooN::DefaultPrecision*, TooN::DefaultPrecision*) const
+		inline void unproject(const TooN::DefaultPrecision* u, const TooN::DefaultPrecision* v, int n, TooN::DefaultPrecision* x, TooN::DefaultPrecision* y, TooN::DefaultPrecision* J = nullptr) const
+		{
+			const Internal::Precision a = my_camera_parameters[4];
+			Internal::radial_unproject(my_camera_parameters[0], my_camera_parameters[1], my_camera_parameters[2], my_camera_parameters[3],
+			    [a](Internal::Precision r2) { return 1 / sqrt(1 + a * r2); },
+			    [a](Internal::Precision r2) { const Internal::Precision g = 1 / sqrt(1 + a * r2); return -a / 2 * g * g * g; },
+			    [a](Internal::Precision m2) { return sqrt(1 - a * m2); },
+			    u, v, n, x, y, J);
+		}
+
 		/// Evaluate the derivative of image frame wrt camera frame at an arbitrary point @p pt.
 		/// Get the derivative of image frame wrt camera frame at the last computed projection
 		/// in the form \f$ \begin{bmatrix} \frac{\partial \text{im1}}{\partial \text{cam1}} & \frac{\partial \text{im1}}{\partial \text{cam2}} \\ \frac{\partial \text{im2}}{\partial \text{cam1}} & \frac{\partial \text{im2}}{\partial \text{cam2}} \end{bmatrix} \f$
@@ -454,6 +630,27 @@ namespace Camera
 			return my_last_camframe;
 		}
 
+		/// @copydoc Linear::project(const TooN::DefaultPrecision*, const TooN::DefaultPrecision*, int, TooN::DefaultPrecision*, TooN::DefaultPrecision*, TooN::DefaultPrecision*) const
+		inline void project(const TooN::DefaultPrecision* x, const TooN::DefaultPrecision* y, int n, TooN::DefaultPrecision* u, TooN::DefaultPrecision* v, TooN::DefaultPrecision* J = nullptr) const
+		{
+			const Internal::Precision a = my_camera_parameters[4];
+			Internal::radial_project(my_camera_parameters[0], my_camera_parameters[0], my_camera_parameters[2], my_camera_parameters[3],
+			    [a](Internal::Precision r2) { return 1 / sqrt(1 + a * r2); },
+			    [a](Internal::Precision r2) { const Internal::Precision g = 1 / sqrt(1 + a * r2); return -a / 2 * g * g * g; },
+			    x, y, n, u, v, J);
+		}
+
+		/// @copydoc Linear::unproject(const TooN::DefaultPrecision*, const TooN::DefaultPrecision*, int, TooN::DefaultPrecision*, TooN::DefaultPrecision*, TooN::DefaultPrecision*) const
+		inline void unproject(const TooN::DefaultPrecision* u, const TooN::DefaultPrecision* v, int n, TooN::DefaultPrecision* x, TooN::DefaultPrecision* y, TooN::DefaultPrecision* J = nullptr) const
+		{
+			const Internal::Precision a = my_camera_parameters[4];
+			Internal::radial_unproject(my_camera_parameters[0], my_camera_parameters[0], my_camera_parameters[2], my_camera_parameters[3],
+			    [a](Internal::Precision r2) { return 1 / sqrt(1 + a * r2); },
+			    [a](Internal::Precision r2) { const Internal::Precision g = 1 / sqrt(1 + a * r2); return -a / 2 * g * g * g; },
+			    [a](Internal::Precision m2) { return sqrt(1 - a * m2); },
+			    u, v, n, x, y, J);
+		}
+
 		/// Get the derivative of image frame wrt camera frame at the last computed projection
 		/// in the form \f$ \begin{bmatrix} \frac{\partial \text{im1}}{\partial \text{cam1}} & \frac{\partial \text{im1}}{\partial \text{cam2}} \\ \frac{\partial \text{im2}}{\partial \text{cam1}} & \frac{\partial \text{im2}}{\partial \text{cam2}} \end{bmatrix} \f$
 		inline TooN::Matrix<2, 2> get_derivative() const
@@ -624,6 +821,40 @@ namespace Camera
 			return mod_camframe / (1 + scale * (k3 + scale * (k5 + scale * k7)));
 		}
 
+		/// @copydoc Linear::project(const TooN::DefaultPrecision*, const TooN::DefaultPrecision*, int, TooN::DefaultPrecision*, TooN::DefaultPrecision*, TooN::DefaultPrecision*) const
+		inline void project(const TooN::DefaultPrecision* x, const TooN::DefaultPrecision* y, int n, TooN::DefaultPrecision* u, TooN::DefaultPrecision* v, TooN::DefaultPrecision* J = nullptr) const
+		{
+			const Internal::Precision w2 = my_camera_parameters[4] * my_camera_parameters[4];
+			const Internal::Precision k3 = -w2 / 3.0, k5 = w2 * w2 / 5.0, k7 = -w2 * w2 * w2 / 7.0;
+			Internal::radial_project(my_camera_parameters[0], my_camera_parameters[1], my_camera_parameters[2], my_camera_parameters[3],
+			    [=](Internal::Precision r2) { return 1 + r2 * (k3 + r2 * (k5 + r2 * k7)); },
+			    [=](Internal::Precision r2) { return k3 + r2 * (2 * k5 + 3 * r2 * k7); },
+			    x, y, n, u, v, J);
+		}
+
+		/// @copydoc Linear::unproject(const TooN::DefaultPrecision*, const TooN::DefaultPrecision*, int, TooN::DefaultPrecision*, TooN::DefaultPrecision*, TooN::DefaultPrecision*) const
+		inline void unproject(const TooN::DefaultPrecision* u, const TooN::DefaultPrecision* v, int n, TooN::DefaultPrecision* x, TooN::DefaultPrecision* y, TooN::DefaultPrecision* J = nullptr) const
+		{
+			const Internal::Precision w2 = my_camera_parameters[4] * my_camera_parameters[4];
+			const Internal::Precision k3 = -w2 / 3.0, k5 = w2 * w2 / 5.0, k7 = -w2 * w2 * w2 / 7.0;
+			Internal::radial_unproject(my_camera_parameters[0], my_camera_parameters[1], my_camera_parameters[2], my_camera_parameters[3],
+			    [=](Internal::Precision r2) { return 1 + r2 * (k3 + r2 * (k5 + r2 * k7)); },
+			    [=](Internal::Precision r2) { return k3 + r2 * (2 * k5 + 3 * r2 * k7); },
+			    [=](Internal::Precision rprime2) {
+				    // The same Newton iterations as unproject(), on |x|^2.
+				    Internal::Precision scale = rprime2;
+				    for(int i = 0; i < 3; i++)
+				    {
+					    const Internal::Precision temp = 1 + scale * (k3 + scale * (k5 + scale * k7));
+					    const Internal::Precision error = rprime2 - scale * temp * temp;
+					    const Internal::Precision deriv = temp * (temp + 2 * scale * (k3 + 2 * scale * (k5 + 1.5 * scale * k7)));
+					    scale += error / deriv;
+				    }
+				    return 1 + scale * (k3 + scale * (k5 + scale * k7));
+			    },
+			    u, v, n, x, y, J);
+		}
+
 		/// Evaluate the derivative of image frame wrt camera frame at an arbitrary point @p pt.
 		/// in the form \f$ \begin{bmatrix} \frac{\partial \text{im1}}{\partial \text{cam1}} & \frac{\partial \text{im1}}{\partial \text{cam2}} \\ \frac{\partial \text{im2}}{\partial \text{cam1}} & \frac{\partial \text{im2}}{\partial \text{cam2}} \end{bmatrix} \f$
 		/// @sa get_derivative()
@@ -721,6 +952,8 @@ namespace Camera
 	{
 		public:
 		using C::num_parameters;
+		using C::project;
+		using C::unproject;
 		TooN::Vector<2> project(const TooN::Vector<2>& v) const
 		{
 			my_last_camframe = v;
@@ -793,6 +1026,35 @@ inline TooN::Vector<2> Camera::Cubic::unproject(const TooN::Vector<2>& imframe)
 	return mod_camframe / scale;
 }
 
+inline void Camera::Cubic::project(const TooN::DefaultPrecision* x, const TooN::DefaultPrecision* y, int n, TooN::DefaultPrecision* u, TooN::DefaultPrecision* v, TooN::DefaultPrecision* J) const
+{
+	const Internal::Precision k = my_camera_parameters[4];
+	Internal::radial_project(my_camera_parameters[0], my_camera_parameters[1], my_camera_parameters[2], my_camera_parameters[3],
+	    [k](Internal::Precision r2) { return 1 + SAT(k * r2); },
+	    [k](Internal::Precision) { return k; },
+	    x, y, n, u, v, J);
+}
+
+inline void Camera::Cubic::unproject(const TooN::DefaultPrecision* u, const TooN::DefaultPrecision* v, int n, TooN::DefaultPrecision* x, TooN::DefaultPrecision* y, TooN::DefaultPrecision* J) const
+{
+	const Internal::Precision k = my_camera_parameters[4];
+	Internal::radial_unproject(my_camera_parameters[0], my_camera_parameters[1], my_camera_parameters[2], my_camera_parameters[3],
+	    [k](Internal::Precision r2) { return 1 + k * r2; },
+	    [k](Internal::Precision) { return k; },
+	    [k](Internal::Precision m2) {
+		    // The same Newton iterations as unproject(), on the scale.
+		    Internal::Precision scale = 1 + k * m2;
+		    for(int i = 0; i < 3; i++)
+		    {
+			    const Internal::Precision error = k * m2 - scale * scale * (scale - 1);
+			    const Internal::Precision deriv = (3 * scale - 2) * scale;
+			    scale += error / deriv;
+		    }
+		    return scale;
+	    },
+	    u, v, n, x, y, J);
+}
+
 TooN::Matrix<2, 2> Camera::Cubic::get_derivative_at(const TooN::Vector<2>& pos) const
 {
 	TooN::Matrix<2, 2> result = TooN::Identity;
@@ -918,6 +1180,36 @@ inline std::pair<TooN::Vector<2>, TooN::Matrix<2>> Camera::Quintic::unproject(co
 	return result;
 }
 
+inline void Camera::Quintic::project(const TooN::DefaultPrecision* x, const TooN::DefaultPrecision* y, int n, TooN::DefaultPrecision* u, TooN::DefaultPrecision* v, TooN::DefaultPrecision* J) const
+{
+	const Internal::Precision a = my_camera_parameters[4], b = my_camera_parameters[5];
+	Internal::radial_project(my_camera_parameters[0], my_camera_parameters[1], my_camera_parameters[2], my_camera_parameters[3],
+	    [a, b](Internal::Precision r2) { return 1 + r2 * (a + r2 * b); },
+	    [a, b](Internal::Precision r2) { return a + 2 * b * r2; },
+	    x, y, n, u, v, J);
+}
+
+inline void Camera::Quintic::unproject(const TooN::DefaultPrecision* u, const TooN::DefaultPrecision* v, int n, TooN::DefaultPrecision* x, TooN::DefaultPrecision* y, TooN::DefaultPrecision* J) const
+{
+	const Internal::Precision a = my_camera_parameters[4], b = my_camera_parameters[5];
+	Internal::radial_unproject(my_camera_parameters[0], my_camera_parameters[1], my_camera_parameters[2], my_camera_parameters[3],
+	    [a, b](Internal::Precision r2) { return 1 + r2 * (a + r2 * b); },
+	    [a, b](Internal::Precision r2) { return a + 2 * b * r2; },
+	    [a, b](Internal::Precision m2) {
+		    // The same Newton iterations as unproject(), on |x|^2.
+		    Internal::Precision scale = m2;
+		    for(int i = 0; i < 3; i++)
+		    {
+			    const Internal::Precision temp = 1 + scale * (a + b * scale);
+			    const Internal::Precision error = m2 - scale * temp * temp;
+			    const Internal::Precision deriv = temp * (temp + 2 * scale * (a + 2 * b * scale));
+			    scale += error / deriv;
+		    }
+		    return 1 + scale * (a + b * scale);
+	    },
+	    u, v, n, x, y, J);
+}
+
 TooN::Matrix<2, 2> Camera::Quintic::get_derivative() const
 {
 	TooN::Matrix<2, 2> result = TooN::Identity;
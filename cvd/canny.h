@@ -1,15 +1,48 @@
 #ifndef CVD_INCLUDE_EDGE_HPP
 #define CVD_INCLUDE_EDGE_HPP
 
-#include <TooN/TooN.h>
 #include <cmath>
+#include <cvd/byte.h>
+#include <cvd/config.h>
 #include <cvd/convolution.h>
 #include <cvd/image.h>
 #include <queue>
 
+#ifdef CVD_HAVE_TOON
+#include <TooN/TooN.h>
+#endif
+
 namespace CVD
 {
 
+/// Canny edge detection for byte images, in integer arithmetic throughout.
+///
+/// The gradients are 3x3 Sobel gradients of the image, which is not smoothed first,
+/// so it is usual to blur it beforehand, for example with
+/// <code>convolveSeparableFixed<FixedKernels::Gaussian5, FixedKernels::Gaussian5>()</code>.
+/// The direction of the gradient is quantised to the nearest of the horizontal,
+/// vertical and two diagonal directions. A pixel survives nonmaximal suppression if
+/// its gradient magnitude is greater than that of the neighbour before it along the
+/// gradient and at least that of the neighbour after it. Surviving pixels with a
+/// magnitude greater than @p upper_threshold are edges, as are those greater than
+/// @p lower_threshold which are 8-connected to an edge through such pixels.
+///
+/// The gradients are 16 bit, the magnitudes are compared squared, and the inner loops
+/// are vectorised. The image is processed in bands on multiple threads, including the
+/// hysteresis, which gives exactly the same edges as tracing the whole image at once.
+///
+/// @param im The source image.
+/// @param edges The destination image, which must be the same size. Edges are set to
+///              255 and other pixels to 0. Pixels on the border of the image are never
+///              edges. It may be the source image.
+/// @param lower_threshold The lower threshold on the gradient magnitude
+/// @param upper_threshold The upper threshold on the gradient magnitude
+/// @throws Exceptions::Vision::IncompatibleImageSizes if the images are different sizes
+/// @throws Exceptions::Vision::BadInput unless 0 <= @p lower_threshold <= @p upper_threshold
+/// @ingroup gVision
+void canny_edges(const BasicImage<byte>& im, BasicImage<byte>& edges, int lower_threshold, int upper_threshold);
+
+#ifdef CVD_HAVE_TOON
 template <class T>
 void canny_gradient(const BasicImage<T>& im, BasicImage<TooN::Vector<2>>& grad, const double sigma = 1.0)
 {
@@ -27,6 +60,7 @@ void canny_gradient(const BasicImage<T>& im, BasicImage<TooN::Vector<2>>& grad,
 		}
 	}
 }
+#endif
 
 template <class T>
 void canny(const BasicImage<T>& im, BasicImage<T>& out, const double sigma = 1.0, const double lower_threshold = 0.1, const double upper_threshold = 0.2)
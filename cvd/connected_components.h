@@ -2,7 +2,11 @@
 #ifndef CVD_INC_CONNECTED_COMPONENTS_H
 #define CVD_INC_CONNECTED_COMPONENTS_H
 
+#include <cvd/binary_image.h>
+#include <cvd/byte.h>
+#include <cvd/image.h>
 #include <cvd/image_ref.h>
+#include <climits>
 #include <vector>
 
 namespace CVD
@@ -17,6 +21,126 @@ namespace CVD
 ///@param r List of segments.
 ///@ingroup gVision
 void connected_components(const std::vector<ImageRef>& v, std::vector<std::vector<ImageRef>>& r);
+
+///Find the 4-way connected components of the set pixels of a bit-packed binary image.
+///@param im The binary image
+///@param r List of segments.
+///@ingroup gVision
+void connected_components(const BinaryImage& im, std::vector<std::vector<ImageRef>>& r);
+
+///Which neighbours of a pixel are connected to it.
+///@ingroup gVision
+enum class Connectivity
+{
+	Four, ///< The pixels to the left, right, above and below
+	Eight ///< The four, plus the diagonal neighbours
+};
+
+///Label the connected components of the non-zero pixels of an image.
+///The image is scanned as runs of pixels, which are joined using a union-find
+///structure with path compression, so the cost is close to linear in the number
+///of runs and no lists of pixels are made.
+///
+///Background pixels are labelled 0, and the components are labelled from 1
+///in the raster order of their first pixel.
+///@param in The image to label
+///@param labels The label image, which must be the same size as the input
+///@param connectivity Which pixels are neighbours
+///@return The number of components
+///@ingroup gVision
+int connected_components(const BasicImage<byte>& in, BasicImage<int>& labels, Connectivity connectivity = Connectivity::Four);
+
+///Label the connected components of the set pixels of a bit-packed binary image.
+///See connected_components(const BasicImage<byte>&, BasicImage<int>&, Connectivity).
+///@ingroup gVision
+int connected_components(const BinaryImage& in, BasicImage<int>& labels, Connectivity connectivity = Connectivity::Four);
+
+///Label the connected regions of a label image, where neighbouring pixels are
+///connected if they have the same non-zero value. A region of one value that is
+///split in two gets two labels. Otherwise this is the same as
+///connected_components(const BasicImage<byte>&, BasicImage<int>&, Connectivity).
+///@param in The image to label
+///@param labels The label image, which must be the same size as the input
+///@param connectivity Which pixels are neighbours
+///@return The number of regions
+///@ingroup gVision
+int connected_regions(const BasicImage<byte>& in, BasicImage<int>& labels, Connectivity connectivity = Connectivity::Four);
+int connected_regions(const BasicImage<int>& in, BasicImage<int>& labels, Connectivity connectivity = Connectivity::Four);
+
+///Statistics of labelled components, stored as one array per statistic.
+///Element i of each array belongs to label i + 1.
+///@ingroup gVision
+struct ComponentStatistics
+{
+	std::vector<int> area;                  ///< Number of pixels
+	std::vector<ImageRef> top_left;         ///< Smallest x and y of the bounding box
+	std::vector<ImageRef> bottom_right;     ///< Largest x and y of the bounding box
+	std::vector<double> centroid_x;         ///< Mean x
+	std::vector<double> centroid_y;         ///< Mean y
+	std::vector<double> xx, xy, yy;         ///< Central second moments, divided by the area
+
+	///@name Intensity weighted statistics
+	///These are only filled in by the versions which take a greyscale image, and
+	///are the statistics above with each pixel weighted by its intensity. The
+	///weighted moments of a component with no intensity are zero.
+	///@{
+	std::vector<double> intensity;          ///< Sum of the intensities
+	std::vector<double> weighted_centroid_x;
+	std::vector<double> weighted_centroid_y;
+	std::vector<double> weighted_xx, weighted_xy, weighted_yy;
+	///@}
+
+	///The number of components
+	size_t size() const
+	{
+		return area.size();
+	}
+};
+
+///Limits on the size of the components which are kept. Components outside
+///the limits are labelled as background and left out of the numbering.
+///@ingroup gVision
+struct ComponentFilter
+{
+	int min_area = 0;
+	int max_area = INT_MAX;
+	ImageRef min_size = ImageRef(0, 0);              ///< Smallest bounding box width and height
+	ImageRef max_size = ImageRef(INT_MAX, INT_MAX); ///< Largest bounding box width and height
+};
+
+///Label the connected components of the non-zero pixels of an image, and gather
+///the statistics of each component in the same pass. Components can be removed
+///by size at the same time, without any lists of pixels being made.
+///See connected_components(const BasicImage<byte>&, BasicImage<int>&, Connectivity).
+///@param in The image to label
+///@param labels The label image, which must be the same size as the input
+///@param stats The statistics of each component which is kept
+///@param connectivity Which pixels are neighbours
+///@param filter Which components to keep
+///@return The number of components kept
+///@ingroup gVision
+int connected_components(const BasicImage<byte>& in, BasicImage<int>& labels, ComponentStatistics& stats, Connectivity connectivity = Connectivity::Four, const ComponentFilter& filter = ComponentFilter());
+int connected_components(const BinaryImage& in, BasicImage<int>& labels, ComponentStatistics& stats, Connectivity connectivity = Connectivity::Four, const ComponentFilter& filter = ComponentFilter());
+
+///Label the connected components of the non-zero pixels of an image, and gather
+///the statistics of each component including the intensity weighted statistics.
+///@param in The image to label
+///@param grey The intensities, which must be the same size as the input
+///@param labels The label image, which must be the same size as the input
+///@param stats The statistics of each component which is kept
+///@param connectivity Which pixels are neighbours
+///@param filter Which components to keep
+///@return The number of components kept
+///@ingroup gVision
+int connected_components(const BasicImage<byte>& in, const BasicImage<byte>& grey, BasicImage<int>& labels, ComponentStatistics& stats, Connectivity connectivity = Connectivity::Four, const ComponentFilter& filter = ComponentFilter());
+int connected_components(const BinaryImage& in, const BasicImage<byte>& grey, BasicImage<int>& labels, ComponentStatistics& stats, Connectivity connectivity = Connectivity::Four, const ComponentFilter& filter = ComponentFilter());
+
+///Label the connected regions of a label image, and gather the statistics of each
+///region. See connected_regions(const BasicImage<byte>&, BasicImage<int>&, Connectivity)
+///and connected_components(const BasicImage<byte>&, BasicImage<int>&, ComponentStatistics&, Connectivity, const ComponentFilter&).
+///@ingroup gVision
+int connected_regions(const BasicImage<byte>& in, BasicImage<int>& labels, ComponentStatistics& stats, Connectivity connectivity = Connectivity::Four, const ComponentFilter& filter = ComponentFilter());
+int connected_regions(const BasicImage<int>& in, BasicImage<int>& labels, ComponentStatistics& stats, Connectivity connectivity = Connectivity::Four, const ComponentFilter& filter = ComponentFilter());
 }
 
 #endif
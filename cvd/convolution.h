@@ -3,8 +3,12 @@
 #define CVD_CONVOLUTION_H_
 
 #include <algorithm>
+#include <climits>
+#include <limits>
 #include <memory>
 #include <numeric>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <cvd/config.h>
@@ -187,6 +191,14 @@ void convolveWithBox(const BasicImage<T>& I, BasicImage<T>& J, ImageRef hwin)
 	}
 }
 
+/// Box filter for colour images, with the same results as the generic convolveWithBox().
+/// The components are processed interleaved, without splitting the image in to planes.
+/// @ingroup gVision
+void convolveWithBox(const BasicImage<Rgb<byte>>& I, BasicImage<Rgb<byte>>& J, ImageRef hwin);
+void convolveWithBox(const BasicImage<Rgba<byte>>& I, BasicImage<Rgba<byte>>& J, ImageRef hwin);
+void convolveWithBox(const BasicImage<Rgb<float>>& I, BasicImage<Rgb<float>>& J, ImageRef hwin);
+void convolveWithBox(const BasicImage<Rgba<float>>& I, BasicImage<Rgba<float>>& J, ImageRef hwin);
+
 template <class T>
 inline void convolveWithBox(const BasicImage<T>& I, BasicImage<T>& J, int hwin)
 {
@@ -618,6 +630,50 @@ void van_vliet_blur(const double b[], const BasicImage<float> in, BasicImage<flo
 void convolveGaussian(const BasicImage<float>& I, BasicImage<float>& out, double sigma, double sigmas = 3.0);
 void convolveGaussian_fir(const BasicImage<float>& I, BasicImage<float>& out, double sigma, double sigmas = 3.0);
 
+/// Gaussian blur of colour images, using the same kernel as the generic
+/// convolveGaussian(). The components are filtered interleaved, with a pixel step of
+/// 3 or 4 components, so no per-channel copies are made and the loops vectorise.
+/// The output may be the input image.
+/// @ingroup gVision
+void convolveGaussian(const BasicImage<Rgb<byte>>& I, BasicImage<Rgb<byte>>& out, double sigma, double sigmas = 3.0);
+void convolveGaussian(const BasicImage<Rgba<byte>>& I, BasicImage<Rgba<byte>>& out, double sigma, double sigmas = 3.0);
+void convolveGaussian(const BasicImage<Rgb<float>>& I, BasicImage<Rgb<float>>& out, double sigma, double sigmas = 3.0);
+void convolveGaussian(const BasicImage<Rgba<float>>& I, BasicImage<Rgba<float>>& out, double sigma, double sigmas = 3.0);
+
+/// Method used to evaluate an arbitrary 2D kernel in convolve() and correlate().
+/// @ingroup gVision
+enum class ConvolutionMethod
+{
+	Automatic, ///< Choose the cheaper of the two methods below based on the kernel size
+	Direct,    ///< Evaluate the kernel directly, one vectorisable multiply-add per kernel element per pixel
+	FFT        ///< Overlap-save tiling with a real FFT. Cost is nearly independent of the kernel size
+};
+
+/// Convolve an image with an arbitrary (non separable) 2D kernel. The centre of the kernel
+/// is at <code>kernel.size()/2</code> and pixels beyond the edge of the image take the value
+/// of the nearest edge pixel. For small kernels the direct method is used. For large ones
+/// (from about 15x15) the image is processed in tiles with a real FFT.
+/// @param in input image
+/// @param kernel kernel, which must have odd dimensions
+/// @param out output image, which must be the same size as the input. It may be the input image.
+/// @param method algorithm to use
+/// @throw Exceptions::Convolution::IncompatibleImageSizes if in and out differ in size
+/// @throw Exceptions::Convolution::OddSizedKernelRequired if the kernel is not odd sized
+/// @ingroup gVision
+void convolve(const BasicImage<float>& in, const BasicImage<float>& kernel, BasicImage<float>& out, ConvolutionMethod method = ConvolutionMethod::Automatic);
+
+/// Correlate an image with an arbitrary 2D kernel. This is the same as convolve() with the kernel
+/// rotated by 180 degrees, so it computes
+/// <code>out[y][x] = sum kernel[j][i] * in[y + j - kernel.size().y/2][x + i - kernel.size().x/2]</code>.
+/// @param in input image
+/// @param kernel kernel, which must have odd dimensions
+/// @param out output image, which must be the same size as the input. It may be the input image.
+/// @param method algorithm to use
+/// @throw Exceptions::Convolution::IncompatibleImageSizes if in and out differ in size
+/// @throw Exceptions::Convolution::OddSizedKernelRequired if the kernel is not odd sized
+/// @ingroup gVision
+void correlate(const BasicImage<float>& in, const BasicImage<float>& kernel, BasicImage<float>& out, ConvolutionMethod method = ConvolutionMethod::Automatic);
+
 template <class T, class O, class K>
 void convolve_gaussian_3(const BasicImage<T>& I, BasicImage<O>& out, K k1, K k2)
 {
@@ -637,6 +693,304 @@ void convolve_gaussian_3(const BasicImage<T>& I, BasicImage<O>& out, K k1, K k2)
 	}
 }
 
+/// A 1D convolution kernel whose size and coefficients are compile time constants,
+/// for use with convolveSeparableFixed(). The kernel computes
+/// <code>sum(C[k] * I[x + k - radius]) / Divisor</code>. Since the kernel is known
+/// to the compiler, the loop over it is fully unrolled, zero coefficients are dropped
+/// and the coefficients are held in registers. See FixedKernels for common kernels.
+/// @param Divisor normalising constant
+/// @param C the coefficients, of which there must be an odd number
+/// @ingroup gVision
+template <int Divisor, int... C>
+struct FixedKernel
+{
+	static_assert(sizeof...(C) % 2 == 1, "FixedKernel needs an odd number of coefficients");
+	static_assert(Divisor > 0, "FixedKernel divisor must be positive");
+
+	static constexpr int size = sizeof...(C);
+	static constexpr int radius = size / 2;
+	static constexpr int divisor = Divisor;
+	static constexpr int coefficients[size] = { C... };
+	static constexpr long long abs_sum = (0LL + ... + (C < 0 ? -static_cast<long long>(C) : C));
+	static constexpr bool non_negative = (true && ... && (C >= 0));
+};
+
+/// A 2D convolution kernel whose size and coefficients are compile time constants,
+/// for use with convolveFixed(). The coefficients are given in row major order.
+/// @param Divisor normalising constant
+/// @param Width number of columns. The number of rows is deduced from the number of coefficients.
+/// @param C the coefficients
+/// @ingroup gVision
+template <int Divisor, int Width, int... C>
+struct FixedKernel2D
+{
+	static_assert(Width % 2 == 1 && sizeof...(C) % Width == 0 && (sizeof...(C) / Width) % 2 == 1, "FixedKernel2D needs odd dimensions");
+	static_assert(Divisor > 0, "FixedKernel2D divisor must be positive");
+
+	static constexpr int width = Width;
+	static constexpr int height = sizeof...(C) / Width;
+	static constexpr int divisor = Divisor;
+	static constexpr int coefficients[sizeof...(C)] = { C... };
+	static constexpr long long abs_sum = (0LL + ... + (C < 0 ? -static_cast<long long>(C) : C));
+	static constexpr bool non_negative = (true && ... && (C >= 0));
+};
+
+/// Commonly used compile time kernels. The Sobel operator is
+/// <code>convolveSeparableFixed<Difference3, Binomial3></code> for the x gradient and
+/// <code>convolveSeparableFixed<Binomial3, Difference3></code> for y, which gives the
+/// usual Sobel response divided by 4. Likewise, Scharr uses Scharr3 in place of Binomial3,
+/// giving the usual response divided by 16.
+/// @ingroup gVision
+namespace FixedKernels
+{
+	/// [1 2 1] / 4
+	using Binomial3 = FixedKernel<4, 1, 2, 1>;
+	/// [1 4 6 4 1] / 16
+	using Binomial5 = FixedKernel<16, 1, 4, 6, 4, 1>;
+	/// The kernel used by convolveGaussian5_1(), in 16 bit fixed point
+	using Gaussian5 = FixedKernel<65536, 3571, 16004, 26386, 16004, 3571>;
+	/// Central difference [-1 0 1]
+	using Difference3 = FixedKernel<1, -1, 0, 1>;
+	/// Smoothing part of the Scharr operator, [3 10 3] / 16
+	using Scharr3 = FixedKernel<16, 3, 10, 3>;
+	/// 3x3 box filter
+	using Box3x3 = FixedKernel2D<9, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1>;
+	/// 4-neighbour Laplacian
+	using Laplacian3x3 = FixedKernel2D<1, 3, 0, 1, 0, 1, -4, 1, 0, 1, 0>;
+}
+
+#ifndef DOXYGEN_IGNORE_INTERNAL
+namespace Internal
+{
+	namespace FixedConvolution
+	{
+		template <int C, class A, class P>
+		inline A term(const P& p)
+		{
+			if constexpr(C == 0)
+				return A(0);
+			else if constexpr(C == 1)
+				return static_cast<A>(p);
+			else if constexpr(C == -1)
+				return -static_cast<A>(p);
+			else
+				return static_cast<A>(C) * static_cast<A>(p);
+		}
+
+		// Sum of C[k] * p[(k - radius) * stride]
+		template <class K, class A, class P, size_t... I>
+		inline A apply(const P* p, ptrdiff_t stride, std::index_sequence<I...>)
+		{
+			return (A(0) + ... + term<K::coefficients[I], A>(p[(static_cast<ptrdiff_t>(I) - K::radius) * stride]));
+		}
+
+		// Sum of C[k] * rows[k][i]
+		template <class K, class A, class P, size_t... I>
+		inline A apply_rows(const P* const* rows, int i, std::index_sequence<I...>)
+		{
+			return (A(0) + ... + term<K::coefficients[I], A>(rows[I][i]));
+		}
+
+		// Sum of C[j][k] * rows[j][i + k * n]
+		template <class K, class A, class P, size_t... I>
+		inline A apply_2d(const P* const* rows, int i, int n, std::index_sequence<I...>)
+		{
+			return (A(0) + ... + term<K::coefficients[I], A>(rows[I / K::width][i + static_cast<int>(I % K::width) * n]));
+		}
+
+		// Divide, rounding to nearest for integers. If the sum is known to be
+		// non-negative, the sign test is skipped.
+		template <int D, bool NonNegative, class A>
+		inline A divide(A sum)
+		{
+			if constexpr(D == 1)
+				return sum;
+			else if constexpr(std::is_floating_point<A>::value)
+				return sum * (A(1) / D);
+			else if constexpr(NonNegative)
+				return (sum + D / 2) / D;
+			else
+				return (sum + (sum < 0 ? -(D / 2) : D / 2)) / D;
+		}
+
+		template <class D, class A>
+		inline D saturate(A v)
+		{
+			if constexpr(std::is_integral<D>::value)
+			{
+				const A lo = static_cast<A>(std::numeric_limits<D>::min());
+				const A hi = static_cast<A>(std::numeric_limits<D>::max());
+				return static_cast<D>(v < lo ? lo : (v > hi ? hi : v));
+			}
+			else
+				return static_cast<D>(v);
+		}
+
+		// Largest magnitude of a pixel component, or 1 for floating point types.
+		template <class C>
+		constexpr long long magnitude()
+		{
+			if constexpr(std::is_floating_point<C>::value)
+				return 1;
+			else
+				return std::max(static_cast<long long>(std::numeric_limits<C>::max()), -static_cast<long long>(std::numeric_limits<C>::min()));
+		}
+
+		// Floating point components accumulate in their own type. Integers use int
+		// unless the kernel could overflow it.
+		template <class C, long long Bound>
+		using Accumulator = typename std::conditional<std::is_floating_point<C>::value, C,
+		    typename std::conditional<(Bound <= INT_MAX), int, long long>::type>::type;
+	}
+}
+#endif
+
+/// Convolve an image with a separable kernel known at compile time, for example
+/// <code>convolveSeparableFixed<FixedKernels::Binomial5, FixedKernels::Binomial5>(in, out)</code>.
+/// The vertical kernel is applied first and the intermediate result is rounded and
+/// divided by its divisor, in the same way as convolveGaussian5_1(). Pixels beyond the
+/// edge of the image take the value of the nearest edge pixel. Multi-component pixels
+/// (such as Rgb<byte>) are processed as interleaved arrays of components, so the inner
+/// loops are contiguous and vectorise without splitting the image in to planes.
+/// Integer outputs are saturated.
+/// @param KX the horizontal FixedKernel
+/// @param KY the vertical FixedKernel
+/// @param in input image
+/// @param out output image, which must be the same size as the input. It may be the input image.
+/// @throw Exceptions::Convolution::IncompatibleImageSizes if in and out differ in size
+/// @ingroup gVision
+template <class KX, class KY, class S, class D>
+void convolveSeparableFixed(const BasicImage<S>& in, BasicImage<D>& out)
+{
+	using namespace Internal::FixedConvolution;
+	typedef typename Pixel::Component<S>::type SC;
+	typedef typename Pixel::Component<D>::type DC;
+	const int N = Pixel::Component<S>::count;
+	static_assert(Pixel::Component<D>::count == N, "convolveSeparableFixed: pixel types must have the same number of components");
+	static_assert(sizeof(S) == N * sizeof(SC) && sizeof(D) == N * sizeof(DC), "convolveSeparableFixed: pixels must be packed arrays of components");
+
+	constexpr long long vertical_bound = magnitude<SC>() * KY::abs_sum;
+	constexpr long long horizontal_bound = (vertical_bound / KY::divisor + 1) * KX::abs_sum;
+	typedef Accumulator<SC, std::max(vertical_bound, horizontal_bound)> A;
+	constexpr bool unsigned_input = !std::numeric_limits<SC>::is_signed;
+
+	if(in.size() != out.size())
+		throw Exceptions::Convolution::IncompatibleImageSizes("convolveSeparableFixed");
+
+	if(static_cast<const void*>(in.data()) == static_cast<const void*>(out.data()))
+	{
+		Image<S> copy(in.size());
+		copy.copy_from(in);
+		convolveSeparableFixed<KX, KY>(copy, out);
+		return;
+	}
+
+	const int w = in.size().x;
+	const int h = in.size().y;
+	const int n = w * N;
+	const int rx = KX::radius;
+	if(w == 0 || h == 0)
+		return;
+
+	std::vector<A> buffer((w + 2 * rx) * N);
+	A* row = buffer.data() + rx * N;
+	const SC* rows[KY::size];
+
+	for(int y = 0; y < h; y++)
+	{
+		for(int k = 0; k < KY::size; k++)
+			rows[k] = reinterpret_cast<const SC*>(in[std::min(std::max(y + k - KY::radius, 0), h - 1)]);
+
+		for(int i = 0; i < n; i++)
+			row[i] = divide<KY::divisor, unsigned_input && KY::non_negative>(apply_rows<KY, A>(rows, i, std::make_index_sequence<KY::size>()));
+
+		for(int x = 0; x < rx; x++)
+			for(int c = 0; c < N; c++)
+			{
+				row[(-1 - x) * N + c] = row[c];
+				row[(w + x) * N + c] = row[(w - 1) * N + c];
+			}
+
+		DC* o = reinterpret_cast<DC*>(out[y]);
+		for(int i = 0; i < n; i++)
+			o[i] = saturate<DC>(divide<KX::divisor, unsigned_input && KY::non_negative && KX::non_negative>(apply<KX, A>(row + i, N, std::make_index_sequence<KX::size>())));
+	}
+}
+
+/// Convolve an image with a 2D kernel known at compile time, for example
+/// <code>convolveFixed<FixedKernels::Laplacian3x3>(in, out)</code>. Pixels beyond the
+/// edge of the image take the value of the nearest edge pixel. Multi-component pixels
+/// are handled as in convolveSeparableFixed(). Integer outputs are saturated.
+/// @param K the FixedKernel2D
+/// @param in input image
+/// @param out output image, which must be the same size as the input. It may be the input image.
+/// @throw Exceptions::Convolution::IncompatibleImageSizes if in and out differ in size
+/// @ingroup gVision
+template <class K, class S, class D>
+void convolveFixed(const BasicImage<S>& in, BasicImage<D>& out)
+{
+	using namespace Internal::FixedConvolution;
+	typedef typename Pixel::Component<S>::type SC;
+	typedef typename Pixel::Component<D>::type DC;
+	const int N = Pixel::Component<S>::count;
+	static_assert(Pixel::Component<D>::count == N, "convolveFixed: pixel types must have the same number of components");
+	static_assert(sizeof(S) == N * sizeof(SC) && sizeof(D) == N * sizeof(DC), "convolveFixed: pixels must be packed arrays of components");
+	typedef Accumulator<SC, magnitude<SC>() * K::abs_sum> A;
+	constexpr bool non_negative = !std::numeric_limits<SC>::is_signed && K::non_negative;
+
+	if(in.size() != out.size())
+		throw Exceptions::Convolution::IncompatibleImageSizes("convolveFixed");
+
+	if(static_cast<const void*>(in.data()) == static_cast<const void*>(out.data()))
+	{
+		Image<S> copy(in.size());
+		copy.copy_from(in);
+		convolveFixed<K>(copy, out);
+		return;
+	}
+
+	const int w = in.size().x;
+	const int h = in.size().y;
+	const int n = w * N;
+	const int rx = K::width / 2;
+	const int ry = K::height / 2;
+	const int padded = (w + 2 * rx) * N;
+	if(w == 0 || h == 0)
+		return;
+
+	// Ring of edge-padded input rows. Row y+k-ry lives in slot (y+k) % height.
+	std::vector<SC> storage(padded * K::height);
+	std::vector<int> slot_row(K::height, -1);
+	const SC* rows[K::height];
+
+	for(int y = 0; y < h; y++)
+	{
+		for(int k = 0; k < K::height; k++)
+		{
+			const int src = std::min(std::max(y + k - ry, 0), h - 1);
+			const int slot = (y + k) % K::height;
+			SC* p = storage.data() + slot * padded;
+			if(slot_row[slot] != src)
+			{
+				const SC* r = reinterpret_cast<const SC*>(in[src]);
+				std::copy(r, r + n, p + rx * N);
+				for(int x = 0; x < rx; x++)
+					for(int c = 0; c < N; c++)
+					{
+						p[x * N + c] = r[c];
+						p[(rx + w + x) * N + c] = r[(w - 1) * N + c];
+					}
+				slot_row[slot] = src;
+			}
+			rows[k] = p;
+		}
+
+		DC* o = reinterpret_cast<DC*>(out[y]);
+		for(int i = 0; i < n; i++)
+			o[i] = saturate<DC>(divide<K::divisor, non_negative>(apply_2d<K, A>(rows, i, N, std::make_index_sequence<K::width * K::height>())));
+	}
+}
+
 } // namespace CVD
 
 #endif
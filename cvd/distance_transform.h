@@ -6,8 +6,11 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cvd/binary_image.h>
 #include <cvd/image.h>
+#include <cvd/internal/slice.h>
 #include <limits>
+#include <type_traits>
 #include <vector>
 
 namespace CVD
@@ -19,77 +22,136 @@ class DistanceTransformEuclidean
 	// Implements
 	// Distance Transforms of Sampled Functions
 	//   Pedro F. Felzenszwalb Daniel P. Huttenlocher
+	//
+	// The columns are transformed a block at a time: each block is copied in
+	// to a transposed tile, so that every column is contiguous in memory, and
+	// the blocks are shared between threads. The rows are then shared between
+	// threads.
 
 	public:
 	DistanceTransformEuclidean()
-	    : sz(ImageRef(-1, -1))
-	    , big_number(1'000'000'000) //Hmm, why doesn't HUGE_VAL work?
+	    : big_number(1'000'000'000) //Hmm, why doesn't HUGE_VAL work?
 	//Anyway, hilariously small number here so it works with int, too.
 	{
 	}
 
 	private:
-	inline void transform_row(const int n)
+	// Working space for the lower envelope of one row or column.
+	struct Envelope
 	{
-		v[0] = 0; //std::numeric_limits<Precision>::infinity();
-		z[0] = -big_number; //std::numeric_limits<Precision>::infinity();
-		z[1] = +big_number; // std::numeric_limits<Precision>::infinity();
-		int k = 0;
-		for(int q = 1; q < n; q++)
+		explicit Envelope(int m)
+		    : d(m)
+		    , z(m + 1)
+		    , pos(m)
+		    , v(m)
 		{
-			Precision s = ((f[q] + (q * q)) - (f[v[k]] + (v[k] * v[k]))) / (2 * q - 2 * v[k]);
-			while(s <= z[k])
-			{
-				k--;
-				s = ((f[q] + (q * q)) - (f[v[k]] + (v[k] * v[k]))) / (2 * q - 2 * v[k]);
-			}
-			k++;
-			v[k] = q;
-			z[k] = s;
-			z[k + 1] = +big_number; //std::numeric_limits<Precision>::infinity();
 		}
-		k = 0;
-		for(int q = 0; q < n; q++)
+
+		std::vector<Precision> d;
+		std::vector<Precision> z;
+		std::vector<Precision> pos;
+		std::vector<int> v;
+
+		// Where the parabolas from v and q meet. For integer precision this
+		// rounds down, which gives the exact envelope at the integer samples,
+		// where rounding towards zero does not.
+		static Precision intersection(const Precision* f, int q, int v)
 		{
-			while(z[k + 1] < q)
-			{
-				k++;
-			}
-			d[q] = ((q - v[k]) * (q - v[k])) + f[v[k]];
-			pos[q] = q > v[k] ? (q - v[k]) : (v[k] - q);
-			//cout << "n=" << n << " q=" << q << " d[q]=" << d[q] << " v[k]=" << v[k] << " f[v[k]]=" << f[v[k]] << endl;
+			const Precision num = (f[q] + (q * q)) - (f[v] + (v * v));
+			const Precision den = 2 * q - 2 * v;
+			if constexpr(std::is_integral<Precision>::value)
+				if(num < 0 && num % den != 0)
+					return num / den - 1;
+			return num / den;
 		}
-	}
 
-	void transform_image(BasicImage<Precision>& DT)
-	{
-		const ImageRef img_sz(DT.size());
-		for(int x = 0; x < img_sz.x; x++)
+		inline void transform_row(const Precision* f, const int n, const int big_number)
 		{
-			for(int y = 0; y < img_sz.y; y++)
+			v[0] = 0; //std::numeric_limits<Precision>::infinity();
+			z[0] = -big_number; //std::numeric_limits<Precision>::infinity();
+			z[1] = +big_number; // std::numeric_limits<Precision>::infinity();
+			int k = 0;
+			for(int q = 1; q < n; q++)
 			{
-				f[y] = DT[y][x];
+				Precision s = intersection(f, q, v[k]);
+				while(s <= z[k])
+				{
+					k--;
+					s = intersection(f, q, v[k]);
+				}
+				k++;
+				v[k] = q;
+				z[k] = s;
+				z[k + 1] = +big_number; //std::numeric_limits<Precision>::infinity();
 			}
-			transform_row(img_sz.y);
-			for(int y = 0; y < img_sz.y; y++)
+			k = 0;
+			for(int q = 0; q < n; q++)
 			{
-				DT[y][x] = d[y];
+				while(z[k + 1] < q)
+				{
+					k++;
+				}
+				d[q] = ((q - v[k]) * (q - v[k])) + f[v[k]];
+				pos[q] = q > v[k] ? (q - v[k]) : (v[k] - q);
 			}
 		}
-		//#if 0
-		for(int y = 0; y < img_sz.y; y++)
-		{
-			for(int x = 0; x < img_sz.x; x++)
+	};
+
+	void transform_columns(BasicImage<Precision>& DT)
+	{
+		const int w = DT.size().x;
+		const int h = DT.size().y;
+
+		// Enough columns to fill a cache line of a row on the way in and out.
+		const int block = std::max<int>(8, 64 / sizeof(Precision));
+		const int blocks = (w + block - 1) / block;
+
+		internal::Slice(blocks, internal::SliceHeight(blocks), [&](int, int b0, int nb) {
+			Envelope e(h);
+			std::vector<Precision> tile(static_cast<size_t>(block) * h);
+
+			for(int b = b0; b < b0 + nb; b++)
 			{
-				f[x] = DT[y][x];
+				const int x0 = b * block;
+				const int cols = std::min(block, w - x0);
+
+				for(int y = 0; y < h; y++)
+				{
+					const Precision* row = DT[y] + x0;
+					for(int c = 0; c < cols; c++)
+						tile[c * h + y] = row[c];
+				}
+
+				for(int c = 0; c < cols; c++)
+				{
+					Precision* column = tile.data() + c * h;
+					e.transform_row(column, h, big_number);
+					std::copy(e.d.begin(), e.d.begin() + h, column);
+				}
+
+				for(int y = 0; y < h; y++)
+				{
+					Precision* row = DT[y] + x0;
+					for(int c = 0; c < cols; c++)
+						row[c] = tile[c * h + y];
+				}
 			}
-			transform_row(img_sz.x);
-			for(int x = 0; x < img_sz.x; x++)
+		});
+	}
+
+	void transform_image(BasicImage<Precision>& DT)
+	{
+		const ImageRef img_sz(DT.size());
+		transform_columns(DT);
+
+		internal::Slice(img_sz.y, internal::SliceHeight(img_sz.y), [&](int, int y0, int rows) {
+			Envelope e(img_sz.x);
+			for(int y = y0; y < y0 + rows; y++)
 			{
-				DT[y][x] = d[x];
+				e.transform_row(DT[y], img_sz.x, big_number);
+				std::copy(e.d.begin(), e.d.begin() + img_sz.x, DT[y]);
 			}
-		}
-		//#endif
+		});
 	}
 
 	template <class Functor>
@@ -99,81 +161,53 @@ class DistanceTransformEuclidean
 	{
 		const ImageRef img_sz(DT.size());
 		const double maxdist = img_sz.x * img_sz.y;
-		for(int x = 0; x < img_sz.x; x++)
-		{
-			for(int y = 0; y < img_sz.y; y++)
-			{
-				f[y] = DT[y][x];
-			}
-			transform_row(img_sz.y);
-			for(int y = 0; y < img_sz.y; y++)
-			{
-				DT[y][x] = d[y];
-			}
-		}
-		for(int y = 0; y < img_sz.y; y++)
-		{
-			for(int x = 0; x < img_sz.x; x++)
-			{
-				f[x] = DT[y][x];
-			}
-			transform_row(img_sz.x);
-			for(int x = 0; x < img_sz.x; x++)
+		transform_columns(DT);
+
+		internal::Slice(img_sz.y, internal::SliceHeight(img_sz.y), [&](int, int y0, int rows) {
+			Envelope e(img_sz.x);
+			for(int y = y0; y < y0 + rows; y++)
 			{
-				DT[y][x] = d[x];
-				const double hyp = d[x];
-				if(hyp >= maxdist)
+				e.transform_row(DT[y], img_sz.x, big_number);
+				const Precision* d = e.d.data();
+				for(int x = 0; x < img_sz.x; x++)
 				{
-					ADT[y][x] = ImageRef(-1, -1);
-					continue;
-				}
-				const double dx = pos[x];
-				const double dy = sqrt(hyp - dx * dx);
-				const int ddy = static_cast<int>(dy);
-				const ImageRef candA(static_cast<int>(x - dx), static_cast<int>(y - ddy));
-				const ImageRef candB(static_cast<int>(x - dx), static_cast<int>(y + ddy));
-				const ImageRef candC(static_cast<int>(x + dx), static_cast<int>(y - ddy));
-				const ImageRef candD(static_cast<int>(x + dx), static_cast<int>(y + ddy));
-				/** cerr << "hyp=" << hyp << " dx="<< dx << " dy=" << dy << " ddy=" << ddy
-								  << " A=" << candA << " B=" << candB << " C=" << candC << " D=" << candD << endl;*/
-				if(DT.in_image(candA) && func(candA))
-				{
-					ADT[y][x] = candA;
-				}
-				else if(DT.in_image(candB) && func(candB))
-				{
-					ADT[y][x] = candB;
-				}
-				else if(DT.in_image(candC) && func(candC))
-				{
-					ADT[y][x] = candC;
-				}
-				else if(DT.in_image(candD) && func(candD))
-				{
-					ADT[y][x] = candD;
-				}
-				else
-				{
-					//ADT[y][x] = ImageRef(-1,-1);
-					/**cerr << hyp << " " << ImageRef(x, y);*/
-					throw Exceptions::Vision::BadInput("DistanceTransformEuclidean: no points set");
+					DT[y][x] = d[x];
+					const double hyp = d[x];
+					if(hyp >= maxdist)
+					{
+						ADT[y][x] = ImageRef(-1, -1);
+						continue;
+					}
+					const double dx = e.pos[x];
+					const double dy = sqrt(hyp - dx * dx);
+					const int ddy = static_cast<int>(dy);
+					const ImageRef candA(static_cast<int>(x - dx), static_cast<int>(y - ddy));
+					const ImageRef candB(static_cast<int>(x - dx), static_cast<int>(y + ddy));
+					const ImageRef candC(static_cast<int>(x + dx), static_cast<int>(y - ddy));
+					const ImageRef candD(static_cast<int>(x + dx), static_cast<int>(y + ddy));
+					if(DT.in_image(candA) && func(candA))
+					{
+						ADT[y][x] = candA;
+					}
+					else if(DT.in_image(candB) && func(candB))
+					{
+						ADT[y][x] = candB;
+					}
+					else if(DT.in_image(candC) && func(candC))
+					{
+						ADT[y][x] = candC;
+					}
+					else if(DT.in_image(candD) && func(candD))
+					{
+						ADT[y][x] = candD;
+					}
+					else
+					{
+						throw Exceptions::Vision::BadInput("DistanceTransformEuclidean: no points set");
+					}
 				}
 			}
-		}
-	}
-
-	void resize(const ImageRef& new_size)
-	{
-		if(new_size != sz)
-		{
-			sz = new_size;
-			int m(std::max(new_size.x, new_size.y));
-			d.resize(m);
-			v.resize(m);
-			f.resize(m);
-			pos.resize(m);
-			z.resize(m + 1);
-		}
+		});
 	}
 
 	public:
@@ -186,16 +220,26 @@ class DistanceTransformEuclidean
 		if(feature.size() != ADT.size())
 			throw Exceptions::Vision::IncompatibleImageSizes(__FUNCTION__);
 
-		resize(feature.size());
-
 		apply_functor(DT, NotZero<T>(feature));
 
 		transform_image_with_ADT(DT, ADT, NotZero<T>(feature));
 	}
 
+	void transform_ADT(const BinaryImage& feature, BasicImage<Precision>& DT, BasicImage<ImageRef>& ADT)
+	{
+		if(feature.size() != DT.size())
+			throw Exceptions::Vision::IncompatibleImageSizes(__FUNCTION__);
+
+		if(feature.size() != ADT.size())
+			throw Exceptions::Vision::IncompatibleImageSizes(__FUNCTION__);
+
+		apply_functor(DT, IsSet(feature));
+
+		transform_image_with_ADT(DT, ADT, IsSet(feature));
+	}
+
 	void transform(BasicImage<Precision>& out)
 	{
-		resize(out.size());
 		transform_image(out);
 	}
 
@@ -214,25 +258,35 @@ class DistanceTransformEuclidean
 		}
 	};
 
+	struct IsSet
+	{
+		IsSet(const BinaryImage& im_)
+		    : im(im_)
+		{
+		}
+
+		const BinaryImage& im;
+		bool operator()(const ImageRef& i) const
+		{
+			return im[i];
+		}
+	};
+
 	template <class Out, class Functor>
 	void apply_functor(BasicImage<Out>& out, const Functor& f)
 	{
-		for(int y = 0; y < out.size().y; y++)
-			for(int x = 0; x < out.size().x; x++)
-				if(f(ImageRef(x, y)))
-					out[y][x] = 0;
-				else
-					out[y][x] = big_number;
+		internal::Slice(out.size().y, internal::SliceHeight(out.size().y), [&](int, int y0, int rows) {
+			for(int y = y0; y < y0 + rows; y++)
+				for(int x = 0; x < out.size().x; x++)
+					if(f(ImageRef(x, y)))
+						out[y][x] = 0;
+					else
+						out[y][x] = big_number;
+		});
 	}
 
 	private:
-	ImageRef sz;
 	int big_number;
-	std::vector<Precision> d;
-	std::vector<int> v;
-	std::vector<Precision> z;
-	std::vector<Precision> f;
-	std::vector<Precision> pos;
 };
 
 ///Compute squared Euclidean distance transform using the Felzenszwalb & Huttenlocher algorithm.
@@ -267,6 +321,35 @@ void euclidean_distance_transform_sq(const BasicImage<T>& in, BasicImage<Q>& out
 	dt.transform_ADT(in, out, lookup_DT);
 }
 
+///Compute squared Euclidean distance transform of a bit-packed binary image.
+///@ingroup gVision
+///@param in input image: set pixels are on the object
+///@param out output image is euclidean distance of input image.
+template <class Q>
+void euclidean_distance_transform_sq(const BinaryImage& in, BasicImage<Q>& out)
+{
+	if(in.size() != out.size())
+		throw Exceptions::Vision::IncompatibleImageSizes(__FUNCTION__);
+	DistanceTransformEuclidean<Q> dt;
+	dt.apply_functor(out, typename DistanceTransformEuclidean<Q>::IsSet(in));
+	dt.transform(out);
+}
+
+///Compute squared Euclidean distance transform of a bit-packed binary image.
+///@ingroup gVision
+///@param in input image: set pixels are on the object
+///@param out output image is euclidean distance of input image.
+///@param lookup_DT For each output pixel, this is the location of the closest input pixel.
+///@throws Exceptions::Vision::BadInput Throws if the input contains no points.
+template <class Q>
+void euclidean_distance_transform_sq(const BinaryImage& in, BasicImage<Q>& out, BasicImage<ImageRef>& lookup_DT)
+{
+	if(in.size() != out.size())
+		throw Exceptions::Vision::IncompatibleImageSizes(__FUNCTION__);
+	DistanceTransformEuclidean<Q> dt;
+	dt.transform_ADT(in, out, lookup_DT);
+}
+
 ///Compute Euclidean distance transform using the Felzenszwalb & Huttenlocher algorithm.
 ///Example in examples/distance_transform.cc
 ///@ingroup gVision
@@ -298,6 +381,292 @@ void euclidean_distance_transform(const BasicImage<T>& in, BasicImage<Q>& out, B
 			out[y][x] = sqrt(out[y][x]);
 }
 
+///Compute Euclidean distance transform of a bit-packed binary image.
+///@ingroup gVision
+///@param in input image: set pixels are on the object
+///@param out output image is euclidean distance of input image.
+template <class Q>
+void euclidean_distance_transform(const BinaryImage& in, BasicImage<Q>& out)
+{
+	euclidean_distance_transform_sq(in, out);
+	for(int y = 0; y < out.size().y; y++)
+		for(int x = 0; x < out.size().x; x++)
+			out[y][x] = sqrt(out[y][x]);
+}
+
+///Compute Euclidean distance transform of a bit-packed binary image.
+///@ingroup gVision
+///@param in input image: set pixels are on the object
+///@param out output image is euclidean distance of input image.
+///@param lookup_DT For each output pixel, this is the location of the closest input pixel.
+///@throws Exceptions::Vision::BadInput Throws if the input contains no points.
+template <class Q>
+void euclidean_distance_transform(const BinaryImage& in, BasicImage<Q>& out, BasicImage<ImageRef>& lookup_DT)
+{
+	euclidean_distance_transform_sq(in, out, lookup_DT);
+	for(int y = 0; y < out.size().y; y++)
+		for(int x = 0; x < out.size().x; x++)
+			out[y][x] = sqrt(out[y][x]);
+}
+
+/// The metrics of the distance transforms which are computed by raster scans.
+/// See distance_transform().
+/// @ingroup gVision
+enum class DistanceMetric
+{
+	CityBlock,   ///< The L1 distance: steps of 1 to the four neighbours
+	Chessboard,  ///< The L infinity distance: steps of 1 to the eight neighbours
+	Chamfer34,   ///< Steps of 3 to the four neighbours and 4 diagonally: about 3 times the Euclidean distance
+	Chamfer5711, ///< Steps of 5, 7 diagonally and 11 for a knight's move: about 5 times the Euclidean distance
+};
+
+#ifndef DOXYGEN_IGNORE_INTERNAL
+namespace Internal
+{
+	// Two pass chamfer distance transforms, after Borgefors, "Distance
+	// Transformations in Digital Images", 1986. The forward pass brings each row
+	// the distances from the rows above and then from the left, and the backward
+	// pass from the rows below and then from the right. The terms from other rows
+	// are independent along the row, so those loops vectorise, and only the scan
+	// along the row is sequential.
+	struct ChamferSteps
+	{
+		int axial, diagonal, knight;
+	};
+
+	inline ChamferSteps chamfer_steps(DistanceMetric metric)
+	{
+		switch(metric)
+		{
+			case DistanceMetric::CityBlock:
+				return { 1, 2, 0 };
+			case DistanceMetric::Chessboard:
+				return { 1, 1, 0 };
+			case DistanceMetric::Chamfer34:
+				return { 3, 4, 0 };
+			case DistanceMetric::Chamfer5711:
+				return { 5, 7, 11 };
+		}
+		throw Exceptions::Vision::BadInput("distance_transform: unknown metric");
+	}
+
+	// dst[x] = min(dst[x], src[x - shift] + step) wherever src[x - shift] exists.
+	inline void chamfer_fold(int* dst, const int* src, int w, int shift, int step)
+	{
+		const int begin = std::max(0, shift);
+		const int end = std::min(w, w + shift);
+		for(int x = begin; x < end; x++)
+			dst[x] = std::min(dst[x], src[x - shift] + step);
+	}
+
+	// Bring the distances in to row dst from the rows one and two away.
+	inline void chamfer_rows(int* dst, const int* one, const int* two, int w, const ChamferSteps& s)
+	{
+		if(one)
+		{
+			chamfer_fold(dst, one, w, 0, s.axial);
+			chamfer_fold(dst, one, w, 1, s.diagonal);
+			chamfer_fold(dst, one, w, -1, s.diagonal);
+			if(s.knight)
+			{
+				chamfer_fold(dst, one, w, 2, s.knight);
+				chamfer_fold(dst, one, w, -2, s.knight);
+			}
+		}
+		if(two && s.knight)
+		{
+			chamfer_fold(dst, two, w, 1, s.knight);
+			chamfer_fold(dst, two, w, -1, s.knight);
+		}
+	}
+
+	template <class T, class Q>
+	void chamfer_distance_transform(const BasicImage<T>& in, BasicImage<Q>& out, const ChamferSteps& s)
+	{
+		const int w = in.size().x;
+		const int h = in.size().y;
+		const int far = std::numeric_limits<int>::max() / 4;
+		Image<int> d(in.size());
+
+		bool any = false;
+		for(int y = 0; y < h; y++)
+		{
+			int* row = d[y];
+			const T* p = in[y];
+			for(int x = 0; x < w; x++)
+				row[x] = p[x] != 0 ? 0 : far;
+			for(int x = 0; x < w && !any; x++)
+				any = row[x] == 0;
+
+			chamfer_rows(row, y >= 1 ? d[y - 1] : nullptr, y >= 2 ? d[y - 2] : nullptr, w, s);
+			for(int x = 1; x < w; x++)
+				row[x] = std::min(row[x], row[x - 1] + s.axial);
+		}
+
+		if(!any)
+			throw Exceptions::Vision::BadInput("distance_transform: the input contains no points");
+
+		for(int y = h - 1; y >= 0; y--)
+		{
+			int* row = d[y];
+			chamfer_rows(row, y + 1 < h ? d[y + 1] : nullptr, y + 2 < h ? d[y + 2] : nullptr, w, s);
+			for(int x = w - 2; x >= 0; x--)
+				row[x] = std::min(row[x], row[x + 1] + s.axial);
+
+			Q* o = out[y];
+			for(int x = 0; x < w; x++)
+				o[x] = static_cast<Q>(row[x]);
+		}
+	}
+
+	inline int floor_div(long long a, long long b)
+	{
+		return static_cast<int>(a >= 0 ? a / b : -((-a + b - 1) / b));
+	}
+
+	// The squared Euclidean distance transform, found exactly only out to
+	// max_distance. The distances down the columns come from a scan down and a
+	// scan up, which vectorise along the rows and stop counting at
+	// max_distance + 1. Along each row, only the columns within max_distance of a
+	// point make parabolas for the lower envelope (Meijster et al, "A General
+	// Algorithm for Computing Distance Transforms in Linear Time", 2000), and a
+	// row with none is simply filled.
+	template <class T, class Q>
+	void truncated_euclidean_distance_transform_sq(const BasicImage<T>& in, BasicImage<Q>& out, int max_distance)
+	{
+		const int w = in.size().x;
+		const int h = in.size().y;
+		const int cap = max_distance + 1;
+		const int max_sq = max_distance * max_distance;
+		Image<int> g(in.size());
+
+		for(int y = 0; y < h; y++)
+		{
+			int* row = g[y];
+			const T* p = in[y];
+			if(y == 0)
+				for(int x = 0; x < w; x++)
+					row[x] = p[x] != 0 ? 0 : cap;
+			else
+			{
+				const int* up = g[y - 1];
+				for(int x = 0; x < w; x++)
+					row[x] = p[x] != 0 ? 0 : std::min(up[x] + 1, cap);
+			}
+		}
+		for(int y = h - 2; y >= 0; y--)
+		{
+			int* row = g[y];
+			const int* down = g[y + 1];
+			for(int x = 0; x < w; x++)
+				row[x] = std::min(row[x], down[x] + 1);
+		}
+
+		internal::Slice(h, internal::SliceHeight(h), [&](int, int y0, int rows) {
+			// The sites of the lower envelope, and the column at which each
+			// starts to be the lowest.
+			std::vector<int> site(w), start(w);
+			for(int y = y0; y < y0 + rows; y++)
+			{
+				const int* f = g[y];
+				Q* o = out[y];
+				auto value = [&](int x, int i) { return (x - i) * (x - i) + f[i] * f[i]; };
+
+				int q = -1;
+				for(int u = 0; u < w; u++)
+				{
+					if(f[u] > max_distance)
+						continue;
+
+					while(q >= 0 && value(start[q], site[q]) > value(start[q], u))
+						q--;
+
+					if(q < 0)
+					{
+						q = 0;
+						site[0] = u;
+						start[0] = 0;
+					}
+					else
+					{
+						const int i = site[q];
+						const long long num = static_cast<long long>(u) * u - static_cast<long long>(i) * i + f[u] * f[u] - f[i] * f[i];
+						const int from = 1 + floor_div(num, 2LL * (u - i));
+						if(from < w)
+						{
+							q++;
+							site[q] = u;
+							start[q] = from;
+						}
+					}
+				}
+
+				if(q < 0)
+					std::fill(o, o + w, static_cast<Q>(max_sq));
+				else
+					for(int x = w - 1; x >= 0; x--)
+					{
+						o[x] = static_cast<Q>(std::min(value(x, site[q]), max_sq));
+						if(x == start[q])
+							q--;
+					}
+			}
+		});
+	}
+}
+#endif
+
+///Compute a distance transform with one of the metrics that can be found by two
+///raster scans of the image: the city block (L1), chessboard (L infinity), or
+///3-4 and 5-7-11 chamfer distances. The chamfer distances are given in units of
+///their steps, so are 3 and 5 times the Euclidean distance, approximately.
+///@ingroup gVision
+///@param in input image: thresholded so anything &gt; 0 is on the object
+///@param out output image is the distance to the nearest point of the input image.
+///@param metric the metric to use
+///@throws Exceptions::Vision::BadInput Throws if the input contains no points.
+template <class T, class Q>
+void distance_transform(const BasicImage<T>& in, BasicImage<Q>& out, DistanceMetric metric)
+{
+	if(in.size() != out.size())
+		throw Exceptions::Vision::IncompatibleImageSizes(__FUNCTION__);
+	Internal::chamfer_distance_transform(in, out, Internal::chamfer_steps(metric));
+}
+
+///Compute the squared Euclidean distance transform out to a maximum distance.
+///Distances within the maximum are exact, and pixels further from the object
+///than that are given the square of the maximum. The work done beyond the
+///maximum is small, so this is faster than the full transform for small
+///maxima.
+///@ingroup gVision
+///@param in input image: thresholded so anything &gt; 0 is on the object
+///@param out output image is the squared euclidean distance of input image.
+///@param max_distance the maximum distance
+template <class T, class Q>
+void euclidean_distance_transform_sq(const BasicImage<T>& in, BasicImage<Q>& out, int max_distance)
+{
+	if(in.size() != out.size())
+		throw Exceptions::Vision::IncompatibleImageSizes(__FUNCTION__);
+	if(max_distance < 0)
+		throw Exceptions::Vision::BadInput("euclidean_distance_transform_sq: negative maximum distance");
+	Internal::truncated_euclidean_distance_transform_sq(in, out, max_distance);
+}
+
+///Compute the Euclidean distance transform out to a maximum distance. See
+///euclidean_distance_transform_sq(const BasicImage<T>&, BasicImage<Q>&, int).
+///@ingroup gVision
+///@param in input image: thresholded so anything &gt; 0 is on the object
+///@param out output image is euclidean distance of input image.
+///@param max_distance the maximum distance
+template <class T, class Q>
+void euclidean_distance_transform(const BasicImage<T>& in, BasicImage<Q>& out, int max_distance)
+{
+	euclidean_distance_transform_sq(in, out, max_distance);
+	for(int y = 0; y < out.size().y; y++)
+		for(int x = 0; x < out.size().x; x++)
+			out[y][x] = sqrt(out[y][x]);
+}
+
 #ifndef DOXYGEN_IGNORE_INTERNAL
 namespace Internal
 {
@@ -323,6 +692,74 @@ namespace Internal
 			euclidean_distance_transform(in, im);
 		}
 	};
+
+	template <>
+	struct ImagePromise<DoDistanceTransform<BinaryImage>>
+	{
+		ImagePromise(const BinaryImage& in_)
+		    : in(in_)
+		{
+		}
+
+		const BinaryImage& in;
+
+		template <class C>
+		void execute(Image<C>& im)
+		{
+			im.resize(in.size());
+			euclidean_distance_transform(in, im);
+		}
+	};
+
+	template <class C>
+	class DoMetricDistanceTransform
+	{
+	};
+
+	template <class T>
+	struct ImagePromise<DoMetricDistanceTransform<T>>
+	{
+		ImagePromise(const BasicImage<T>& in_, DistanceMetric metric_)
+		    : in(in_)
+		    , metric(metric_)
+		{
+		}
+
+		const BasicImage<T>& in;
+		DistanceMetric metric;
+
+		template <class C>
+		void execute(Image<C>& im)
+		{
+			im.resize(in.size());
+			distance_transform(in, im, metric);
+		}
+	};
+
+	template <class C>
+	class DoTruncatedDistanceTransform
+	{
+	};
+
+	template <class T>
+	struct ImagePromise<DoTruncatedDistanceTransform<T>>
+	{
+		ImagePromise(const BasicImage<T>& in_, int max_distance_)
+		    : in(in_)
+		    , max_distance(max_distance_)
+		{
+		}
+
+		const BasicImage<T>& in;
+		int max_distance;
+
+		template <class C>
+		void execute(Image<C>& im)
+		{
+			im.resize(in.size());
+			euclidean_distance_transform(in, im, max_distance);
+		}
+	};
 };
 
 template <class T>
@@ -331,6 +768,26 @@ Internal::ImagePromise<Internal::DoDistanceTransform<T>> euclidean_distance_tran
 	using namespace Internal;
 	return ImagePromise<DoDistanceTransform<T>>(in);
 }
+
+inline Internal::ImagePromise<Internal::DoDistanceTransform<BinaryImage>> euclidean_distance_transform(const BinaryImage& in)
+{
+	using namespace Internal;
+	return ImagePromise<DoDistanceTransform<BinaryImage>>(in);
+}
+
+template <class T>
+Internal::ImagePromise<Internal::DoMetricDistanceTransform<T>> distance_transform(const BasicImage<T>& in, DistanceMetric metric)
+{
+	using namespace Internal;
+	return ImagePromise<DoMetricDistanceTransform<T>>(in, metric);
+}
+
+template <class T>
+Internal::ImagePromise<Internal::DoTruncatedDistanceTransform<T>> euclidean_distance_transform(const BasicImage<T>& in, int max_distance)
+{
+	using namespace Internal;
+	return ImagePromise<DoTruncatedDistanceTransform<T>>(in, max_distance);
+}
 #else
 
 ///Compute Euclidean distance transform using the Felzenszwalb & Huttenlocher algorithm.
@@ -340,6 +797,25 @@ Internal::ImagePromise<Internal::DoDistanceTransform<T>> euclidean_distance_tran
 ///@throws Exceptions::Vision::BadInput Throws if the input contains no points.
 template <class T>
 Image euclidean_distance_transform(const BasicImage<T>& in);
+
+///Compute a distance transform with a metric found by raster scans. See
+///distance_transform(const BasicImage<T>&, BasicImage<Q>&, DistanceMetric).
+///@ingroup gVision
+///@param in input image: thresholded so anything &gt; 0 is on the object
+///@param metric the metric to use
+///@returns output image is the distance to the nearest point of the input image.
+///@throws Exceptions::Vision::BadInput Throws if the input contains no points.
+template <class T>
+Image distance_transform(const BasicImage<T>& in, DistanceMetric metric);
+
+///Compute the Euclidean distance transform out to a maximum distance. See
+///euclidean_distance_transform_sq(const BasicImage<T>&, BasicImage<Q>&, int).
+///@ingroup gVision
+///@param in input image: thresholded so anything &gt; 0 is on the object
+///@param max_distance the maximum distance
+///@returns output image is euclidean distance of input image.
+template <class T>
+Image euclidean_distance_transform(const BasicImage<T>& in, int max_distance);
 #endif
 
 ///@example distance_transform.cc
@@ -4,6 +4,8 @@
 #include <algorithm>
 #include <cmath>
 #include <cvd/image.h>
+#include <cvd/internal/slice.h>
+#include <cvd/vision_exceptions.h>
 #include <vector>
 
 namespace CVD
@@ -32,6 +34,170 @@ namespace Internal
 		}
 		std::copy(store, store + 2 * w, from);
 	}
+
+	// The butterfly of the orthonormal transform, which turns a pair of samples
+	// in to their scaled sum and difference.
+	struct HaarOrthonormal
+	{
+		template <class T>
+		static void forward(T a, T b, T& s, T& d)
+		{
+			s = (a + b) * M_SQRT1_2;
+			d = (a - b) * M_SQRT1_2;
+		}
+
+		template <class T>
+		static void inverse(T s, T d, T& a, T& b)
+		{
+			a = (s + d) * M_SQRT1_2;
+			b = (s - d) * M_SQRT1_2;
+		}
+	};
+
+	// The S transform by lifting: the difference, then the first sample
+	// updated by half of it to give the mean rounded down. Every step can be
+	// undone exactly in integers. The shifts rely on >> of a negative number
+	// rounding down, as it does on all supported compilers.
+	struct HaarLifting
+	{
+		template <class T>
+		static void forward(T a, T b, T& s, T& d)
+		{
+			d = a - b;
+			s = b + (d >> 1);
+		}
+
+		template <class T>
+		static void inverse(T s, T d, T& a, T& b)
+		{
+			b = s - (d >> 1);
+			a = b + d;
+		}
+	};
+
+	// One step of a 2D transform applies the butterfly along the rows and/or
+	// down the columns of the w x h block at the top left of the image.
+	struct HaarStep
+	{
+		int w, h;
+		bool rows, columns;
+	};
+
+	// The rows are transformed through a scratch row, and shared between threads.
+	// If w is odd the last sample of each row is left alone, as it is down the
+	// columns.
+	template <class B, bool Inverse, class T>
+	void haar_rows(BasicImage<T>& I, int w, int h)
+	{
+		const int half = w / 2;
+		internal::Slice(h, internal::SliceHeight(h, 16), [&](int, int y0, int rows) {
+			std::vector<T> store(2 * half);
+			for(int y = y0; y < y0 + rows; y++)
+			{
+				T* r = I[y];
+				if(Inverse)
+					for(int i = 0; i < half; i++)
+						B::inverse(r[i], r[half + i], store[2 * i], store[2 * i + 1]);
+				else
+					for(int i = 0; i < half; i++)
+						B::forward(r[2 * i], r[2 * i + 1], store[i], store[half + i]);
+				std::copy(store.begin(), store.end(), r);
+			}
+		});
+	}
+
+	// The columns are transformed a block at a time. The block is copied to a
+	// tile, and each pair of rows of the tile is combined to give a pair of
+	// rows of the block, so every access is along a row and vectorises.
+	template <class B, bool Inverse, class T>
+	void haar_columns(BasicImage<T>& I, int w, int h)
+	{
+		const int block = 64;
+		const int half = h / 2;
+		const int blocks = (w + block - 1) / block;
+		internal::Slice(blocks, internal::SliceHeight(blocks), [&](int, int b0, int nb) {
+			std::vector<T> tile(static_cast<size_t>(h) * block);
+			for(int b = b0; b < b0 + nb; b++)
+			{
+				const int x0 = b * block;
+				const int n = std::min(block, w - x0);
+				for(int y = 0; y < h; y++)
+					std::copy(I[y] + x0, I[y] + x0 + n, tile.begin() + static_cast<size_t>(y) * n);
+
+				for(int i = 0; i < half; i++)
+				{
+					if(Inverse)
+					{
+						const T* s = &tile[static_cast<size_t>(i) * n];
+						const T* d = &tile[static_cast<size_t>(half + i) * n];
+						T* a = I[2 * i] + x0;
+						T* c = I[2 * i + 1] + x0;
+						for(int x = 0; x < n; x++)
+							B::inverse(s[x], d[x], a[x], c[x]);
+					}
+					else
+					{
+						const T* a = &tile[static_cast<size_t>(2 * i) * n];
+						const T* c = &tile[static_cast<size_t>(2 * i + 1) * n];
+						T* s = I[i] + x0;
+						T* d = I[half + i] + x0;
+						for(int x = 0; x < n; x++)
+							B::forward(a[x], c[x], s[x], d[x]);
+					}
+				}
+			}
+		});
+	}
+
+	// Each step is done in parallel, and the steps in turn. The inverse undoes
+	// the steps in reverse order.
+	template <class B, bool Inverse, class T>
+	void haar_steps(BasicImage<T>& I, const std::vector<HaarStep>& steps)
+	{
+		if(Inverse)
+			for(auto s = steps.rbegin(); s != steps.rend(); ++s)
+			{
+				if(s->columns)
+					haar_columns<B, true>(I, s->w, s->h);
+				if(s->rows)
+					haar_rows<B, true>(I, s->w, s->h);
+			}
+		else
+			for(const HaarStep& s : steps)
+			{
+				if(s.rows)
+					haar_rows<B, false>(I, s.w, s.h);
+				if(s.columns)
+					haar_columns<B, false>(I, s.w, s.h);
+			}
+	}
+
+	// The steps of the full transform of haar2D(), which halves each side until it is 1.
+	inline std::vector<HaarStep> haar_steps(ImageRef size)
+	{
+		std::vector<HaarStep> steps;
+		for(int w = size.x, h = size.y; w > 1 || h > 1;)
+		{
+			steps.push_back({ w, h, w > 1, h > 1 });
+			if(w > 1)
+				w /= 2;
+			if(h > 1)
+				h /= 2;
+		}
+		return steps;
+	}
+
+	// The steps of a transform with a given number of levels, each of which halves both sides.
+	inline std::vector<HaarStep> haar_steps(ImageRef size, int levels)
+	{
+		if(levels < 0 || levels > 30 || size.x % (1 << levels) != 0 || size.y % (1 << levels) != 0)
+			throw Exceptions::Vision::BadInput("haar2D: the image size must be divisible by 2^levels");
+
+		std::vector<HaarStep> steps;
+		for(int l = 0; l < levels; l++)
+			steps.push_back({ size.x >> l, size.y >> l, true, true });
+		return steps;
+	}
 }
 
 /// computes the 1D Haar transform of a signal in place. This version takes
@@ -135,7 +301,69 @@ inline void haar2D(It from, const int width, const int height, int stride = -1)
 template <class T>
 inline void haar2D(BasicImage<T>& I)
 {
-	haar2D(I.data(), I.size().x, I.size().y, I.row_stride());
+	Internal::haar_steps<Internal::HaarOrthonormal, false>(I, Internal::haar_steps(I.size()));
+}
+
+/// computes the inverse of the 2D Haar transform computed by haar2D(BasicImage<T>&)
+/// in place. Works only with images with power of two dimensions, 2^N x 2^ M.
+/// @param I image to be transformed
+/// @ingroup gVision
+template <class T>
+inline void inv_haar2D(BasicImage<T>& I)
+{
+	Internal::haar_steps<Internal::HaarOrthonormal, true>(I, Internal::haar_steps(I.size()));
+}
+
+/// computes a 2D Haar transform of an image in place, with a given number of
+/// levels. Each level transforms the rows and then the columns of the low pass
+/// quarter from the level before, at the top left of the image, leaving the
+/// sums in the top left quarter and the differences in the other three. The
+/// rows and columns of each level are shared between threads.
+/// @param I image to be transformed. Its sides must be multiples of 2^levels.
+/// @param levels the number of levels
+/// @throws Exceptions::Vision::BadInput if the sides are not multiples of 2^levels
+/// @ingroup gVision
+template <class T>
+inline void haar2D(BasicImage<T>& I, int levels)
+{
+	Internal::haar_steps<Internal::HaarOrthonormal, false>(I, Internal::haar_steps(I.size(), levels));
+}
+
+/// computes the inverse of haar2D(BasicImage<T>&, int) in place.
+/// @param I image to be transformed. Its sides must be multiples of 2^levels.
+/// @param levels the number of levels
+/// @throws Exceptions::Vision::BadInput if the sides are not multiples of 2^levels
+/// @ingroup gVision
+template <class T>
+inline void inv_haar2D(BasicImage<T>& I, int levels)
+{
+	Internal::haar_steps<Internal::HaarOrthonormal, true>(I, Internal::haar_steps(I.size(), levels));
+}
+
+/// computes an integer 2D Haar transform (the S transform) of an image in place,
+/// with a given number of levels, laid out as for haar2D(BasicImage<T>&, int).
+/// Each pair of pixels a, b becomes the mean floor((a + b) / 2) and the
+/// difference a - b, which is exactly invertible with inv_integer_haar2D(). The
+/// differences need one more bit than the input for each level.
+/// @param I image to be transformed, of a signed integer type. Its sides must be multiples of 2^levels.
+/// @param levels the number of levels
+/// @throws Exceptions::Vision::BadInput if the sides are not multiples of 2^levels
+/// @ingroup gVision
+template <class T>
+inline void integer_haar2D(BasicImage<T>& I, int levels)
+{
+	Internal::haar_steps<Internal::HaarLifting, false>(I, Internal::haar_steps(I.size(), levels));
+}
+
+/// computes the inverse of integer_haar2D() in place.
+/// @param I image to be transformed. Its sides must be multiples of 2^levels.
+/// @param levels the number of levels
+/// @throws Exceptions::Vision::BadInput if the sides are not multiples of 2^levels
+/// @ingroup gVision
+template <class T>
+inline void inv_integer_haar2D(BasicImage<T>& I, int levels)
+{
+	Internal::haar_steps<Internal::HaarLifting, true>(I, Internal::haar_steps(I.size(), levels));
 }
 
 }
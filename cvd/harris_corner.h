@@ -4,11 +4,14 @@
 #include <algorithm>
 #include <cmath>
 #include <cstdlib>
+#include <functional>
 #include <utility>
 #include <vector>
 
+#include <cvd/config.h>
 #include <cvd/convolution.h>
 #include <cvd/image.h>
+#include <cvd/internal/slice.h>
 
 namespace CVD
 {
@@ -65,6 +68,160 @@ namespace Harris
 	};
 }
 
+#ifndef DOXYGEN_IGNORE_INTERNAL
+namespace Internal
+{
+	// The kernel of the generic convolveGaussian(), computed in the same way.
+	struct HarrisKernel
+	{
+		HarrisKernel(double sigma, double sigmas);
+
+		int ksize;
+		std::vector<float> kernel;
+		double factor;
+	};
+
+	// The blurs along a row and down the columns, which use the same operations
+	// in the same order as the generic convolveGaussian(). They are compiled in
+	// the library alongside it, so that the compiler options which may affect
+	// the rounding are the same. The column blur takes the 2*ksize+1 rows
+	// centred on the row to blur, repeating the end rows of the image.
+	void harris_blur_row(const float* in, float* out, int w, const HarrisKernel& k);
+	void harris_blur_column(const float* const* rows, float* out, int w, const HarrisKernel& k);
+
+	// The Harris detector for one band of rows, streamed through rolling
+	// buffers. For each row of the image it finds the gradient products and
+	// blurs them along the row in to a ring of the 2*ksize+1 rows which the
+	// vertical blur of a row needs. The blurred rows are scored in to a ring
+	// of three rows for the non maximum suppression.
+	template <class Score, class B>
+	class HarrisBand
+	{
+		public:
+		HarrisBand(const BasicImage<B>& im_, const HarrisKernel& k_, int kspread_)
+		    : im(im_)
+		    , k(k_)
+		    , w(im_.size().x)
+		    , h(im_.size().y)
+		    , kspread(kspread_)
+		    , ring_rows(2 * k_.ksize + 1)
+		    , ring(3 * static_cast<size_t>(ring_rows) * w)
+		    , products(3 * static_cast<size_t>(w))
+		    , blurred(3 * static_cast<size_t>(w))
+		    , scores(3 * static_cast<size_t>(w))
+		{
+		}
+
+		// Find the local maxima in rows y0 to y0+rows, in raster order.
+		void operator()(int y0, int rows, std::vector<std::pair<float, ImageRef>>& corners)
+		{
+			next_product = std::max(0, y0 - 1 - k.ksize);
+			score_row(y0 - 1);
+			score_row(y0);
+
+			for(int y = y0; y < y0 + rows; y++)
+			{
+				score_row(y + 1);
+				const float* above = score(y - 1);
+				const float* row = score(y);
+				const float* below = score(y + 1);
+				// Most pixels fail against a neighbour on the same row, and
+				// the test of those is branch free.
+				for(int x = kspread; x < w - kspread; x++)
+				{
+					const float c = row[x];
+					if((c > row[x - 1]) & (c > row[x + 1]) && c > above[x - 1] && c > above[x] && c > above[x + 1] && c > below[x - 1] && c > below[x] && c > below[x + 1])
+						corners.push_back(std::make_pair(c, ImageRef(x, y)));
+				}
+			}
+		}
+
+		private:
+		float* score(int y)
+		{
+			return &scores[static_cast<size_t>(y % 3) * w];
+		}
+
+		float* ring_row(int channel, int y)
+		{
+			return &ring[(static_cast<size_t>(channel) * ring_rows + y % ring_rows) * w];
+		}
+
+		// Gradient products of a row, which are zero on the border of the
+		// image, blurred along the row.
+		void product_row(int y)
+		{
+			typedef typename Pixel::traits<B>::wider_type gType;
+			float* xx = &products[0];
+			float* xy = xx + w;
+			float* yy = xy + w;
+			std::fill(products.begin(), products.end(), 0.f);
+
+			if(y > 0 && y < h - 1)
+			{
+				// The gradients go through small local arrays, which can not
+				// alias the image, so that both loops vectorise.
+				const int block = 64;
+				gType gx[block], gy[block];
+				for(int x0 = 1; x0 < w - 1; x0 += block)
+				{
+					const int n = std::min(block, w - 1 - x0);
+					const B* above = im[y - 1] + x0;
+					const B* row = im[y] + x0;
+					const B* below = im[y + 1] + x0;
+					for(int x = 0; x < n; x++)
+					{
+						gx[x] = (gType)row[x - 1] - row[x + 1];
+						gy[x] = (gType)above[x] - below[x];
+					}
+					for(int x = 0; x < n; x++)
+					{
+						xx[x0 + x] = gx[x] * gx[x];
+						xy[x0 + x] = gx[x] * gy[x];
+						yy[x0 + x] = gy[x] * gy[x];
+					}
+				}
+			}
+
+			for(int c = 0; c < 3; c++)
+				harris_blur_row(xx + static_cast<size_t>(c) * w, ring_row(c, y), w, k);
+		}
+
+		// The image which the original detector searches for maxima: the score
+		// away from the border, and the blurred xx product on it.
+		void score_row(int y)
+		{
+			float* out = score(y);
+			const int n = k.ksize;
+			for(; next_product <= std::min(h - 1, y + n); next_product++)
+				product_row(next_product);
+
+			for(int c = 0; c < 3; c++)
+			{
+				const float* rows[13];
+				for(int j = -n; j <= n; j++)
+					rows[n + j] = ring_row(c, std::min(std::max(y + j, 0), h - 1));
+				harris_blur_column(rows, &blurred[static_cast<size_t>(c) * w], w, k);
+			}
+
+			const float* xx = &blurred[0];
+			const float* xy = xx + w;
+			const float* yy = xy + w;
+			std::copy(xx, xx + w, out);
+			if(y >= kspread && y < h - kspread)
+				for(int x = kspread; x < w - kspread; x++)
+					out[x] = Score::Compute(xx[x], xy[x], yy[x]);
+		}
+
+		const BasicImage<B>& im;
+		const HarrisKernel& k;
+		const int w, h, kspread, ring_rows;
+		int next_product = 0;
+		std::vector<float> ring, products, blurred, scores;
+	};
+}
+#endif
+
 /// Generic Harris corner detection function. This can use any scoring metric and
 /// can store corners in any container. The images used to hold the intermediate
 /// results must be passed to this function.
@@ -169,18 +326,90 @@ void harrislike_corner_detect(const BasicImage<B>& i, C& c, unsigned int N, floa
 		Inserter::insert(c, corner_heap[i]);
 }
 
+/// Generic Harris corner detection function, without any intermediate images.
+/// The gradient products are blurred and scored in a single streaming pass
+/// through a few rows of buffers, and bands of rows are processed in parallel.
+/// The corners, and the order in which they are inserted, are identical to the
+/// version which takes the images of the intermediate results, which this calls
+/// whenever the generic convolveGaussian() would blur differently. That is if
+/// the kernel is wider than 6 pixels (where it switches to a recursive filter),
+/// if the image is too small for the kernel, and always when the library is
+/// built with the SSE convolveGaussian() (CVD_HAVE_SSE), which has a different
+/// filter and uses a recursive one for aligned images from a kernel of 3 pixels.
+///
+///@param i Input image.
+///@param c Container holding detected corners
+///@param N Number of corners to detect
+///@param blur Blur radius to use
+///@param sigmas Number of sigmas to use in blur.
+///@ingroup gVision
+template <class Score, class Inserter, class C, class B>
+void harrislike_corner_detect(const BasicImage<B>& i, C& c, unsigned int N, float blur, float sigmas)
+{
+	using std::greater;
+	using std::pair;
+	using std::vector;
+
+	const Internal::HarrisKernel kernel(blur, sigmas);
+	const int kspread = (int)ceil(sigmas * blur);
+	const int w = i.size().x;
+	const int h = i.size().y;
+
+#ifdef CVD_HAVE_SSE
+	const bool generic_blur = false;
+#else
+	const bool generic_blur = true;
+#endif
+	if(!generic_blur || kernel.ksize < 1 || kernel.ksize > 6 || kspread < 1 || w < 2 * kernel.ksize || h < 2 * kernel.ksize + 1)
+	{
+		Image<float> xx(i.size()), xy(i.size()), yy(i.size());
+		harrislike_corner_detect<Score, Inserter>(i, c, N, blur, sigmas, xx, xy, yy);
+		return;
+	}
+
+	// The local maxima of each band, in raster order
+	const int rows = std::max(0, h - 2 * kspread);
+	const int band = internal::SliceHeight(rows, 32);
+	vector<vector<pair<float, ImageRef>>> maxima((rows + band - 1) / band);
+	internal::Slice(rows, band, [&](int b, int start, int count) {
+		Internal::HarrisBand<Score, B> detector(i, kernel, kspread);
+		detector(kspread + start, count, maxima[b]);
+	});
+
+	// Keep the N best in a min-heap, as above.
+	vector<pair<float, ImageRef>> corner_heap;
+	corner_heap.reserve(N + 1);
+	typedef greater<pair<float, ImageRef>> minheap_compare;
+	for(const auto& m : maxima)
+		for(const auto& corner : m)
+		{
+			if(corner_heap.size() <= N || corner.first > corner_heap[0].first)
+			{
+				corner_heap.push_back(corner);
+				push_heap(corner_heap.begin(), corner_heap.end(), minheap_compare());
+			}
+
+			if(corner_heap.size() > N)
+			{
+				pop_heap(corner_heap.begin(), corner_heap.end(), minheap_compare());
+				corner_heap.pop_back();
+			}
+		}
+
+	for(unsigned int j = 0; j < corner_heap.size(); j++)
+		Inserter::insert(c, corner_heap[j]);
+}
+
 template <class C>
 void harris_corner_detect(const BasicImage<C>& i, std::vector<ImageRef>& c, unsigned int N, float blur = 1.0, float sigmas = 3.0)
 {
-	Image<float> xx(i.size()), xy(i.size()), yy(i.size());
-	harrislike_corner_detect<Harris::HarrisScore, Harris::PosInserter>(i, c, N, blur, sigmas, xx, xy, yy);
+	harrislike_corner_detect<Harris::HarrisScore, Harris::PosInserter>(i, c, N, blur, sigmas);
 }
 
 template <class C>
 void shitomasi_corner_detect(const BasicImage<C>& i, std::vector<ImageRef>& c, unsigned int N, float blur = 1.0, float sigmas = 3.0)
 {
-	Image<float> xx(i.size()), xy(i.size()), yy(i.size());
-	harrislike_corner_detect<Harris::ShiTomasiScore, Harris::PosInserter>(i, c, N, blur, sigmas, xx, xy, yy);
+	harrislike_corner_detect<Harris::ShiTomasiScore, Harris::PosInserter>(i, c, N, blur, sigmas);
 }
 }
 #endif
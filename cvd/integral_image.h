@@ -4,13 +4,144 @@
 
 #include <cvd/image.h>
 #include <cvd/internal/pixel_operations.h>
+#include <cvd/internal/slice.h>
 #include <cvd/vision.h>
 
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
 namespace CVD
 {
+#ifndef DOXYGEN_IGNORE_INTERNAL
+namespace Internal
+{
+	// Write one row of an integral image: out[x] = prev[x] + f(in[0]) + ... + f(in[x]),
+	// with prev taken as zero if it is null. The prefix sums within each block of
+	// lanes do not depend on the running total, so they are computed ahead of it
+	// and the additions of the row above vectorise.
+	template <class S, class D, class F>
+	void integral_row(const S* in, const D* prev, D* out, int w, F f)
+	{
+		const int lanes = 8;
+		D carry = 0;
+		int x = 0;
+		for(; x + lanes <= w; x += lanes)
+		{
+			D v[lanes];
+			for(int i = 0; i < lanes; i++)
+				v[i] = f(in[x + i]);
+			for(int i = 1; i < lanes; i++)
+				v[i] += v[i - 1];
+
+			if(prev)
+				for(int i = 0; i < lanes; i++)
+					out[x + i] = v[i] + carry + prev[x + i];
+			else
+				for(int i = 0; i < lanes; i++)
+					out[x + i] = v[i] + carry;
+			carry += v[lanes - 1];
+		}
+
+		for(; x < w; x++)
+		{
+			carry += f(in[x]);
+			out[x] = prev ? carry + prev[x] : carry;
+		}
+	}
+
+	// The image is split in to bands of rows which are summed independently in
+	// parallel, then the bottom rows of the bands above are added to each band.
+	template <class S, class D, class F>
+	void integral_image_bands(const BasicImage<S>& in, BasicImage<D>& out, F f)
+	{
+		const int w = in.size().x;
+		const int h = in.size().y;
+		if(w == 0 || h == 0)
+			return;
+
+		const int band = internal::SliceHeight(h, 64);
+
+		internal::Slice(h, band, [&](int, int y0, int rows) {
+			for(int y = y0; y < y0 + rows; y++)
+				integral_row(in[y], y > y0 ? out[y - 1] : static_cast<const D*>(nullptr), out[y], w, f);
+		});
+
+		if(band >= h)
+			return;
+
+		// carry[b] is the total of the rows above band b + 1.
+		const int bands = (h + band - 1) / band;
+		std::vector<D> carry(static_cast<size_t>(bands - 1) * w);
+		std::copy(out[band - 1], out[band - 1] + w, carry.begin());
+		for(int b = 1; b < bands - 1; b++)
+		{
+			const D* above = &carry[static_cast<size_t>(b - 1) * w];
+			const D* last = out[(b + 1) * band - 1];
+			D* c = &carry[static_cast<size_t>(b) * w];
+			for(int x = 0; x < w; x++)
+				c[x] = above[x] + last[x];
+		}
+
+		internal::Slice(h - band, band, [&](int b, int start, int rows) {
+			const D* c = &carry[static_cast<size_t>(b) * w];
+			for(int y = band + start; y < band + start + rows; y++)
+			{
+				D* o = out[y];
+				for(int x = 0; x < w; x++)
+					o[x] += c[x];
+			}
+		});
+	}
+
+	template <class D>
+	struct Identity
+	{
+		template <class S>
+		D operator()(const S& s) const
+		{
+			return static_cast<D>(s);
+		}
+	};
+
+	template <class D>
+	struct Square
+	{
+		template <class S>
+		D operator()(const S& s) const
+		{
+			return static_cast<D>(s) * static_cast<D>(s);
+		}
+	};
+
+	// The tilted integral image at any x, and any y below the bottom of the
+	// image. Off the sides, the cone is cut by the edge of the image in the same
+	// way as the cone from the nearest edge pixel with the same diagonal.
+	template <class D>
+	D tilted_at(const BasicImage<D>& tilted, int x, int y)
+	{
+		const int w = tilted.size().x;
+		if(x < 0)
+		{
+			y += x;
+			x = 0;
+		}
+		else if(x >= w)
+		{
+			y -= x - w + 1;
+			x = w - 1;
+		}
+		return y < 0 ? D(0) : tilted[y][x];
+	}
+}
+#endif
+
 ///Compute an integral image. In an integral image, pixel (x,y) is equal to the sum of all the pixels
 ///in the rectangle from (0,0) to (x,y) in the original image.
 /// and reallocation is not performed if <code>b</code> is unique and of the correct size.
+/// For scalar pixel types, the rows are summed a block of pixels at a time and
+/// large images are summed in parallel bands, so floating point sums may be
+/// rounded slightly differently from a running total.
 /// @param D The destination image pixel type
 /// @param S The source image pixel type
 /// @param in The source image.
@@ -23,6 +154,12 @@ void integral_image(const BasicImage<S>& in, BasicImage<D>& out)
 	if(in.size() != out.size())
 		throw Exceptions::Vision::IncompatibleImageSizes("integral_image");
 
+	if constexpr(std::is_arithmetic<S>::value && std::is_arithmetic<D>::value)
+	{
+		Internal::integral_image_bands(in, out, Internal::Identity<D>());
+		return;
+	}
+
 	Pixel::operations<D>::assign(out[0][0], in[0][0]);
 	//Do the first row.
 	for(int x = 1; x < in.size().x; x++)
@@ -45,6 +182,191 @@ void integral_image(const BasicImage<S>& in, BasicImage<D>& out)
 		}
 	}
 }
+
+///Compute an integral image of the squares of the pixels, so pixel (x,y) is equal to the sum
+///of the squares of all the pixels in the rectangle from (0,0) to (x,y) in the original image.
+///With integral_image(), this gives the mean and variance of any rectangle in constant time.
+/// @param D The destination image pixel type
+/// @param S The source image pixel type, which must be a scalar type
+/// @param in The source image.
+/// @param out The destination image, which must be the same size.
+/// @ingroup gVision
+template <class S, class D>
+void integral_image_squared(const BasicImage<S>& in, BasicImage<D>& out)
+{
+	if(in.size() != out.size())
+		throw Exceptions::Vision::IncompatibleImageSizes("integral_image_squared");
+	Internal::integral_image_bands(in, out, Internal::Square<D>());
+}
+
+///Compute a 45 degree tilted integral image. Pixel (x,y) is equal to the sum of
+///all the pixels (x',y') of the original image for which y' &lt;= y and
+///|x - x'| &lt;= y - y', which is the triangle above and including the pixel. See
+///tilted_rectangle_sum().
+///
+///Each row depends only on the two rows above, so the rows are computed in
+///a single vectorised pass.
+/// @param D The destination image pixel type
+/// @param S The source image pixel type, which must be a scalar type
+/// @param in The source image.
+/// @param out The destination image, which must be the same size.
+/// @ingroup gVision
+template <class S, class D>
+void tilted_integral_image(const BasicImage<S>& in, BasicImage<D>& out)
+{
+	if(in.size() != out.size())
+		throw Exceptions::Vision::IncompatibleImageSizes("tilted_integral_image");
+
+	// T(x,y) = T(x-1,y-1) + T(x+1,y-1) - T(x,y-2) + I(x,y) + I(x,y-1), where
+	// the triangles which are cut by the side of the image are the same as the
+	// triangle from the edge pixel one row higher.
+	const int w = in.size().x;
+	const std::vector<D> zero_row(w, D(0));
+	const std::vector<S> zero_in(w, S(0));
+	for(int y = 0; y < in.size().y; y++)
+	{
+		const D* t1 = y >= 1 ? out[y - 1] : zero_row.data();
+		const D* t2 = y >= 2 ? out[y - 2] : zero_row.data();
+		const S* i0 = in[y];
+		const S* i1 = y >= 1 ? in[y - 1] : zero_in.data();
+		D* o = out[y];
+
+		for(int x = 1; x < w - 1; x++)
+			o[x] = t1[x - 1] + t1[x + 1] - t2[x] + static_cast<D>(i0[x]) + static_cast<D>(i1[x]);
+
+		for(int x : { 0, w - 1 })
+			if(x >= 0)
+			{
+				const D left = x > 0 ? t1[x - 1] : t2[0];
+				const D right = x < w - 1 ? t1[x + 1] : t2[w - 1];
+				o[x] = left + right - t2[x] + static_cast<D>(i0[x]) + static_cast<D>(i1[x]);
+			}
+	}
+}
+
+///Find the sum of a rectangle of pixels from an integral image.
+/// @param integral The integral image, as computed by integral_image() or integral_image_squared().
+/// @param top_left The top left corner of the rectangle.
+/// @param size The size of the rectangle, which must be at least 1x1 and inside the image.
+/// @return The sum of the pixels in the rectangle
+/// @ingroup gVision
+template <class D>
+D rectangle_sum(const BasicImage<D>& integral, const ImageRef& top_left, const ImageRef& size)
+{
+	const ImageRef bottom_right = top_left + size - ImageRef(1, 1);
+	D sum = integral[bottom_right];
+	if(top_left.x > 0)
+		sum -= integral[bottom_right.y][top_left.x - 1];
+	if(top_left.y > 0)
+	{
+		sum -= integral[top_left.y - 1][bottom_right.x];
+		if(top_left.x > 0)
+			sum += integral[top_left.y - 1][top_left.x - 1];
+	}
+	return sum;
+}
+
+///Find the sums of many rectangles of the same size from an integral image,
+///for instance one feature of a cascade at many positions.
+/// @param integral The integral image.
+/// @param top_left The top left corners of the rectangles.
+/// @param size The size of the rectangles, which must be at least 1x1.
+/// @param sums The sums of the rectangles, in the same order.
+/// @throws Exceptions::Vision::BadInput Throws if any rectangle is not inside the image.
+/// @ingroup gVision
+template <class D>
+void rectangle_sums(const BasicImage<D>& integral, const std::vector<ImageRef>& top_left, const ImageRef& size, std::vector<D>& sums)
+{
+	if(size.x < 1 || size.y < 1)
+		throw Exceptions::Vision::BadInput("rectangle_sums: empty rectangle");
+	for(const ImageRef& p : top_left)
+		if(!integral.in_image(p) || !integral.in_image(p + size - ImageRef(1, 1)))
+			throw Exceptions::Vision::BadInput("rectangle_sums: rectangle outside the image");
+
+	// Away from the top and left edges, the four corners are at fixed offsets
+	// from the pixel above and left of the rectangle.
+	const ptrdiff_t stride = integral.row_stride();
+	const ptrdiff_t across = size.x;
+	const ptrdiff_t down = size.y * stride;
+
+	sums.resize(top_left.size());
+	for(size_t i = 0; i < top_left.size(); i++)
+	{
+		const ImageRef& p = top_left[i];
+		if(p.x > 0 && p.y > 0)
+		{
+			const D* c = &integral[p.y - 1][p.x - 1];
+			sums[i] = c[down + across] - c[down] - c[across] + c[0];
+		}
+		else
+			sums[i] = rectangle_sum(integral, p, size);
+	}
+}
+
+///Find the sum of the rectangle at every position in an image, from its integral image.
+/// @param integral The integral image.
+/// @param size The size of the rectangle, which must be at least 1x1.
+/// @param sums Pixel (x,y) is the sum of the rectangle with its top left corner at (x,y).
+///             It must be of size <code>integral.size() - size + ImageRef(1,1)</code>.
+/// @ingroup gVision
+template <class D>
+void rectangle_sums(const BasicImage<D>& integral, const ImageRef& size, BasicImage<D>& sums)
+{
+	if(size.x < 1 || size.y < 1 || size.x > integral.size().x || size.y > integral.size().y)
+		throw Exceptions::Vision::BadInput("rectangle_sums: bad rectangle size");
+	if(sums.size() != integral.size() - size + ImageRef(1, 1))
+		throw Exceptions::Vision::IncompatibleImageSizes("rectangle_sums");
+
+	const int w = sums.size().x;
+	const int h = sums.size().y;
+
+	internal::Slice(h, internal::SliceHeight(h, 16), [&](int, int y0, int rows) {
+		for(int y = y0; y < y0 + rows; y++)
+		{
+			const D* bottom = integral[y + size.y - 1];
+			D* o = sums[y];
+			if(y == 0)
+			{
+				o[0] = bottom[size.x - 1];
+				for(int x = 1; x < w; x++)
+					o[x] = bottom[x + size.x - 1] - bottom[x - 1];
+			}
+			else
+			{
+				const D* top = integral[y - 1];
+				o[0] = bottom[size.x - 1] - top[size.x - 1];
+				for(int x = 1; x < w; x++)
+					o[x] = bottom[x + size.x - 1] - bottom[x - 1] - top[x + size.x - 1] + top[x - 1];
+			}
+		}
+	});
+}
+
+///Find the sum of a rectangle at 45 degrees from a tilted integral image (see
+///tilted_integral_image()). The rectangle covers the pixels
+///(top.x + i - j, top.y + i + j) and (top.x + i - j, top.y + i + j + 1) for
+///0 &lt;= i &lt; width and 0 &lt;= j &lt; height, so its sides run down and right
+///from the top pixel for width pixels and down and left for height pixels.
+///Pixels outside the sides or top of the image count as zero, but the bottom
+///pixel must be inside the image.
+/// @param tilted The tilted integral image.
+/// @param top The top pixel of the rectangle.
+/// @param width The length of the side running down and right.
+/// @param height The length of the side running down and left.
+/// @return The sum of the pixels in the rectangle
+/// @ingroup gVision
+template <class D>
+D tilted_rectangle_sum(const BasicImage<D>& tilted, const ImageRef& top, int width, int height)
+{
+	// The triangles are quadrants in coordinates of x+y and y-x, so the
+	// rectangle is found from four of them like an upright rectangle.
+	using Internal::tilted_at;
+	return tilted_at(tilted, top.x + width - height, top.y + width + height - 1)
+	    - tilted_at(tilted, top.x - height, top.y + height - 1)
+	    - tilted_at(tilted, top.x + width, top.y + width - 1)
+	    + tilted_at(tilted, top.x, top.y - 1);
+}
+
 #ifndef DOXYGEN_IGNORE_INTERNAL
 namespace Internal
 {
@@ -69,6 +391,50 @@ namespace Internal
 			integral_image<C, D>(i, j);
 		}
 	};
+
+	template <class C>
+	class IntegralImageSquared
+	{
+	};
+
+	template <class C>
+	struct ImagePromise<IntegralImageSquared<C>>
+	{
+		ImagePromise(const BasicImage<C>& im)
+		    : i(im)
+		{
+		}
+
+		const BasicImage<C>& i;
+		template <class D>
+		void execute(Image<D>& j)
+		{
+			j.resize(i.size());
+			integral_image_squared<C, D>(i, j);
+		}
+	};
+
+	template <class C>
+	class TiltedIntegralImage
+	{
+	};
+
+	template <class C>
+	struct ImagePromise<TiltedIntegralImage<C>>
+	{
+		ImagePromise(const BasicImage<C>& im)
+		    : i(im)
+		{
+		}
+
+		const BasicImage<C>& i;
+		template <class D>
+		void execute(Image<D>& j)
+		{
+			j.resize(i.size());
+			tilted_integral_image<C, D>(i, j);
+		}
+	};
 };
 
 template <class C>
@@ -76,6 +442,18 @@ Internal::ImagePromise<Internal::IntegralImage<C>> integral_image(const BasicIma
 {
 	return Internal::ImagePromise<Internal::IntegralImage<C>>(c);
 }
+
+template <class C>
+Internal::ImagePromise<Internal::IntegralImageSquared<C>> integral_image_squared(const BasicImage<C>& c)
+{
+	return Internal::ImagePromise<Internal::IntegralImageSquared<C>>(c);
+}
+
+template <class C>
+Internal::ImagePromise<Internal::TiltedIntegralImage<C>> tilted_integral_image(const BasicImage<C>& c)
+{
+	return Internal::ImagePromise<Internal::TiltedIntegralImage<C>>(c);
+}
 #else
 ///Compute an integral image. In an integral image, pixel (x,y) is equal to the sum of all the pixels
 ///in the rectangle from (0,0) to (x,y) in the original image.
@@ -97,6 +475,22 @@ Internal::ImagePromise<Internal::IntegralImage<C>> integral_image(const BasicIma
 template <class S, class D>
 Image<D> integral_image(const BasicImage<S>& from);
 
+///Compute an integral image of the squares of the pixels, using lazy evaluation
+///like integral_image(). See integral_image_squared(const BasicImage<S>&, BasicImage<D>&).
+/// @param from The source image.
+/// @return The integral image of the squares
+/// @ingroup gVision
+template <class S, class D>
+Image<D> integral_image_squared(const BasicImage<S>& from);
+
+///Compute a 45 degree tilted integral image, using lazy evaluation like
+///integral_image(). See tilted_integral_image(const BasicImage<S>&, BasicImage<D>&).
+/// @param from The source image.
+/// @return The tilted integral image
+/// @ingroup gVision
+template <class S, class D>
+Image<D> tilted_integral_image(const BasicImage<S>& from);
+
 #endif
 
 }
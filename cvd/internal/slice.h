@@ -1,3 +1,6 @@
+#ifndef CVD_INC_INTERNAL_SLICE_H
+#define CVD_INC_INTERNAL_SLICE_H
+
 #include <algorithm>
 #include <future>
 #include <thread>
@@ -8,6 +11,14 @@ namespace CVD
 namespace internal
 {
 
+	// The height of slices which split a range of the given height evenly between the hardware threads, but no less than
+	// min_height, so that each slice is worth the thread started for it.
+	inline int SliceHeight(int height, int min_height = 1)
+	{
+		const int threads = std::max(1u, std::thread::hardware_concurrency());
+		return std::max(min_height, (height + threads - 1) / threads);
+	}
+
 	// Executes a function on multiple threads over a vertical image range, splitting the range into a number of slices of
 	// the specified height.
 	template <typename F>
@@ -28,3 +39,5 @@ namespace internal
 
 }
 }
+
+#endif
@@ -645,8 +645,55 @@ namespace median
 #ifndef DOXYGEN_IGNORE_INTERNAL
 //Overload for median filtering of byte images, to special-case 3x3
 void morphology(const BasicImage<byte>& in, const std::vector<ImageRef>& selem, const Morphology::Median<byte>& m, BasicImage<byte>& out);
+
+//Overloads for erosion and dilation, which use erodeRectangle() and dilateRectangle()
+//if the structuring element is a filled rectangle (including a horizontal or vertical line).
+void morphology(const BasicImage<byte>& in, const std::vector<ImageRef>& selem, const Morphology::Erode<byte>& e, BasicImage<byte>& out);
+void morphology(const BasicImage<byte>& in, const std::vector<ImageRef>& selem, const Morphology::Dilate<byte>& d, BasicImage<byte>& out);
+void morphology(const BasicImage<unsigned short>& in, const std::vector<ImageRef>& selem, const Morphology::Erode<unsigned short>& e, BasicImage<unsigned short>& out);
+void morphology(const BasicImage<unsigned short>& in, const std::vector<ImageRef>& selem, const Morphology::Dilate<unsigned short>& d, BasicImage<unsigned short>& out);
+void morphology(const BasicImage<float>& in, const std::vector<ImageRef>& selem, const Morphology::Erode<float>& e, BasicImage<float>& out);
+void morphology(const BasicImage<float>& in, const std::vector<ImageRef>& selem, const Morphology::Dilate<float>& d, BasicImage<float>& out);
 #endif
 
+/// Greyscale erosion with a rectangular structuring element, using the van Herk/Gil-Werman
+/// algorithm. The cost is about three comparisons per pixel in each direction, independent
+/// of the size of the rectangle. The work is split over multiple threads.
+///
+/// The rectangle covers the offsets from @p lo to @p hi inclusive, so a centred
+/// 2r+1 square is <code>ImageRef(-r, -r), ImageRef(r, r)</code> and a horizontal line
+/// has <code>lo.y == hi.y</code>. As with morphology(), the rectangle is cropped at the
+/// edge of the image. morphology() with Morphology::Erode uses this automatically when
+/// the structuring element is a rectangle.
+/// @param in The source image.
+/// @param lo The top left offset of the rectangle
+/// @param hi The bottom right offset of the rectangle
+/// @param out The destination image. It may be the source image.
+/// @ingroup gVision
+void erodeRectangle(const BasicImage<byte>& in, ImageRef lo, ImageRef hi, BasicImage<byte>& out);
+void erodeRectangle(const BasicImage<unsigned short>& in, ImageRef lo, ImageRef hi, BasicImage<unsigned short>& out);
+void erodeRectangle(const BasicImage<float>& in, ImageRef lo, ImageRef hi, BasicImage<float>& out);
+
+/// Greyscale dilation with a rectangular structuring element. See erodeRectangle().
+/// @ingroup gVision
+void dilateRectangle(const BasicImage<byte>& in, ImageRef lo, ImageRef hi, BasicImage<byte>& out);
+void dilateRectangle(const BasicImage<unsigned short>& in, ImageRef lo, ImageRef hi, BasicImage<unsigned short>& out);
+void dilateRectangle(const BasicImage<float>& in, ImageRef lo, ImageRef hi, BasicImage<float>& out);
+
+/// Greyscale opening with a rectangular structuring element: erosion by the rectangle
+/// followed by dilation by its reflection. See erodeRectangle().
+/// @ingroup gVision
+void openRectangle(const BasicImage<byte>& in, ImageRef lo, ImageRef hi, BasicImage<byte>& out);
+void openRectangle(const BasicImage<unsigned short>& in, ImageRef lo, ImageRef hi, BasicImage<unsigned short>& out);
+void openRectangle(const BasicImage<float>& in, ImageRef lo, ImageRef hi, BasicImage<float>& out);
+
+/// Greyscale closing with a rectangular structuring element: dilation by the rectangle
+/// followed by erosion by its reflection. See erodeRectangle().
+/// @ingroup gVision
+void closeRectangle(const BasicImage<byte>& in, ImageRef lo, ImageRef hi, BasicImage<byte>& out);
+void closeRectangle(const BasicImage<unsigned short>& in, ImageRef lo, ImageRef hi, BasicImage<unsigned short>& out);
+void closeRectangle(const BasicImage<float>& in, ImageRef lo, ImageRef hi, BasicImage<float>& out);
+
 }
 
 #endif
@@ -1,10 +1,19 @@
 #ifndef CVD_NONMAX_SUPPRESSION_H
 #define CVD_NONMAX_SUPPRESSION_H
 
+#include <cvd/byte.h>
+#include <cvd/config.h>
+#include <cvd/image.h>
 #include <cvd/image_ref.h>
+#include <limits>
 #include <utility>
 #include <vector>
 
+#ifdef CVD_HAVE_TOON
+#include <cvd/interpolate.h>
+#include <cmath>
+#endif
+
 namespace CVD
 {
 /**Perform nonmaximal suppression on a set of features, in a 3 by 3 window.
@@ -36,6 +45,135 @@ void nonmax_suppression(const std::vector<ImageRef>& corners, const std::vector<
 	  */
 void nonmax_suppression_with_scores(const std::vector<ImageRef>& corners, const std::vector<int>& socres, std::vector<std::pair<ImageRef, int>>& max_corners);
 
+/**Select a well spread set of corners with adaptive nonmaximal suppression (ANMS),
+	  after Brown, Szeliski and Winder, "Multi-image matching using multi-scale oriented
+	  patches", 2005. The suppression radius of a corner is the distance to the nearest
+	  corner which is sufficiently stronger, that is whose score times @p robustness
+	  exceeds the corner's own. The corners with the largest radii are selected. Corners
+	  with no stronger corner have an infinite radius.
+
+	  The corners are bucketed in a grid, and the search for the largest radii stops
+	  at the first stronger corner near most candidates, so the cost is dominated by
+	  sorting the scores: O(n log n) for n corners.
+
+	  @param corners The corner locations, in any order
+	  @param scores  The corners' scores
+	  @param count The number of corners to select. If there are fewer corners, all are selected.
+	  @param selected The selected corners, in descending order of radius. Ties are in
+	                  descending order of score, and then in the order of the input.
+	  @param robustness A number in (0, 1]. Smaller values require a corner to be clearly
+	                    stronger to suppress another; 0.9 is usual. If it is less than 1,
+	                    the scores must not be negative.
+	  @throws Exceptions::Vision::BadInput if the sizes of @p corners and @p scores differ,
+	          @p count is negative or @p robustness is out of range.
+	  @ingroup gVision
+	  */
+void adaptive_nonmax_suppression(const std::vector<ImageRef>& corners, const std::vector<int>& scores, int count, std::vector<ImageRef>& selected, double robustness = 1);
+void adaptive_nonmax_suppression(const std::vector<ImageRef>& corners, const std::vector<float>& scores, int count, std::vector<ImageRef>& selected, double robustness = 1);
+
+/**Suppress corners within a radius of a stronger corner. The corners are visited in
+	  descending order of score (ties in the order of the input), and a corner is kept if
+	  no corner kept so far is within @p radius of it, so the kept corners are all more than
+	  @p radius apart. The corners are bucketed in a grid, so the cost is dominated by
+	  sorting the scores.
+
+	  @param corners The corner locations, in any order
+	  @param scores  The corners' scores
+	  @param radius The suppression radius, which must not be negative
+	  @param selected The kept corners, in descending order of score
+	  @param count The largest number of corners to keep. The strongest are kept.
+	  @throws Exceptions::Vision::BadInput if the sizes of @p corners and @p scores differ or
+	          @p radius is negative.
+	  @ingroup gVision
+	  */
+void radius_nonmax_suppression(const std::vector<ImageRef>& corners, const std::vector<int>& scores, int radius, std::vector<ImageRef>& selected, size_t count = std::numeric_limits<size_t>::max());
+void radius_nonmax_suppression(const std::vector<ImageRef>& corners, const std::vector<float>& scores, int radius, std::vector<ImageRef>& selected, size_t count = std::numeric_limits<size_t>::max());
+
+/**Perform nonmaximal suppression on every pixel of a score image, in a square
+	  window of (2 * radius + 1) by (2 * radius + 1) pixels. The test is non-strict:
+	  a pixel is a maximum if it is at least as large as the rest of its window.
+	  As with morphology(), the window is cropped at the edge of the image.
+
+	  The maximum of the rest of the window is found with separable max filters, so
+	  the cost grows with the logarithm of the radius, and the work is split over
+	  multiple threads. The scores must not be NaN.
+
+	  @param scores The score image
+	  @param radius The radius of the window, which must be at least 1
+	  @param mask The destination image, which must be the same size. Maxima are set to 255 and other pixels to 0.
+	  @param threshold Pixels scoring less than this are never maxima
+	  @throws Exceptions::Vision::IncompatibleImageSizes if the mask is the wrong size
+	  @throws Exceptions::Vision::BadInput if the radius is less than 1
+	  @ingroup gVision
+	  */
+void nonmax_suppression(const BasicImage<float>& scores, int radius, BasicImage<byte>& mask, float threshold = -std::numeric_limits<float>::infinity());
+void nonmax_suppression(const BasicImage<int>& scores, int radius, BasicImage<byte>& mask, int threshold = std::numeric_limits<int>::lowest());
+
+/**Perform nonmaximal suppression on every pixel of a score image. The test is strict:
+	  a pixel must be greater than the rest of its window. See the dense nonmax_suppression().
+	  @ingroup gVision
+	  */
+void nonmax_suppression_strict(const BasicImage<float>& scores, int radius, BasicImage<byte>& mask, float threshold = -std::numeric_limits<float>::infinity());
+void nonmax_suppression_strict(const BasicImage<int>& scores, int radius, BasicImage<byte>& mask, int threshold = std::numeric_limits<int>::lowest());
+
+/**Perform nonmaximal suppression on every pixel of a score image, giving a list of
+	  the maxima. Non strict. See the dense nonmax_suppression().
+
+	  @param scores The score image
+	  @param radius The radius of the window, which must be at least 1
+	  @param max_corners The maxima and their scores, in raster scan order.
+	  @param threshold Pixels scoring less than this are never maxima
+	  @ingroup gVision
+	  */
+void nonmax_suppression_with_scores(const BasicImage<float>& scores, int radius, std::vector<std::pair<ImageRef, float>>& max_corners, float threshold = -std::numeric_limits<float>::infinity());
+void nonmax_suppression_with_scores(const BasicImage<int>& scores, int radius, std::vector<std::pair<ImageRef, int>>& max_corners, int threshold = std::numeric_limits<int>::lowest());
+
+/**Perform nonmaximal suppression on every pixel of a score image, giving a list of
+	  the maxima. Strict. See the dense nonmax_suppression().
+	  @ingroup gVision
+	  */
+void nonmax_suppression_strict_with_scores(const BasicImage<float>& scores, int radius, std::vector<std::pair<ImageRef, float>>& max_corners, float threshold = -std::numeric_limits<float>::infinity());
+void nonmax_suppression_strict_with_scores(const BasicImage<int>& scores, int radius, std::vector<std::pair<ImageRef, int>>& max_corners, int threshold = std::numeric_limits<int>::lowest());
+
+#if defined CVD_HAVE_TOON || defined DOXYGEN_IGNORE_INTERNAL
+/**Find the sub-pixel positions and values of maxima in a score image, by fitting a
+	  quadratic to the 3 by 3 neighbourhood of each with interpolate_extremum_value().
+	  Maxima on the edge of the image, and maxima where the fit is degenerate or puts the
+	  peak more than a pixel away (as happens on a plateau), keep their integer position
+	  and score.
+
+	  @param scores The score image
+	  @param max_corners The maxima, for example from nonmax_suppression_with_scores()
+	  @param refined The refined positions and values, in the same order
+	  @ingroup gVision
+	  */
+template <class T>
+void interpolate_maxima(const BasicImage<T>& scores, const std::vector<std::pair<ImageRef, T>>& max_corners, std::vector<std::pair<TooN::Vector<2>, double>>& refined)
+{
+	refined.clear();
+	refined.reserve(max_corners.size());
+
+	for(const auto& c : max_corners)
+	{
+		const ImageRef p = c.first;
+		std::pair<TooN::Vector<2>, double> r(vec(p), c.second);
+
+		if(p.x > 0 && p.y > 0 && p.x < scores.size().x - 1 && p.y < scores.size().y - 1)
+		{
+			const std::pair<TooN::Vector<2>, double> fit = interpolate_extremum_value(scores, p);
+			const double dx = fit.first[0] - p.x;
+			const double dy = fit.first[1] - p.y;
+
+			//This is false if the fit is NaN.
+			if(std::abs(dx) <= 1 && std::abs(dy) <= 1)
+				r = fit;
+		}
+
+		refined.push_back(r);
+	}
+}
+#endif
+
 }
 
 #endif
@@ -0,0 +1,191 @@
+#ifndef CVD_INCLUDE_REMAP_H
+#define CVD_INCLUDE_REMAP_H
+
+#include <cvd/byte.h>
+#include <cvd/config.h>
+#include <cvd/image.h>
+#include <cvd/internal/slice.h>
+#include <cvd/rgb.h>
+
+#include <cstdint>
+
+#ifdef CVD_HAVE_TOON
+#include <TooN/TooN.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#endif
+
+namespace CVD
+{
+
+/// How a RemapTable stores the source coordinates.
+/// @ingroup gVision
+enum class RemapFormat
+{
+	Fixed16, ///< Each coordinate as a 32 bit number in 16.16 fixed point, 8 bytes a pixel.
+	Split,   ///< The whole parts as 16 bits and the fractions as 8 bits, 6 bytes a pixel, at a 1/256 pixel resolution.
+};
+
+/// A table of the point in a source image which each pixel of a destination image
+/// comes from, for resampling many images in the same way with remap(). This is the
+/// usual way to undistort video: the camera models are evaluated once for each
+/// pixel when the table is made, and not for every frame.
+///
+/// A point is valid if it lies in the source image, that is in [0, w-1] x [0, h-1],
+/// as in warp(). Other points, and all points if the source is less than two pixels
+/// wide or high, are invalid and give a default value. The source image can be at
+/// most 32767 pixels wide and high.
+/// @ingroup gVision
+class RemapTable
+{
+	public:
+	RemapTable() = default;
+
+	/// Make a table with every point invalid.
+	/// @param source_size The size of the images to be resampled
+	/// @param size The size of the resampled images
+	/// @param format How the coordinates are stored
+	/// @throws Exceptions::Vision::BadInput if the source is too large
+	RemapTable(ImageRef source_size, ImageRef size, RemapFormat format = RemapFormat::Fixed16);
+
+	/// Set the source point for a pixel, which is rounded to the resolution of the table.
+	/// @param p The pixel in the resampled image
+	/// @param x The x coordinate of the point in the source image
+	/// @param y The y coordinate of the point in the source image
+	void set(ImageRef p, double x, double y);
+
+	/// Whether the source point of a pixel is valid.
+	bool valid(ImageRef p) const;
+
+	/// The size of the images to be resampled.
+	ImageRef source_size() const { return my_source_size; }
+
+	/// The size of the resampled images.
+	ImageRef size() const { return my_size; }
+
+	RemapFormat format() const { return my_format; }
+
+	/// Decode the source points of n pixels of a row, starting at (x, y), into the
+	/// top left pixels of the 2x2 squares around them and the fractions of the way
+	/// across each square in 1/65536 of a pixel. Invalid points are given the square
+	/// at the origin and a flag of 0, valid ones a flag of 1.
+	void decode(int x, int y, int n, int* xi, int* yi, int* fx, int* fy, int* flag) const;
+
+	private:
+	ImageRef my_source_size;
+	ImageRef my_size;
+	RemapFormat my_format = RemapFormat::Fixed16;
+
+	// Fixed16: -1 in x for invalid points.
+	Image<int32_t> fixed_x, fixed_y;
+
+	// Split: -1 in whole_x for invalid points.
+	Image<int16_t> whole_x, whole_y;
+	Image<byte> fraction_x, fraction_y;
+};
+
+#ifdef CVD_HAVE_TOON
+
+namespace Internal
+{
+	typedef TooN::DefaultPrecision Precision;
+
+	template <class C>
+	using batch_project = decltype(std::declval<const C&>().project(std::declval<const Precision*>(), std::declval<const Precision*>(), 0, std::declval<Precision*>(), std::declval<Precision*>()));
+
+	template <class C>
+	using batch_unproject = decltype(std::declval<const C&>().unproject(std::declval<const Precision*>(), std::declval<const Precision*>(), 0, std::declval<Precision*>(), std::declval<Precision*>()));
+
+	// Whether a camera model can project and unproject arrays of points.
+	template <class C, class = void>
+	struct has_batch_projection : std::false_type
+	{
+	};
+
+	template <class C>
+	struct has_batch_projection<C, std::void_t<batch_project<C>, batch_unproject<C>>> : std::true_type
+	{
+	};
+}
+
+/// Make the table to warp or unwarp images from one camera model to another, giving
+/// the same points as warp(). The models are evaluated on multiple threads, each
+/// with its own copy of them, and a row at a time if they can project arrays of
+/// points, as those in cvd/camera.h can.
+/// @param cam_in The camera model of the images to be resampled
+/// @param source_size The size of the images to be resampled
+/// @param cam_out The camera model of the resampled images
+/// @param size The size of the resampled images
+/// @param format How the coordinates are stored
+/// @ingroup gVision
+template <class CAM1, class CAM2>
+RemapTable make_remap_table(const CAM1& cam_in, ImageRef source_size, const CAM2& cam_out, ImageRef size, RemapFormat format = RemapFormat::Fixed16)
+{
+	RemapTable table(source_size, size, format);
+	internal::Slice(size.y, internal::SliceHeight(size.y, 16), [&](int, int y0, int rows) {
+		CAM1 in = cam_in;
+		CAM2 out = cam_out;
+		if constexpr(Internal::has_batch_projection<CAM1>::value && Internal::has_batch_projection<CAM2>::value)
+		{
+			std::vector<TooN::DefaultPrecision> u(size.x), v(size.x);
+			for(int y = y0; y < y0 + rows; y++)
+			{
+				for(int x = 0; x < size.x; x++)
+				{
+					u[x] = x;
+					v[x] = y;
+				}
+				out.unproject(u.data(), v.data(), size.x, u.data(), v.data());
+				in.project(u.data(), v.data(), size.x, u.data(), v.data());
+				for(int x = 0; x < size.x; x++)
+					table.set(ImageRef(x, y), u[x], v[x]);
+			}
+		}
+		else
+			for(int y = y0; y < y0 + rows; y++)
+				for(int x = 0; x < size.x; x++)
+				{
+					const TooN::Vector<2> l = in.project(out.unproject(TooN::makeVector(x, y)));
+					table.set(ImageRef(x, y), l[0], l[1]);
+				}
+	});
+	return table;
+}
+
+#endif
+
+/// Resample an image with bilinear interpolation at the points in a table.
+///
+/// The points are decoded, and the pixels around them gathered, in blocks, and the
+/// interpolation is vectorised. Byte images are interpolated in fixed point with
+/// weights in 1/256 of a pixel. The image is processed in bands on multiple threads.
+/// @param in The source image, which must be the source size of the table
+/// @param table The points to sample at
+/// @param out The resampled image, which must be the size of the table
+/// @param default_value The value of pixels whose point is invalid
+/// @throws Exceptions::Vision::IncompatibleImageSizes if the images are the wrong sizes
+/// @ingroup gVision
+void remap(const BasicImage<byte>& in, const RemapTable& table, BasicImage<byte>& out, byte default_value = 0);
+
+/// @copydoc remap(const BasicImage<byte>&, const RemapTable&, BasicImage<byte>&, byte)
+void remap(const BasicImage<Rgb<byte>>& in, const RemapTable& table, BasicImage<Rgb<byte>>& out, Rgb<byte> default_value = Rgb<byte>(0, 0, 0));
+
+/// @copydoc remap(const BasicImage<byte>&, const RemapTable&, BasicImage<byte>&, byte)
+void remap(const BasicImage<float>& in, const RemapTable& table, BasicImage<float>& out, float default_value = 0);
+
+/// Resample an image at the points in a table, returning a new image.
+/// @param in The source image, which must be the source size of the table
+/// @param table The points to sample at
+/// @ingroup gVision
+template <class T>
+Image<T> remap(const BasicImage<T>& in, const RemapTable& table)
+{
+	Image<T> out(table.size());
+	remap(in, table, out);
+	return out;
+}
+
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <TooN/TooN.h>
 #include <TooN/helpers.h>
+#include <cvd/byte.h>
 #include <cvd/image.h>
 #include <utility>
 #include <vector>
@@ -163,84 +164,88 @@ Image<TooN::Matrix<2>> dense_tensor_vote_gradients(const BasicImage<C>& image, d
 	return field;
 }
 
-#ifdef CVD_EXPERIMENTAL
-
-template <class C>
-Image<TooN::Matrix<2>> dense_tensor_vote_gradients_fast(const BasicImage<C>& image, double sigma, double ratio, double cutoff = 0.001, int num_divs = 4096)
+/// The field produced by tensor voting. The tensors are symmetric, so the
+/// field is stored as three planes holding the elements \f$[0][0]\f$,
+/// \f$[0][1]\f$ and \f$[1][1]\f$ of each.
+/// @ingroup gVision
+struct TensorField
 {
-	using std::make_pair;
-	using std::pair;
-	using std::vector;
-	using TensorVoting::TV_coord;
-	using TooN::Matrix;
+	Image<float> xx, xy, yy;
+};
 
-	Matrix<2> zero(TooN::Zeros);
-	Image<Matrix<2>> ffield(image.size(), zero);
-	Image<__m128> field(image.size());
-	field.zero();
-
-	//In much the same way as dense_tensor_vote_gradients, build up the kernel.
-	int kernel_radius = (int)ceil(sigma * sqrt(-log(cutoff)));
-	vector<vector<pair<TV_coord, Matrix<2>>>> matrix_kernels;
-	for(int i = 0; i < num_divs; i++)
-	{
-		double angle = M_PI * i / num_divs;
-		matrix_kernels.push_back(TensorVoting::compute_a_tensor_kernel(kernel_radius, cutoff, angle, sigma, ratio, field.row_stride()));
-	}
+/**
+	  Tensor voting on the gradients of an image, as dense_tensor_vote_gradients(),
+	  with the field computed in single precision and stored as three planes.
 
-	//Put the kernel in aligned SSE registers.
-	//Image<__m128> is used since it guarantees SSE aligned memory.
-	vector<vector<int>> kernel_offsets;
-	vector<Image<__m128>> kernel_values;
-	for(unsigned int i = 0; i < matrix_kernels.size(); i++)
-	{
-		vector<int> off(matrix_kernels[i].size());
-		Image<__m128> val(ImageRef(matrix_kernels[i].size(), 1));
+	  Each voting kernel is stored as rows of short fixed length chunks, so a
+	  vote is a few vector additions along rows of each plane. The field is
+	  split in to bands of rows, one per thread, and each band gathers the
+	  votes which land in it, so no thread writes to another's rows. The sum
+	  at each pixel is made in the same order whatever the number of threads.
+	  Only the kernels for directions which occur in the image are built.
 
-		for(unsigned int j = 0; j < matrix_kernels[i].size(); j++)
-		{
-			off[j] = matrix_kernels[i][j].first.o;
-			Matrix<2>& m = matrix_kernels[i][j].second;
-			val.data()[j] = _mm_setr_ps(m[0][0], m[0][1], m[1][0], m[1][1]);
-		}
+	  @param image    The image on which to perform tensor voting
+	  @param sigma    \f$ \sigma \f$
+	  @param ratio    \f$ \kappa \f$
+	  @param field    The field, which is resized to the size of the image.
+	  @param cutoff   When \f$s\f$ points drop below the cutoff, it is set to zero.
+	  @param num_divs The voting kernels are quantized by angle in to this many divisions in the half-circle.
+	  @throws Exceptions::Vision::BadInput unless sigma > 0, 0 < cutoff < 1 and num_divs > 0
+	  @ingroup gVision
+	 **/
+void dense_tensor_vote_gradients(const BasicImage<byte>& image, double sigma, double ratio, TensorField& field, double cutoff = 0.001, unsigned int num_divs = 4096);
 
-		kernel_offsets.push_back(off);
-		kernel_values.push_back(val);
-	}
+/// @copydoc dense_tensor_vote_gradients(const BasicImage<byte>&, double, double, TensorField&, double, unsigned int)
+void dense_tensor_vote_gradients(const BasicImage<float>& image, double sigma, double ratio, TensorField& field, double cutoff = 0.001, unsigned int num_divs = 4096);
 
-#pragma omp parallel for
-	for(int y = kernel_radius; y < field.size().y - kernel_radius; y++)
-		for(int x = kernel_radius; x < field.size().x - kernel_radius; x++)
-		{
-			float gx = ((float)image[y][x + 1] - image[y][x - 1]) / 2.;
-			float gy = ((float)image[y + 1][x] - image[y - 1][x]) / 2.;
+/**
+	  Tensor voting in which only the pixels with a gradient magnitude greater
+	  than a threshold vote. The time taken is proportional to the number of
+	  voting pixels, so this is much faster than dense voting if the image has
+	  few edges. With a threshold of zero, the result is that of dense voting.
+
+	  @param image     The image on which to perform tensor voting
+	  @param sigma     \f$ \sigma \f$
+	  @param ratio     \f$ \kappa \f$
+	  @param threshold The gradient magnitude which a pixel must exceed to vote.
+	  @param field     The field, which is resized to the size of the image.
+	  @param cutoff    When \f$s\f$ points drop below the cutoff, it is set to zero.
+	  @param num_divs  The voting kernels are quantized by angle in to this many divisions in the half-circle.
+	  @throws Exceptions::Vision::BadInput unless sigma > 0, 0 < cutoff < 1 and num_divs > 0
+	  @ingroup gVision
+	 **/
+void sparse_tensor_vote_gradients(const BasicImage<byte>& image, double sigma, double ratio, double threshold, TensorField& field, double cutoff = 0.001, unsigned int num_divs = 4096);
 
-			float scale = sqrt(gx * gx + gy * gy);
-			unsigned int direction = TensorVoting::quantize_half_angle(M_PI / 2 + atan(gy / gx), num_divs);
+/// @copydoc sparse_tensor_vote_gradients(const BasicImage<byte>&, double, double, double, TensorField&, double, unsigned int)
+void sparse_tensor_vote_gradients(const BasicImage<float>& image, double sigma, double ratio, double threshold, TensorField& field, double cutoff = 0.001, unsigned int num_divs = 4096);
 
-			const vector<int>& off = kernel_offsets[direction];
-			__m128* val = kernel_values[direction].data();
-			__m128* p = &field[y][x];
-			__m128 s = _mm_set1_ps(scale);
+/**
+	  Tensor voting as dense_tensor_vote_gradients(), computed in single
+	  precision on three planes as above, and returned as matrices.
+	  @ingroup gVision
+	 **/
+template <class C>
+Image<TooN::Matrix<2>> dense_tensor_vote_gradients_fast(const BasicImage<C>& image, double sigma, double ratio, double cutoff = 0.001, int num_divs = 4096)
+{
+	Image<float> in(image.size());
+	for(int y = 0; y < image.size().y; y++)
+		for(int x = 0; x < image.size().x; x++)
+			in[y][x] = static_cast<float>(image[y][x]);
 
-			for(unsigned int i = 0; i < off.size(); i++)
-				p[off[i]] = _mm_add_ps(p[off[i]], _mm_mul_ps(val[i], s));
-		}
+	TensorField field;
+	dense_tensor_vote_gradients(in, sigma, ratio, field, cutoff, num_divs);
 
-	for(int y = 0; y < field.size().y; y++)
-		for(int x = 0; x < field.size().x; x++)
+	Image<TooN::Matrix<2>> ffield(image.size());
+	for(int y = 0; y < image.size().y; y++)
+		for(int x = 0; x < image.size().x; x++)
 		{
-			float f[4];
-			_mm_storeu_ps(f, field[y][x]);
-			ffield[y][x][0][0] = f[0];
-			ffield[y][x][0][1] = f[1];
-			ffield[y][x][1][0] = f[2];
-			ffield[y][x][1][1] = f[3];
+			ffield[y][x][0][0] = field.xx[y][x];
+			ffield[y][x][0][1] = field.xy[y][x];
+			ffield[y][x][1][0] = field.xy[y][x];
+			ffield[y][x][1][1] = field.yy[y][x];
 		}
-
 	return ffield;
 }
-#endif
 
 }
 
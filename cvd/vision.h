@@ -3,11 +3,17 @@
 #define CVD_VISION_H_
 
 #include <algorithm>
+#include <cstddef>
 #include <memory>
+#include <type_traits>
 #include <vector>
 
+#include <cvd/byte.h>
+#include <cvd/colourspaces.h>
 #include <cvd/image.h>
 #include <cvd/internal/pixel_operations.h>
+#include <cvd/rgb.h>
+#include <cvd/rgba.h>
 #include <cvd/utility.h>
 #include <cvd/vision_exceptions.h>
 
@@ -140,6 +146,50 @@ Image<C> fastApproximateDownSample(const BasicImage<C>& in, double scale)
 	return linearInterpolationDownsample(*current_ptr, scale);
 }
 
+/// The kernels which resample() can filter with.
+/// @ingroup gVision
+enum class ResampleKernel
+{
+	Box,      ///< The average of the pixels under each output pixel, or the nearest pixel when enlarging
+	Triangle, ///< Bilinear interpolation when enlarging, and a triangle of twice the width when shrinking
+	Bicubic,  ///< The Catmull-Rom cubic, of half width 2
+	Lanczos3  ///< The windowed sinc of half width 3, which is the sharpest
+};
+
+/// Resample an image to any size, larger or smaller along each axis, with a separable
+/// filter. The filter for each output row and column is worked out once from the
+/// kernel, and is stretched by the scale when shrinking, which avoids the aliasing of
+/// linearInterpolationDownsample(). Pixel centres are at whole numbers, and the image
+/// is cut off at its edges, with the weights normalised over the pixels it covers. The
+/// horizontal and vertical passes are loops which the compiler vectorises, and the
+/// image is processed in bands on multiple threads. Byte results are rounded and
+/// saturated.
+/// @param in The image to resample
+/// @param out The resampled image, whose size gives the scale
+/// @param kernel The kernel to filter with
+/// @throws Exceptions::Vision::BadInput if in is empty and out is not
+/// @ingroup gVision
+void resample(const BasicImage<byte>& in, BasicImage<byte>& out, ResampleKernel kernel = ResampleKernel::Lanczos3);
+
+/// @copydoc resample(const BasicImage<byte>&, BasicImage<byte>&, ResampleKernel)
+void resample(const BasicImage<Rgb<byte>>& in, BasicImage<Rgb<byte>>& out, ResampleKernel kernel = ResampleKernel::Lanczos3);
+
+/// @copydoc resample(const BasicImage<byte>&, BasicImage<byte>&, ResampleKernel)
+void resample(const BasicImage<float>& in, BasicImage<float>& out, ResampleKernel kernel = ResampleKernel::Lanczos3);
+
+/// Resample an image to any size, returning a new image.
+/// @param in The image to resample
+/// @param size The size of the resampled image
+/// @param kernel The kernel to filter with
+/// @ingroup gVision
+template <class T>
+Image<T> resample(const BasicImage<T>& in, ImageRef size, ResampleKernel kernel = ResampleKernel::Lanczos3)
+{
+	Image<T> out(size);
+	resample(in, out, kernel);
+	return out;
+}
+
 /** Subsamples an image to 2/3 of its size by averaging 3x3 blocks into 2x2 blocks.
 	  @param in input image
 	  @param out output image (must be <code>out.size() == in.size()/3*2 </code>)
@@ -182,6 +232,20 @@ void twoThirdsSample(const BasicImage<C>& in, BasicImage<C>& out)
 	  */
 void twoThirdsSample(const BasicImage<byte>& in, BasicImage<byte>& out);
 
+/// @overload
+/// These work on the components of the pixels, in loops which the compiler
+/// vectorises, and give exactly the same results as the generic version.
+void twoThirdsSample(const BasicImage<Rgb<byte>>& in, BasicImage<Rgb<byte>>& out);
+
+/// @overload
+void twoThirdsSample(const BasicImage<Rgba<byte>>& in, BasicImage<Rgba<byte>>& out);
+
+/// @overload
+void twoThirdsSample(const BasicImage<unsigned short>& in, BasicImage<unsigned short>& out);
+
+/// @overload
+void twoThirdsSample(const BasicImage<float>& in, BasicImage<float>& out);
+
 ///Subsamples an image by averaging 3x3 blocks in to 2x2 ones.
 /// Note that this is performed using lazy evaluation, so subsampling
 /// happens on assignment, and memory allocation is not performed if
@@ -216,6 +280,52 @@ void halfSample(const BasicImage<T>& in, BasicImage<T>& out)
 
 void halfSample(const BasicImage<byte>& in, BasicImage<byte>& out);
 
+/// @overload
+/// These work on the components of the pixels, in loops which the compiler
+/// vectorises, and give exactly the same results as the generic version.
+void halfSample(const BasicImage<Rgb<byte>>& in, BasicImage<Rgb<byte>>& out);
+
+/// @overload
+void halfSample(const BasicImage<Rgba<byte>>& in, BasicImage<Rgba<byte>>& out);
+
+/// @overload
+void halfSample(const BasicImage<unsigned short>& in, BasicImage<unsigned short>& out);
+
+/// @overload
+void halfSample(const BasicImage<float>& in, BasicImage<float>& out);
+
+/// Bins a raw Bayer image in to a colour image of half its size. Each 2x2 cell of
+/// the colour filter pattern becomes one pixel, made of the red and blue pixels of
+/// the cell and the average of its two greens, rounded. This is much faster than
+/// demosaicing with convert_image() and then half sampling, and there is no
+/// interpolation between cells.
+/// @param in The raw image
+/// @param out The colour image, which must be half the size of in
+/// @throw IncompatibleImageSizes if out does not have half the dimensions of in
+/// @ingroup gVision
+void halfSample(const BasicImage<bayer_rggb>& in, BasicImage<Rgb<byte>>& out);
+
+/// @copydoc halfSample(const BasicImage<bayer_rggb>&, BasicImage<Rgb<byte>>&)
+void halfSample(const BasicImage<bayer_grbg>& in, BasicImage<Rgb<byte>>& out);
+
+/// @copydoc halfSample(const BasicImage<bayer_rggb>&, BasicImage<Rgb<byte>>&)
+void halfSample(const BasicImage<bayer_gbrg>& in, BasicImage<Rgb<byte>>& out);
+
+/// @copydoc halfSample(const BasicImage<bayer_rggb>&, BasicImage<Rgb<byte>>&)
+void halfSample(const BasicImage<bayer_bggr>& in, BasicImage<Rgb<byte>>& out);
+
+/// @copydoc halfSample(const BasicImage<bayer_rggb>&, BasicImage<Rgb<byte>>&)
+void halfSample(const BasicImage<bayer_rggb16>& in, BasicImage<Rgb<unsigned short>>& out);
+
+/// @copydoc halfSample(const BasicImage<bayer_rggb>&, BasicImage<Rgb<byte>>&)
+void halfSample(const BasicImage<bayer_grbg16>& in, BasicImage<Rgb<unsigned short>>& out);
+
+/// @copydoc halfSample(const BasicImage<bayer_rggb>&, BasicImage<Rgb<byte>>&)
+void halfSample(const BasicImage<bayer_gbrg16>& in, BasicImage<Rgb<unsigned short>>& out);
+
+/// @copydoc halfSample(const BasicImage<bayer_rggb>&, BasicImage<Rgb<byte>>&)
+void halfSample(const BasicImage<bayer_bggr16>& in, BasicImage<Rgb<unsigned short>>& out);
+
 /// subsamples an image to half its size by averaging 2x2 pixel blocks
 /// @param in input image
 /// @return The output image
@@ -396,6 +506,140 @@ inline void sample(const BasicImage<float>& im, double x, double y, float& resul
 	result = (float)(x * (y * (e - c + d) - e) + y * (c - a) + a);
 }
 
+/// How the batched sampling functions treat pixels outside the image.
+/// @ingroup gVision
+enum class SampleBorder
+{
+	Clamp,   ///< Pixels outside the image take the value of the nearest pixel in it
+	Constant ///< Pixels outside the image take a given value
+};
+
+/// Sample an image at many points with bilinear interpolation, as sample() does at one.
+/// The coordinates are given as separate arrays of x and y, with pixel centres at whole
+/// numbers. The points are processed in blocks: the neighbours of each point are gathered,
+/// then the weights and values for the whole block are computed in loops which the compiler
+/// vectorises. Checks against the edges of the image are skipped for blocks which lie
+/// entirely inside it.
+/// @param im The image to sample
+/// @param x The x coordinates of the points
+/// @param y The y coordinates of the points
+/// @param n The number of points
+/// @param values The n interpolated values
+/// @param border How to treat pixels outside the image
+/// @param border_value The value of pixels outside the image, for SampleBorder::Constant
+/// @ingroup gVision
+void sample_bilinear(const BasicImage<byte>& im, const float* x, const float* y, int n, float* values, SampleBorder border = SampleBorder::Clamp, float border_value = 0);
+
+/// @copydoc sample_bilinear(const BasicImage<byte>&, const float*, const float*, int, float*, SampleBorder, float)
+void sample_bilinear(const BasicImage<float>& im, const float* x, const float* y, int n, float* values, SampleBorder border = SampleBorder::Clamp, float border_value = 0);
+
+/// Sample a byte image at many points with bilinear interpolation in fixed point. The
+/// fractional parts of the coordinates are rounded to 1/256 of a pixel, and the result is
+/// rounded to the nearest byte, so the arithmetic is all in integers. Otherwise this is the
+/// same as sample_bilinear(const BasicImage<byte>&, const float*, const float*, int, float*, SampleBorder, float).
+/// @param im The image to sample
+/// @param x The x coordinates of the points
+/// @param y The y coordinates of the points
+/// @param n The number of points
+/// @param values The n interpolated values
+/// @param border How to treat pixels outside the image
+/// @param border_value The value of pixels outside the image, for SampleBorder::Constant
+/// @ingroup gVision
+void sample_bilinear(const BasicImage<byte>& im, const float* x, const float* y, int n, byte* values, SampleBorder border = SampleBorder::Clamp, byte border_value = 0);
+
+/// Sample an image and its gradient at many points. The values are as for sample_bilinear(),
+/// and the gradient is the derivative of the bilinear surface, which is constant along each
+/// axis within a square of four pixels.
+/// @param im The image to sample
+/// @param x The x coordinates of the points
+/// @param y The y coordinates of the points
+/// @param n The number of points
+/// @param values The n interpolated values
+/// @param dx The n derivatives along x
+/// @param dy The n derivatives along y
+/// @param border How to treat pixels outside the image
+/// @param border_value The value of pixels outside the image, for SampleBorder::Constant
+/// @ingroup gVision
+void sample_bilinear_gradient(const BasicImage<byte>& im, const float* x, const float* y, int n, float* values, float* dx, float* dy, SampleBorder border = SampleBorder::Clamp, float border_value = 0);
+
+/// @copydoc sample_bilinear_gradient(const BasicImage<byte>&, const float*, const float*, int, float*, float*, float*, SampleBorder, float)
+void sample_bilinear_gradient(const BasicImage<float>& im, const float* x, const float* y, int n, float* values, float* dx, float* dy, SampleBorder border = SampleBorder::Clamp, float border_value = 0);
+
+/// Sample an image at many points with bicubic interpolation, using the same kernel as
+/// image_interpolate<Interpolate::Bicubic, T>. Each point uses the 4x4 pixels around it.
+/// @param im The image to sample
+/// @param x The x coordinates of the points
+/// @param y The y coordinates of the points
+/// @param n The number of points
+/// @param values The n interpolated values
+/// @param border How to treat pixels outside the image
+/// @param border_value The value of pixels outside the image, for SampleBorder::Constant
+/// @ingroup gVision
+void sample_bicubic(const BasicImage<byte>& im, const float* x, const float* y, int n, float* values, SampleBorder border = SampleBorder::Clamp, float border_value = 0);
+
+/// @copydoc sample_bicubic(const BasicImage<byte>&, const float*, const float*, int, float*, SampleBorder, float)
+void sample_bicubic(const BasicImage<float>& im, const float* x, const float* y, int n, float* values, SampleBorder border = SampleBorder::Clamp, float border_value = 0);
+
+/// How warp_affine() and warp_homography() interpolate the source image.
+/// @ingroup gVision
+enum class WarpInterpolation
+{
+	Nearest,  ///< The nearest pixel
+	Bilinear, ///< Bilinear interpolation, in fixed point with weights in 1/256 of a pixel for byte images
+	Bicubic   ///< The kernel of image_interpolate<Interpolate::Bicubic, T>, with the image clamped at its edges
+};
+
+/// Warp an image with an affine map, which takes each pixel (x, y) of the output to the
+/// point (M[0][0] x + M[0][1] y + M[0][2], M[1][0] x + M[1][1] y + M[1][2]) in the input.
+/// The points of each row are stepped along from its start instead of being mapped one
+/// at a time, and are processed in blocks, in loops which the compiler vectorises, with
+/// only the gathering of the pixels around them done a point at a time. The image is
+/// warped in bands on multiple threads. Points are in the input if they lie in
+/// [0, w-1] x [0, h-1], and points outside it give a default value.
+/// @param in The image to warp
+/// @param out The warped image
+/// @param M The map from the output to the input
+/// @param interpolation How to interpolate the input
+/// @param default_value The value of pixels whose point is outside the input
+/// @return The number of pixels whose point is outside the input
+/// @ingroup gVision
+int warp_affine(const BasicImage<byte>& in, BasicImage<byte>& out, const double (&M)[2][3], WarpInterpolation interpolation = WarpInterpolation::Bilinear, byte default_value = 0);
+
+/// @copydoc warp_affine(const BasicImage<byte>&, BasicImage<byte>&, const double (&)[2][3], WarpInterpolation, byte)
+int warp_affine(const BasicImage<Rgb<byte>>& in, BasicImage<Rgb<byte>>& out, const double (&M)[2][3], WarpInterpolation interpolation = WarpInterpolation::Bilinear, Rgb<byte> default_value = Rgb<byte>(0, 0, 0));
+
+/// @copydoc warp_affine(const BasicImage<byte>&, BasicImage<byte>&, const double (&)[2][3], WarpInterpolation, byte)
+int warp_affine(const BasicImage<float>& in, BasicImage<float>& out, const double (&M)[2][3], WarpInterpolation interpolation = WarpInterpolation::Bilinear, float default_value = 0);
+
+/// Warp an image with a homography, which takes each pixel (x, y) of the output to the
+/// point in the input with homogeneous coordinates H (x, y, 1). The homogeneous
+/// coordinates are stepped along each row and divided for every pixel, and points at or
+/// behind the line at infinity are outside the input. Otherwise this is the same as
+/// warp_affine(const BasicImage<byte>&, BasicImage<byte>&, const double (&)[2][3], WarpInterpolation, byte).
+/// @param in The image to warp
+/// @param out The warped image
+/// @param H The map from the output to the input
+/// @param interpolation How to interpolate the input
+/// @param default_value The value of pixels whose point is outside the input
+/// @return The number of pixels whose point is outside the input
+/// @ingroup gVision
+int warp_homography(const BasicImage<byte>& in, BasicImage<byte>& out, const double (&H)[3][3], WarpInterpolation interpolation = WarpInterpolation::Bilinear, byte default_value = 0);
+
+/// @copydoc warp_homography(const BasicImage<byte>&, BasicImage<byte>&, const double (&)[3][3], WarpInterpolation, byte)
+int warp_homography(const BasicImage<Rgb<byte>>& in, BasicImage<Rgb<byte>>& out, const double (&H)[3][3], WarpInterpolation interpolation = WarpInterpolation::Bilinear, Rgb<byte> default_value = Rgb<byte>(0, 0, 0));
+
+/// @copydoc warp_homography(const BasicImage<byte>&, BasicImage<byte>&, const double (&)[3][3], WarpInterpolation, byte)
+int warp_homography(const BasicImage<float>& in, BasicImage<float>& out, const double (&H)[3][3], WarpInterpolation interpolation = WarpInterpolation::Bilinear, float default_value = 0);
+
+namespace Internal
+{
+	// Whether warp_affine() and warp_homography() can warp an image of T to an image of S.
+	template <class T, class S>
+	struct has_fast_warp : std::integral_constant<bool, std::is_same<T, S>::value && (std::is_same<T, byte>::value || std::is_same<T, Rgb<byte>>::value || std::is_same<T, float>::value)>
+	{
+	};
+}
+
 #if defined(CVD_HAVE_TOON)
 
 /**
@@ -407,6 +651,11 @@ inline void sample(const BasicImage<float>& im, double x, double y, float& resul
 	 * @param outOrig origin in the out image
 	 * @return the number of pixels not in the in image 
 	 * @Note: this will collide with transform in the std namespace
+	 * Images of byte, Rgb<byte> and float are warped with warp_affine(). For these, points
+	 * on the last row and column of in are in the image, where they used to be counted
+	 * as outside it, and byte components are interpolated with weights in 1/256 of a
+	 * pixel and rounded, where they used to be truncated, so results may differ by one
+	 * level from earlier versions.
 	 */
 template <typename T, typename S, typename P>
 int transform(const BasicImage<S>& in, BasicImage<T>& out, const TooN::Matrix<2, 2, P>& M, const TooN::Vector<2, P>& inOrig, const TooN::Vector<2, P>& outOrig, const T defaultValue = T())
@@ -416,6 +665,13 @@ int transform(const BasicImage<S>& in, BasicImage<T>& out, const TooN::Matrix<2,
 	const TooN::Vector<2, P> down = M.T()[1];
 
 	const TooN::Vector<2, P> p0 = inOrig - M * outOrig;
+
+	if constexpr(Internal::has_fast_warp<S, T>::value)
+	{
+		const double A[2][3] = { { M(0, 0), M(0, 1), p0[0] }, { M(1, 0), M(1, 1), p0[1] } };
+		return warp_affine(in, out, A, WarpInterpolation::Bilinear, defaultValue);
+	}
+
 	const TooN::Vector<2, P> p1 = p0 + w * across;
 	const TooN::Vector<2, P> p2 = p0 + h * down;
 	const TooN::Vector<2, P> p3 = p0 + w * across + h * down;
@@ -483,6 +739,16 @@ int transform(const BasicImage<S>& in, BasicImage<T>& out, const TooN::Matrix<2,
 	}
 }
 
+/// Warp an image with a homography about the centres of the images. Images of byte,
+/// Rgb<byte> and float are warped with warp_homography(). For these, points up to the
+/// last row and column of in are in the image, where those within a pixel of them used
+/// to be zero, points behind the line at infinity are zero, where they used to be
+/// projected through it, and byte components are interpolated with weights in 1/256 of
+/// a pixel and rounded, where they used to be truncated.
+/// @param in The image to warp
+/// @param out The warped image, where pixels whose point is outside in are zero
+/// @param Minv The homography, which takes points in out to points in in
+/// @ingroup gVision
 template <class T>
 void transform(const BasicImage<T>& in, BasicImage<T>& out, const TooN::Matrix<3>& Minv /* <-- takes points in "out" to points in "in" */)
 {
@@ -498,6 +764,23 @@ void transform(const BasicImage<T>& in, BasicImage<T>& out, const TooN::Matrix<3
 	int ow = out.size().x;
 	int oh = out.size().y;
 	base -= down * (oh / 2) + across * (ow / 2);
+
+	if constexpr(Internal::has_fast_warp<T, T>::value)
+	{
+		// The point is project(across x + down y + base) + offset. The sign is
+		// chosen so that the centre of out is in front.
+		const double s = Minv(2, 2) < 0 ? -1 : 1;
+		const double H[3][3] = {
+			{ s * (across[0] + offset[0] * across[2]), s * (down[0] + offset[0] * down[2]), s * (base[0] + offset[0] * base[2]) },
+			{ s * (across[1] + offset[1] * across[2]), s * (down[1] + offset[1] * down[2]), s * (base[1] + offset[1] * base[2]) },
+			{ s * across[2], s * down[2], s * base[2] },
+		};
+		T zero;
+		zeroPixel(zero);
+		warp_homography(in, out, H, WarpInterpolation::Bilinear, zero);
+		return;
+	}
+
 	for(int row = 0; row < oh; row++, base += down)
 	{
 		TooN::Vector<3> x = base;
@@ -513,6 +796,8 @@ void transform(const BasicImage<T>& in, BasicImage<T>& out, const TooN::Matrix<3
 }
 
 /// warp or unwarps an image according to two camera models.
+/// To warp many images in the same way, make_remap_table() and remap() in
+/// cvd/remap.h evaluate the camera models only once.
 template <typename T, typename CAM1, typename CAM2>
 void warp(const BasicImage<T>& in, const CAM1& cam_in, BasicImage<T>& out, const CAM2& cam_out)
 {
@@ -602,20 +887,73 @@ namespace Internal
 		}
 	}
 
+	/// Transposes an image of pixels of 1, 2 or 4 bytes, given as bytes, so that
+	/// pixel (x, y) of in goes to (y, x) of out. The strides are in bytes, and
+	/// either may be negative, which takes those rows from the bottom up.
+	/// @param in The first row of the input
+	/// @param in_stride The bytes from one row of the input to the next
+	/// @param out The first row of the output
+	/// @param out_stride The bytes from one row of the output to the next
+	/// @param size The size of the input
+	/// @param bytes The size of a pixel
+	void transposeBytes(const unsigned char* in, std::ptrdiff_t in_stride, unsigned char* out, std::ptrdiff_t out_stride, ImageRef size, int bytes);
+
+	/// Transposes a block of w by h pixels which fits in the cache, in tiles
+	/// which are transposed in registers. This is specific to the architecture.
+	void transposeBlock(const unsigned char* in, std::ptrdiff_t in_stride, unsigned char* out, std::ptrdiff_t out_stride, int w, int h, int bytes);
+
+	template <class T>
+	struct has_fast_transpose : public std::integral_constant<bool, std::is_trivially_copyable<T>::value && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4)>
+	{
+	};
+
+	/// Transposes in to out, taking the rows of in, or of out, from the bottom
+	/// up if asked, which rotates the image instead.
+	template <class T>
+	void transposeReversed(const SubImage<T>& in, SubImage<T>& out, bool reverse_in, bool reverse_out)
+	{
+		if constexpr(has_fast_transpose<T>::value)
+		{
+			if(in.size().x == 0 || in.size().y == 0)
+				return;
+			const std::ptrdiff_t in_stride = static_cast<std::ptrdiff_t>(in.row_stride()) * sizeof(T);
+			const std::ptrdiff_t out_stride = static_cast<std::ptrdiff_t>(out.row_stride()) * sizeof(T);
+			transposeBytes(reinterpret_cast<const unsigned char*>(in[reverse_in ? in.size().y - 1 : 0]), reverse_in ? -in_stride : in_stride,
+			    reinterpret_cast<unsigned char*>(out[reverse_out ? out.size().y - 1 : 0]), reverse_out ? -out_stride : out_stride, in.size(), sizeof(T));
+		}
+		else
+		{
+			recursiveTranspose(in, out);
+			if(reverse_in)
+				flipHorizontal(out);
+			if(reverse_out)
+				flipVertical(out);
+		}
+	}
 }
 
+/// Transposes an image, so that pixel (x, y) of in goes to (y, x) of out. Images
+/// of pixels of 1, 2 or 4 bytes are done in blocks which stay in the cache, in
+/// tiles transposed in SIMD registers, and in bands on multiple threads. Others
+/// are split recursively until they fit in the cache.
+/// @param in The image to transpose
+/// @param out The transposed image, which must be the size of in transposed
+/// @ingroup gVision
 template <class T>
 void transpose(const SubImage<T>& in, SubImage<T>&& out)
 {
 	CVD_ASSERT(in.size().transpose() == out.size());
-	Internal::recursiveTranspose(in, out);
+	Internal::transposeReversed(in, out, false, false);
 }
 
+/// Transposes an image, returning a new one.
+/// @param in The image to transpose
+/// @ingroup gVision
 template <class T>
 Image<T> transpose(const SubImage<T>& in)
 {
 	Image<T> out(in.size().transpose());
-	Internal::recursiveTranspose(in, out);
+	Internal::transposeReversed(in, out, false, false);
 	return out;
 }
 
@@ -650,6 +988,104 @@ void flipHorizontal(SubImage<T>& in)
 	flipHorizontal(std::move(in));
 }
 
+/// Rotates an image a quarter turn clockwise, so that pixel (x, y) of in goes to
+/// (h - 1 - y, x) of out, where h is the height of in. This is a transpose with
+/// the rows of in taken from the bottom up, so it is done in one pass as fast
+/// as transpose().
+/// @param in The image to rotate
+/// @param out The rotated image, which must be the size of in transposed
+/// @throw IncompatibleImageSizes if out is the wrong size
+/// @ingroup gVision
+template <class T>
+void rotate90(const SubImage<T>& in, SubImage<T>&& out)
+{
+	if(in.size().transpose() != out.size())
+		throw Exceptions::Vision::IncompatibleImageSizes("rotate90");
+	Internal::transposeReversed(in, out, true, false);
+}
+
+template <class T>
+void rotate90(const SubImage<T>& in, SubImage<T>& out)
+{
+	rotate90(in, std::move(out));
+}
+
+/// Rotates an image a quarter turn clockwise, returning a new one.
+/// @param in The image to rotate
+/// @ingroup gVision
+template <class T>
+Image<T> rotate90(const SubImage<T>& in)
+{
+	Image<T> out(in.size().transpose());
+	rotate90(in, out);
+	return out;
+}
+
+/// Rotates an image a half turn, so that pixel (x, y) of in goes to
+/// (w - 1 - x, h - 1 - y) of out, where w and h are the size of in.
+/// @param in The image to rotate
+/// @param out The rotated image, which must be the same size as in
+/// @throw IncompatibleImageSizes if out is the wrong size
+/// @ingroup gVision
+template <class T>
+void rotate180(const SubImage<T>& in, SubImage<T>&& out)
+{
+	if(in.size() != out.size())
+		throw Exceptions::Vision::IncompatibleImageSizes("rotate180");
+	for(int y = 0; y < in.size().y; y++)
+		std::reverse_copy(in[y], in[y] + in.size().x, out[in.size().y - 1 - y]);
+}
+
+template <class T>
+void rotate180(const SubImage<T>& in, SubImage<T>& out)
+{
+	rotate180(in, std::move(out));
+}
+
+/// Rotates an image a half turn, returning a new one.
+/// @param in The image to rotate
+/// @ingroup gVision
+template <class T>
+Image<T> rotate180(const SubImage<T>& in)
+{
+	Image<T> out(in.size());
+	rotate180(in, out);
+	return out;
+}
+
+/// Rotates an image a quarter turn anticlockwise, so that pixel (x, y) of in goes
+/// to (y, w - 1 - x) of out, where w is the width of in. This is a transpose
+/// with the rows of out taken from the bottom up, so it is done in one pass as
+/// fast as transpose().
+/// @param in The image to rotate
+/// @param out The rotated image, which must be the size of in transposed
+/// @throw IncompatibleImageSizes if out is the wrong size
+/// @ingroup gVision
+template <class T>
+void rotate270(const SubImage<T>& in, SubImage<T>&& out)
+{
+	if(in.size().transpose() != out.size())
+		throw Exceptions::Vision::IncompatibleImageSizes("rotate270");
+	Internal::transposeReversed(in, out, false, true);
+}
+
+template <class T>
+void rotate270(const SubImage<T>& in, SubImage<T>& out)
+{
+	rotate270(in, std::move(out));
+}
+
+/// Rotates an image a quarter turn anticlockwise, returning a new one.
+/// @param in The image to rotate
+/// @ingroup gVision
+template <class T>
+Image<T> rotate270(const SubImage<T>& in)
+{
+	Image<T> out(in.size().transpose());
+	rotate270(in, out);
+	return out;
+}
+
 namespace median
 {
 	template <class T>
@@ -721,6 +1157,34 @@ void median_filter_3x3(const BasicImage<T>& I, BasicImage<T> out)
 
 void median_filter_3x3(const BasicImage<byte>& I, BasicImage<byte> out);
 
+/// Median filter with a square window of (2 radius + 1) pixels on a side, in constant
+/// time per pixel regardless of the radius, using the histogram method of Perreault and Hebert.
+/// At the edges of the image the window is cropped, and if it then has an even number of
+/// pixels the upper of the two middle values is taken, which matches morphology() with
+/// Morphology::Median. The work is split over multiple threads.
+/// @param in The source image
+/// @param radius The window radius, from 0 to 127
+/// @param out The destination image. It may be the source image.
+/// @ingroup gVision
+void median_filter(const BasicImage<byte>& in, int radius, BasicImage<byte>& out);
+
+/// Median filter for images with up to 16 significant bits, such as 12 bit thermal or
+/// depth images. See median_filter(const BasicImage<byte>&, int, BasicImage<byte>&).
+/// The histograms are sized for the given number of bits, so fewer bits are faster.
+/// Values which do not fit in that many bits are treated as the largest value that does,
+/// 2<sup>bits</sup>-1. Each column of the image needs a histogram of 2<sup>bits</sup>
+/// counts, so with more than 12 bits the image is filtered in vertical strips, each of
+/// which also updates the histograms of the columns within the radius either side of it.
+/// With 16 bits the strips are 64 columns wide, or wider for radii above 31, so the time
+/// grows with the radius, by about half from the smallest radius to 50, and the histograms
+/// take (64 + 2 radius) x 128 KB per thread, or (4 radius + 1) x 128 KB above 31.
+/// @param in The source image
+/// @param radius The window radius, from 0 to 127
+/// @param out The destination image. It may be the source image.
+/// @param bits The number of significant bits in each pixel
+/// @ingroup gVision
+void median_filter(const BasicImage<unsigned short>& in, int radius, BasicImage<unsigned short>& out, int bits = 16);
+
 //template<class T>
 
 }; // namespace CVD
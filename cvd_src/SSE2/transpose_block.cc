@@ -0,0 +1,128 @@
+#include "cvd/vision.h"
+
+#include <algorithm>
+#include <cstring>
+#include <emmintrin.h>
+#include <utility>
+
+namespace CVD
+{
+namespace Internal
+{
+	namespace
+	{
+		// Interleaves the lanes of a and b, of the given number of bytes.
+		template <int Lane>
+		void unpack(__m128i a, __m128i b, __m128i& lo, __m128i& hi);
+
+		template <>
+		inline void unpack<1>(__m128i a, __m128i b, __m128i& lo, __m128i& hi)
+		{
+			lo = _mm_unpacklo_epi8(a, b);
+			hi = _mm_unpackhi_epi8(a, b);
+		}
+
+		template <>
+		inline void unpack<2>(__m128i a, __m128i b, __m128i& lo, __m128i& hi)
+		{
+			lo = _mm_unpacklo_epi16(a, b);
+			hi = _mm_unpackhi_epi16(a, b);
+		}
+
+		template <>
+		inline void unpack<4>(__m128i a, __m128i b, __m128i& lo, __m128i& hi)
+		{
+			lo = _mm_unpacklo_epi32(a, b);
+			hi = _mm_unpackhi_epi32(a, b);
+		}
+
+		template <>
+		inline void unpack<8>(__m128i a, __m128i b, __m128i& lo, __m128i& hi)
+		{
+			lo = _mm_unpacklo_epi64(a, b);
+			hi = _mm_unpackhi_epi64(a, b);
+		}
+
+		// Each round interleaves the N rows in pairs D apart, in lanes twice the
+		// width of the last round's, until the rows are the columns. Pair k is
+		// rows i + j and i + j + D, where i = k / D * 2 * D and j = k % D. The
+		// rounds and pairs are expanded at compile time so that the rows stay
+		// in registers.
+		template <int Lane, int D, std::size_t... K>
+		inline void round(const __m128i* a, __m128i* b, std::index_sequence<K...>)
+		{
+			(unpack<Lane>(a[K / D * 2 * D + K % D], a[K / D * 2 * D + K % D + D], b[K / D * 2 * D + 2 * (K % D)], b[K / D * 2 * D + 2 * (K % D) + 1]), ...);
+		}
+
+		template <int N, int Lane, int D>
+		inline void rounds(const __m128i* a, __m128i* result)
+		{
+			if constexpr(D < N)
+			{
+				__m128i b[N];
+				round<Lane, D>(a, b, std::make_index_sequence<N / 2>());
+				rounds<N, 2 * Lane, 2 * D>(b, result);
+			}
+			else
+				std::copy(a, a + N, result);
+		}
+
+		template <std::size_t... I>
+		inline void load(const unsigned char* in, std::ptrdiff_t stride, __m128i* a, std::index_sequence<I...>)
+		{
+			((a[I] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + I * stride))), ...);
+		}
+
+		template <std::size_t... I>
+		inline void store(const __m128i* a, unsigned char* out, std::ptrdiff_t stride, std::index_sequence<I...>)
+		{
+			(_mm_storeu_si128(reinterpret_cast<__m128i*>(out + I * stride), a[I]), ...);
+		}
+
+		// Transposes a tile of 16 bytes square, of 16x16, 8x8 or 4x4 pixels,
+		// in registers.
+		template <int B>
+		void transpose_tile(const unsigned char* in, std::ptrdiff_t in_stride, unsigned char* out, std::ptrdiff_t out_stride)
+		{
+			const int N = 16 / B;
+			__m128i a[N];
+			load(in, in_stride, a, std::make_index_sequence<N>());
+			rounds<N, B, 1>(a, a);
+			store(a, out, out_stride, std::make_index_sequence<N>());
+		}
+
+		template <int B>
+		void transpose_pixels(const unsigned char* in, std::ptrdiff_t in_stride, unsigned char* out, std::ptrdiff_t out_stride, int x0, int x1, int y0, int y1)
+		{
+			for(int y = y0; y < y1; y++)
+				for(int x = x0; x < x1; x++)
+					std::memcpy(out + x * out_stride + y * B, in + y * in_stride + x * B, B);
+		}
+
+		template <int B>
+		void transpose_block(const unsigned char* in, std::ptrdiff_t in_stride, unsigned char* out, std::ptrdiff_t out_stride, int w, int h)
+		{
+			const int N = 16 / B;
+			int y = 0;
+			for(; y + N <= h; y += N)
+			{
+				int x = 0;
+				for(; x + N <= w; x += N)
+					transpose_tile<B>(in + y * in_stride + x * B, in_stride, out + x * out_stride + y * B, out_stride);
+				transpose_pixels<B>(in, in_stride, out, out_stride, x, w, y, y + N);
+			}
+			transpose_pixels<B>(in, in_stride, out, out_stride, 0, w, y, h);
+		}
+	}
+
+	void transposeBlock(const unsigned char* in, std::ptrdiff_t in_stride, unsigned char* out, std::ptrdiff_t out_stride, int w, int h, int bytes)
+	{
+		if(bytes == 1)
+			transpose_block<1>(in, in_stride, out, out_stride, w, h);
+		else if(bytes == 2)
+			transpose_block<2>(in, in_stride, out, out_stride, w, h);
+		else
+			transpose_block<4>(in, in_stride, out, out_stride, w, h);
+	}
+}
+}
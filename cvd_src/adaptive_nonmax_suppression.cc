@@ -0,0 +1,335 @@
+#include "cvd/nonmax_suppression.h"
+#include "cvd/vision_exceptions.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace CVD
+{
+
+namespace
+{
+	// Keys which sort in the same order as the scores, reversed so that the
+	// strongest corner comes first.
+	uint32_t descending_key(int score)
+	{
+		return ~(static_cast<uint32_t>(score) ^ 0x80000000u);
+	}
+
+	uint32_t descending_key(float score)
+	{
+		// Adding 0 turns -0 in to 0, so that they compare equal.
+		uint32_t u;
+		score += 0.0f;
+		memcpy(&u, &score, sizeof(u));
+		return ~((u & 0x80000000u) ? ~u : (u | 0x80000000u));
+	}
+
+	// The corners sorted by descending score, with ties in their original
+	// order. The rank of a corner is its position in this order.
+	//
+	// This is a least significant digit first radix sort on the keys, which
+	// is stable and takes linear time. Digits which are the same for every
+	// corner, such as the high bits of small integer scores, are skipped.
+	template <class Score>
+	vector<int> score_order(const vector<ImageRef>& corners, const vector<Score>& scores)
+	{
+		if(corners.size() != scores.size())
+			throw Exceptions::Vision::BadInput("nonmax_suppression: there must be one score per corner");
+
+		const size_t n = scores.size();
+		vector<uint32_t> keys(n), keys_out(n);
+		vector<int> order(n), order_out(n);
+		vector<size_t> offsets(4 * 256);
+		for(size_t i = 0; i < n; i++)
+		{
+			keys[i] = descending_key(scores[i]);
+			order[i] = static_cast<int>(i);
+			for(int d = 0; d < 4; d++)
+				offsets[d * 256 + ((keys[i] >> (8 * d)) & 0xff)]++;
+		}
+
+		for(int d = 0; d < 4; d++)
+		{
+			size_t* offset = &offsets[d * 256];
+			const int shift = 8 * d;
+			if(n == 0 || offset[(keys[0] >> shift) & 0xff] == n)
+				continue;
+
+			size_t sum = 0;
+			for(int b = 0; b < 256; b++)
+			{
+				const size_t c = offset[b];
+				offset[b] = sum;
+				sum += c;
+			}
+
+			for(size_t i = 0; i < n; i++)
+			{
+				const size_t j = offset[(keys[i] >> shift) & 0xff]++;
+				keys_out[j] = keys[i];
+				order_out[j] = order[i];
+			}
+			keys.swap(keys_out);
+			order.swap(order_out);
+		}
+		return order;
+	}
+
+	void bounds(const vector<ImageRef>& corners, ImageRef& lo, ImageRef& hi)
+	{
+		lo = hi = corners[0];
+		for(const ImageRef& p : corners)
+		{
+			lo.x = min(lo.x, p.x);
+			lo.y = min(lo.y, p.y);
+			hi.x = max(hi.x, p.x);
+			hi.y = max(hi.y, p.y);
+		}
+	}
+
+	// A uniform grid of square cells over the bounding box of the corners.
+	// Each cell holds a linked list of the points inserted in to it, so
+	// inserting costs nothing to allocate. Points are numbered by rank.
+	class Grid
+	{
+		public:
+		Grid(const vector<ImageRef>& corners, const vector<int>& order, int cell_)
+		    : cell(max(1, cell_))
+		    , x(order.size())
+		    , y(order.size())
+		    , next(order.size(), -1)
+		{
+			ImageRef hi;
+			bounds(corners, lo, hi);
+			columns = (hi.x - lo.x) / cell + 1;
+			rows = (hi.y - lo.y) / cell + 1;
+			head.assign(static_cast<size_t>(columns) * rows, -1);
+
+			for(size_t i = 0; i < order.size(); i++)
+			{
+				x[i] = corners[order[i]].x;
+				y[i] = corners[order[i]].y;
+			}
+		}
+
+		void insert(int i)
+		{
+			int& h = head[index(column(x[i]), row(y[i]))];
+			next[i] = h;
+			h = i;
+			points++;
+		}
+
+		// Whether an inserted point is within sqrt(d2) of point i.
+		bool any_within(int i, long long d2) const
+		{
+			// The largest offset along either axis, and the cells it can reach.
+			long long d = static_cast<long long>(sqrt(static_cast<double>(d2)));
+			while(d * d > d2)
+				d--;
+			while((d + 1) * (d + 1) <= d2)
+				d++;
+			const int r = static_cast<int>(min<long long>((cell - 1 + d) / cell, max(columns, rows)));
+
+			// Search outwards, since the nearest cells are the most likely.
+			for(int k = 0; k <= r; k++)
+				if(ring(i, k, [&](int j) { return distance2(i, j) <= d2; }))
+					return true;
+			return false;
+		}
+
+		// The squared distance from point i to the nearest inserted point, or
+		// LLONG_MAX if there are none. Points in ring k > 0 are at least
+		// (k - 1) * cell + 1 away along one axis, so the search stops once
+		// the nearest point is no further than that.
+		long long nearest(int i) const
+		{
+			const int cx = column(x[i]), cy = row(y[i]);
+			const int rings = max(max(cx, columns - 1 - cx), max(cy, rows - 1 - cy));
+			long long best = LLONG_MAX;
+
+			for(int k = 0; k <= rings && points; k++)
+			{
+				const long long reach = static_cast<long long>(k - 1) * cell + 1;
+				if(k > 0 && best <= reach * reach)
+					break;
+				ring(i, k, [&](int j) {
+					best = min(best, distance2(i, j));
+					return false;
+				});
+			}
+			return best;
+		}
+
+		private:
+		// Call f for each point in the cells of the square ring k cells
+		// from the cell of point i, until it returns true. Returns whether
+		// it did.
+		template <class F>
+		bool ring(int i, int k, F f) const
+		{
+			const int cx = column(x[i]), cy = row(y[i]);
+			for(int gy = max(0, cy - k); gy <= min(rows - 1, cy + k); gy++)
+			{
+				const bool edge = gy == cy - k || gy == cy + k;
+				for(int gx = cx - k; gx <= cx + k; gx += edge ? 1 : 2 * k)
+					if(gx >= 0 && gx < columns)
+						for(int j = head[index(gx, gy)]; j != -1; j = next[j])
+							if(f(j))
+								return true;
+			}
+			return false;
+		}
+
+		int column(int px) const
+		{
+			return (px - lo.x) / cell;
+		}
+
+		int row(int py) const
+		{
+			return (py - lo.y) / cell;
+		}
+
+		size_t index(int gx, int gy) const
+		{
+			return static_cast<size_t>(gy) * columns + gx;
+		}
+
+		long long distance2(int i, int j) const
+		{
+			const long long dx = x[i] - x[j], dy = y[i] - y[j];
+			return dx * dx + dy * dy;
+		}
+
+		const int cell;
+		ImageRef lo;
+		int columns, rows;
+		int points = 0;
+		vector<int> x, y, next, head;
+	};
+
+	// Adaptive nonmaximal suppression, after Brown, Szeliski and Winder,
+	// "Multi-image matching using multi-scale oriented patches", 2005.
+	//
+	// The corners are visited in descending order of score, and a corner is
+	// put in the grid once it is strong enough to suppress the corner being
+	// visited, so the suppression radius is the distance to the nearest
+	// point in the grid. Only the count largest radii are wanted, and they
+	// are kept in a heap. Once it is full, a corner can only join if nothing
+	// in the grid is within the smallest radius in the heap, which is usually
+	// settled by the first few points near it. The full nearest neighbour
+	// search is needed only for corners which join the heap.
+	template <class Score>
+	void adaptive_nonmax(const vector<ImageRef>& corners, const vector<Score>& scores, int count, vector<ImageRef>& selected, double robustness)
+	{
+		if(count < 0 || !(robustness > 0 && robustness <= 1))
+			throw Exceptions::Vision::BadInput("adaptive_nonmax_suppression");
+
+		const vector<int> order = score_order(corners, scores);
+		selected.clear();
+		if(order.empty() || count == 0)
+			return;
+
+		const int n = static_cast<int>(order.size());
+		count = min(count, n);
+
+		// Cells about half the spacing of count evenly spread corners.
+		ImageRef lo, hi;
+		bounds(corners, lo, hi);
+		const double area = (hi.x - lo.x + 1.0) * (hi.y - lo.y + 1.0);
+		Grid grid(corners, order, static_cast<int>(sqrt(area / count) / 2));
+
+		// The heap holds (radius squared, rank), with the weakest entry on
+		// top: the smallest radius, then the largest rank.
+		typedef pair<long long, int> Entry;
+		auto weaker = [](const Entry& a, const Entry& b) { return a.first > b.first || (a.first == b.first && a.second < b.second); };
+		priority_queue<Entry, vector<Entry>, decltype(weaker)> heap(weaker);
+
+		int inserted = 0;
+		for(int i = 0; i < n; i++)
+		{
+			const double score = static_cast<double>(scores[order[i]]);
+			for(; inserted < i && robustness * static_cast<double>(scores[order[inserted]]) > score; inserted++)
+				grid.insert(inserted);
+
+			// Later corners lose ties, so a corner must beat the weakest
+			// radius outright to join a full heap, which it cannot do if that
+			// radius is infinite.
+			if(static_cast<int>(heap.size()) == count && (heap.top().first == LLONG_MAX || grid.any_within(i, heap.top().first)))
+				continue;
+
+			heap.push(Entry(grid.nearest(i), i));
+			if(static_cast<int>(heap.size()) > count)
+				heap.pop();
+		}
+
+		vector<Entry> best;
+		for(; !heap.empty(); heap.pop())
+			best.push_back(heap.top());
+		reverse(best.begin(), best.end());
+
+		for(const Entry& e : best)
+			selected.push_back(corners[order[e.second]]);
+	}
+
+	// Greedy suppression in descending order of score. A corner is kept if
+	// no kept corner is within the radius. With cells at least as large as
+	// the radius, those can only be in the 3x3 cells around it. The cells are
+	// made larger if need be to keep the grid to a few cells per corner.
+	template <class Score>
+	void radius_nonmax(const vector<ImageRef>& corners, const vector<Score>& scores, int radius, vector<ImageRef>& selected, size_t count)
+	{
+		if(radius < 0)
+			throw Exceptions::Vision::BadInput("radius_nonmax_suppression");
+
+		const vector<int> order = score_order(corners, scores);
+		selected.clear();
+		if(order.empty())
+			return;
+
+		ImageRef lo, hi;
+		bounds(corners, lo, hi);
+		const double area = (hi.x - lo.x + 1.0) * (hi.y - lo.y + 1.0);
+		Grid grid(corners, order, max(radius, static_cast<int>(sqrt(area / (4.0 * order.size())))));
+		const long long r2 = static_cast<long long>(radius) * radius;
+
+		for(int i = 0; i < static_cast<int>(order.size()) && selected.size() < count; i++)
+			if(!grid.any_within(i, r2))
+			{
+				grid.insert(i);
+				selected.push_back(corners[order[i]]);
+			}
+	}
+}
+
+void adaptive_nonmax_suppression(const vector<ImageRef>& corners, const vector<int>& scores, int count, vector<ImageRef>& selected, double robustness)
+{
+	adaptive_nonmax(corners, scores, count, selected, robustness);
+}
+
+void adaptive_nonmax_suppression(const vector<ImageRef>& corners, const vector<float>& scores, int count, vector<ImageRef>& selected, double robustness)
+{
+	adaptive_nonmax(corners, scores, count, selected, robustness);
+}
+
+void radius_nonmax_suppression(const vector<ImageRef>& corners, const vector<int>& scores, int radius, vector<ImageRef>& selected, size_t count)
+{
+	radius_nonmax(corners, scores, radius, selected, count);
+}
+
+void radius_nonmax_suppression(const vector<ImageRef>& corners, const vector<float>& scores, int radius, vector<ImageRef>& selected, size_t count)
+{
+	radius_nonmax(corners, scores, radius, selected, count);
+}
+
+}
@@ -0,0 +1,287 @@
+#include "cvd/binary_image.h"
+#include "cvd/vision_exceptions.h"
+#include "cvd_src/config_internal.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+namespace CVD
+{
+
+typedef BinaryImage::word word;
+
+namespace
+{
+	const int B = BinaryImage::bits_per_word;
+
+	struct And
+	{
+		static word identity() { return ~word(0); }
+		static word apply(word a, word b) { return a & b; }
+	};
+
+	struct Or
+	{
+		static word identity() { return 0; }
+		static word apply(word a, word b) { return a | b; }
+	};
+
+	// dst[i] = bits [B*i + d, B*(i+1) + d) of the row src, for m words. The
+	// source has n words and is taken to be the identity outside them. If
+	// Combine is set, the shifted row is combined with dst. This works in place
+	// if d >= 0.
+	template <class Op, bool Combine>
+	void shift_row(const word* src, int n, int d, word* dst, int m)
+	{
+		const int q = d >= 0 ? d / B : -((-d + B - 1) / B);
+		const int r = d - q * B;
+
+		auto fetch = [&](int j) { return j >= 0 && j < n ? src[j] : Op::identity(); };
+		auto shifted = [&](int i) {
+			const word a = fetch(i + q);
+			return r ? (a >> r) | (fetch(i + q + 1) << (B - r)) : a;
+		};
+		auto store = [&](int i, word w) { dst[i] = Combine ? Op::apply(dst[i], w) : w; };
+
+		// Words for which both source words are in the row
+		const int begin = min(m, max(0, -q));
+		const int end = max(begin, min(m, n - q - 1));
+
+		for(int i = 0; i < begin; i++)
+			store(i, shifted(i));
+		if(r)
+			for(int i = begin; i < end; i++)
+				store(i, (src[i + q] >> r) | (src[i + q + 1] << (B - r)));
+		else
+			for(int i = begin; i < end; i++)
+				store(i, src[i + q]);
+		for(int i = end; i < m; i++)
+			store(i, shifted(i));
+	}
+
+	// Combine a 1D window of n elements using doubling: if R_L is the window of
+	// length L starting at each element, R_2L(x) = R_L(x) op R_L(x + L), and any
+	// n is covered by two overlapping windows of the largest power of two p <= n.
+	// The row versions shift words, and the column versions combine whole rows.
+	template <class Op>
+	void rectangle(const BinaryImage& in, ImageRef lo, ImageRef hi, BinaryImage& out)
+	{
+		const int w = in.size().x;
+		const int h = in.size().y;
+
+		if(lo.x > hi.x || lo.y > hi.y)
+			throw Exceptions::Vision::BadInput("BinaryImage rectangle morphology: empty rectangle");
+
+		// Offsets more than the image size away select the same pixels as
+		// offsets of the image size.
+		lo.x = min(max(lo.x, -w), w);
+		hi.x = min(max(hi.x, -w), w);
+		lo.y = min(max(lo.y, -h), h);
+		hi.y = min(max(hi.y, -h), h);
+
+		const int nx = hi.x - lo.x + 1;
+		const int ny = hi.y - lo.y + 1;
+		const int words = in.words_per_row();
+
+		int px = 1, py = 1;
+		while(2 * px <= nx)
+			px *= 2;
+		while(2 * py <= ny)
+			py *= 2;
+
+		// The image rows and the rows that the windows reach outside it, which
+		// hold the identity. Row e holds image row e + base.
+		const int base = min(lo.y, 0);
+		const int rows = max(h - 1 + hi.y, h - 1) - base + 1;
+		vector<word> ext(static_cast<size_t>(rows) * words, Op::identity());
+		const word mask = in.last_word_mask();
+
+		// Windows starting left of the image are needed if lo.x < 0, so the
+		// row is extended to the left with whole words of the identity.
+		const int left = (max(0, -lo.x) + B - 1) / B;
+		const int n = left + words;
+		vector<word> run(n);
+
+		for(int y = 0; y < h; y++)
+		{
+			const word* src = in.row(y);
+			fill(run.begin(), run.begin() + left, Op::identity());
+			copy(src, src + words, run.begin() + left);
+			if(words)
+				run[n - 1] |= Op::identity() & ~mask;
+
+			for(int l = 1; l < px; l *= 2)
+				shift_row<Op, true>(run.data(), n, l, run.data(), n);
+			if(px != nx)
+				shift_row<Op, true>(run.data(), n, nx - px, run.data(), n);
+
+			shift_row<Op, false>(run.data(), n, left * B + lo.x, &ext[static_cast<size_t>(y - base) * words], words);
+		}
+
+		for(int l = 1; l < py; l *= 2)
+			for(int e = 0; e + l < rows; e++)
+			{
+				word* a = &ext[static_cast<size_t>(e) * words];
+				const word* b = a + static_cast<size_t>(l) * words;
+				for(int i = 0; i < words; i++)
+					a[i] = Op::apply(a[i], b[i]);
+			}
+
+		out.resize(in.size());
+		for(int y = 0; y < h; y++)
+		{
+			const word* a = &ext[static_cast<size_t>(y + lo.y - base) * words];
+			const word* b = a + static_cast<size_t>(ny - py) * words;
+			word* o = out.row(y);
+			for(int i = 0; i < words; i++)
+				o[i] = Op::apply(a[i], b[i]);
+			if(words)
+				o[words - 1] &= mask;
+		}
+	}
+}
+
+BinaryImage::BinaryImage(const BasicImage<byte>& in, byte threshold)
+{
+	binary_threshold(in, threshold, *this);
+}
+
+void BinaryImage::fill(bool value)
+{
+	std::fill(my_data.begin(), my_data.end(), value ? ~word(0) : word(0));
+	if(value && my_words)
+		for(int y = 0; y < my_size.y; y++)
+			row(y)[my_words - 1] &= last_word_mask();
+}
+
+size_t BinaryImage::count() const
+{
+	size_t n = 0;
+	for(word w : my_data)
+		n += Internal::popcount(w);
+	return n;
+}
+
+BinaryImage& BinaryImage::operator&=(const BinaryImage& b)
+{
+	if(size() != b.size())
+		throw Exceptions::Vision::IncompatibleImageSizes(__FUNCTION__);
+	for(size_t i = 0; i < my_data.size(); i++)
+		my_data[i] &= b.my_data[i];
+	return *this;
+}
+
+BinaryImage& BinaryImage::operator|=(const BinaryImage& b)
+{
+	if(size() != b.size())
+		throw Exceptions::Vision::IncompatibleImageSizes(__FUNCTION__);
+	for(size_t i = 0; i < my_data.size(); i++)
+		my_data[i] |= b.my_data[i];
+	return *this;
+}
+
+BinaryImage& BinaryImage::operator^=(const BinaryImage& b)
+{
+	if(size() != b.size())
+		throw Exceptions::Vision::IncompatibleImageSizes(__FUNCTION__);
+	for(size_t i = 0; i < my_data.size(); i++)
+		my_data[i] ^= b.my_data[i];
+	return *this;
+}
+
+void BinaryImage::invert()
+{
+	for(word& w : my_data)
+		w = ~w;
+	if(my_words)
+		for(int y = 0; y < my_size.y; y++)
+			row(y)[my_words - 1] &= last_word_mask();
+}
+
+void binary_threshold(const BasicImage<byte>& in, byte threshold, BinaryImage& out)
+{
+	const int w = in.size().x;
+	out.resize(in.size());
+
+	for(int y = 0; y < in.size().y; y++)
+	{
+		const byte* p = in[y];
+		word* o = out.row(y);
+
+		// For whole words, the comparisons give 64 flags of 0 or 1, which is
+		// vectorised. Each group of 8 flags is then gathered in to the top
+		// byte of a multiply, which puts flag k at bit 56 + k when the flags
+		// are loaded little endian.
+		int i = 0;
+		for(; (i + 1) * B <= w; i++, p += B)
+		{
+			uint8_t flags[B];
+			for(int k = 0; k < B; k++)
+				flags[k] = p[k] > threshold;
+
+			word bits = 0;
+#ifdef CVD_INTERNAL_ARCH_LITTLE_ENDIAN
+			for(int k = 0; k < B / 8; k++)
+			{
+				word f;
+				memcpy(&f, flags + 8 * k, 8);
+				bits |= ((f * 0x0102040810204080ull) >> 56) << (8 * k);
+			}
+#else
+			for(int k = 0; k < B; k++)
+				bits |= word(flags[k]) << k;
+#endif
+			o[i] = bits;
+		}
+
+		if(i * B < w)
+		{
+			word bits = 0;
+			for(int k = 0; k < w - i * B; k++)
+				bits |= word(p[k] > threshold) << k;
+			o[i] = bits;
+		}
+	}
+}
+
+void binary_unpack(const BinaryImage& in, BasicImage<byte>& out, byte on, byte off)
+{
+	if(in.size() != out.size())
+		throw Exceptions::Vision::IncompatibleImageSizes(__FUNCTION__);
+
+	const int w = in.size().x;
+	for(int y = 0; y < in.size().y; y++)
+	{
+		const word* p = in.row(y);
+		byte* o = out[y];
+		for(int x = 0; x < w; x++)
+			o[x] = (p[x / B] >> (x % B)) & 1 ? on : off;
+	}
+}
+
+void erodeRectangle(const BinaryImage& in, ImageRef lo, ImageRef hi, BinaryImage& out)
+{
+	rectangle<And>(in, lo, hi, out);
+}
+
+void dilateRectangle(const BinaryImage& in, ImageRef lo, ImageRef hi, BinaryImage& out)
+{
+	rectangle<Or>(in, lo, hi, out);
+}
+
+void openRectangle(const BinaryImage& in, ImageRef lo, ImageRef hi, BinaryImage& out)
+{
+	rectangle<And>(in, lo, hi, out);
+	rectangle<Or>(out, -hi, -lo, out);
+}
+
+void closeRectangle(const BinaryImage& in, ImageRef lo, ImageRef hi, BinaryImage& out)
+{
+	rectangle<Or>(in, lo, hi, out);
+	rectangle<And>(out, -hi, -lo, out);
+}
+
+}
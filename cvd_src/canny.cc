@@ -0,0 +1,318 @@
+#include "cvd/canny.h"
+#include "cvd/vision_exceptions.h"
+
+#include "cvd/internal/slice.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+namespace CVD
+{
+
+// Canny edge detection in integers.
+//
+// Each band of rows is processed on its own thread. The Sobel gradients of a
+// row are 16 bit, and the squared magnitudes 32 bit. The direction of the
+// gradient is binned by comparing the components against tan(22.5 degrees)
+// in fixed point, and the nonmaximal suppression compares each magnitude
+// with both pairs of neighbours and selects by the bin. All of these are
+// branch free loops over rows, which the compiler vectorises. Only three
+// rows of magnitudes are kept, and the result of the suppression is written
+// straight to the output as a code for each pixel.
+//
+// Hysteresis first floods from the strong pixels within each band. A
+// weak pixel next to an accepted pixel in the band above or below is then
+// used as a new seed, and this is repeated until there are none, so the
+// result is the same as flooding the whole image at once.
+namespace
+{
+	const byte weak = 1;
+	const byte strong = 2;
+	const byte accepted = 255;
+
+	// tan(22.5 degrees) in 15 bit fixed point
+	const int tan_22_5 = 13573;
+
+	// Direction bins: which pair of neighbours lies along the gradient.
+	enum Bin : byte
+	{
+		Horizontal,
+		Diagonal,     // (x-1, y-1) and (x+1, y+1)
+		Vertical,
+		AntiDiagonal, // (x+1, y-1) and (x-1, y+1)
+	};
+
+	class CannyBand
+	{
+		public:
+		CannyBand(const BasicImage<byte>& im_, BasicImage<byte>& edges_, int lower, int upper)
+		    : im(im_)
+		    , edges(edges_)
+		    , w(im_.size().x)
+		    , h(im_.size().y)
+		    , lower2(square(lower))
+		    , upper2(square(upper))
+		    , mags(3 * w)
+		    , bins(3 * w)
+		{
+		}
+
+		// Write the weak and strong codes for rows y0 to y1, then accept the
+		// pixels connected to strong ones within those rows.
+		void operator()(int y0, int y1)
+		{
+			int* m[3];
+			byte* b[3];
+			for(int i = 0; i < 3; i++)
+			{
+				m[i] = &mags[static_cast<size_t>(i) * w];
+				b[i] = &bins[static_cast<size_t>(i) * w];
+			}
+
+			gradients(y0 - 1, m[0], b[0]);
+			gradients(y0, m[1], b[1]);
+			for(int y = y0; y < y1; y++)
+			{
+				gradients(y + 1, m[2], b[2]);
+				suppress(y, m[0], m[1], m[2], b[1]);
+				rotate(m, m + 1, m + 3);
+				rotate(b, b + 1, b + 3);
+			}
+
+			for(int y = y0; y < y1; y++)
+			{
+				byte* row = edges[y];
+				for(int x = 1; x < w - 1; x++)
+					if(row[x] == strong)
+					{
+						row[x] = accepted;
+						stack.push_back(ImageRef(x, y));
+						flood(y0, y1);
+					}
+			}
+		}
+
+		// Accept the weak pixels connected to the seeds within rows y0 to y1.
+		void operator()(int y0, int y1, const vector<ImageRef>& seeds)
+		{
+			for(const ImageRef& s : seeds)
+				if(edges[s] == weak)
+				{
+					edges[s] = accepted;
+					stack.push_back(s);
+					flood(y0, y1);
+				}
+		}
+
+		private:
+		static int square(int t)
+		{
+			return static_cast<int>(min<long long>(static_cast<long long>(t) * t, INT_MAX));
+		}
+
+		// Squared gradient magnitudes and direction bins for row y. The
+		// magnitude is zero on the edge of the image and outside it.
+		void gradients(int y, int* mag, byte* bin)
+		{
+			fill(mag, mag + w, 0);
+			if(y < 1 || y >= h - 1)
+				return;
+
+			const byte* a = im[y - 1];
+			const byte* c = im[y];
+			const byte* d = im[y + 1];
+
+			// The pixels are copied to local arrays, since byte pointers could
+			// alias anything and would stop the loops being vectorised.
+			const int N = 64;
+			for(int x0 = 1; x0 < w - 1; x0 += N)
+			{
+				const int n = min(N, w - 1 - x0);
+				int16_t above[N + 2], middle[N + 2], below[N + 2];
+				for(int i = 0; i < n + 2; i++)
+				{
+					above[i] = a[x0 - 1 + i];
+					middle[i] = c[x0 - 1 + i];
+					below[i] = d[x0 - 1 + i];
+				}
+
+				int m[N];
+				byte k[N];
+				for(int i = 0; i < n; i++)
+				{
+					const int16_t gx = (above[i + 2] + 2 * middle[i + 2] + below[i + 2]) - (above[i] + 2 * middle[i] + below[i]);
+					const int16_t gy = (below[i] + 2 * below[i + 1] + below[i + 2]) - (above[i] + 2 * above[i + 1] + above[i + 2]);
+					const int ax = abs(gx), ay = abs(gy);
+					m[i] = gx * gx + gy * gy;
+
+					const bool horizontal = (ay << 15) < tan_22_5 * ax;
+					const bool vertical = (ax << 15) < tan_22_5 * ay;
+					const bool same_sign = (gx ^ gy) >= 0;
+					k[i] = horizontal ? Horizontal : vertical ? Vertical : same_sign ? Diagonal : AntiDiagonal;
+				}
+
+				std::copy(m, m + n, mag + x0);
+				std::copy(k, k + n, bin + x0);
+			}
+		}
+
+		// Nonmaximal suppression and thresholding of row y. A pixel must be
+		// greater than its neighbour on one side along the gradient and at
+		// least as great as the other, so that a ridge two pixels wide with
+		// equal magnitudes gives one edge and not none.
+		void suppress(int y, const int* m0, const int* m1, const int* m2, const byte* bin)
+		{
+			byte* out = edges[y];
+			out[0] = out[w - 1] = 0;
+			if(y < 1 || y >= h - 1)
+			{
+				fill(out, out + w, 0);
+				return;
+			}
+
+			// All the neighbours are loaded and then selected, since loads
+			// which depend on the bin would not be vectorised.
+			const int N = 64;
+			for(int x0 = 1; x0 < w - 1; x0 += N)
+			{
+				const int n = min(N, w - 1 - x0);
+				byte codes[N];
+				for(int i = 0; i < n; i++)
+				{
+					const int x = x0 + i;
+					const int k = bin[x];
+					const int left = m1[x - 1], right = m1[x + 1];
+					const int up_left = m0[x - 1], up = m0[x], up_right = m0[x + 1];
+					const int down_left = m2[x - 1], down = m2[x], down_right = m2[x + 1];
+
+					const int before = k == Horizontal ? left : k == Diagonal ? up_left : k == Vertical ? up : up_right;
+					const int after = k == Horizontal ? right : k == Diagonal ? down_right : k == Vertical ? down : down_left;
+					const int m = m1[x];
+					const bool maximum = (m > before) & (m >= after);
+					codes[i] = maximum & (m > upper2) ? strong : maximum & (m > lower2) ? weak : 0;
+				}
+				std::copy(codes, codes + n, out + x0);
+			}
+		}
+
+		// Depth first flood from the pixels on the stack, within rows y0 to y1.
+		// Pixels on the edge of the image are never weak or strong, so the
+		// neighbours are always inside it.
+		void flood(int y0, int y1)
+		{
+			while(!stack.empty())
+			{
+				const ImageRef p = stack.back();
+				stack.pop_back();
+
+				for(int y = max(y0, p.y - 1); y <= min(y1 - 1, p.y + 1); y++)
+				{
+					byte* row = edges[y];
+					for(int x = p.x - 1; x <= p.x + 1; x++)
+						if(row[x] == weak || row[x] == strong)
+						{
+							row[x] = accepted;
+							stack.push_back(ImageRef(x, y));
+						}
+				}
+			}
+		}
+
+		const BasicImage<byte>& im;
+		BasicImage<byte>& edges;
+		const int w, h;
+		const int lower2, upper2;
+		vector<int> mags;
+		vector<byte> bins;
+		vector<ImageRef> stack;
+	};
+
+	void canny_bands(const BasicImage<byte>& im, BasicImage<byte>& edges, int lower, int upper)
+	{
+		const int w = im.size().x;
+		const int h = im.size().y;
+		const int band = internal::SliceHeight(h, 16);
+		const int bands = (h + band - 1) / band;
+
+		internal::Slice(h, band, [&](int, int y0, int rows) {
+			CannyBand c(im, edges, lower, upper);
+			c(y0, y0 + rows);
+		});
+
+		// Carry the edges across the boundaries between bands until nothing
+		// changes. Finding the seeds only reads the image, and flooding in a
+		// band only touches its own rows, so each step can run in parallel.
+		vector<vector<ImageRef>> seeds(bands);
+		for(;;)
+		{
+			internal::Slice(h, band, [&](int i, int y0, int rows) {
+				seeds[i].clear();
+				auto cross = [&](int y, int other) {
+					if(other < 0 || other >= h)
+						return;
+					const byte* row = edges[y];
+					const byte* next = edges[other];
+					for(int x = 1; x < w - 1; x++)
+						if(row[x] == weak && (next[x - 1] == accepted || next[x] == accepted || next[x + 1] == accepted))
+							seeds[i].push_back(ImageRef(x, y));
+				};
+				cross(y0, y0 - 1);
+				cross(y0 + rows - 1, y0 + rows);
+			});
+
+			bool any = false;
+			for(const auto& s : seeds)
+				any = any || !s.empty();
+			if(!any)
+				break;
+
+			internal::Slice(h, band, [&](int i, int y0, int rows) {
+				CannyBand c(im, edges, lower, upper);
+				c(y0, y0 + rows, seeds[i]);
+			});
+		}
+
+		internal::Slice(h, band, [&](int, int y0, int rows) {
+			// A local copy of the width, which the byte stores cannot alias.
+			const int width = w;
+			for(int y = y0; y < y0 + rows; y++)
+			{
+				byte* row = edges[y];
+				for(int x = 0; x < width; x++)
+					row[x] = row[x] == accepted ? accepted : 0;
+			}
+		});
+	}
+}
+
+void canny_edges(const BasicImage<byte>& im, BasicImage<byte>& edges, int lower_threshold, int upper_threshold)
+{
+	if(im.size() != edges.size())
+		throw Exceptions::Vision::IncompatibleImageSizes(__FUNCTION__);
+	if(lower_threshold < 0 || upper_threshold < lower_threshold)
+		throw Exceptions::Vision::BadInput("canny_edges: the thresholds must satisfy 0 <= lower <= upper");
+
+	if(im.size().x < 3 || im.size().y < 3)
+	{
+		edges.zero();
+		return;
+	}
+
+	// The bands read rows of the source beyond their own, so work from a
+	// copy if in place.
+	if(im.data() == edges.data())
+	{
+		Image<byte> copy(im.size());
+		copy.copy_from(im);
+		canny_bands(copy, edges, lower_threshold, upper_threshold);
+	}
+	else
+		canny_bands(im, edges, lower_threshold, upper_threshold);
+}
+
+}
@@ -1,5 +1,8 @@
 #include "cvd/connected_components.h"
+#include "cvd/vision_exceptions.h"
+#include "cvd/internal/slice.h"
 #include <algorithm>
+#include <atomic>
 #include <climits>
 #include <iterator>
 
@@ -152,4 +155,588 @@ void connected_components(const vector<ImageRef>& v, vector<vector<ImageRef>>& r
 	for(unsigned int i = 0; i < components.size(); i++)
 		r[i].swap(segments[components[i]]);
 }
+
+void connected_components(const BinaryImage& im, vector<vector<ImageRef>>& r)
+{
+	//Scan the set bits a word at a time, which gives the points in the
+	//raster order that the point list version expects.
+	vector<ImageRef> v;
+	v.reserve(im.count());
+	for(int y = 0; y < im.size().y; y++)
+	{
+		const BinaryImage::word* row = im.row(y);
+		for(int i = 0; i < im.words_per_row(); i++)
+			for(BinaryImage::word w = row[i]; w != 0; w &= w - 1)
+				v.push_back(ImageRef(i * BinaryImage::bits_per_word + Internal::lowest_bit(w), y));
+	}
+
+	connected_components(v, r);
+}
+
+//Image based labelling. Each row is broken in to runs of foreground pixels,
+//and each run is joined to the runs it touches in the row above. Runs are
+//given provisional labels in raster order, and the union-find structure keeps
+//the smallest provisional label of a component as its root, so numbering the
+//roots in order labels the components in the raster order of their first
+//pixel. The image is labelled in stripes on multiple threads.
+namespace
+{
+	struct Run
+	{
+		int x0, x1; //The run covers [x0, x1)
+		int value;
+		int label;
+	};
+
+	int find_root(vector<int>& parent, int n)
+	{
+		//Path halving
+		while(parent[n] != n)
+		{
+			parent[n] = parent[parent[n]];
+			n = parent[n];
+		}
+		return n;
+	}
+
+	int unite(vector<int>& parent, int a, int b)
+	{
+		a = find_root(parent, a);
+		b = find_root(parent, b);
+		if(a < b)
+			parent[b] = a;
+		else
+			parent[a] = b;
+		return min(a, b);
+	}
+
+	//Runs of non-zero pixels.
+	template <class T>
+	struct NonZeroRuns
+	{
+		const BasicImage<T>& im;
+
+		void operator()(int y, vector<Run>& runs) const
+		{
+			const T* p = im[y];
+			const int w = im.size().x;
+			for(int x = 0; x < w;)
+			{
+				while(x < w && p[x] == 0)
+					x++;
+				if(x == w)
+					break;
+				const int x0 = x;
+				while(x < w && p[x] != 0)
+					x++;
+				runs.push_back(Run { x0, x, 1, 0 });
+			}
+		}
+	};
+
+	//Runs of equal non-zero pixels.
+	template <class T>
+	struct EqualRuns
+	{
+		const BasicImage<T>& im;
+
+		void operator()(int y, vector<Run>& runs) const
+		{
+			const T* p = im[y];
+			const int w = im.size().x;
+			for(int x = 0; x < w;)
+			{
+				while(x < w && p[x] == 0)
+					x++;
+				if(x == w)
+					break;
+				const int x0 = x;
+				const T v = p[x];
+				while(x < w && p[x] == v)
+					x++;
+				runs.push_back(Run { x0, x, static_cast<int>(v), 0 });
+			}
+		}
+	};
+
+	//Runs of set bits, found a word at a time.
+	struct BinaryRuns
+	{
+		const BinaryImage& im;
+
+		//The first position from x onwards with the given value, or the width.
+		int next(const BinaryImage::word* row, int x, bool value) const
+		{
+			const int B = BinaryImage::bits_per_word;
+			const int w = im.size().x;
+			const int n = im.words_per_row();
+			int i = x / B;
+			if(i >= n)
+				return w;
+			BinaryImage::word m = (value ? row[i] : ~row[i]) & (~BinaryImage::word(0) << (x % B));
+			while(m == 0)
+			{
+				if(++i == n)
+					return w;
+				m = value ? row[i] : ~row[i];
+			}
+			return min(w, i * B + Internal::lowest_bit(m));
+		}
+
+		void operator()(int y, vector<Run>& runs) const
+		{
+			const BinaryImage::word* row = im.row(y);
+			const int w = im.size().x;
+			for(int x = next(row, 0, true); x < w;)
+			{
+				const int x1 = next(row, x, false);
+				runs.push_back(Run { x, x1, 1, 0 });
+				x = next(row, x1, true);
+			}
+		}
+	};
+
+	//Call f for each run in [a, end) of the row above which touches r and has
+	//the same value. Returns the first of these runs which might touch a run
+	//to the right of r.
+	template <class F>
+	int for_each_touching(const vector<Run>& above, int a, int end, const Run& r, int reach, F f)
+	{
+		while(a < end && above[a].x1 + reach <= r.x0)
+			a++;
+		for(int i = a; i < end && above[i].x0 < r.x1 + reach; i++)
+			if(above[i].value == r.value)
+				f(above[i]);
+		return a;
+	}
+
+	//Sums over the pixels of a component. The sums over a run of n pixels
+	//have closed forms, so the cost of these is per run, except for the
+	//intensity weighted sums.
+	struct Moments
+	{
+		long long area = 0, x = 0, y = 0, xx = 0, xy = 0, yy = 0;
+		ImageRef lo = ImageRef(INT_MAX, INT_MAX), hi = ImageRef(INT_MIN, INT_MIN);
+		double w = 0, wx = 0, wy = 0, wxx = 0, wxy = 0, wyy = 0;
+
+		//Sum of i^2 for i from 0 to m
+		static long long squares(long long m)
+		{
+			return m * (m + 1) * (2 * m + 1) / 6;
+		}
+
+		void add(const Run& r, int row)
+		{
+			const long long n = r.x1 - r.x0;
+			const long long sx = (r.x0 + r.x1 - 1) * n / 2;
+			area += n;
+			x += sx;
+			y += row * n;
+			xx += squares(r.x1 - 1) - squares(r.x0 - 1);
+			xy += row * sx;
+			yy += static_cast<long long>(row) * row * n;
+			lo.x = min(lo.x, r.x0);
+			lo.y = min(lo.y, row);
+			hi.x = max(hi.x, r.x1 - 1);
+			hi.y = max(hi.y, row);
+		}
+
+		void add_weighted(const Run& r, int row, const byte* grey)
+		{
+			long long s = 0, sx = 0, sxx = 0;
+			for(long long i = r.x0; i < r.x1; i++)
+			{
+				s += grey[i];
+				sx += grey[i] * i;
+				sxx += grey[i] * i * i;
+			}
+			w += s;
+			wx += sx;
+			wy += static_cast<double>(s) * row;
+			wxx += sxx;
+			wxy += static_cast<double>(sx) * row;
+			wyy += static_cast<double>(s) * row * row;
+		}
+
+		Moments& operator+=(const Moments& m)
+		{
+			area += m.area;
+			x += m.x;
+			y += m.y;
+			xx += m.xx;
+			xy += m.xy;
+			yy += m.yy;
+			lo.x = min(lo.x, m.lo.x);
+			lo.y = min(lo.y, m.lo.y);
+			hi.x = max(hi.x, m.hi.x);
+			hi.y = max(hi.y, m.hi.y);
+			w += m.w;
+			wx += m.wx;
+			wy += m.wy;
+			wxx += m.wxx;
+			wxy += m.wxy;
+			wyy += m.wyy;
+			return *this;
+		}
+
+		bool passes(const ComponentFilter& f) const
+		{
+			const ImageRef size = hi - lo + ImageRef(1, 1);
+			return area >= f.min_area && area <= f.max_area && size.x >= f.min_size.x && size.y >= f.min_size.y && size.x <= f.max_size.x && size.y <= f.max_size.y;
+		}
+	};
+
+	//Which statistics to gather while labelling.
+	struct Gather
+	{
+		ComponentStatistics* stats;
+		const BasicImage<byte>* grey;
+		ComponentFilter filter;
+	};
+
+	//The runs and provisional labels of a horizontal stripe of the image.
+	struct Stripe
+	{
+		vector<Run> runs;
+		vector<int> row_start;
+		vector<int> parent;
+		vector<Moments> moments;
+		int offset = 0;
+	};
+
+	template <class Runs>
+	void label_stripe(const Runs& find_runs, int y0, int rows, int reach, const Gather* gather, Stripe& stripe)
+	{
+		vector<Run>& runs = stripe.runs;
+		vector<int>& parent = stripe.parent;
+		stripe.row_start.assign(rows + 1, 0);
+
+		for(int y = 0; y < rows; y++)
+		{
+			stripe.row_start[y] = static_cast<int>(runs.size());
+			find_runs(y0 + y, runs);
+
+			int above = y > 0 ? stripe.row_start[y - 1] : 0;
+			const int above_end = stripe.row_start[y];
+
+			for(size_t i = stripe.row_start[y]; i < runs.size(); i++)
+			{
+				Run& r = runs[i];
+				r.label = -1;
+
+				above = for_each_touching(runs, above, above_end, r, reach, [&](const Run& a) {
+					r.label = r.label == -1 ? find_root(parent, a.label) : unite(parent, r.label, a.label);
+				});
+
+				if(r.label == -1)
+				{
+					r.label = static_cast<int>(parent.size());
+					parent.push_back(r.label);
+				}
+
+				if(gather)
+				{
+					stripe.moments.resize(parent.size());
+					stripe.moments[r.label].add(r, y0 + y);
+					if(gather->grey)
+						stripe.moments[r.label].add_weighted(r, y0 + y, (*gather->grey)[y0 + y]);
+				}
+			}
+		}
+		stripe.row_start[rows] = static_cast<int>(runs.size());
+
+		//Gather the sums on the roots within the stripe.
+		if(gather)
+			for(size_t i = 0; i < parent.size(); i++)
+			{
+				const int root = find_root(parent, static_cast<int>(i));
+				if(root != static_cast<int>(i))
+					stripe.moments[root] += stripe.moments[i];
+			}
+	}
+
+	void fill_statistics(const Moments& m, ComponentStatistics& stats, size_t i, bool weighted)
+	{
+		const double area = static_cast<double>(m.area);
+		stats.area[i] = static_cast<int>(m.area);
+		stats.top_left[i] = m.lo;
+		stats.bottom_right[i] = m.hi;
+		stats.centroid_x[i] = m.x / area;
+		stats.centroid_y[i] = m.y / area;
+		stats.xx[i] = m.xx / area - stats.centroid_x[i] * stats.centroid_x[i];
+		stats.xy[i] = m.xy / area - stats.centroid_x[i] * stats.centroid_y[i];
+		stats.yy[i] = m.yy / area - stats.centroid_y[i] * stats.centroid_y[i];
+
+		if(!weighted)
+			return;
+
+		stats.intensity[i] = m.w;
+		if(m.w == 0)
+		{
+			stats.weighted_centroid_x[i] = stats.weighted_centroid_y[i] = 0;
+			stats.weighted_xx[i] = stats.weighted_xy[i] = stats.weighted_yy[i] = 0;
+			return;
+		}
+		const double cx = stats.weighted_centroid_x[i] = m.wx / m.w;
+		const double cy = stats.weighted_centroid_y[i] = m.wy / m.w;
+		stats.weighted_xx[i] = m.wxx / m.w - cx * cx;
+		stats.weighted_xy[i] = m.wxy / m.w - cx * cy;
+		stats.weighted_yy[i] = m.wyy / m.w - cy * cy;
+	}
+
+	void resize_statistics(ComponentStatistics& stats, size_t n, bool weighted)
+	{
+		stats.area.resize(n);
+		stats.top_left.resize(n);
+		stats.bottom_right.resize(n);
+		stats.centroid_x.resize(n);
+		stats.centroid_y.resize(n);
+		stats.xx.resize(n);
+		stats.xy.resize(n);
+		stats.yy.resize(n);
+
+		const size_t nw = weighted ? n : 0;
+		stats.intensity.resize(nw);
+		stats.weighted_centroid_x.resize(nw);
+		stats.weighted_centroid_y.resize(nw);
+		stats.weighted_xx.resize(nw);
+		stats.weighted_xy.resize(nw);
+		stats.weighted_yy.resize(nw);
+	}
+
+	int find_root(const vector<atomic<int>>& parent, int n)
+	{
+		for(int p; (p = parent[n].load()) != n;)
+			n = p;
+		return n;
+	}
+
+	//Lock free union. Only roots are changed, with a compare and swap which
+	//fails if another thread got there first. The larger root is always
+	//joined to the smaller, so the final root of a component is its smallest
+	//label whatever order the joins happen in.
+	void unite(vector<atomic<int>>& parent, int a, int b)
+	{
+		for(;;)
+		{
+			a = find_root(parent, a);
+			b = find_root(parent, b);
+			if(a == b)
+				return;
+			if(a < b)
+				swap(a, b);
+			int expected = a;
+			if(parent[a].compare_exchange_strong(expected, b))
+				return;
+		}
+	}
+
+	//Rows per stripe. There are several stripes per thread, to balance the
+	//load, but each is tall enough that the joins between stripes are cheap.
+	int stripe_height(int height)
+	{
+		return min(256, internal::SliceHeight(height, 32));
+	}
+
+	//The stripes are labelled independently, then the stripes are joined
+	//along their borders in a shared union-find structure. Provisional labels
+	//are still numbered in raster order across the whole image, so the result
+	//is the same as labelling the image in one pass, whatever the number of
+	//threads.
+	template <class Runs>
+	int label_image(const Runs& find_runs, ImageRef size, BasicImage<int>& labels, Connectivity connectivity, const Gather* gather = nullptr)
+	{
+		if(labels.size() != size)
+			throw Exceptions::Vision::IncompatibleImageSizes("connected_components");
+		if(gather && gather->grey && gather->grey->size() != size)
+			throw Exceptions::Vision::IncompatibleImageSizes("connected_components");
+
+		//With 8 way connectivity, runs which meet at a corner touch.
+		const int reach = connectivity == Connectivity::Eight ? 1 : 0;
+		const int height = stripe_height(size.y);
+		const int n = (size.y + height - 1) / height;
+		vector<Stripe> stripes(n);
+
+		internal::Slice(size.y, height, [&](int s, int y0, int rows) {
+			label_stripe(find_runs, y0, rows, reach, gather, stripes[s]);
+		});
+
+		int total = 0;
+		for(Stripe& stripe : stripes)
+		{
+			stripe.offset = total;
+			total += static_cast<int>(stripe.parent.size());
+		}
+
+		//Move to global labels. The roots within each stripe stay roots, with
+		//everything else pointing straight at them.
+		vector<atomic<int>> parent(total);
+		internal::Slice(n, 1, [&](int s, int, int) {
+			Stripe& stripe = stripes[s];
+			for(size_t i = 0; i < stripe.parent.size(); i++)
+				parent[stripe.offset + i].store(stripe.offset + find_root(stripe.parent, static_cast<int>(i)));
+			for(Run& r : stripe.runs)
+				r.label += stripe.offset;
+		});
+
+		//Join the first row of each stripe to the last row of the one above.
+		internal::Slice(n, 1, [&](int s, int, int) {
+			if(s == 0)
+				return;
+			const Stripe& above = stripes[s - 1];
+			const Stripe& below = stripes[s];
+			const int rows_above = static_cast<int>(above.row_start.size()) - 1;
+
+			int a = above.row_start[rows_above - 1];
+			for(int i = 0; i < below.row_start[1]; i++)
+			{
+				const Run& r = below.runs[i];
+				a = for_each_touching(above.runs, a, above.row_start[rows_above], r, reach, [&](const Run& b) {
+					unite(parent, r.label, b.label);
+				});
+			}
+		});
+
+		//Point every label at its final root.
+		internal::Slice(n, 1, [&](int s, int, int) {
+			const int begin = stripes[s].offset;
+			const int end = begin + static_cast<int>(stripes[s].parent.size());
+			for(int i = begin; i < end; i++)
+				parent[i].store(find_root(parent, i));
+		});
+
+		//Only the roots within stripes which were joined through another
+		//stripe have sums to move, which is few enough to do on one thread.
+		if(gather)
+			for(int s = 0; s < n; s++)
+				for(size_t i = 0; i < stripes[s].parent.size(); i++)
+				{
+					const int label = stripes[s].offset + static_cast<int>(i);
+					const int root = parent[label].load();
+					if(stripes[s].parent[i] == static_cast<int>(i) && root != label)
+					{
+						int t = s;
+						while(stripes[t].offset > root)
+							t--;
+						stripes[t].moments[root - stripes[t].offset] += stripes[s].moments[i];
+					}
+				}
+
+		//Count the roots which are kept in each stripe.
+		vector<int> roots(n, 0);
+		internal::Slice(n, 1, [&](int s, int, int) {
+			const Stripe& stripe = stripes[s];
+			for(size_t i = 0; i < stripe.parent.size(); i++)
+			{
+				const int label = stripe.offset + static_cast<int>(i);
+				if(parent[label].load() == label)
+					roots[s] += !gather || stripe.moments[i].passes(gather->filter);
+			}
+		});
+
+		//Number the roots in order.
+		vector<int> number(total);
+		int count = 0;
+		for(int s = 0; s < n; s++)
+		{
+			const int first = count;
+			count += roots[s];
+			roots[s] = first;
+		}
+		const bool weighted = gather && gather->grey;
+		if(gather)
+			resize_statistics(*gather->stats, count, weighted);
+
+		internal::Slice(n, 1, [&](int s, int, int) {
+			const Stripe& stripe = stripes[s];
+			int k = roots[s];
+			for(size_t i = 0; i < stripe.parent.size(); i++)
+			{
+				const int label = stripe.offset + static_cast<int>(i);
+				if(parent[label].load() != label)
+					continue;
+				if(gather && !stripe.moments[i].passes(gather->filter))
+					number[label] = 0;
+				else
+				{
+					number[label] = ++k;
+					if(gather)
+						fill_statistics(stripe.moments[i], *gather->stats, k - 1, weighted);
+				}
+			}
+		});
+
+		internal::Slice(size.y, height, [&](int s, int y0, int rows) {
+			const Stripe& stripe = stripes[s];
+			for(int y = 0; y < rows; y++)
+			{
+				int* out = labels[y0 + y];
+				fill(out, out + size.x, 0);
+				for(int i = stripe.row_start[y]; i < stripe.row_start[y + 1]; i++)
+				{
+					const Run& r = stripe.runs[i];
+					fill(out + r.x0, out + r.x1, number[parent[r.label].load()]);
+				}
+			}
+		});
+
+		return count;
+	}
+}
+
+int connected_components(const BasicImage<byte>& in, BasicImage<int>& labels, Connectivity connectivity)
+{
+	return label_image(NonZeroRuns<byte> { in }, in.size(), labels, connectivity);
+}
+
+int connected_components(const BinaryImage& in, BasicImage<int>& labels, Connectivity connectivity)
+{
+	return label_image(BinaryRuns { in }, in.size(), labels, connectivity);
+}
+
+int connected_regions(const BasicImage<byte>& in, BasicImage<int>& labels, Connectivity connectivity)
+{
+	return label_image(EqualRuns<byte> { in }, in.size(), labels, connectivity);
+}
+
+int connected_regions(const BasicImage<int>& in, BasicImage<int>& labels, Connectivity connectivity)
+{
+	return label_image(EqualRuns<int> { in }, in.size(), labels, connectivity);
+}
+
+int connected_components(const BasicImage<byte>& in, BasicImage<int>& labels, ComponentStatistics& stats, Connectivity connectivity, const ComponentFilter& filter)
+{
+	const Gather gather { &stats, nullptr, filter };
+	return label_image(NonZeroRuns<byte> { in }, in.size(), labels, connectivity, &gather);
+}
+
+int connected_components(const BinaryImage& in, BasicImage<int>& labels, ComponentStatistics& stats, Connectivity connectivity, const ComponentFilter& filter)
+{
+	const Gather gather { &stats, nullptr, filter };
+	return label_image(BinaryRuns { in }, in.size(), labels, connectivity, &gather);
+}
+
+int connected_components(const BasicImage<byte>& in, const BasicImage<byte>& grey, BasicImage<int>& labels, ComponentStatistics& stats, Connectivity connectivity, const ComponentFilter& filter)
+{
+	const Gather gather { &stats, &grey, filter };
+	return label_image(NonZeroRuns<byte> { in }, in.size(), labels, connectivity, &gather);
+}
+
+int connected_components(const BinaryImage& in, const BasicImage<byte>& grey, BasicImage<int>& labels, ComponentStatistics& stats, Connectivity connectivity, const ComponentFilter& filter)
+{
+	const Gather gather { &stats, &grey, filter };
+	return label_image(BinaryRuns { in }, in.size(), labels, connectivity, &gather);
+}
+
+int connected_regions(const BasicImage<byte>& in, BasicImage<int>& labels, ComponentStatistics& stats, Connectivity connectivity, const ComponentFilter& filter)
+{
+	const Gather gather { &stats, nullptr, filter };
+	return label_image(EqualRuns<byte> { in }, in.size(), labels, connectivity, &gather);
+}
+
+int connected_regions(const BasicImage<int>& in, BasicImage<int>& labels, ComponentStatistics& stats, Connectivity connectivity, const ComponentFilter& filter)
+{
+	const Gather gather { &stats, nullptr, filter };
+	return label_image(EqualRuns<int> { in }, in.size(), labels, connectivity, &gather);
+}
 }
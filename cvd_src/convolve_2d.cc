@@ -0,0 +1,240 @@
+#include "cvd/convolution.h"
+#include "fft.h"
+
+#include <algorithm>
+#include <complex>
+#include <vector>
+
+using namespace std;
+
+namespace CVD
+{
+
+namespace
+{
+	// Copy the image in to a buffer with a border of rx and ry pixels, where
+	// the border pixels take the value of the nearest image pixel.
+	vector<float> pad_clamped(const BasicImage<float>& in, int rx, int ry, int& pw, int& ph)
+	{
+		const int w = in.size().x;
+		const int h = in.size().y;
+		pw = w + 2 * rx;
+		ph = h + 2 * ry;
+		vector<float> padded(static_cast<size_t>(pw) * ph);
+
+		for(int y = 0; y < ph; y++)
+		{
+			const float* src = in[min(max(y - ry, 0), h - 1)];
+			float* dst = padded.data() + static_cast<size_t>(y) * pw;
+			fill(dst, dst + rx, src[0]);
+			std::copy(src, src + w, dst + rx);
+			fill(dst + rx + w, dst + pw, src[w - 1]);
+		}
+		return padded;
+	}
+
+	// Correlate the padded image with the coefficients c, one kernel element at
+	// a time. The inner loop is a contiguous multiply-add along the row, which
+	// the compiler vectorises.
+	void correlate_direct(const vector<float>& padded, int pw, const vector<float>& c, int kx, int ky, BasicImage<float>& out)
+	{
+		const int w = out.size().x;
+		const int h = out.size().y;
+
+		for(int y = 0; y < h; y++)
+		{
+			float* o = out[y];
+			fill(o, o + w, 0.f);
+
+			for(int j = 0; j < ky; j++)
+			{
+				const float* row = padded.data() + static_cast<size_t>(y + j) * pw;
+				for(int i = 0; i < kx; i++)
+				{
+					const float k = c[j * kx + i];
+					if(k == 0)
+						continue;
+
+					const float* s = row + i;
+					for(int x = 0; x < w; x++)
+						o[x] += k * s[x];
+				}
+			}
+		}
+	}
+
+	int log2_of(int n)
+	{
+		int l = 0;
+		while((1 << l) < n)
+			l++;
+		return l;
+	}
+
+	// Estimated work for processing the whole image with nx by ny tiles.
+	double fft_cost(int nx, int ny, int kx, int ky, int w, int h)
+	{
+		const int vx = nx - kx + 1;
+		const int vy = ny - ky + 1;
+		const double tiles = static_cast<double>((w + vx - 1) / vx) * ((h + vy - 1) / vy);
+
+		// Forward and inverse transform, plus the spectrum product and the
+		// tile copies which are cheap in comparison.
+		return tiles * nx * ny * (2.5 * (log2_of(nx) + log2_of(ny)) + 4);
+	}
+
+	// Find the power-of-two tile size with the least total work. Tiles are
+	// no larger than 1024, unless the kernel is, in which case only the
+	// smallest tile which holds it is tried. There is always a tile.
+	void choose_tile(int kx, int ky, int w, int h, int& best_nx, int& best_ny, double& best_cost)
+	{
+		const int min_nx = max(16, 1 << log2_of(kx));
+		const int min_ny = max(16, 1 << log2_of(ky));
+		const int max_nx = min(max(16, 1 << log2_of(w + kx - 1)), max(1024, min_nx));
+		const int max_ny = min(max(16, 1 << log2_of(h + ky - 1)), max(1024, min_ny));
+		best_cost = -1;
+
+		for(int nx = min_nx; nx <= max_nx; nx *= 2)
+		{
+			for(int ny = min_ny; ny <= max_ny; ny *= 2)
+			{
+				const double cost = fft_cost(nx, ny, kx, ky, w, h);
+				if(best_cost < 0 || cost < best_cost)
+				{
+					best_cost = cost;
+					best_nx = nx;
+					best_ny = ny;
+				}
+			}
+		}
+	}
+
+	// Overlap-save: each tile is transformed, multiplied by the kernel spectrum
+	// and transformed back. The first kx-1 columns and ky-1 rows of the result
+	// are corrupted by the circular wrap around and are discarded, so tiles are
+	// overlapped by that amount.
+	void correlate_fft(const vector<float>& padded, int pw, int ph, const vector<float>& c, int kx, int ky, int nx, int ny, BasicImage<float>& out)
+	{
+		const int w = out.size().x;
+		const int h = out.size().y;
+		const int vx = nx - kx + 1;
+		const int vy = ny - ky + 1;
+
+		Internal::RealFFT2D fft(nx, ny);
+		const int sw = fft.spectrum_width();
+
+		vector<float> tile(static_cast<size_t>(nx) * ny);
+		vector<complex<float>> spectrum(static_cast<size_t>(sw) * ny);
+		vector<complex<float>> kernel_spectrum(static_cast<size_t>(sw) * ny);
+
+		// Overlap-save computes a convolution, so the correlation coefficients
+		// are flipped when they are placed in the tile.
+		fill(tile.begin(), tile.end(), 0.f);
+		for(int j = 0; j < ky; j++)
+			for(int i = 0; i < kx; i++)
+				tile[j * nx + i] = c[(ky - 1 - j) * kx + (kx - 1 - i)];
+		fft.forward(tile.data(), kernel_spectrum.data());
+
+		for(int ty = 0; ty < h; ty += vy)
+			for(int tx = 0; tx < w; tx += vx)
+			{
+				const int cols = min(nx, pw - tx);
+				for(int r = 0; r < ny; r++)
+				{
+					float* dst = tile.data() + static_cast<size_t>(r) * nx;
+					if(ty + r < ph)
+					{
+						const float* src = padded.data() + static_cast<size_t>(ty + r) * pw + tx;
+						std::copy(src, src + cols, dst);
+						fill(dst + cols, dst + nx, 0.f);
+					}
+					else
+						fill(dst, dst + nx, 0.f);
+				}
+
+				fft.forward(tile.data(), spectrum.data());
+
+				for(size_t i = 0; i < spectrum.size(); i++)
+				{
+					const complex<float> a = spectrum[i];
+					const complex<float> b = kernel_spectrum[i];
+					spectrum[i] = complex<float>(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+				}
+
+				fft.inverse(spectrum.data(), tile.data());
+
+				const int rows = min(vy, h - ty);
+				const int outcols = min(vx, w - tx);
+				for(int r = 0; r < rows; r++)
+				{
+					const float* src = tile.data() + static_cast<size_t>(r + ky - 1) * nx + kx - 1;
+					std::copy(src, src + outcols, out[ty + r] + tx);
+				}
+			}
+	}
+
+	void correlate_coefficients(const BasicImage<float>& in, const vector<float>& c, int kx, int ky, BasicImage<float>& out, ConvolutionMethod method)
+	{
+		if(in.size().x == 0 || in.size().y == 0)
+			return;
+
+		int pw, ph;
+		const vector<float> padded = pad_clamped(in, kx / 2, ky / 2, pw, ph);
+
+		if(method == ConvolutionMethod::Direct)
+		{
+			correlate_direct(padded, pw, c, kx, ky, out);
+			return;
+		}
+
+		int nx = 0, ny = 0;
+		double cost;
+		choose_tile(kx, ky, in.size().x, in.size().y, nx, ny, cost);
+
+		// The direct method does one multiply-add per kernel element per pixel,
+		// several at a time once vectorised.
+		const double direct_cost = 0.25 * kx * ky * in.size().area();
+
+		if(method == ConvolutionMethod::FFT || (cost >= 0 && cost < direct_cost))
+			correlate_fft(padded, pw, ph, c, kx, ky, nx, ny, out);
+		else
+			correlate_direct(padded, pw, c, kx, ky, out);
+	}
+
+	void check_arguments(const BasicImage<float>& in, const BasicImage<float>& kernel, const BasicImage<float>& out, const string& function)
+	{
+		if(in.size() != out.size())
+			throw Exceptions::Convolution::IncompatibleImageSizes(function);
+		if(kernel.size().x % 2 == 0 || kernel.size().y % 2 == 0)
+			throw Exceptions::Convolution::OddSizedKernelRequired(function);
+	}
+}
+
+void correlate(const BasicImage<float>& in, const BasicImage<float>& kernel, BasicImage<float>& out, ConvolutionMethod method)
+{
+	check_arguments(in, kernel, out, "correlate");
+
+	const int kx = kernel.size().x;
+	const int ky = kernel.size().y;
+	vector<float> c(static_cast<size_t>(kx) * ky);
+	for(int j = 0; j < ky; j++)
+		std::copy(kernel[j], kernel[j] + kx, c.begin() + j * kx);
+
+	correlate_coefficients(in, c, kx, ky, out, method);
+}
+
+void convolve(const BasicImage<float>& in, const BasicImage<float>& kernel, BasicImage<float>& out, ConvolutionMethod method)
+{
+	check_arguments(in, kernel, out, "convolve");
+
+	const int kx = kernel.size().x;
+	const int ky = kernel.size().y;
+	vector<float> c(static_cast<size_t>(kx) * ky);
+	for(int j = 0; j < ky; j++)
+		for(int i = 0; i < kx; i++)
+			c[j * kx + i] = kernel[ky - 1 - j][kx - 1 - i];
+
+	correlate_coefficients(in, c, kx, ky, out, method);
+}
+
+}
@@ -0,0 +1,282 @@
+#include "cvd/convolution.h"
+#include "cvd/rgb.h"
+#include "cvd/rgba.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+namespace CVD
+{
+
+// Colour images are filtered with the components left interleaved. A row of
+// w pixels with N components is treated as a row of w*N values, and a pixel
+// offset of k becomes a component offset of k*N. Every loop below then runs
+// contiguously over the whole row, with no splitting in to planes and no
+// per pixel arithmetic through Pixel::operations, so the compiler vectorises
+// them.
+namespace
+{
+	// Horizontal pass over one padded row. With the kernel radius K known at
+	// compile time the taps are unrolled, leaving a straight line loop body
+	// that is vectorised along the row.
+	template <int K, int N>
+	void filter_row(const float* p, const float* kernel, float* out, int n)
+	{
+		float k[K + 1];
+		for(int i = 0; i <= K; i++)
+			k[i] = kernel[i];
+
+		for(int j = 0; j < n; j++)
+		{
+			float s = k[0] * p[j];
+			for(int i = 1; i <= K; i++)
+				s += k[i] * (p[j - i * N] + p[j + i * N]);
+			out[j] = s;
+		}
+	}
+
+	// Vertical pass: rows[K] is the centre row.
+	template <int K, class C>
+	void filter_column(const float* const* rows, const float* kernel, C* out, int n)
+	{
+		float k[K + 1];
+		const float* r[2 * K + 1];
+		for(int i = 0; i <= K; i++)
+			k[i] = kernel[i];
+		for(int i = 0; i <= 2 * K; i++)
+			r[i] = rows[i];
+
+		for(int j = 0; j < n; j++)
+		{
+			float s = k[0] * r[K][j];
+			for(int i = 1; i <= K; i++)
+				s += k[i] * (r[K - i][j] + r[K + i][j]);
+			out[j] = static_cast<C>(s);
+		}
+	}
+
+	// Any radius, with the partial sums kept in memory.
+	template <int N>
+	void filter_row_any(const float* p, const float* kernel, int ksize, float* out, int n)
+	{
+		for(int j = 0; j < n; j++)
+			out[j] = kernel[0] * p[j];
+		for(int i = 1; i <= ksize; i++)
+		{
+			const float m = kernel[i];
+			const float* a = p - i * N;
+			const float* b = p + i * N;
+			for(int j = 0; j < n; j++)
+				out[j] += m * (a[j] + b[j]);
+		}
+	}
+
+	template <class C>
+	void filter_column_any(const float* const* rows, const float* kernel, int ksize, float* sum, C* out, int n)
+	{
+		for(int j = 0; j < n; j++)
+			sum[j] = kernel[0] * rows[ksize][j];
+		for(int i = 1; i <= ksize; i++)
+		{
+			const float m = kernel[i];
+			const float* a = rows[ksize - i];
+			const float* b = rows[ksize + i];
+			for(int j = 0; j < n; j++)
+				sum[j] += m * (a[j] + b[j]);
+		}
+		for(int j = 0; j < n; j++)
+			out[j] = static_cast<C>(sum[j]);
+	}
+
+	template <class T>
+	void gaussian_interleaved(const BasicImage<T>& I, BasicImage<T>& out, double sigma, double sigmas)
+	{
+		typedef typename Pixel::Component<T>::type C;
+		const int N = Pixel::Component<T>::count;
+
+		if(I.size() != out.size())
+			throw Exceptions::Convolution::IncompatibleImageSizes("convolveGaussian");
+
+		// The same kernel as the generic convolveGaussian()
+		const int ksize = (int)ceil(sigmas * sigma);
+		vector<float> kernel(ksize + 1);
+		double ksum = 0;
+		for(int i = 1; i <= ksize; i++)
+			ksum += (kernel[i] = static_cast<float>(exp(-i * i / (2 * sigma * sigma))));
+		for(int i = 1; i <= ksize; i++)
+			kernel[i] /= static_cast<float>(2 * ksum + 1);
+		kernel[0] = static_cast<float>(1.0 / (2 * ksum + 1));
+
+		const int w = I.size().x;
+		const int h = I.size().y;
+
+		if(w < ksize || h < ksize)
+		{
+			if(I.data() != out.data())
+				out.copy_from(I);
+			return;
+		}
+
+		const int n = w * N;
+		const int pad = ksize * N;
+		const int window = 2 * ksize + 1;
+
+		// One input row with ksize replicated pixels either side, a ring of
+		// horizontally filtered rows, and scratch for the vertical pass.
+		vector<float> padded(n + 2 * pad);
+		vector<float> ring(static_cast<size_t>(n) * window);
+		vector<float> sum(n);
+		vector<const float*> rows(window);
+		const float* p = padded.data() + pad;
+
+		// Row y of the output only depends on input rows up to y + ksize, which
+		// have been read before row y is written, so this works in place.
+		for(int y = 0, next = 0; y < h; y++)
+		{
+			for(; next <= min(y + ksize, h - 1); next++)
+			{
+				const C* in = reinterpret_cast<const C*>(I[next]);
+				for(int i = 0; i < n; i++)
+					padded[pad + i] = in[i];
+				for(int i = 0; i < pad; i++)
+				{
+					padded[i] = in[i % N];
+					padded[pad + n + i] = in[n - N + i % N];
+				}
+
+				float* hrow = ring.data() + static_cast<size_t>(next % window) * n;
+				switch(ksize)
+				{
+					case 1: filter_row<1, N>(p, kernel.data(), hrow, n); break;
+					case 2: filter_row<2, N>(p, kernel.data(), hrow, n); break;
+					case 3: filter_row<3, N>(p, kernel.data(), hrow, n); break;
+					case 4: filter_row<4, N>(p, kernel.data(), hrow, n); break;
+					default: filter_row_any<N>(p, kernel.data(), ksize, hrow, n);
+				}
+			}
+
+			for(int k = -ksize; k <= ksize; k++)
+				rows[ksize + k] = ring.data() + static_cast<size_t>(min(max(y + k, 0), h - 1) % window) * n;
+
+			C* o = reinterpret_cast<C*>(out[y]);
+			switch(ksize)
+			{
+				case 1: filter_column<1>(rows.data(), kernel.data(), o, n); break;
+				case 2: filter_column<2>(rows.data(), kernel.data(), o, n); break;
+				case 3: filter_column<3>(rows.data(), kernel.data(), o, n); break;
+				case 4: filter_column<4>(rows.data(), kernel.data(), o, n); break;
+				default: filter_column_any(rows.data(), kernel.data(), ksize, sum.data(), o, n);
+			}
+		}
+	}
+
+	// The same results as the generic convolveWithBox(): only the pixels
+	// where the whole box lies inside the image are written. Column sums are
+	// kept for the current window of rows, and a copy of the rows in the
+	// window is kept so that the oldest can be subtracted even when working in
+	// place.
+	template <class T>
+	void box_interleaved(const BasicImage<T>& I, BasicImage<T>& J, ImageRef hwin)
+	{
+		typedef typename Pixel::Component<T>::type C;
+		typedef typename Pixel::traits<C>::wider_type S;
+		const int N = Pixel::Component<T>::count;
+
+		if(I.size() != J.size())
+			throw Exceptions::Convolution::IncompatibleImageSizes("convolveWithBox");
+
+		const int w = I.size().x;
+		const int h = I.size().y;
+		const ImageRef win = 2 * hwin + ImageRef(1, 1);
+		if(win.x > w || win.y > h)
+			return;
+
+		const double factor = 1.0 / (win.x * win.y);
+		const int n = w * N;
+
+		vector<C> rows(static_cast<size_t>(n) * win.y);
+		vector<S> sums(n, S());
+
+		for(int y = 0; y < h; y++)
+		{
+			const C* in = reinterpret_cast<const C*>(I[y]);
+			C* saved = rows.data() + static_cast<size_t>(y % win.y) * n;
+			for(int i = 0; i < n; i++)
+			{
+				saved[i] = in[i];
+				sums[i] += in[i];
+			}
+
+			if(y < win.y - 1)
+				continue;
+
+			// Sliding sum along the row, with one running total per component
+			// held in registers.
+			C* o = reinterpret_cast<C*>(J[y - hwin.y] + hwin.x);
+			S hsum[N];
+			for(int c = 0; c < N; c++)
+				hsum[c] = S();
+			for(int x = 0; x < win.x; x++)
+				for(int c = 0; c < N; c++)
+					hsum[c] += sums[x * N + c];
+
+			for(int x = 0; x + win.x <= w; x++)
+			{
+				for(int c = 0; c < N; c++)
+					o[x * N + c] = static_cast<C>(hsum[c] * factor);
+				if(x + win.x < w)
+					for(int c = 0; c < N; c++)
+						hsum[c] += sums[(x + win.x) * N + c] - sums[x * N + c];
+			}
+
+			const C* oldest = rows.data() + static_cast<size_t>((y + 1) % win.y) * n;
+			for(int i = 0; i < n; i++)
+				sums[i] -= oldest[i];
+		}
+	}
+}
+
+void convolveGaussian(const BasicImage<Rgb<byte>>& I, BasicImage<Rgb<byte>>& out, double sigma, double sigmas)
+{
+	gaussian_interleaved(I, out, sigma, sigmas);
+}
+
+void convolveGaussian(const BasicImage<Rgba<byte>>& I, BasicImage<Rgba<byte>>& out, double sigma, double sigmas)
+{
+	gaussian_interleaved(I, out, sigma, sigmas);
+}
+
+void convolveGaussian(const BasicImage<Rgb<float>>& I, BasicImage<Rgb<float>>& out, double sigma, double sigmas)
+{
+	gaussian_interleaved(I, out, sigma, sigmas);
+}
+
+void convolveGaussian(const BasicImage<Rgba<float>>& I, BasicImage<Rgba<float>>& out, double sigma, double sigmas)
+{
+	gaussian_interleaved(I, out, sigma, sigmas);
+}
+
+void convolveWithBox(const BasicImage<Rgb<byte>>& I, BasicImage<Rgb<byte>>& J, ImageRef hwin)
+{
+	box_interleaved(I, J, hwin);
+}
+
+void convolveWithBox(const BasicImage<Rgba<byte>>& I, BasicImage<Rgba<byte>>& J, ImageRef hwin)
+{
+	box_interleaved(I, J, hwin);
+}
+
+void convolveWithBox(const BasicImage<Rgb<float>>& I, BasicImage<Rgb<float>>& J, ImageRef hwin)
+{
+	box_interleaved(I, J, hwin);
+}
+
+void convolveWithBox(const BasicImage<Rgba<float>>& I, BasicImage<Rgba<float>>& J, ImageRef hwin)
+{
+	box_interleaved(I, J, hwin);
+}
+
+}
@@ -0,0 +1,206 @@
+#ifndef CVD_SRC_FFT_H
+#define CVD_SRC_FFT_H
+
+#include <cmath>
+#include <complex>
+#include <utility>
+#include <vector>
+
+namespace CVD
+{
+namespace Internal
+{
+
+	// Radix-2 complex FFT of a fixed power-of-two length. The twiddle factors and
+	// the bit reversal permutation are computed once, so a single instance can be
+	// reused for many transforms of the same size.
+	class FFT1D
+	{
+		public:
+		explicit FFT1D(int n_)
+		    : n(n_)
+		    , twiddle(n_ / 2)
+		    , bitrev(n_)
+		{
+			for(int i = 0; i < n / 2; i++)
+			{
+				const double a = -2 * M_PI * i / n;
+				twiddle[i] = std::complex<float>(static_cast<float>(std::cos(a)), static_cast<float>(std::sin(a)));
+			}
+
+			int bits = 0;
+			while((1 << bits) < n)
+				bits++;
+
+			for(int i = 0; i < n; i++)
+			{
+				int r = 0;
+				for(int b = 0; b < bits; b++)
+					if(i & (1 << b))
+						r |= 1 << (bits - 1 - b);
+				bitrev[i] = r;
+			}
+		}
+
+		int size() const
+		{
+			return n;
+		}
+
+		// In place transform. The inverse is unscaled.
+		void transform(std::complex<float>* data, bool inverse) const
+		{
+			for(int i = 0; i < n; i++)
+				if(i < bitrev[i])
+					std::swap(data[i], data[bitrev[i]]);
+
+			for(int len = 2; len <= n; len *= 2)
+			{
+				const int half = len / 2;
+				const int step = n / len;
+				for(int i = 0; i < n; i += len)
+				{
+					std::complex<float>* a = data + i;
+					std::complex<float>* b = data + i + half;
+					for(int j = 0; j < half; j++)
+					{
+						// Written out by hand: std::complex multiplication carries
+						// NaN handling which prevents it from being inlined.
+						const float wr = twiddle[j * step].real();
+						const float wi = inverse ? -twiddle[j * step].imag() : twiddle[j * step].imag();
+						const float tr = b[j].real() * wr - b[j].imag() * wi;
+						const float ti = b[j].real() * wi + b[j].imag() * wr;
+						b[j] = std::complex<float>(a[j].real() - tr, a[j].imag() - ti);
+						a[j] = std::complex<float>(a[j].real() + tr, a[j].imag() + ti);
+					}
+				}
+			}
+		}
+
+		private:
+		int n;
+		std::vector<std::complex<float>> twiddle;
+		std::vector<int> bitrev;
+	};
+
+	// 2D FFT of real data with power-of-two dimensions. Only the non-redundant
+	// half of the spectrum is stored: h rows of w/2+1 complex values.
+	//
+	// Rows are transformed two at a time by packing them in to the real and
+	// imaginary parts of a single complex transform and separating the two
+	// spectra afterwards, so the row pass costs half of a complex 2D FFT.
+	//
+	// Instances hold scratch space, so each thread needs its own.
+	class RealFFT2D
+	{
+		public:
+		RealFFT2D(int w_, int h_)
+		    : w(w_)
+		    , h(h_)
+		    , row_fft(w_)
+		    , col_fft(h_)
+		    , row(w_)
+		    , col(h_)
+		{
+		}
+
+		int width() const
+		{
+			return w;
+		}
+
+		int height() const
+		{
+			return h;
+		}
+
+		int spectrum_width() const
+		{
+			return w / 2 + 1;
+		}
+
+		// in: h rows of w floats. out: h rows of w/2+1 complex values.
+		void forward(const float* in, std::complex<float>* out) const
+		{
+			const int sw = spectrum_width();
+
+			for(int y = 0; y < h; y += 2)
+			{
+				const float* a = in + y * w;
+				const float* b = in + (y + 1) * w;
+				for(int x = 0; x < w; x++)
+					row[x] = std::complex<float>(a[x], b[x]);
+
+				row_fft.transform(row.data(), false);
+
+				std::complex<float>* A = out + y * sw;
+				std::complex<float>* B = out + (y + 1) * sw;
+				for(int k = 0; k < sw; k++)
+				{
+					const std::complex<float> z = row[k];
+					const std::complex<float> zc = std::conj(row[(w - k) & (w - 1)]);
+					A[k] = 0.5f * (z + zc);
+					B[k] = std::complex<float>(0, -0.5f) * (z - zc);
+				}
+			}
+
+			columns(out, false);
+		}
+
+		// in: spectrum as produced by forward(). It is overwritten.
+		// out: h rows of w floats, scaled so that inverse(forward(x)) == x.
+		void inverse(std::complex<float>* in, float* out) const
+		{
+			const int sw = spectrum_width();
+			const float scale = 1.0f / (static_cast<float>(w) * h);
+
+			columns(in, true);
+
+			for(int y = 0; y < h; y += 2)
+			{
+				const std::complex<float>* A = in + y * sw;
+				const std::complex<float>* B = in + (y + 1) * sw;
+				const std::complex<float> i(0, 1);
+
+				for(int k = 0; k < sw; k++)
+					row[k] = A[k] + i * B[k];
+				for(int k = sw; k < w; k++)
+					row[k] = std::conj(A[w - k]) + i * std::conj(B[w - k]);
+
+				row_fft.transform(row.data(), true);
+
+				float* a = out + y * w;
+				float* b = out + (y + 1) * w;
+				for(int x = 0; x < w; x++)
+				{
+					a[x] = row[x].real() * scale;
+					b[x] = row[x].imag() * scale;
+				}
+			}
+		}
+
+		private:
+		void columns(std::complex<float>* data, bool inverse) const
+		{
+			const int sw = spectrum_width();
+			for(int k = 0; k < sw; k++)
+			{
+				for(int y = 0; y < h; y++)
+					col[y] = data[y * sw + k];
+
+				col_fft.transform(col.data(), inverse);
+
+				for(int y = 0; y < h; y++)
+					data[y * sw + k] = col[y];
+			}
+		}
+
+		int w, h;
+		FFT1D row_fft, col_fft;
+		mutable std::vector<std::complex<float>> row, col;
+	};
+
+}
+}
+
+#endif
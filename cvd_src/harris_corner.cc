@@ -0,0 +1,71 @@
+#include "cvd/harris_corner.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace CVD
+{
+namespace Internal
+{
+	HarrisKernel::HarrisKernel(double sigma, double sigmas)
+	    : ksize(static_cast<int>(ceil(sigmas * sigma)))
+	    , kernel(max(ksize, 0))
+	{
+		float ksum = 0;
+		for(int i = 1; i <= ksize; i++)
+			ksum += (kernel[i - 1] = static_cast<float>(exp(-i * i / (2 * sigma * sigma))));
+		for(int i = 0; i < ksize; i++)
+			kernel[i] /= (2 * ksum + 1);
+		factor = 1.0 / (2 * ksum + 1);
+	}
+
+	// The middle is done a tap at a time across the row, so it vectorises. The
+	// ends are extended with the end pixels.
+	void harris_blur_row(const float* in, float* out, int w, const HarrisKernel& k)
+	{
+		const int n = k.ksize;
+		const float factor = static_cast<float>(k.factor);
+		for(int x = n; x < w - n; x++)
+			out[x] = in[x] * factor;
+		for(int j = 0; j < n; j++)
+		{
+			const float m = k.kernel[j];
+			for(int x = n; x < w - n; x++)
+				out[x] += (in[x - j - 1] + in[x + j + 1]) * m;
+		}
+
+		for(int x = 0; x < n; x++)
+		{
+			float sum = static_cast<float>(in[x] * k.factor);
+			for(int j = 0; j < n; j++)
+				sum += (in[max(x - j - 1, 0)] + in[x + j + 1]) * k.kernel[j];
+			out[x] = sum;
+		}
+		for(int x = w - n; x < w; x++)
+		{
+			float sum = static_cast<float>(in[x] * k.factor);
+			for(int j = 0; j < n; j++)
+				sum += (in[x - j - 1] + in[min(x + j + 1, w - 1)]) * k.kernel[j];
+			out[x] = sum;
+		}
+	}
+
+	void harris_blur_column(const float* const* rows, float* out, int w, const HarrisKernel& k)
+	{
+		const int n = k.ksize;
+		const float* middle = rows[n];
+		for(int x = 0; x < w; x++)
+			out[x] = static_cast<float>(middle[x] * k.factor);
+		for(int j = 0; j < n; j++)
+		{
+			const float m = k.kernel[j];
+			const float* above = rows[n - j - 1];
+			const float* below = rows[n + j + 1];
+			for(int x = 0; x < w; x++)
+				out[x] += (above[x] + below[x]) * m;
+		}
+	}
+}
+}
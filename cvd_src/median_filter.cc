@@ -0,0 +1,263 @@
+#include "cvd/vision.h"
+#include "cvd/vision_exceptions.h"
+
+#include "cvd/internal/slice.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+namespace CVD
+{
+
+// Median filtering in constant time per pixel, after Perreault and Hebert,
+// "Median Filtering in Constant Time", 2007.
+//
+// Each column keeps a histogram of the 2r+1 pixels above and below the
+// current row. Moving down a row costs one removal and one insertion per
+// column. The histogram of the window is the sum of 2r+1 column histograms,
+// and moving along a row adds one column histogram and subtracts another.
+//
+// The histograms are two level: a coarse histogram of the high bits and a
+// fine histogram of all the bits. The window's coarse histogram is kept up to
+// date at every pixel, but a block of the fine histogram is only brought up
+// to date when the median lands in it. The adds and subtracts are loops over
+// short arrays of 16 bit counts, which the compiler vectorises.
+namespace
+{
+	// Bytes of histogram that a thread is allowed for its columns. Images with
+	// more bits are processed in vertical strips to keep within this. A strip
+	// also needs the columns within the radius either side of it, and is at
+	// least 64 columns wide so that those do not dominate, which with 16 bits
+	// takes more than this.
+	const size_t histogram_budget = 8 << 20;
+
+	template <int Bits, class T>
+	class MedianStrip
+	{
+		public:
+		static const int fine_bits = Bits / 2;
+		static const int F = 1 << fine_bits;
+		static const int C = 1 << (Bits - fine_bits);
+		static const size_t column_bytes = sizeof(uint16_t) * (C + C * F);
+
+		MedianStrip(const BasicImage<T>& in_, int r_, BasicImage<T>& out_, unsigned int max_value_)
+		    : in(in_)
+		    , out(out_)
+		    , max_value(max_value_)
+		    , r(r_)
+		    , w(in_.size().x)
+		    , h(in_.size().y)
+		{
+		}
+
+		// Filter rows y0 to y0+rows and columns x0 to x0+cols.
+		void operator()(int y0, int rows, int x0, int cols)
+		{
+			c0 = max(0, x0 - r);
+			const int c1 = min(w, x0 + cols + r);
+			coarse.assign(static_cast<size_t>(c1 - c0) * C, 0);
+			fine.assign(static_cast<size_t>(c1 - c0) * C * F, 0);
+
+			for(int y = max(0, y0 - r); y < min(h, y0 + r + 1); y++)
+				update_columns(y, c1, 1);
+
+			for(int y = y0; y < y0 + rows; y++)
+			{
+				if(y > y0)
+				{
+					if(y - r - 1 >= 0)
+						update_columns(y - r - 1, c1, -1);
+					if(y + r < h)
+						update_columns(y + r, c1, 1);
+				}
+
+				const int rows_in = min(h - 1, y + r) - max(0, y - r) + 1;
+				filter_row(y, x0, cols, rows_in);
+			}
+		}
+
+		private:
+		void update_columns(int y, int c1, int delta)
+		{
+			const T* p = in[y];
+			for(int x = c0; x < c1; x++)
+			{
+				const unsigned int v = min<unsigned int>(p[x], max_value);
+				coarse[static_cast<size_t>(x - c0) * C + (v >> fine_bits)] += delta;
+				fine[static_cast<size_t>(x - c0) * C * F + v] += delta;
+			}
+		}
+
+		const uint16_t* column_coarse(int x) const
+		{
+			return coarse.data() + static_cast<size_t>(x - c0) * C;
+		}
+
+		const uint16_t* column_fine(int x, int c) const
+		{
+			return fine.data() + (static_cast<size_t>(x - c0) * C + c) * F;
+		}
+
+		static void add(uint16_t* a, const uint16_t* b, int n)
+		{
+			for(int i = 0; i < n; i++)
+				a[i] += b[i];
+		}
+
+		static void subtract(uint16_t* a, const uint16_t* b, int n)
+		{
+			for(int i = 0; i < n; i++)
+				a[i] -= b[i];
+		}
+
+		// Find the bin containing the element of the given rank, given that
+		// sum elements precede the histogram.
+		static void find_bin(const uint16_t* histogram, int rank, int& bin, int& sum)
+		{
+			bin = 0;
+			while(sum + histogram[bin] <= rank)
+				sum += histogram[bin++];
+		}
+
+		void filter_row(int y, int x0, int cols, int rows_in)
+		{
+			uint16_t kernel_coarse[C] = {};
+			kernel_fine.resize(static_cast<size_t>(C) * F);
+			last.assign(C, INT_MIN);
+
+			for(int x = max(0, x0 - r); x <= min(w - 1, x0 + r); x++)
+				add(kernel_coarse, column_coarse(x), C);
+
+			T* o = out[y];
+			for(int x = x0; x < x0 + cols; x++)
+			{
+				if(x > x0)
+				{
+					if(x + r < w)
+						add(kernel_coarse, column_coarse(x + r), C);
+					if(x - r - 1 >= 0)
+						subtract(kernel_coarse, column_coarse(x - r - 1), C);
+				}
+
+				// The same rank as Morphology::Median, which takes the upper
+				// median if the cropped window has an even number of pixels.
+				const int lo = max(0, x - r);
+				const int hi = min(w - 1, x + r);
+				const int total = rows_in * (hi - lo + 1);
+				const int rank = total - max(0, (total + 1) / 2 - 1) - 1;
+
+				int c = 0, sum = 0;
+				find_bin(kernel_coarse, rank, c, sum);
+
+				uint16_t* kf = kernel_fine.data() + static_cast<size_t>(c) * F;
+				const int window = hi - lo + 1;
+				if(last[c] == INT_MIN || 2 * (x - last[c]) > window)
+				{
+					fill(kf, kf + F, 0);
+					for(int xx = lo; xx <= hi; xx++)
+						add(kf, column_fine(xx, c), F);
+				}
+				else
+					for(int xx = last[c] + 1; xx <= x; xx++)
+					{
+						if(xx + r < w)
+							add(kf, column_fine(xx + r, c), F);
+						if(xx - r - 1 >= 0)
+							subtract(kf, column_fine(xx - r - 1, c), F);
+					}
+				last[c] = x;
+
+				int f = 0;
+				find_bin(kf, rank, f, sum);
+
+				o[x] = static_cast<T>(c * F + f);
+			}
+		}
+
+		const BasicImage<T>& in;
+		BasicImage<T>& out;
+		const unsigned int max_value;
+		const int r, w, h;
+		int c0 = 0;
+		vector<uint16_t> coarse, fine, kernel_fine;
+		vector<int> last;
+	};
+
+	// Values above max_value are taken as max_value, which must fit in Bits.
+	template <int Bits, class T>
+	void median_filter_bits(const BasicImage<T>& in, int radius, BasicImage<T>& out, unsigned int max_value)
+	{
+		typedef MedianStrip<Bits, T> Strip;
+
+		const int w = in.size().x;
+		const int h = in.size().y;
+		const int budget_columns = static_cast<int>(histogram_budget / Strip::column_bytes);
+		const int strip = max(max(64, 2 * radius + 1), budget_columns - 2 * radius);
+
+		internal::Slice(h, internal::SliceHeight(h, 2 * radius + 1), [&](int, int y0, int rows) {
+			Strip filter(in, radius, out, max_value);
+			for(int x0 = 0; x0 < w; x0 += strip)
+				filter(y0, rows, x0, min(strip, w - x0));
+		});
+	}
+
+	template <class T>
+	void check_arguments(const BasicImage<T>& in, int radius, const BasicImage<T>& out)
+	{
+		if(in.size() != out.size())
+			throw Exceptions::Vision::IncompatibleImageSizes("median_filter");
+		if(radius < 0 || radius > 127)
+			throw Exceptions::Vision::BadInput("median_filter");
+	}
+}
+
+void median_filter(const BasicImage<byte>& in, int radius, BasicImage<byte>& out)
+{
+	check_arguments(in, radius, out);
+	if(in.size().x == 0 || in.size().y == 0)
+		return;
+
+	// The bands read rows beyond their own, so work from a copy if in place.
+	if(in.data() == out.data())
+	{
+		Image<byte> copy(in.size());
+		copy.copy_from(in);
+		median_filter_bits<8>(copy, radius, out, 255);
+	}
+	else
+		median_filter_bits<8>(in, radius, out, 255);
+}
+
+void median_filter(const BasicImage<unsigned short>& in, int radius, BasicImage<unsigned short>& out, int bits)
+{
+	check_arguments(in, radius, out);
+	if(bits < 1 || bits > 16)
+		throw Exceptions::Vision::BadInput("median_filter");
+	if(in.size().x == 0 || in.size().y == 0)
+		return;
+
+	Image<unsigned short> copy;
+	const BasicImage<unsigned short>* src = &in;
+	if(in.data() == out.data())
+	{
+		copy.resize(in.size());
+		copy.copy_from(in);
+		src = &copy;
+	}
+
+	const unsigned int max_value = (1u << bits) - 1;
+	if(bits <= 8)
+		median_filter_bits<8>(*src, radius, out, max_value);
+	else if(bits <= 10)
+		median_filter_bits<10>(*src, radius, out, max_value);
+	else if(bits <= 12)
+		median_filter_bits<12>(*src, radius, out, max_value);
+	else
+		median_filter_bits<16>(*src, radius, out, max_value);
+}
+
+}
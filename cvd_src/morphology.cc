@@ -1,5 +1,9 @@
 #include <cvd/morphology.h>
 
+#include "cvd/internal/slice.h"
+
+#include <limits>
+
 namespace CVD
 {
 
@@ -20,8 +24,320 @@ namespace Internal
 	}
 }
 
+namespace
+{
+	template <class T>
+	struct Min
+	{
+		static T identity()
+		{
+			return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+		}
+
+		T operator()(T a, T b) const
+		{
+			return b < a ? b : a;
+		}
+	};
+
+	template <class T>
+	struct Max
+	{
+		static T identity()
+		{
+			return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest();
+		}
+
+		T operator()(T a, T b) const
+		{
+			return b > a ? b : a;
+		}
+	};
+
+	// van Herk/Gil-Werman filter over windows of k samples, where each sample
+	// is a vector of R elements.
+	//
+	// The samples are cut in to blocks of k. Within a block, s holds the
+	// running extremum to the end of the block and g the running extremum from
+	// the start. A window starting at i spans at most two blocks, so its
+	// extremum is op(s[i], g[i+k-1]): three operations per sample whatever the
+	// size of k. Only s for the current block and g for the next are kept, so
+	// the working set stays in the cache.
+	//
+	// src(i) returns sample i, for i in [0, count + k - 1). emit(i, v) is
+	// called with the result for the window starting at i, for i in
+	// [0, count). All arithmetic is elementwise over the R elements of a
+	// sample, which the compiler vectorises.
+	//
+	// If Lanes is nonzero, R must be equal to it. Knowing it at compile time
+	// lets the elementwise loops be unrolled to single vector operations.
+	template <class T, class Op, int Lanes = 0>
+	struct VanHerk
+	{
+		std::vector<T> s, g, v;
+
+		template <class Src, class Emit>
+		void operator()(int count, int k, int lanes, Src src, Emit emit)
+		{
+			const Op op;
+			const int R = Lanes ? Lanes : lanes;
+			s.resize(static_cast<size_t>(k) * R);
+			g.resize(R);
+			v.resize(R);
+
+			for(int b = 0; b < count; b += k)
+			{
+				// Blocks start before count, so the whole block is available.
+				const T* last = src(b + k - 1);
+				std::copy(last, last + R, s.begin() + static_cast<size_t>(k - 1) * R);
+				for(int i = k - 2; i >= 0; i--)
+				{
+					const T* in = src(b + i);
+					const T* next = s.data() + static_cast<size_t>(i + 1) * R;
+					T* si = s.data() + static_cast<size_t>(i) * R;
+					for(int r = 0; r < R; r++)
+						si[r] = op(next[r], in[r]);
+				}
+
+				// The window starting at b is exactly the block.
+				emit(b, s.data());
+
+				for(int i = 1; i < k && b + i < count; i++)
+				{
+					const T* in = src(b + k + i - 1);
+					if(i == 1)
+						std::copy(in, in + R, g.begin());
+					else
+						for(int r = 0; r < R; r++)
+							g[r] = op(g[r], in[r]);
+
+					const T* si = s.data() + static_cast<size_t>(i) * R;
+					for(int r = 0; r < R; r++)
+						v[r] = op(si[r], g[r]);
+					emit(b + i, v.data());
+				}
+			}
+		}
+	};
+
+	// Erosion or dilation by the rectangle lo to hi. Pixels outside the image
+	// take the identity of the operation, which is the same as cropping the
+	// structuring element.
+	//
+	// The vertical pass treats whole rows as the samples. For the horizontal
+	// pass, groups of rows are interleaved so that each sample is a column of
+	// the group. Both passes are split in to bands of rows which run on
+	// separate threads.
+	template <class T, class Op>
+	void van_herk(const BasicImage<T>& in, ImageRef lo, ImageRef hi, BasicImage<T>& out)
+	{
+		if(in.size() != out.size())
+			throw Exceptions::Vision::IncompatibleImageSizes(__FUNCTION__);
+		if(lo.x > hi.x || lo.y > hi.y)
+			throw Exceptions::Vision::BadInput(__FUNCTION__);
+
+		const int w = in.size().x;
+		const int h = in.size().y;
+		if(w == 0 || h == 0)
+			return;
+
+		const T identity = Op::identity();
+		const ImageRef k = hi - lo + ImageRef(1, 1);
+
+		// The horizontal pass always goes via a temporary, which allows the
+		// vertical pass to work in place.
+		Image<T> horizontal(in.size());
+
+		internal::Slice(h, internal::SliceHeight(h, 16), [&](int, int y0, int rows) {
+			const int R = 16;
+			const int n = w + k.x - 1;
+			std::vector<T> group(static_cast<size_t>(n) * R, identity);
+			VanHerk<T, Op, R> filter;
+
+			for(int y = y0; y < y0 + rows; y += R)
+			{
+				const int m = std::min(R, y0 + rows - y);
+				const int first = std::min(std::max(-lo.x, 0), n);
+				const int last = std::min(std::max(w - lo.x, first), n);
+
+				for(int r = 0; r < m; r++)
+				{
+					const T* row = in[y + r] + lo.x;
+					for(int i = first; i < last; i++)
+						group[static_cast<size_t>(i) * R + r] = row[i];
+				}
+
+				T* o = horizontal[y];
+				const ptrdiff_t stride = horizontal.row_stride();
+				filter(w, k.x, R, [&](int i) { return group.data() + static_cast<size_t>(i) * R; }, [&](int x, const T* v) {
+					for(int r = 0; r < m; r++)
+						o[r * stride + x] = v[r];
+				});
+			}
+		});
+
+		internal::Slice(h, internal::SliceHeight(h, 16), [&](int, int y0, int rows) {
+			const std::vector<T> outside(w, identity);
+			VanHerk<T, Op> filter;
+
+			// Work in strips of columns so that a block of rows stays in the cache.
+			const int strip = 512;
+			for(int x0 = 0; x0 < w; x0 += strip)
+			{
+				const int width = std::min(strip, w - x0);
+				auto source = [&](int i) {
+					const int y = y0 + lo.y + i;
+					return ((y >= 0 && y < h) ? horizontal[y] : outside.data()) + x0;
+				};
+
+				filter(rows, k.y, width, source, [&](int j, const T* v) { std::copy(v, v + width, out[y0 + j] + x0); });
+			}
+		});
+	}
+
+	// If the structuring element is a filled rectangle, find its corners.
+	bool is_rectangle(const std::vector<ImageRef>& selem, ImageRef& lo, ImageRef& hi)
+	{
+		if(selem.empty())
+			return false;
+
+		lo = hi = selem[0];
+		for(const ImageRef& p : selem)
+		{
+			lo.x = std::min(lo.x, p.x);
+			lo.y = std::min(lo.y, p.y);
+			hi.x = std::max(hi.x, p.x);
+			hi.y = std::max(hi.y, p.y);
+		}
+
+		const ImageRef size = hi - lo + ImageRef(1, 1);
+		if(static_cast<long long>(size.x) * size.y != static_cast<long long>(selem.size()))
+			return false;
+
+		// The right number of points are all inside the bounding box, so the
+		// box is filled unless there are duplicates.
+		std::vector<ImageRef> s = selem;
+		std::sort(s.begin(), s.end());
+		return std::adjacent_find(s.begin(), s.end()) == s.end();
+	}
+
+	template <class T, class Op, class Accumulator>
+	void morphology_rectangle_or_general(const BasicImage<T>& in, const std::vector<ImageRef>& selem, const Accumulator& a, BasicImage<T>& out)
+	{
+		ImageRef lo, hi;
+		if(is_rectangle(selem, lo, hi))
+			van_herk<T, Op>(in, lo, hi, out);
+		else
+			morphology<Accumulator, T>(in, selem, a, out);
+	}
+}
+
+void erodeRectangle(const BasicImage<byte>& in, ImageRef lo, ImageRef hi, BasicImage<byte>& out)
+{
+	van_herk<byte, Min<byte>>(in, lo, hi, out);
+}
+
+void dilateRectangle(const BasicImage<byte>& in, ImageRef lo, ImageRef hi, BasicImage<byte>& out)
+{
+	van_herk<byte, Max<byte>>(in, lo, hi, out);
+}
+
+void openRectangle(const BasicImage<byte>& in, ImageRef lo, ImageRef hi, BasicImage<byte>& out)
+{
+	van_herk<byte, Min<byte>>(in, lo, hi, out);
+	van_herk<byte, Max<byte>>(out, -hi, -lo, out);
+}
+
+void closeRectangle(const BasicImage<byte>& in, ImageRef lo, ImageRef hi, BasicImage<byte>& out)
+{
+	van_herk<byte, Max<byte>>(in, lo, hi, out);
+	van_herk<byte, Min<byte>>(out, -hi, -lo, out);
+}
+
+void morphology(const BasicImage<byte>& in, const std::vector<ImageRef>& selem, const Morphology::Erode<byte>& e, BasicImage<byte>& out)
+{
+	morphology_rectangle_or_general<byte, Min<byte>>(in, selem, e, out);
+}
+
+void morphology(const BasicImage<byte>& in, const std::vector<ImageRef>& selem, const Morphology::Dilate<byte>& d, BasicImage<byte>& out)
+{
+	morphology_rectangle_or_general<byte, Max<byte>>(in, selem, d, out);
+}
+
+void erodeRectangle(const BasicImage<unsigned short>& in, ImageRef lo, ImageRef hi, BasicImage<unsigned short>& out)
+{
+	van_herk<unsigned short, Min<unsigned short>>(in, lo, hi, out);
+}
+
+void dilateRectangle(const BasicImage<unsigned short>& in, ImageRef lo, ImageRef hi, BasicImage<unsigned short>& out)
+{
+	van_herk<unsigned short, Max<unsigned short>>(in, lo, hi, out);
+}
+
+void openRectangle(const BasicImage<unsigned short>& in, ImageRef lo, ImageRef hi, BasicImage<unsigned short>& out)
+{
+	van_herk<unsigned short, Min<unsigned short>>(in, lo, hi, out);
+	van_herk<unsigned short, Max<unsigned short>>(out, -hi, -lo, out);
+}
+
+void closeRectangle(const BasicImage<unsigned short>& in, ImageRef lo, ImageRef hi, BasicImage<unsigned short>& out)
+{
+	van_herk<unsigned short, Max<unsigned short>>(in, lo, hi, out);
+	van_herk<unsigned short, Min<unsigned short>>(out, -hi, -lo, out);
+}
+
+void morphology(const BasicImage<unsigned short>& in, const std::vector<ImageRef>& selem, const Morphology::Erode<unsigned short>& e, BasicImage<unsigned short>& out)
+{
+	morphology_rectangle_or_general<unsigned short, Min<unsigned short>>(in, selem, e, out);
+}
+
+void morphology(const BasicImage<unsigned short>& in, const std::vector<ImageRef>& selem, const Morphology::Dilate<unsigned short>& d, BasicImage<unsigned short>& out)
+{
+	morphology_rectangle_or_general<unsigned short, Max<unsigned short>>(in, selem, d, out);
+}
+
+void erodeRectangle(const BasicImage<float>& in, ImageRef lo, ImageRef hi, BasicImage<float>& out)
+{
+	van_herk<float, Min<float>>(in, lo, hi, out);
+}
+
+void dilateRectangle(const BasicImage<float>& in, ImageRef lo, ImageRef hi, BasicImage<float>& out)
+{
+	van_herk<float, Max<float>>(in, lo, hi, out);
+}
+
+void openRectangle(const BasicImage<float>& in, ImageRef lo, ImageRef hi, BasicImage<float>& out)
+{
+	van_herk<float, Min<float>>(in, lo, hi, out);
+	van_herk<float, Max<float>>(out, -hi, -lo, out);
+}
+
+void closeRectangle(const BasicImage<float>& in, ImageRef lo, ImageRef hi, BasicImage<float>& out)
+{
+	van_herk<float, Max<float>>(in, lo, hi, out);
+	van_herk<float, Min<float>>(out, -hi, -lo, out);
+}
+
+void morphology(const BasicImage<float>& in, const std::vector<ImageRef>& selem, const Morphology::Erode<float>& e, BasicImage<float>& out)
+{
+	morphology_rectangle_or_general<float, Min<float>>(in, selem, e, out);
+}
+
+void morphology(const BasicImage<float>& in, const std::vector<ImageRef>& selem, const Morphology::Dilate<float>& d, BasicImage<float>& out)
+{
+	morphology_rectangle_or_general<float, Max<float>>(in, selem, d, out);
+}
+
 void morphology(const BasicImage<byte>& in, const std::vector<ImageRef>& selem, const Morphology::Median<byte>& m, BasicImage<byte>& out)
 {
+	//Larger centred squares use the constant time median filter.
+	ImageRef lo, hi;
+	if(selem.size() > 9 && is_rectangle(selem, lo, hi) && lo == -hi && hi.x == hi.y && hi.x <= 127)
+	{
+		median_filter(in, hi.x, out);
+		return;
+	}
+
 	//If we happen to be given a 3x3 square, then perform
 	//median filtering using the hand coded functions.
 	if(selem.size() == 9)
@@ -0,0 +1,117 @@
+#include "cvd/vision.h"
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace CVD
+{
+namespace Internal
+{
+	namespace
+	{
+		// A row of 8 bytes of a tile as a word, with the first byte lowest
+		// whatever the byte order of the machine, and back. Compilers make each
+		// of these a single load or store.
+		template <std::size_t... K>
+		inline std::uint64_t load(const unsigned char* p, std::index_sequence<K...>)
+		{
+			return ((static_cast<std::uint64_t>(p[K]) << (8 * K)) | ...);
+		}
+
+		template <std::size_t... K>
+		inline void store(std::uint64_t w, unsigned char* p, std::index_sequence<K...>)
+		{
+			((p[K] = static_cast<unsigned char>(w >> (8 * K))), ...);
+		}
+
+		// Each round swaps lanes between the N rows in pairs D apart, in lanes
+		// twice the width of the last round's, until the rows are the columns.
+		// Pair k is rows j and j + D, where j = k / D * 2 * D + k % D. The
+		// rounds and pairs are expanded at compile time so that the rows stay
+		// in registers.
+		template <int Lane, int D>
+		inline void swap_lanes(std::uint64_t& a, std::uint64_t& b)
+		{
+			const int bits = 8 * Lane;
+			const std::uint64_t low = ~std::uint64_t(0) / ((std::uint64_t(1) << bits) + 1);
+			const std::uint64_t x = a, y = b;
+			a = (x & low) | ((y & low) << bits);
+			b = ((x >> bits) & low) | (y & ~low);
+		}
+
+		template <int Lane, int D, std::size_t... K>
+		inline void round(std::uint64_t* r, std::index_sequence<K...>)
+		{
+			(swap_lanes<Lane, D>(r[K / D * 2 * D + K % D], r[K / D * 2 * D + K % D + D]), ...);
+		}
+
+		template <int N, int Lane, int D>
+		inline void rounds(std::uint64_t* r)
+		{
+			if constexpr(D < N)
+			{
+				round<Lane, D>(r, std::make_index_sequence<N / 2>());
+				rounds<N, 2 * Lane, 2 * D>(r);
+			}
+		}
+
+		template <std::size_t... I>
+		inline void load(const unsigned char* in, std::ptrdiff_t stride, std::uint64_t* r, std::index_sequence<I...>)
+		{
+			((r[I] = load(in + I * stride, std::make_index_sequence<8>())), ...);
+		}
+
+		template <std::size_t... I>
+		inline void store(const std::uint64_t* r, unsigned char* out, std::ptrdiff_t stride, std::index_sequence<I...>)
+		{
+			(store(r[I], out + I * stride, std::make_index_sequence<8>()), ...);
+		}
+
+		// Transposes a tile of 8 bytes square, of 8x8, 4x4 or 2x2 pixels, in
+		// 64 bit registers.
+		template <int B>
+		void transpose_tile(const unsigned char* in, std::ptrdiff_t in_stride, unsigned char* out, std::ptrdiff_t out_stride)
+		{
+			const int N = 8 / B;
+			std::uint64_t r[N];
+			load(in, in_stride, r, std::make_index_sequence<N>());
+			rounds<N, B, 1>(r);
+			store(r, out, out_stride, std::make_index_sequence<N>());
+		}
+
+		template <int B>
+		void transpose_pixels(const unsigned char* in, std::ptrdiff_t in_stride, unsigned char* out, std::ptrdiff_t out_stride, int x0, int x1, int y0, int y1)
+		{
+			for(int y = y0; y < y1; y++)
+				for(int x = x0; x < x1; x++)
+					std::memcpy(out + x * out_stride + y * B, in + y * in_stride + x * B, B);
+		}
+
+		template <int B>
+		void transpose_block(const unsigned char* in, std::ptrdiff_t in_stride, unsigned char* out, std::ptrdiff_t out_stride, int w, int h)
+		{
+			const int N = 8 / B;
+			int y = 0;
+			for(; y + N <= h; y += N)
+			{
+				int x = 0;
+				for(; x + N <= w; x += N)
+					transpose_tile<B>(in + y * in_stride + x * B, in_stride, out + x * out_stride + y * B, out_stride);
+				transpose_pixels<B>(in, in_stride, out, out_stride, x, w, y, y + N);
+			}
+			transpose_pixels<B>(in, in_stride, out, out_stride, 0, w, y, h);
+		}
+	}
+
+	void transposeBlock(const unsigned char* in, std::ptrdiff_t in_stride, unsigned char* out, std::ptrdiff_t out_stride, int w, int h, int bytes)
+	{
+		if(bytes == 1)
+			transpose_block<1>(in, in_stride, out, out_stride, w, h);
+		else if(bytes == 2)
+			transpose_block<2>(in, in_stride, out, out_stride, w, h);
+		else
+			transpose_block<4>(in, in_stride, out, out_stride, w, h);
+	}
+}
+}
@@ -1,5 +1,10 @@
 #include <cvd/image_ref.h>
 #include <cvd/nonmax_suppression.h>
+#include <cvd/vision_exceptions.h>
+
+#include "cvd/internal/slice.h"
+
+#include <algorithm>
 #include <vector>
 
 using namespace std;
@@ -150,4 +155,252 @@ void nonmax_suppression_with_scores(const vector<ImageRef>& corners, const vecto
 	nonmax_suppression_t<int, pair<ImageRef, int>, collect_score, Greater>(corners, scores, nonmax_corners);
 }
 
+namespace
+{
+	// Dense nonmaximal suppression over windows of (2r+1) x (2r+1) pixels.
+	//
+	// Each pixel s(x, y) is compared with E(x, y), the largest of the other
+	// pixels in its window, which is built separably from windows of r pixels
+	// either side of the centre:
+	//
+	//   C(x, y) = max of the r pixels to the left and the r pixels to the right
+	//   H(x, y) = max(C(x, y), s(x, y)), the whole row of the window
+	//   E(x, y) = max(C(x, y), H over the r rows above, H over the r rows below)
+	//
+	// Windows of r samples are found by doubling: if M_l(i) is the largest of
+	// the l samples starting at i, M_2l(i) = max(M_l(i), M_l(i + l)), and with
+	// the largest power of two p <= r, M_r(i) = max(M_p(i), M_p(i + r - p)).
+	// That costs about log2(r) + 1 elementwise operations per sample in each
+	// direction, and the compiler vectorises all of them. Pixels outside the
+	// image take the lowest value, which crops the window.
+	//
+	// The image is worked in strips of rows. The vertical pass needs r rows of
+	// H above and below each strip, so the strips are at least 2r rows high to
+	// keep the extra work down.
+	template <class T>
+	class DenseNonmax
+	{
+		public:
+		DenseNonmax(const BasicImage<T>& scores_, int r_, T threshold_, bool strict_)
+		    : scores(scores_)
+		    , r(r_)
+		    , w(scores_.size().x)
+		    , h(scores_.size().y)
+		    , threshold(threshold_)
+		    , strict(strict_)
+		    , lowest(std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest())
+		    , padded(w + 2 * r, lowest)
+		    , a(w + 2 * r)
+		    , b(w + 2 * r)
+		    , flags(w)
+		{
+			p = 1;
+			while(2 * p <= r)
+				p *= 2;
+		}
+
+		// Calls emit(y, flags) for each row from y0 to y0 + rows, where flags
+		// is 255 for the maxima and 0 elsewhere.
+		template <class Emit>
+		void operator()(int y0, int rows, Emit emit)
+		{
+			const int strip = std::max(32, 2 * r);
+
+			for(int ys = y0; ys < y0 + rows; ys += strip)
+			{
+				const int m = std::min(strip, y0 + rows - ys);
+				const int n = m + 2 * r;
+				vertical.resize(static_cast<size_t>(n) * w);
+				centre.resize(static_cast<size_t>(m) * w);
+
+				// Row e of the vertical buffer holds H for row ys - r + e.
+				for(int e = 0; e < n; e++)
+				{
+					const int y = ys - r + e;
+					T* v = &vertical[static_cast<size_t>(e) * w];
+					if(y < 0 || y >= h)
+						std::fill(v, v + w, lowest);
+					else
+						horizontal(y, v, (e >= r && e < r + m) ? &centre[static_cast<size_t>(e - r) * w] : nullptr);
+				}
+
+				// Row e becomes M_p of the rows starting at e. Row e + l is
+				// read before it is itself updated.
+				for(int l = 1; l < p; l *= 2)
+					for(int e = 0; e + l < n; e++)
+						max_into(&vertical[static_cast<size_t>(e) * w], &vertical[static_cast<size_t>(e + l) * w], w);
+
+				for(int j = 0; j < m; j++)
+				{
+					const T* v = vertical.data();
+					const T* above_0 = v + static_cast<size_t>(j) * w;
+					const T* above_1 = v + static_cast<size_t>(j + r - p) * w;
+					const T* below_0 = v + static_cast<size_t>(j + r + 1) * w;
+					const T* below_1 = v + static_cast<size_t>(j + 2 * r + 1 - p) * w;
+					const T* c = &centre[static_cast<size_t>(j) * w];
+					const T* s = scores[ys + j];
+					byte* f = flags.data();
+
+					if(strict)
+						for(int x = 0; x < w; x++)
+						{
+							const T e = max(max(max(c[x], above_0[x]), max(above_1[x], below_0[x])), below_1[x]);
+							f[x] = (s[x] > e) & (s[x] >= threshold) ? 255 : 0;
+						}
+					else
+						for(int x = 0; x < w; x++)
+						{
+							const T e = max(max(max(c[x], above_0[x]), max(above_1[x], below_0[x])), below_1[x]);
+							f[x] = (s[x] >= e) & (s[x] >= threshold) ? 255 : 0;
+						}
+
+					emit(ys + j, f);
+				}
+			}
+		}
+
+		private:
+		static T max(T x, T y)
+		{
+			return y > x ? y : x;
+		}
+
+		static void max_into(T* x, const T* y, int count)
+		{
+			for(int i = 0; i < count; i++)
+				x[i] = max(x[i], y[i]);
+		}
+
+		// Compute H for row y, and C if c is not null.
+		void horizontal(int y, T* hrow, T* c)
+		{
+			const int n = w + 2 * r;
+			const T* s = scores[y];
+			std::copy(s, s + w, padded.begin() + r);
+
+			// Afterwards, q[i] is M_p of the padded row starting at i, so the r
+			// pixels left of x start at x and the r to the right at x + r + 1.
+			const T* q = padded.data();
+			T* next = a.data();
+			T* spare = b.data();
+			for(int l = 1; l < p; l *= 2)
+			{
+				for(int i = 0; i + l < n; i++)
+					next[i] = max(q[i], q[i + l]);
+				q = next;
+				std::swap(next, spare);
+			}
+
+			const T* left_0 = q;
+			const T* left_1 = q + r - p;
+			const T* right_0 = q + r + 1;
+			const T* right_1 = q + 2 * r + 1 - p;
+
+			if(c)
+			{
+				for(int x = 0; x < w; x++)
+					c[x] = max(max(left_0[x], left_1[x]), max(right_0[x], right_1[x]));
+				for(int x = 0; x < w; x++)
+					hrow[x] = max(c[x], s[x]);
+			}
+			else
+				for(int x = 0; x < w; x++)
+					hrow[x] = max(max(max(left_0[x], left_1[x]), max(right_0[x], right_1[x])), s[x]);
+		}
+
+		const BasicImage<T>& scores;
+		const int r, w, h;
+		const T threshold;
+		const bool strict;
+		const T lowest;
+		int p;
+		std::vector<T> padded, a, b, vertical, centre;
+		std::vector<byte> flags;
+	};
+
+	void check_radius(int radius)
+	{
+		if(radius < 1)
+			throw Exceptions::Vision::BadInput("nonmax_suppression: the radius must be at least 1");
+	}
+
+	template <class T>
+	void dense_nonmax_suppression(const BasicImage<T>& scores, int radius, BasicImage<byte>& mask, T threshold, bool strict)
+	{
+		check_radius(radius);
+		if(scores.size() != mask.size())
+			throw Exceptions::Vision::IncompatibleImageSizes("nonmax_suppression");
+
+		const int w = scores.size().x;
+		internal::Slice(scores.size().y, internal::SliceHeight(scores.size().y, 32), [&](int, int y0, int rows) {
+			DenseNonmax<T> nonmax(scores, radius, threshold, strict);
+			nonmax(y0, rows, [&](int y, const byte* f) { std::copy(f, f + w, mask[y]); });
+		});
+	}
+
+	template <class T>
+	void dense_nonmax_suppression(const BasicImage<T>& scores, int radius, vector<pair<ImageRef, T>>& max_corners, T threshold, bool strict)
+	{
+		check_radius(radius);
+
+		const int w = scores.size().x;
+		const int h = scores.size().y;
+		const int band = internal::SliceHeight(h, 32);
+		vector<vector<pair<ImageRef, T>>> bands((h + band - 1) / band);
+
+		internal::Slice(h, band, [&](int i, int y0, int rows) {
+			DenseNonmax<T> nonmax(scores, radius, threshold, strict);
+			nonmax(y0, rows, [&](int y, const byte* f) {
+				for(int x = 0; x < w; x++)
+					if(f[x])
+						bands[i].push_back(make_pair(ImageRef(x, y), scores[y][x]));
+			});
+		});
+
+		max_corners.clear();
+		for(const auto& c : bands)
+			max_corners.insert(max_corners.end(), c.begin(), c.end());
+	}
+}
+
+void nonmax_suppression(const BasicImage<float>& scores, int radius, BasicImage<byte>& mask, float threshold)
+{
+	dense_nonmax_suppression(scores, radius, mask, threshold, false);
+}
+
+void nonmax_suppression(const BasicImage<int>& scores, int radius, BasicImage<byte>& mask, int threshold)
+{
+	dense_nonmax_suppression(scores, radius, mask, threshold, false);
+}
+
+void nonmax_suppression_strict(const BasicImage<float>& scores, int radius, BasicImage<byte>& mask, float threshold)
+{
+	dense_nonmax_suppression(scores, radius, mask, threshold, true);
+}
+
+void nonmax_suppression_strict(const BasicImage<int>& scores, int radius, BasicImage<byte>& mask, int threshold)
+{
+	dense_nonmax_suppression(scores, radius, mask, threshold, true);
+}
+
+void nonmax_suppression_with_scores(const BasicImage<float>& scores, int radius, vector<pair<ImageRef, float>>& max_corners, float threshold)
+{
+	dense_nonmax_suppression(scores, radius, max_corners, threshold, false);
+}
+
+void nonmax_suppression_with_scores(const BasicImage<int>& scores, int radius, vector<pair<ImageRef, int>>& max_corners, int threshold)
+{
+	dense_nonmax_suppression(scores, radius, max_corners, threshold, false);
+}
+
+void nonmax_suppression_strict_with_scores(const BasicImage<float>& scores, int radius, vector<pair<ImageRef, float>>& max_corners, float threshold)
+{
+	dense_nonmax_suppression(scores, radius, max_corners, threshold, true);
+}
+
+void nonmax_suppression_strict_with_scores(const BasicImage<int>& scores, int radius, vector<pair<ImageRef, int>>& max_corners, int threshold)
+{
+	dense_nonmax_suppression(scores, radius, max_corners, threshold, true);
+}
+
 }
@@ -0,0 +1,257 @@
+#include "cvd/remap.h"
+#include "cvd/vision_exceptions.h"
+
+#include "cvd/internal/pixel_traits.h"
+#include "cvd/internal/rgb_components.h"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+using namespace std;
+
+namespace CVD
+{
+
+// Remapping through a table of source points.
+//
+// Both storage formats decode to the top left pixel of the 2x2 square around
+// each point and the fractions across it in 1/65536 of a pixel. Points on the
+// last row or column are moved to the square before, with a fraction of one,
+// so the whole square of a valid point is always in the image and gathering
+// needs no checks. Invalid points gather the square at the origin and are
+// replaced by the default value afterwards.
+//
+// Each band of rows is remapped on its own thread, in blocks of a row. The
+// decoding, the interpolation of each channel and the selection of the
+// default value are loops over the block, which the compiler vectorises, and
+// only the gathering is done a pixel at a time.
+namespace
+{
+	const int block = 64;
+
+	// Bilinear interpolation of n points in fixed point, with weights
+	// rounded to 1/256 of a pixel.
+	void interpolate(const int* fx, const int* fy, const int (&v)[4][block], int n, int* result)
+	{
+		for(int i = 0; i < n; i++)
+		{
+			const int wx = (fx[i] + 128) >> 8;
+			const int wy = (fy[i] + 128) >> 8;
+			const int top = v[0][i] * (256 - wx) + v[1][i] * wx;
+			const int bottom = v[2][i] * (256 - wx) + v[3][i] * wx;
+			result[i] = (top * (256 - wy) + bottom * wy + 32768) >> 16;
+		}
+	}
+
+	void interpolate(const int* fx, const int* fy, const float (&v)[4][block], int n, float* result)
+	{
+		for(int i = 0; i < n; i++)
+		{
+			const float wx = fx[i] * (1.0f / 65536);
+			const float wy = fy[i] * (1.0f / 65536);
+			const float top = v[0][i] + wx * (v[1][i] - v[0][i]);
+			const float bottom = v[2][i] + wx * (v[3][i] - v[2][i]);
+			result[i] = top + wy * (bottom - top);
+		}
+	}
+
+	template <class T>
+	void remap_bands(const BasicImage<T>& in, const RemapTable& table, BasicImage<T>& out, const T& default_value)
+	{
+		typedef Pixel::Component<T> Pix;
+		typedef typename Pix::type S;
+		const int channels = Pix::count;
+
+		// Bytes are interpolated as ints.
+		typedef typename conditional<is_floating_point<S>::value, S, int>::type V;
+
+		const int w = out.size().x;
+		const int h = out.size().y;
+
+		internal::Slice(h, internal::SliceHeight(h, 16), [&](int, int y0, int rows) {
+			int xi[block], yi[block], fx[block], fy[block], flag[block];
+			V v[channels][4][block];
+			V result[channels][block];
+			V fallback[channels];
+			for(int c = 0; c < channels; c++)
+				fallback[c] = Pix::get(default_value, c);
+
+			for(int y = y0; y < y0 + rows; y++)
+			{
+				T* row = out[y];
+				for(int x0 = 0; x0 < w; x0 += block)
+				{
+					const int n = min(block, w - x0);
+					table.decode(x0, y, n, xi, yi, fx, fy, flag);
+
+					for(int i = 0; i < n; i++)
+					{
+						const T* top = in[yi[i]] + xi[i];
+						const T* bottom = in[yi[i] + 1] + xi[i];
+						for(int c = 0; c < channels; c++)
+						{
+							v[c][0][i] = Pix::get(top[0], c);
+							v[c][1][i] = Pix::get(top[1], c);
+							v[c][2][i] = Pix::get(bottom[0], c);
+							v[c][3][i] = Pix::get(bottom[1], c);
+						}
+					}
+
+					for(int c = 0; c < channels; c++)
+					{
+						interpolate(fx, fy, v[c], n, result[c]);
+						const V d = fallback[c];
+						V* r = result[c];
+						for(int i = 0; i < n; i++)
+							r[i] = flag[i] ? r[i] : d;
+					}
+
+					for(int i = 0; i < n; i++)
+						for(int c = 0; c < channels; c++)
+							Pix::get(row[x0 + i], c) = static_cast<S>(result[c][i]);
+				}
+			}
+		});
+	}
+
+	template <class T>
+	void remap_image(const BasicImage<T>& in, const RemapTable& table, BasicImage<T>& out, const T& default_value)
+	{
+		if(in.size() != table.source_size() || out.size() != table.size())
+			throw Exceptions::Vision::IncompatibleImageSizes("remap");
+
+		if(in.size().x < 2 || in.size().y < 2)
+			out.fill(default_value);
+		else
+			remap_bands(in, table, out, default_value);
+	}
+}
+
+RemapTable::RemapTable(ImageRef source_size, ImageRef size, RemapFormat format)
+    : my_source_size(source_size)
+    , my_size(size)
+    , my_format(format)
+{
+	if(source_size.x < 0 || source_size.y < 0 || source_size.x > 32767 || source_size.y > 32767)
+		throw Exceptions::Vision::BadInput("RemapTable: the source image must be at most 32767 pixels wide and high");
+
+	if(format == RemapFormat::Fixed16)
+	{
+		fixed_x.resize(size);
+		fixed_x.fill(-1);
+		fixed_y.resize(size);
+		fixed_y.fill(0);
+	}
+	else
+	{
+		whole_x.resize(size);
+		whole_x.fill(-1);
+		whole_y.resize(size);
+		whole_y.fill(0);
+		fraction_x.resize(size);
+		fraction_x.fill(0);
+		fraction_y.resize(size);
+		fraction_y.fill(0);
+	}
+}
+
+void RemapTable::set(ImageRef p, double x, double y)
+{
+	const int w = my_source_size.x;
+	const int h = my_source_size.y;
+	const bool ok = w >= 2 && h >= 2 && x >= 0 && x <= w - 1 && y >= 0 && y <= h - 1;
+
+	if(my_format == RemapFormat::Fixed16)
+	{
+		fixed_x[p] = ok ? static_cast<int32_t>(lround(x * 65536)) : -1;
+		fixed_y[p] = ok ? static_cast<int32_t>(lround(y * 65536)) : 0;
+	}
+	else
+	{
+		const long sx = ok ? lround(x * 256) : 0;
+		const long sy = ok ? lround(y * 256) : 0;
+		whole_x[p] = ok ? static_cast<int16_t>(sx >> 8) : -1;
+		whole_y[p] = static_cast<int16_t>(sy >> 8);
+		fraction_x[p] = static_cast<byte>(sx & 255);
+		fraction_y[p] = static_cast<byte>(sy & 255);
+	}
+}
+
+bool RemapTable::valid(ImageRef p) const
+{
+	return my_format == RemapFormat::Fixed16 ? fixed_x[p] >= 0 : whole_x[p] >= 0;
+}
+
+void RemapTable::decode(int x, int y, int n, int* xi, int* yi, int* fx, int* fy, int* flag) const
+{
+	const int last_x = max(0, my_source_size.x - 2);
+	const int last_y = max(0, my_source_size.y - 2);
+
+	// Both formats are first put in 16.16 fixed point, in local arrays so
+	// that the loops can be vectorised whatever the outputs point to.
+	int sx[block], sy[block], ok[block];
+	for(int i0 = 0; i0 < n; i0 += block)
+	{
+		const int m = min(block, n - i0);
+		if(my_format == RemapFormat::Fixed16)
+		{
+			const int32_t* px = fixed_x[y] + x + i0;
+			const int32_t* py = fixed_y[y] + x + i0;
+			for(int i = 0; i < m; i++)
+			{
+				const int32_t vx = px[i], vy = py[i];
+				ok[i] = vx >= 0;
+				sx[i] = vx >= 0 ? vx : 0;
+				sy[i] = vx >= 0 ? vy : 0;
+			}
+		}
+		else
+		{
+			const int16_t* wx = whole_x[y] + x + i0;
+			const int16_t* wy = whole_y[y] + x + i0;
+			const byte* ax = fraction_x[y] + x + i0;
+			const byte* ay = fraction_y[y] + x + i0;
+			for(int i = 0; i < m; i++)
+			{
+				const int vx = wx[i] * 65536 + ax[i] * 256;
+				const int vy = wy[i] * 65536 + ay[i] * 256;
+				ok[i] = vx >= 0;
+				sx[i] = vx >= 0 ? vx : 0;
+				sy[i] = vx >= 0 ? vy : 0;
+			}
+		}
+
+		int ix[block], iy[block], ax[block], ay[block];
+		for(int i = 0; i < m; i++)
+		{
+			ix[i] = min(sx[i] >> 16, last_x);
+			iy[i] = min(sy[i] >> 16, last_y);
+			ax[i] = sx[i] - (ix[i] << 16);
+			ay[i] = sy[i] - (iy[i] << 16);
+		}
+
+		std::copy(ix, ix + m, xi + i0);
+		std::copy(iy, iy + m, yi + i0);
+		std::copy(ax, ax + m, fx + i0);
+		std::copy(ay, ay + m, fy + i0);
+		std::copy(ok, ok + m, flag + i0);
+	}
+}
+
+void remap(const BasicImage<byte>& in, const RemapTable& table, BasicImage<byte>& out, byte default_value)
+{
+	remap_image(in, table, out, default_value);
+}
+
+void remap(const BasicImage<Rgb<byte>>& in, const RemapTable& table, BasicImage<Rgb<byte>>& out, Rgb<byte> default_value)
+{
+	remap_image(in, table, out, default_value);
+}
+
+void remap(const BasicImage<float>& in, const RemapTable& table, BasicImage<float>& out, float default_value)
+{
+	remap_image(in, table, out, default_value);
+}
+
+}
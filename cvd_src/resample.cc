@@ -0,0 +1,248 @@
+#include "cvd/vision.h"
+#include "cvd/internal/pixel_traits.h"
+#include "cvd/internal/rgb_components.h"
+#include "cvd/internal/slice.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+namespace CVD
+{
+
+// Resampling to any size with a separable filter.
+//
+// The filter for each output column, and each output row, is worked out once
+// from the kernel: it is centred on the point the output pixel comes from,
+// stretched by the scale when shrinking so that it averages away what would
+// otherwise alias, cut off at the edges of the image and normalised. Each is
+// stored as the first input pixel it covers and a fixed number of weights,
+// with the weights of all the outputs for each tap together.
+//
+// The output rows are split in to bands on multiple threads, and each band is
+// done in chunks of rows. The input rows a chunk needs are first filtered
+// horizontally in to float rows of the output width: the pixels under each
+// tap of a block of outputs are gathered, and the weighted sums are loops
+// over the block. Then the output rows are the weighted sums of those rows,
+// which are loops along the rows. The compiler vectorises both.
+namespace
+{
+	const int block = 64;
+	const int chunk = 64;
+
+	const double pi = 3.14159265358979323846;
+
+	double sinc(double x)
+	{
+		return x == 0 ? 1 : sin(pi * x) / (pi * x);
+	}
+
+	// The half width of the kernel, and its value.
+	double support(ResampleKernel kernel)
+	{
+		switch(kernel)
+		{
+			case ResampleKernel::Box:
+				return 0.5;
+			case ResampleKernel::Triangle:
+				return 1;
+			case ResampleKernel::Bicubic:
+				return 2;
+			default:
+				return 3;
+		}
+	}
+
+	double weight(ResampleKernel kernel, double x)
+	{
+		x = abs(x);
+		switch(kernel)
+		{
+			case ResampleKernel::Box:
+				return x < 0.5 ? 1 : x == 0.5 ? 0.5 : 0;
+			case ResampleKernel::Triangle:
+				return max(0.0, 1 - x);
+			case ResampleKernel::Bicubic:
+				// Catmull-Rom, the cubic convolution kernel with a = -1/2.
+				if(x < 1)
+					return (1.5 * x - 2.5) * x * x + 1;
+				if(x < 2)
+					return ((-0.5 * x + 2.5) * x - 4) * x + 2;
+				return 0;
+			default:
+				return x < 3 ? sinc(x) * sinc(x / 3) : 0;
+		}
+	}
+
+	// The filters taking a line of n pixels to one of m.
+	struct Filters
+	{
+		int taps;
+
+		// The first input pixel of each output.
+		vector<int> first;
+
+		// The weight of tap k of output i is weights[k * m + i].
+		vector<float> weights;
+	};
+
+	Filters make_filters(int n, int m, ResampleKernel kernel)
+	{
+		const double scale = static_cast<double>(n) / m;
+		const double stretch = max(1.0, scale);
+		const double s = support(kernel) * stretch;
+
+		Filters f;
+		f.taps = min(n, 2 * static_cast<int>(ceil(s)) + 1);
+		f.first.resize(m);
+		f.weights.assign(static_cast<size_t>(f.taps) * m, 0.f);
+
+		vector<double> w(f.taps);
+		for(int i = 0; i < m; i++)
+		{
+			// Pixel centres are at whole numbers.
+			const double c = (i + 0.5) * scale - 0.5;
+			const int lo = max(0, static_cast<int>(ceil(c - s)));
+			const int hi = min(n - 1, static_cast<int>(floor(c + s)));
+			const int first = max(0, min(lo, n - f.taps));
+
+			fill(w.begin(), w.end(), 0.0);
+			double sum = 0;
+			for(int j = lo; j <= hi; j++)
+			{
+				w[j - first] = weight(kernel, (j - c) / stretch);
+				sum += w[j - first];
+			}
+
+			// Only a box can miss every pixel, between two of them.
+			if(sum == 0)
+			{
+				const int j = min(n - 1, max(0, static_cast<int>(floor(c + 0.5))));
+				w[j - first] = sum = 1;
+			}
+
+			f.first[i] = first;
+			for(int k = 0; k < f.taps; k++)
+				f.weights[static_cast<size_t>(k) * m + i] = static_cast<float>(w[k] / sum);
+		}
+		return f;
+	}
+
+	// Bytes from the filtered values, rounded and saturated.
+	void to_pixels(const float* r, int n, int* result)
+	{
+		for(int i = 0; i < n; i++)
+			result[i] = min(255, max(0, static_cast<int>(r[i] + 0.5f)));
+	}
+
+	void to_pixels(const float* r, int n, float* result)
+	{
+		for(int i = 0; i < n; i++)
+			result[i] = r[i];
+	}
+
+	template <class T>
+	void resample_image(const BasicImage<T>& in, BasicImage<T>& out, ResampleKernel kernel)
+	{
+		typedef Pixel::Component<T> Pix;
+		typedef typename Pix::type S;
+		const int channels = Pix::count;
+		typedef typename conditional<is_floating_point<S>::value, S, int>::type V;
+
+		const int w = out.size().x;
+		const int h = out.size().y;
+		if(w == 0 || h == 0)
+			return;
+		if(in.size().x == 0 || in.size().y == 0)
+			throw Exceptions::Vision::BadInput("resample: an empty image can not be resampled");
+
+		const Filters across = make_filters(in.size().x, w, kernel);
+		const Filters down = make_filters(in.size().y, h, kernel);
+
+		internal::Slice(h, internal::SliceHeight(h, 16), [&](int, int y0, int rows) {
+			// The gathered pixels, the horizontally filtered rows of a chunk,
+			// and an output row.
+			vector<float> v(static_cast<size_t>(across.taps) * block);
+			vector<float> filtered;
+			vector<float> sum(w);
+			vector<V> result(w);
+
+			for(int c0 = y0; c0 < y0 + rows; c0 += chunk)
+			{
+				const int c1 = min(y0 + rows, c0 + chunk);
+				const int r0 = down.first[c0];
+				const int r1 = down.first[c1 - 1] + down.taps;
+				filtered.resize(static_cast<size_t>(channels) * (r1 - r0) * w);
+
+				for(int r = r0; r < r1; r++)
+				{
+					const T* row = in[r];
+					for(int c = 0; c < channels; c++)
+					{
+						float* f = &filtered[(static_cast<size_t>(c) * (r1 - r0) + (r - r0)) * w];
+						for(int x0 = 0; x0 < w; x0 += block)
+						{
+							const int n = min(block, w - x0);
+							for(int i = 0; i < n; i++)
+							{
+								const T* p = row + across.first[x0 + i];
+								for(int k = 0; k < across.taps; k++)
+									v[k * block + i] = Pix::get(p[k], c);
+							}
+
+							float acc[block] = {};
+							for(int k = 0; k < across.taps; k++)
+							{
+								const float* wk = &across.weights[static_cast<size_t>(k) * w + x0];
+								const float* vk = &v[k * block];
+								for(int i = 0; i < n; i++)
+									acc[i] += wk[i] * vk[i];
+							}
+							std::copy(acc, acc + n, f + x0);
+						}
+					}
+				}
+
+				for(int y = c0; y < c1; y++)
+				{
+					T* out_row = out[y];
+					for(int c = 0; c < channels; c++)
+					{
+						fill(sum.begin(), sum.end(), 0.f);
+						float* s = sum.data();
+						for(int k = 0; k < down.taps; k++)
+						{
+							const float wk = down.weights[static_cast<size_t>(k) * h + y];
+							const float* f = &filtered[(static_cast<size_t>(c) * (r1 - r0) + (down.first[y] + k - r0)) * w];
+							for(int x = 0; x < w; x++)
+								s[x] += wk * f[x];
+						}
+
+						to_pixels(s, w, result.data());
+						for(int x = 0; x < w; x++)
+							Pix::get(out_row[x], c) = static_cast<S>(result[x]);
+					}
+				}
+			}
+		});
+	}
+}
+
+void resample(const BasicImage<byte>& in, BasicImage<byte>& out, ResampleKernel kernel)
+{
+	resample_image(in, out, kernel);
+}
+
+void resample(const BasicImage<Rgb<byte>>& in, BasicImage<Rgb<byte>>& out, ResampleKernel kernel)
+{
+	resample_image(in, out, kernel);
+}
+
+void resample(const BasicImage<float>& in, BasicImage<float>& out, ResampleKernel kernel)
+{
+	resample_image(in, out, kernel);
+}
+
+}
@@ -0,0 +1,229 @@
+#include "cvd/vision.h"
+#include "cvd/vision_exceptions.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace CVD
+{
+
+// Sampling of many points at once.
+//
+// The points are taken in blocks. First the whole and fractional parts of
+// the coordinates of a block are found, and whether all the pixels needed
+// lie in the image. Then the square of pixels around each point is gathered
+// in to arrays, one per position in the square. That is the only step which
+// is done a point at a time, and it can skip the edge checks for blocks
+// inside the image. Finally the weights and the interpolation are loops over
+// those arrays, which the compiler vectorises.
+namespace
+{
+	const int block = 64;
+
+	// The squares of Taps x Taps pixels around a block of points. Taps is 2
+	// for bilinear and 4 for bicubic interpolation, where the square starts
+	// one pixel up and to the left.
+	template <class V, int Taps>
+	class Squares
+	{
+		public:
+		static const int offset = Taps / 2 - 1;
+
+		template <class T>
+		void gather(const BasicImage<T>& im, const float* x, const float* y, int n, SampleBorder border, V border_value)
+		{
+			const int w = im.size().x;
+			const int h = im.size().y;
+
+			// Limiting the coordinates first keeps the conversion to int
+			// defined, and takes NaN to a point outside the image.
+			int inside = 1;
+			for(int i = 0; i < n; i++)
+			{
+				const float cx = min(w + 4.0f, max(-4.0f, x[i]));
+				const float cy = min(h + 4.0f, max(-4.0f, y[i]));
+				int ix = static_cast<int>(cx);
+				int iy = static_cast<int>(cy);
+				ix -= cx < ix;
+				iy -= cy < iy;
+				fx[i] = cx - ix;
+				fy[i] = cy - iy;
+				xi[i] = ix - offset;
+				yi[i] = iy - offset;
+				inside &= (xi[i] >= 0) & (xi[i] + Taps <= w) & (yi[i] >= 0) & (yi[i] + Taps <= h);
+			}
+
+			if(inside)
+				for(int i = 0; i < n; i++)
+				{
+					for(int r = 0; r < Taps; r++)
+					{
+						const T* p = im[yi[i] + r] + xi[i];
+						for(int c = 0; c < Taps; c++)
+							v[r][c][i] = p[c];
+					}
+				}
+			else if(border == SampleBorder::Clamp)
+				for(int i = 0; i < n; i++)
+				{
+					for(int r = 0; r < Taps; r++)
+					{
+						const T* p = im[min(h - 1, max(0, yi[i] + r))];
+						for(int c = 0; c < Taps; c++)
+							v[r][c][i] = p[min(w - 1, max(0, xi[i] + c))];
+					}
+				}
+			else
+				for(int i = 0; i < n; i++)
+				{
+					for(int r = 0; r < Taps; r++)
+						for(int c = 0; c < Taps; c++)
+						{
+							const ImageRef p(xi[i] + c, yi[i] + r);
+							v[r][c][i] = im.in_image(p) ? V(im[p]) : border_value;
+						}
+				}
+		}
+
+		// For bilinear interpolation at the last row or column, the pixels
+		// beyond it have no weight, and border values such as NaN must not
+		// leak in to the result. Those pixels are replaced by their neighbours.
+		void drop_unweighted(int n, int w, int h)
+		{
+			for(int i = 0; i < n; i++)
+			{
+				const bool x0 = (fx[i] == 0) & (xi[i] + 1 == w), y0 = (fy[i] == 0) & (yi[i] + 1 == h);
+				const V a = v[0][0][i];
+				const V b = x0 ? a : v[0][1][i];
+				const V c = y0 ? a : v[1][0][i];
+				const V d = x0 ? c : y0 ? b : v[1][1][i];
+				v[0][1][i] = b;
+				v[1][0][i] = c;
+				v[1][1][i] = d;
+			}
+		}
+
+		float fx[block], fy[block];
+		int xi[block], yi[block];
+
+		// The pixel in row r and column c of the square around point i.
+		V v[Taps][Taps][block];
+	};
+
+	template <class T>
+	void check_image(const BasicImage<T>& im, SampleBorder border)
+	{
+		if(border == SampleBorder::Clamp && (im.size().x == 0 || im.size().y == 0))
+			throw Exceptions::Vision::BadInput("sample: an empty image can not be clamped to");
+	}
+
+	template <class T>
+	void bilinear(const BasicImage<T>& im, const float* x, const float* y, int n, float* values, float* dx, float* dy, SampleBorder border, float border_value)
+	{
+		check_image(im, border);
+		Squares<float, 2> s;
+		for(int i0 = 0; i0 < n; i0 += block)
+		{
+			const int m = min(block, n - i0);
+			s.gather(im, x + i0, y + i0, m, border, border_value);
+			s.drop_unweighted(m, im.size().x, im.size().y);
+
+			for(int i = 0; i < m; i++)
+			{
+				const float a = s.v[0][0][i], b = s.v[0][1][i], c = s.v[1][0][i], d = s.v[1][1][i];
+				const float top = a + s.fx[i] * (b - a);
+				const float bottom = c + s.fx[i] * (d - c);
+				values[i0 + i] = top + s.fy[i] * (bottom - top);
+			}
+
+			if(dx)
+				for(int i = 0; i < m; i++)
+				{
+					const float a = s.v[0][0][i], b = s.v[0][1][i], c = s.v[1][0][i], d = s.v[1][1][i];
+					dx[i0 + i] = (b - a) + s.fy[i] * ((d - c) - (b - a));
+					dy[i0 + i] = (c - a) + s.fx[i] * ((d - b) - (c - a));
+				}
+		}
+	}
+
+	template <class T>
+	void bicubic(const BasicImage<T>& im, const float* x, const float* y, int n, float* values, SampleBorder border, float border_value)
+	{
+		check_image(im, border);
+		Squares<float, 4> s;
+		for(int i0 = 0; i0 < n; i0 += block)
+		{
+			const int m = min(block, n - i0);
+			s.gather(im, x + i0, y + i0, m, border, border_value);
+
+			for(int i = 0; i < m; i++)
+			{
+				// The kernel of image_interpolate<Interpolate::Bicubic, T> is
+				// the cubic B-spline, whose weights are these polynomials.
+				const float fx = s.fx[i], gx = 1 - fx, fx2 = fx * fx, fx3 = fx2 * fx;
+				const float fy = s.fy[i], gy = 1 - fy, fy2 = fy * fy, fy3 = fy2 * fy;
+				const float wx0 = gx * gx * gx / 6, wx1 = (4 - 6 * fx2 + 3 * fx3) / 6, wx2 = (1 + 3 * fx + 3 * fx2 - 3 * fx3) / 6, wx3 = fx3 / 6;
+				const float wy0 = gy * gy * gy / 6, wy1 = (4 - 6 * fy2 + 3 * fy3) / 6, wy2 = (1 + 3 * fy + 3 * fy2 - 3 * fy3) / 6, wy3 = fy3 / 6;
+				values[i0 + i] = wy0 * (wx0 * s.v[0][0][i] + wx1 * s.v[0][1][i] + wx2 * s.v[0][2][i] + wx3 * s.v[0][3][i])
+				    + wy1 * (wx0 * s.v[1][0][i] + wx1 * s.v[1][1][i] + wx2 * s.v[1][2][i] + wx3 * s.v[1][3][i])
+				    + wy2 * (wx0 * s.v[2][0][i] + wx1 * s.v[2][1][i] + wx2 * s.v[2][2][i] + wx3 * s.v[2][3][i])
+				    + wy3 * (wx0 * s.v[3][0][i] + wx1 * s.v[3][1][i] + wx2 * s.v[3][2][i] + wx3 * s.v[3][3][i]);
+			}
+		}
+	}
+}
+
+void sample_bilinear(const BasicImage<byte>& im, const float* x, const float* y, int n, float* values, SampleBorder border, float border_value)
+{
+	bilinear(im, x, y, n, values, nullptr, nullptr, border, border_value);
+}
+
+void sample_bilinear(const BasicImage<float>& im, const float* x, const float* y, int n, float* values, SampleBorder border, float border_value)
+{
+	bilinear(im, x, y, n, values, nullptr, nullptr, border, border_value);
+}
+
+void sample_bilinear(const BasicImage<byte>& im, const float* x, const float* y, int n, byte* values, SampleBorder border, byte border_value)
+{
+	check_image(im, border);
+	Squares<int, 2> s;
+	for(int i0 = 0; i0 < n; i0 += block)
+	{
+		const int m = min(block, n - i0);
+		s.gather(im, x + i0, y + i0, m, border, border_value);
+		s.drop_unweighted(m, im.size().x, im.size().y);
+
+		// Weights in 1/256 of a pixel, so the sum fits easily in an int.
+		for(int i = 0; i < m; i++)
+		{
+			const int wx = static_cast<int>(s.fx[i] * 256 + 0.5f);
+			const int wy = static_cast<int>(s.fy[i] * 256 + 0.5f);
+			const int top = s.v[0][0][i] * (256 - wx) + s.v[0][1][i] * wx;
+			const int bottom = s.v[1][0][i] * (256 - wx) + s.v[1][1][i] * wx;
+			values[i0 + i] = static_cast<byte>((top * (256 - wy) + bottom * wy + 32768) >> 16);
+		}
+	}
+}
+
+void sample_bilinear_gradient(const BasicImage<byte>& im, const float* x, const float* y, int n, float* values, float* dx, float* dy, SampleBorder border, float border_value)
+{
+	bilinear(im, x, y, n, values, dx, dy, border, border_value);
+}
+
+void sample_bilinear_gradient(const BasicImage<float>& im, const float* x, const float* y, int n, float* values, float* dx, float* dy, SampleBorder border, float border_value)
+{
+	bilinear(im, x, y, n, values, dx, dy, border, border_value);
+}
+
+void sample_bicubic(const BasicImage<byte>& im, const float* x, const float* y, int n, float* values, SampleBorder border, float border_value)
+{
+	bicubic(im, x, y, n, values, border, border_value);
+}
+
+void sample_bicubic(const BasicImage<float>& im, const float* x, const float* y, int n, float* values, SampleBorder border, float border_value)
+{
+	bicubic(im, x, y, n, values, border, border_value);
+}
+
+}
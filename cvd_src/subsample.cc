@@ -0,0 +1,263 @@
+#include "cvd/vision.h"
+#include "cvd/internal/slice.h"
+
+#include <algorithm>
+#include <type_traits>
+
+using namespace std;
+
+namespace CVD
+{
+
+// Half and two thirds sampling of pixels other than bytes.
+//
+// The generic halfSample() and twoThirdsSample() in vision.h add up whole
+// pixels through the pixel operations, one output pixel at a time, which the
+// compiler can not vectorise. Here the rows of pixels are treated as rows of
+// their components instead, and each output row is a loop over those, with
+// the components of a pixel in a fixed size inner loop. The compiler
+// vectorises these, interleaving and de-interleaving the components as it
+// goes. Three components do not fit whole vectors that way without the
+// shuffles of later instruction sets, so when half sampling those every pixel
+// is averaged with the one to its right along the whole row, and every other
+// result is kept. The sums are made in the same order and in types as wide as the ones
+// the generic versions use, so the results are exactly the same, including the
+// truncation of integer division. The rows are split in to bands on multiple
+// threads.
+//
+// A raw Bayer image is binned in the same way: each 2x2 cell of the colour
+// filter pattern becomes one colour pixel, from the red and blue pixels of the
+// cell and the average of its two greens.
+namespace
+{
+	const int block = 64;
+
+	// The type of the components of a pixel, and the type they are added up
+	// in, which is wide enough for nine of them.
+	template <class T>
+	struct Sum
+	{
+		typedef typename Pixel::Component<T>::type S;
+		typedef typename conditional<is_floating_point<S>::value, S, typename conditional<sizeof(S) == 1, unsigned short, unsigned int>::type>::type type;
+	};
+
+	// A row of pixels as a row of their components.
+	template <class S, class T>
+	S* components(T* row)
+	{
+		static_assert(sizeof(T) % sizeof(S) == 0, "pixels must be packed components");
+		return reinterpret_cast<S*>(row);
+	}
+
+	// An output row of w pixels from the two input rows it covers.
+	template <class T>
+	void half_sample_row(const T* top_row, const T* bottom_row, T* out_row, int w)
+	{
+		typedef typename Pixel::Component<T>::type S;
+		typedef typename Sum<T>::type A;
+		const int C = Pixel::Component<T>::count;
+		const S* top = components<const S>(top_row);
+		const S* bottom = components<const S>(bottom_row);
+
+		if(C == 3)
+		{
+			for(int x0 = 0; x0 < w; x0 += block)
+			{
+				const int n = min(block, w - x0);
+				const S* t = top + 2 * C * x0;
+				const S* b = bottom + 2 * C * x0;
+				T h[2 * block];
+				S* hs = components<S>(h);
+				for(int i = 0; i < (2 * n - 1) * C; i++)
+					hs[i] = static_cast<S>((A(t[i]) + b[i] + t[i + C] + b[i + C]) / 4);
+				for(int x = 0; x < n; x++)
+					out_row[x0 + x] = h[2 * x];
+			}
+		}
+		else
+		{
+			S* o = components<S>(out_row);
+			for(int x = 0; x < w; x++)
+				for(int c = 0; c < C; c++)
+				{
+					const int i = 2 * C * x + c;
+					o[C * x + c] = static_cast<S>((A(top[i]) + bottom[i] + top[i + C] + bottom[i + C]) / 4);
+				}
+		}
+	}
+
+	template <class T>
+	void half_sample(const BasicImage<T>& in, BasicImage<T>& out)
+	{
+		if((in.size() / 2) != out.size())
+			throw Exceptions::Vision::IncompatibleImageSizes("halfSample");
+
+		internal::Slice(out.size().y, internal::SliceHeight(out.size().y, 16), [&](int, int y0, int rows) {
+			for(int y = y0; y < y0 + rows; y++)
+				half_sample_row(in[2 * y], in[2 * y + 1], out[y], out.size().x);
+		});
+	}
+
+	// Two output rows from three input rows, in blocks of 3x3 pixels which
+	// become 2x2:
+	// a b c
+	// d e f
+	// g h i
+	template <class T>
+	void two_thirds_sample_rows(const T* row0, const T* row1, const T* row2, T* out0, T* out1, int blocks)
+	{
+		typedef typename Pixel::Component<T>::type S;
+		typedef typename Sum<T>::type A;
+		const int C = Pixel::Component<T>::count;
+		const S* r0 = components<const S>(row0);
+		const S* r1 = components<const S>(row1);
+		const S* r2 = components<const S>(row2);
+		S* o0 = components<S>(out0);
+		S* o1 = components<S>(out1);
+
+		for(int x = 0; x < blocks; x++)
+			for(int c = 0; c < C; c++)
+			{
+				const int i = 3 * C * x + c;
+				const A a = r0[i], b = r0[i + C], cc = r0[i + 2 * C];
+				const A d = r1[i], e = r1[i + C], f = r1[i + 2 * C];
+				const A g = r2[i], h = r2[i + C], k = r2[i + 2 * C];
+
+				const int j = 2 * C * x + c;
+				o0[j] = static_cast<S>((a * 4 + b * 2 + d * 2 + e) / 9);
+				o0[j + C] = static_cast<S>((cc * 4 + b * 2 + f * 2 + e) / 9);
+				o1[j] = static_cast<S>((g * 4 + h * 2 + d * 2 + e) / 9);
+				o1[j + C] = static_cast<S>((k * 4 + h * 2 + f * 2 + e) / 9);
+			}
+	}
+
+	template <class T>
+	void two_thirds_sample(const BasicImage<T>& in, BasicImage<T>& out)
+	{
+		if((in.size() / 3 * 2) != out.size())
+			throw Exceptions::Vision::IncompatibleImageSizes("twoThirdsSample");
+
+		const int h = in.size().y / 3;
+		internal::Slice(h, internal::SliceHeight(h, 16), [&](int, int y0, int rows) {
+			for(int y = y0; y < y0 + rows; y++)
+				two_thirds_sample_rows(in[3 * y], in[3 * y + 1], in[3 * y + 2], out[2 * y], out[2 * y + 1], in.size().x / 3);
+		});
+	}
+
+	// An output row from the two rows of a Bayer image whose red pixel is at
+	// (rx, ry) in each 2x2 cell.
+	template <class B, class S>
+	void bin_bayer_row(const B* row0, const B* row1, Rgb<S>* out_row, int w, int rx, int ry)
+	{
+		static_assert(sizeof(B) == sizeof(S), "Bayer pixels must be a single component");
+		typedef typename conditional<sizeof(S) == 1, unsigned short, unsigned int>::type A;
+
+		const S* red_row = components<const S>(ry == 0 ? row0 : row1);
+		const S* blue_row = components<const S>(ry == 0 ? row1 : row0);
+		const S* red = red_row + rx;
+		const S* green1 = red_row + 1 - rx;
+		const S* green2 = blue_row + rx;
+		const S* blue = blue_row + 1 - rx;
+		S* o = components<S>(out_row);
+		for(int x = 0; x < w; x++)
+		{
+			o[3 * x] = red[2 * x];
+			o[3 * x + 1] = static_cast<S>((A(green1[2 * x]) + green2[2 * x] + 1) / 2);
+			o[3 * x + 2] = blue[2 * x];
+		}
+	}
+
+	template <class B, class S>
+	void bin_bayer(const BasicImage<B>& in, BasicImage<Rgb<S>>& out, int rx, int ry)
+	{
+		if((in.size() / 2) != out.size())
+			throw Exceptions::Vision::IncompatibleImageSizes("halfSample");
+
+		internal::Slice(out.size().y, internal::SliceHeight(out.size().y, 16), [&](int, int y0, int rows) {
+			for(int y = y0; y < y0 + rows; y++)
+				bin_bayer_row(in[2 * y], in[2 * y + 1], out[y], out.size().x, rx, ry);
+		});
+	}
+}
+
+void halfSample(const BasicImage<Rgb<byte>>& in, BasicImage<Rgb<byte>>& out)
+{
+	half_sample(in, out);
+}
+
+void halfSample(const BasicImage<Rgba<byte>>& in, BasicImage<Rgba<byte>>& out)
+{
+	half_sample(in, out);
+}
+
+void halfSample(const BasicImage<unsigned short>& in, BasicImage<unsigned short>& out)
+{
+	half_sample(in, out);
+}
+
+void halfSample(const BasicImage<float>& in, BasicImage<float>& out)
+{
+	half_sample(in, out);
+}
+
+void twoThirdsSample(const BasicImage<Rgb<byte>>& in, BasicImage<Rgb<byte>>& out)
+{
+	two_thirds_sample(in, out);
+}
+
+void twoThirdsSample(const BasicImage<Rgba<byte>>& in, BasicImage<Rgba<byte>>& out)
+{
+	two_thirds_sample(in, out);
+}
+
+void twoThirdsSample(const BasicImage<unsigned short>& in, BasicImage<unsigned short>& out)
+{
+	two_thirds_sample(in, out);
+}
+
+void twoThirdsSample(const BasicImage<float>& in, BasicImage<float>& out)
+{
+	two_thirds_sample(in, out);
+}
+
+void halfSample(const BasicImage<bayer_rggb>& in, BasicImage<Rgb<byte>>& out)
+{
+	bin_bayer(in, out, 0, 0);
+}
+
+void halfSample(const BasicImage<bayer_grbg>& in, BasicImage<Rgb<byte>>& out)
+{
+	bin_bayer(in, out, 1, 0);
+}
+
+void halfSample(const BasicImage<bayer_gbrg>& in, BasicImage<Rgb<byte>>& out)
+{
+	bin_bayer(in, out, 0, 1);
+}
+
+void halfSample(const BasicImage<bayer_bggr>& in, BasicImage<Rgb<byte>>& out)
+{
+	bin_bayer(in, out, 1, 1);
+}
+
+void halfSample(const BasicImage<bayer_rggb16>& in, BasicImage<Rgb<unsigned short>>& out)
+{
+	bin_bayer(in, out, 0, 0);
+}
+
+void halfSample(const BasicImage<bayer_grbg16>& in, BasicImage<Rgb<unsigned short>>& out)
+{
+	bin_bayer(in, out, 1, 0);
+}
+
+void halfSample(const BasicImage<bayer_gbrg16>& in, BasicImage<Rgb<unsigned short>>& out)
+{
+	bin_bayer(in, out, 0, 1);
+}
+
+void halfSample(const BasicImage<bayer_bggr16>& in, BasicImage<Rgb<unsigned short>>& out)
+{
+	bin_bayer(in, out, 1, 1);
+}
+
+}
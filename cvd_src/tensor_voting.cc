@@ -1,10 +1,25 @@
 #include <TooN/TooN.h>
 #include <TooN/helpers.h>
 #include <cvd/image.h>
+#include <cvd/internal/slice.h>
 #include <cvd/tensor_voting.h>
+#include <cvd/vision_exceptions.h>
+#include <algorithm>
+#include <cmath>
 #include <utility>
 #include <vector>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CVD_TENSOR_VOTING_AVX
+#define CVD_TENSOR_VOTING_INLINE __attribute__((always_inline)) inline
+#include <immintrin.h>
+#else
+#define CVD_TENSOR_VOTING_INLINE inline
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#endif
+
 using namespace TooN;
 using namespace std;
 
@@ -111,4 +126,275 @@ namespace TensorVoting
 		return ret;
 	}
 }
+
+// Tensor voting on three planes of floats.
+//
+// Each kernel is stored as rows of fixed size chunks of values, covering the
+// elements above the cutoff, with zeros elsewhere. Casting a vote is a loop
+// over the chunks of each row, and adding a chunk is one AVX instruction of
+// each kind, or two SSE ones. With GCC and Clang on x86 the AVX version is
+// built alongside the rest and used if the processor has it.
+//
+// The field is split in to bands of rows. A band takes the voters within
+// the kernel radius of it and adds the rows of their kernels which land in
+// it, so the bands can be filled in parallel without accumulators per
+// thread. The band is built in a buffer wide enough that the votes never
+// need clipping at the sides. The votes at a pixel are always added in
+// raster order of the voters, so the result does not depend on the bands.
+namespace
+{
+	using TensorVoting::TV_coord;
+
+	const int chunk = 8;
+
+	struct Voter
+	{
+		int x, y;
+		unsigned int direction;
+		float scale;
+	};
+
+	class ChunkKernel
+	{
+		public:
+		ChunkKernel()
+		{
+		}
+
+		ChunkKernel(int radius, double cutoff, double angle, double sigma, double ratio)
+		    : stride(row_stride(radius))
+		    , start(2 * radius + 1, 0)
+		    , length(2 * radius + 1, 0)
+		    , xx(static_cast<size_t>(stride) * (2 * radius + 1), 0)
+		    , xy(xx.size(), 0)
+		    , yy(xx.size(), 0)
+		{
+			// The elements come in raster order, so the first of each row
+			// is where its chunks start.
+			const vector<pair<TV_coord, Matrix<2>>> elements = TensorVoting::compute_a_tensor_kernel(radius, cutoff, angle, sigma, ratio, 0);
+			for(size_t i = 0; i < elements.size(); i++)
+			{
+				const int row = elements[i].first.y + radius;
+				const int column = elements[i].first.x + radius;
+				if(i == 0 || elements[i - 1].first.y != elements[i].first.y)
+					start[row] = column;
+				length[row] = column - start[row] + 1;
+
+				const size_t j = static_cast<size_t>(row) * stride + column - start[row];
+				xx[j] = static_cast<float>(elements[i].second[0][0]);
+				xy[j] = static_cast<float>(elements[i].second[0][1]);
+				yy[j] = static_cast<float>(elements[i].second[1][1]);
+			}
+
+			for(int& l : length)
+				l = (l + chunk - 1) / chunk * chunk;
+		}
+
+		// Enough room for a row of a kernel rounded up to whole chunks.
+		static int row_stride(int radius)
+		{
+			return (2 * radius + chunk) / chunk * chunk;
+		}
+
+		int stride;
+
+		// The column at which the values of each row start, and their
+		// number rounded up to whole chunks.
+		vector<int> start, length;
+		vector<float> xx, xy, yy;
+	};
+
+	// The instruction sets which add_chunk() is written for. Baseline is
+	// whatever the library is compiled for.
+	struct Baseline
+	{
+	};
+
+	struct AVX
+	{
+	};
+
+	// Add s times a chunk of kernel values to a plane. The values are
+	// loaded first, since the plane could alias them as far as the compiler
+	// knows.
+	inline void add_chunk(Baseline, float* plane, const float* kernel, float s)
+	{
+#if defined(__SSE2__)
+		const __m128 k0 = _mm_loadu_ps(kernel), k1 = _mm_loadu_ps(kernel + 4);
+		const __m128 v = _mm_set1_ps(s);
+		_mm_storeu_ps(plane, _mm_add_ps(_mm_loadu_ps(plane), _mm_mul_ps(v, k0)));
+		_mm_storeu_ps(plane + 4, _mm_add_ps(_mm_loadu_ps(plane + 4), _mm_mul_ps(v, k1)));
+#else
+		float k[chunk];
+		for(int i = 0; i < chunk; i++)
+			k[i] = kernel[i];
+		for(int i = 0; i < chunk; i++)
+			plane[i] += s * k[i];
+#endif
+	}
+
+#ifdef CVD_TENSOR_VOTING_AVX
+	__attribute__((target("avx"))) inline void add_chunk(AVX, float* plane, const float* kernel, float s)
+	{
+		const __m256 k = _mm256_loadu_ps(kernel);
+		_mm256_storeu_ps(plane, _mm256_add_ps(_mm256_loadu_ps(plane), _mm256_mul_ps(_mm256_set1_ps(s), k)));
+	}
+#endif
+
+	// The planes of a band of the field, where column x of the image is
+	// column x + radius of the band.
+	struct Band
+	{
+		int y0, y1, stride;
+		float *xx, *xy, *yy;
+	};
+
+	// Add the votes of the voters in [begin, end) which land in a band. This
+	// is inlined in to a version for each instruction set, so that
+	// add_chunk() is inlined in to it in turn.
+	template <class Arch>
+	CVD_TENSOR_VOTING_INLINE void cast_votes(const Voter* begin, const Voter* end, const vector<ChunkKernel>& kernels, int radius, const Band& band)
+	{
+		for(const Voter* v = begin; v != end; v++)
+		{
+			const ChunkKernel& k = kernels[v->direction];
+			for(int y = max(band.y0, v->y - radius); y < min(band.y1, v->y + radius + 1); y++)
+			{
+				const int row = y - v->y + radius;
+				const size_t b = static_cast<size_t>(y - band.y0) * band.stride + v->x + k.start[row];
+				const size_t o = static_cast<size_t>(row) * k.stride;
+				for(int c = 0; c < k.length[row]; c += chunk)
+				{
+					add_chunk(Arch(), band.xx + b + c, &k.xx[o + c], v->scale);
+					add_chunk(Arch(), band.xy + b + c, &k.xy[o + c], v->scale);
+					add_chunk(Arch(), band.yy + b + c, &k.yy[o + c], v->scale);
+				}
+			}
+		}
+	}
+
+	void cast_votes_baseline(const Voter* begin, const Voter* end, const vector<ChunkKernel>& kernels, int radius, const Band& band)
+	{
+		cast_votes<Baseline>(begin, end, kernels, radius, band);
+	}
+
+#ifdef CVD_TENSOR_VOTING_AVX
+	__attribute__((target("avx"))) void cast_votes_avx(const Voter* begin, const Voter* end, const vector<ChunkKernel>& kernels, int radius, const Band& band)
+	{
+		cast_votes<AVX>(begin, end, kernels, radius, band);
+	}
+#endif
+
+	// The fastest version of cast_votes() which the processor can run.
+	decltype(&cast_votes_baseline) pick_cast_votes()
+	{
+#ifdef CVD_TENSOR_VOTING_AVX
+		if(__builtin_cpu_supports("avx"))
+			return cast_votes_avx;
+#endif
+		return cast_votes_baseline;
+	}
+
+	template <class C>
+	void tensor_vote(const BasicImage<C>& image, double sigma, double ratio, double threshold, TensorField& field, double cutoff, unsigned int num_divs)
+	{
+		if(!(sigma > 0) || !(cutoff > 0 && cutoff < 1) || num_divs == 0)
+			throw Exceptions::Vision::BadInput("tensor_vote_gradients");
+
+		const int w = image.size().x;
+		const int h = image.size().y;
+		for(Image<float>* plane : { &field.xx, &field.xy, &field.yy })
+		{
+			plane->resize(image.size());
+			plane->zero();
+		}
+		if(w < 3 || h < 3)
+			return;
+
+		const int radius = static_cast<int>(ceil(sigma * sqrt(-log(cutoff))));
+		const int band = internal::SliceHeight(h, 16);
+
+		// Find the voters, in raster order.
+		vector<vector<Voter>> band_voters((h + band - 1) / band);
+		internal::Slice(h, band, [&](int b, int y0, int rows) {
+			for(int y = max(1, y0); y < min(h - 1, y0 + rows); y++)
+				for(int x = 1; x < w - 1; x++)
+				{
+					const double gx = (static_cast<double>(image[y][x + 1]) - image[y][x - 1]) / 2.;
+					const double gy = (static_cast<double>(image[y + 1][x]) - image[y - 1][x]) / 2.;
+					const double scale = sqrt(gx * gx + gy * gy);
+					if(scale > threshold)
+						band_voters[b].push_back(Voter { x, y, TensorVoting::quantize_half_angle(M_PI / 2 + atan2(gy, gx), num_divs), static_cast<float>(scale) });
+				}
+		});
+
+		vector<Voter> voters;
+		for(const vector<Voter>& v : band_voters)
+			voters.insert(voters.end(), v.begin(), v.end());
+
+		// The index of the first voter in each row.
+		vector<size_t> first_in_row(h + 1, voters.size());
+		for(size_t i = voters.size(); i-- > 0;)
+			first_in_row[voters[i].y] = i;
+		for(int y = h - 1; y >= 0; y--)
+			first_in_row[y] = min(first_in_row[y], first_in_row[y + 1]);
+
+		// Build the kernels for the directions which occur.
+		vector<char> used(num_divs, 0);
+		for(const Voter& v : voters)
+			used[v.direction] = 1;
+		vector<unsigned int> directions;
+		for(unsigned int d = 0; d < num_divs; d++)
+			if(used[d])
+				directions.push_back(d);
+
+		vector<ChunkKernel> kernels(num_divs);
+		const int n = static_cast<int>(directions.size());
+		internal::Slice(n, internal::SliceHeight(n), [&](int, int i0, int count) {
+			for(int i = i0; i < i0 + count; i++)
+				kernels[directions[i]] = ChunkKernel(radius, cutoff, M_PI * directions[i] / num_divs, sigma, ratio);
+		});
+
+		// A vote from column x starts at column x of the band buffer. The
+		// last chunk of a row can reach chunk - 1 columns beyond the kernel.
+		static const auto cast_votes_here = pick_cast_votes();
+		const int stride = w + 2 * radius + chunk;
+		internal::Slice(h, band, [&](int, int y0, int rows) {
+			const int y1 = y0 + rows;
+			vector<float> xx(static_cast<size_t>(rows) * stride), xy(xx.size()), yy(xx.size());
+
+			const Voter* const v = voters.data();
+			cast_votes_here(v + first_in_row[max(0, y0 - radius)], v + first_in_row[min(h, y1 + radius)], kernels, radius, Band { y0, y1, stride, xx.data(), xy.data(), yy.data() });
+
+			for(int y = y0; y < y1; y++)
+			{
+				const size_t b = static_cast<size_t>(y - y0) * stride + radius;
+				std::copy(&xx[b], &xx[b] + w, field.xx[y]);
+				std::copy(&xy[b], &xy[b] + w, field.xy[y]);
+				std::copy(&yy[b], &yy[b] + w, field.yy[y]);
+			}
+		});
+	}
+}
+
+void dense_tensor_vote_gradients(const BasicImage<byte>& image, double sigma, double ratio, TensorField& field, double cutoff, unsigned int num_divs)
+{
+	tensor_vote(image, sigma, ratio, 0, field, cutoff, num_divs);
+}
+
+void dense_tensor_vote_gradients(const BasicImage<float>& image, double sigma, double ratio, TensorField& field, double cutoff, unsigned int num_divs)
+{
+	tensor_vote(image, sigma, ratio, 0, field, cutoff, num_divs);
+}
+
+void sparse_tensor_vote_gradients(const BasicImage<byte>& image, double sigma, double ratio, double threshold, TensorField& field, double cutoff, unsigned int num_divs)
+{
+	tensor_vote(image, sigma, ratio, threshold, field, cutoff, num_divs);
+}
+
+void sparse_tensor_vote_gradients(const BasicImage<float>& image, double sigma, double ratio, double threshold, TensorField& field, double cutoff, unsigned int num_divs)
+{
+	tensor_vote(image, sigma, ratio, threshold, field, cutoff, num_divs);
+}
+
 }
@@ -0,0 +1,363 @@
+#include "cvd/vision.h"
+#include "cvd/internal/pixel_traits.h"
+#include "cvd/internal/rgb_components.h"
+#include "cvd/internal/slice.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+namespace CVD
+{
+
+// Affine and projective warps of whole images.
+//
+// The point in the source image is a linear function of the position along
+// an output row, so each row needs only its start and the step along it.
+// The coordinates of a block of the row are the start plus a multiple of the
+// step, which is a loop the compiler vectorises, and the projective warp
+// steps the homogeneous coordinates and divides each point by its own.
+//
+// The coordinates are then limited to just around the image, which keeps the
+// conversion to int defined and takes NaN outside, and turned in to whole
+// pixels and weights. Bilinear interpolation of byte images is done in fixed
+// point with weights in 1/256 of a pixel, and everything else in float. The
+// pixels around each point are gathered a point at a time, clamped to the
+// image, and the interpolation and the selection of the default value for
+// points outside the image are vectorised loops over the block. The image is
+// warped in bands of rows on multiple threads.
+namespace
+{
+	const int block = 64;
+
+	class Affine
+	{
+		public:
+		explicit Affine(const double (&m)[2][3])
+		    : m(m)
+		{
+		}
+
+		void points(int y, int x0, int n, double* x, double* yy) const
+		{
+			const double bx = m[0][0] * x0 + m[0][1] * y + m[0][2];
+			const double by = m[1][0] * x0 + m[1][1] * y + m[1][2];
+			const double ax = m[0][0], ay = m[1][0];
+			for(int i = 0; i < n; i++)
+			{
+				x[i] = bx + ax * i;
+				yy[i] = by + ay * i;
+			}
+		}
+
+		private:
+		const double (&m)[2][3];
+	};
+
+	// Points which map to or behind the line at infinity are made NaN, which is
+	// outside the image.
+	class Homography
+	{
+		public:
+		explicit Homography(const double (&m)[3][3])
+		    : m(m)
+		{
+		}
+
+		void points(int y, int x0, int n, double* x, double* yy) const
+		{
+			const double bx = m[0][0] * x0 + m[0][1] * y + m[0][2];
+			const double by = m[1][0] * x0 + m[1][1] * y + m[1][2];
+			const double bw = m[2][0] * x0 + m[2][1] * y + m[2][2];
+			const double ax = m[0][0], ay = m[1][0], aw = m[2][0];
+			for(int i = 0; i < n; i++)
+			{
+				const double w = bw + aw * i;
+				const double behind = w > 0 ? 0 : NAN;
+				x[i] = (bx + ax * i) / w + behind;
+				yy[i] = (by + ay * i) / w + behind;
+			}
+		}
+
+		private:
+		const double (&m)[3][3];
+	};
+
+	// The whole pixels below the limited coordinates, and the fractions past
+	// them. A point is in the image if it lies in [0, w-1] x [0, h-1].
+	void split(const double* x, const double* y, int n, int w, int h, int* xi, int* yi, float* fx, float* fy, int* ok)
+	{
+		for(int i = 0; i < n; i++)
+		{
+			const double cx = min(w + 4.0, max(-4.0, x[i]));
+			const double cy = min(h + 4.0, max(-4.0, y[i]));
+			const int ix = static_cast<int>(cx + 8) - 8;
+			const int iy = static_cast<int>(cy + 8) - 8;
+			fx[i] = static_cast<float>(cx - ix);
+			fy[i] = static_cast<float>(cy - iy);
+			const int in_x = (ix >= 0) & ((ix < w - 1) | ((ix == w - 1) & (fx[i] == 0)));
+			const int in_y = (iy >= 0) & ((iy < h - 1) | ((iy == h - 1) & (fy[i] == 0)));
+			ok[i] = in_x & in_y;
+			xi[i] = ok[i] ? ix : 0;
+			yi[i] = ok[i] ? iy : 0;
+		}
+	}
+
+	// As split(), with the fractions rounded to 1/256 of a pixel.
+	void split_fixed(const double* x, const double* y, int n, int w, int h, int* xi, int* yi, int* fx, int* fy, int* ok)
+	{
+		for(int i = 0; i < n; i++)
+		{
+			const double cx = min(w + 4.0, max(-4.0, x[i]));
+			const double cy = min(h + 4.0, max(-4.0, y[i]));
+			const int vx = static_cast<int>((cx + 8) * 256 + 0.5) - 8 * 256;
+			const int vy = static_cast<int>((cy + 8) * 256 + 0.5) - 8 * 256;
+			ok[i] = (vx >= 0) & (vx <= (w - 1) * 256) & (vy >= 0) & (vy <= (h - 1) * 256);
+			const int sx = ok[i] ? vx : 0;
+			const int sy = ok[i] ? vy : 0;
+			xi[i] = sx >> 8;
+			yi[i] = sy >> 8;
+			fx[i] = sx & 255;
+			fy[i] = sy & 255;
+		}
+	}
+
+	// The nearest pixel, rounding halves up.
+	void split_nearest(const double* x, const double* y, int n, int w, int h, int* xi, int* yi, int* ok)
+	{
+		for(int i = 0; i < n; i++)
+		{
+			const double cx = min(w + 4.0, max(-4.0, x[i]));
+			const double cy = min(h + 4.0, max(-4.0, y[i]));
+			const int ix = static_cast<int>(cx + 8.5) - 8;
+			const int iy = static_cast<int>(cy + 8.5) - 8;
+			ok[i] = (ix >= 0) & (ix < w) & (iy >= 0) & (iy < h);
+			xi[i] = ok[i] ? ix : 0;
+			yi[i] = ok[i] ? iy : 0;
+		}
+	}
+
+	// The Taps x Taps pixels around each point of a block, starting (Taps - 1) / 2
+	// up and to the left, with each channel in its own arrays.
+	template <class T, class V, int Taps>
+	void gather(const BasicImage<T>& in, const int* xi, const int* yi, int n, V (&v)[Pixel::Component<T>::count][Taps][Taps][block])
+	{
+		typedef Pixel::Component<T> Pix;
+		const int channels = Pix::count;
+		const int w = in.size().x;
+		const int h = in.size().y;
+		const int offset = (Taps - 1) / 2;
+		for(int i = 0; i < n; i++)
+		{
+			int cols[Taps];
+			for(int c = 0; c < Taps; c++)
+				cols[c] = min(w - 1, max(0, xi[i] - offset + c));
+			for(int r = 0; r < Taps; r++)
+			{
+				const T* p = in[min(h - 1, max(0, yi[i] - offset + r))];
+				for(int c = 0; c < Taps; c++)
+					for(int k = 0; k < channels; k++)
+						v[k][r][c][i] = Pix::get(p[cols[c]], k);
+			}
+		}
+	}
+
+	void interpolate(const int* fx, const int* fy, const int (&v)[2][2][block], int n, int* result)
+	{
+		for(int i = 0; i < n; i++)
+		{
+			const int top = v[0][0][i] * (256 - fx[i]) + v[0][1][i] * fx[i];
+			const int bottom = v[1][0][i] * (256 - fx[i]) + v[1][1][i] * fx[i];
+			result[i] = (top * (256 - fy[i]) + bottom * fy[i] + 32768) >> 16;
+		}
+	}
+
+	void interpolate(const float* fx, const float* fy, const float (&v)[2][2][block], int n, float* result)
+	{
+		for(int i = 0; i < n; i++)
+		{
+			const float top = v[0][0][i] + fx[i] * (v[0][1][i] - v[0][0][i]);
+			const float bottom = v[1][0][i] + fx[i] * (v[1][1][i] - v[1][0][i]);
+			result[i] = top + fy[i] * (bottom - top);
+		}
+	}
+
+	// The kernel of image_interpolate<Interpolate::Bicubic, T>, as in sample_bicubic().
+	void interpolate(const float* fx, const float* fy, const float (&v)[4][4][block], int n, float* result)
+	{
+		for(int i = 0; i < n; i++)
+		{
+			const float gx = 1 - fx[i], fx2 = fx[i] * fx[i], fx3 = fx2 * fx[i];
+			const float gy = 1 - fy[i], fy2 = fy[i] * fy[i], fy3 = fy2 * fy[i];
+			const float wx0 = gx * gx * gx / 6, wx1 = (4 - 6 * fx2 + 3 * fx3) / 6, wx2 = (1 + 3 * fx[i] + 3 * fx2 - 3 * fx3) / 6, wx3 = fx3 / 6;
+			const float wy0 = gy * gy * gy / 6, wy1 = (4 - 6 * fy2 + 3 * fy3) / 6, wy2 = (1 + 3 * fy[i] + 3 * fy2 - 3 * fy3) / 6, wy3 = fy3 / 6;
+			result[i] = wy0 * (wx0 * v[0][0][i] + wx1 * v[0][1][i] + wx2 * v[0][2][i] + wx3 * v[0][3][i])
+			    + wy1 * (wx0 * v[1][0][i] + wx1 * v[1][1][i] + wx2 * v[1][2][i] + wx3 * v[1][3][i])
+			    + wy2 * (wx0 * v[2][0][i] + wx1 * v[2][1][i] + wx2 * v[2][2][i] + wx3 * v[2][3][i])
+			    + wy3 * (wx0 * v[3][0][i] + wx1 * v[3][1][i] + wx2 * v[3][2][i] + wx3 * v[3][3][i]);
+		}
+	}
+
+	// Bytes from float results, rounded. The weights of the kernel are positive
+	// and sum to one, so the results are in range.
+	void to_pixels(const float* r, int n, int* result)
+	{
+		for(int i = 0; i < n; i++)
+			result[i] = static_cast<int>(r[i] + 0.5f);
+	}
+
+	void to_pixels(const float* r, int n, float* result)
+	{
+		for(int i = 0; i < n; i++)
+			result[i] = r[i];
+	}
+
+	template <class T>
+	class Warper
+	{
+		typedef Pixel::Component<T> Pix;
+		typedef typename Pix::type S;
+		static const int channels = Pix::count;
+
+		// Bytes are interpolated as ints.
+		typedef typename conditional<is_floating_point<S>::value, S, int>::type V;
+
+		public:
+		Warper(const BasicImage<T>& in, WarpInterpolation interpolation, const T& default_value)
+		    : in(in)
+		    , interpolation(interpolation)
+		{
+			for(int c = 0; c < channels; c++)
+				fallback[c] = Pix::get(default_value, c);
+		}
+
+		// Warp n pixels of a row from their points in the source.
+		void row(const double* x, const double* y, int* ok, int n, T* out)
+		{
+			const int w = in.size().x;
+			const int h = in.size().y;
+
+			if(interpolation == WarpInterpolation::Nearest)
+			{
+				split_nearest(x, y, n, w, h, xi, yi, ok);
+				gather(in, xi, yi, n, nearest);
+				for(int c = 0; c < channels; c++)
+					std::copy(nearest[c][0][0], nearest[c][0][0] + n, result[c]);
+			}
+			else if(interpolation == WarpInterpolation::Bicubic)
+			{
+				split(x, y, n, w, h, xi, yi, fx, fy, ok);
+				gather(in, xi, yi, n, cubic);
+				for(int c = 0; c < channels; c++)
+				{
+					float r[block];
+					interpolate(fx, fy, cubic[c], n, r);
+					to_pixels(r, n, result[c]);
+				}
+			}
+			else if constexpr(is_floating_point<S>::value)
+			{
+				split(x, y, n, w, h, xi, yi, fx, fy, ok);
+				gather(in, xi, yi, n, linear);
+				for(int c = 0; c < channels; c++)
+					interpolate(fx, fy, linear[c], n, result[c]);
+			}
+			else
+			{
+				split_fixed(x, y, n, w, h, xi, yi, wx, wy, ok);
+				gather(in, xi, yi, n, linear);
+				for(int c = 0; c < channels; c++)
+					interpolate(wx, wy, linear[c], n, result[c]);
+			}
+
+			for(int c = 0; c < channels; c++)
+			{
+				const V d = fallback[c];
+				V* r = result[c];
+				for(int i = 0; i < n; i++)
+					r[i] = ok[i] ? r[i] : d;
+			}
+
+			for(int i = 0; i < n; i++)
+				for(int c = 0; c < channels; c++)
+					Pix::get(out[i], c) = static_cast<S>(result[c][i]);
+		}
+
+		private:
+		const BasicImage<T>& in;
+		WarpInterpolation interpolation;
+		V fallback[channels];
+
+		int xi[block], yi[block], wx[block], wy[block];
+		float fx[block], fy[block];
+		V nearest[channels][1][1][block];
+		V linear[channels][2][2][block];
+		float cubic[channels][4][4][block];
+		V result[channels][block];
+	};
+
+	template <class T, class Map>
+	int warp_image(const BasicImage<T>& in, BasicImage<T>& out, const Map& map, WarpInterpolation interpolation, const T& default_value)
+	{
+		const int w = out.size().x;
+		const int h = out.size().y;
+		if(in.size().x == 0 || in.size().y == 0)
+		{
+			out.fill(default_value);
+			return w * h;
+		}
+
+		const int band = internal::SliceHeight(h, 16);
+		vector<int> outside((h + band - 1) / band, 0);
+		internal::Slice(h, band, [&](int b, int y0, int rows) {
+			Warper<T> warper(in, interpolation, default_value);
+			double x[block], y[block];
+			int ok[block];
+			for(int r = y0; r < y0 + rows; r++)
+				for(int x0 = 0; x0 < w; x0 += block)
+				{
+					const int n = min(block, w - x0);
+					map.points(r, x0, n, x, y);
+					warper.row(x, y, ok, n, out[r] + x0);
+					outside[b] += n - accumulate(ok, ok + n, 0);
+				}
+		});
+		return accumulate(outside.begin(), outside.end(), 0);
+	}
+}
+
+int warp_affine(const BasicImage<byte>& in, BasicImage<byte>& out, const double (&M)[2][3], WarpInterpolation interpolation, byte default_value)
+{
+	return warp_image(in, out, Affine(M), interpolation, default_value);
+}
+
+int warp_affine(const BasicImage<Rgb<byte>>& in, BasicImage<Rgb<byte>>& out, const double (&M)[2][3], WarpInterpolation interpolation, Rgb<byte> default_value)
+{
+	return warp_image(in, out, Affine(M), interpolation, default_value);
+}
+
+int warp_affine(const BasicImage<float>& in, BasicImage<float>& out, const double (&M)[2][3], WarpInterpolation interpolation, float default_value)
+{
+	return warp_image(in, out, Affine(M), interpolation, default_value);
+}
+
+int warp_homography(const BasicImage<byte>& in, BasicImage<byte>& out, const double (&H)[3][3], WarpInterpolation interpolation, byte default_value)
+{
+	return warp_image(in, out, Homography(H), interpolation, default_value);
+}
+
+int warp_homography(const BasicImage<Rgb<byte>>& in, BasicImage<Rgb<byte>>& out, const double (&H)[3][3], WarpInterpolation interpolation, Rgb<byte> default_value)
+{
+	return warp_image(in, out, Homography(H), interpolation, default_value);
+}
+
+int warp_homography(const BasicImage<float>& in, BasicImage<float>& out, const double (&H)[3][3], WarpInterpolation interpolation, float default_value)
+{
+	return warp_image(in, out, Homography(H), interpolation, default_value);
+}
+
+}
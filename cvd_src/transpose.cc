@@ -0,0 +1,48 @@
+#include "cvd/vision.h"
+#include "cvd/internal/slice.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace CVD
+{
+
+// Transposing images of small pixels.
+//
+// The image is split in to blocks small enough that the rows of a block of the
+// input and of the output all stay in the cache while the block is done, and
+// transposeBlock(), which is specific to the architecture, transposes each one
+// in tiles, a whole tile at a time in registers. Rows of the input are split
+// in to bands on multiple threads, which write to separate columns of the
+// output.
+//
+// The strides may be negative, in which case the rows are taken from the
+// bottom up. Reversing the rows of the input or of the output turns the
+// transpose in to a rotation.
+namespace
+{
+	const int block = 64;
+}
+
+namespace Internal
+{
+	void transposeBytes(const unsigned char* in, ptrdiff_t in_stride, unsigned char* out, ptrdiff_t out_stride, ImageRef size, int bytes)
+	{
+		auto transpose_rows = [&](int, int y0, int rows) {
+			for(int y = y0; y < y0 + rows; y += block)
+				for(int x = 0; x < size.x; x += block)
+					transposeBlock(in + y * in_stride + x * bytes, in_stride, out + x * out_stride + y * bytes, out_stride, min(block, size.x - x), min(block, y0 + rows - y), bytes);
+		};
+
+		// Bands are whole blocks. Small images are not worth starting a thread
+		// for.
+		const int band = (internal::SliceHeight(size.y, block) + block - 1) / block * block;
+		if(band >= size.y)
+			transpose_rows(0, 0, size.y);
+		else
+			internal::Slice(size.y, band, transpose_rows);
+	}
+}
+
+}
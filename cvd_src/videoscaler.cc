@@ -1,6 +1,6 @@
 #include "cvd/videoscaler.h"
 
-#include "slice.h"
+#include "cvd/internal/slice.h"
 
 extern "C"
 {
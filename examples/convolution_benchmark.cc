@@ -0,0 +1,79 @@
+// Compares the compile time kernels (convolveSeparableFixed, convolveFixed)
+// against the equivalent runtime sized convolutions.
+#include <cvd/convolution.h>
+#include <cvd/rgb.h>
+#include <cvd/timer.h>
+#include <cvd/vision.h>
+
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace CVD;
+using namespace CVD::FixedKernels;
+using std::cout;
+using std::string;
+using std::vector;
+
+template <class F>
+void benchmark(const string& name, int repeats, F f)
+{
+	cvd_timer timer;
+	for(int i = 0; i < repeats; i++)
+		f();
+	cout << std::setw(50) << std::left << name << timer.get_time() / repeats * 1000 << " ms\n";
+}
+
+int main()
+{
+	const ImageRef size(1920, 1080);
+	const int repeats = 10;
+	std::mt19937 engine;
+	std::uniform_int_distribution<int> value(0, 255);
+
+	Image<byte> b(size), bo(size);
+	Image<short> so(size);
+	Image<float> f(size), fo(size);
+	Image<Rgb<byte>> c(size), co(size);
+
+	for(int y = 0; y < size.y; y++)
+		for(int x = 0; x < size.x; x++)
+		{
+			b[y][x] = value(engine);
+			f[y][x] = b[y][x] / 255.f;
+			c[y][x] = Rgb<byte>(value(engine), value(engine), value(engine));
+		}
+
+	cout << "byte, 5 tap Gaussian\n";
+	benchmark("  convolveGaussian5_1 (in place)", repeats, [&] { bo.copy_from(b); convolveGaussian5_1(bo); });
+	benchmark("  convolveSeparableFixed<Gaussian5, Gaussian5>", repeats, [&] { convolveSeparableFixed<Gaussian5, Gaussian5>(b, bo); });
+
+	cout << "float, [1 4 6 4 1]/16\n";
+	vector<float> binomial5 = { 1, 4, 6, 4, 1 };
+	benchmark("  convolveSeparableSymmetric (in place)", repeats, [&] { fo.copy_from(f); convolveSeparableSymmetric(fo, binomial5, 16.f); });
+	benchmark("  convolveSymmetric<float, 1, 4, 6> (in place)", repeats, [&] { fo.copy_from(f); convolveSymmetric<float, 1, 4, 6>(fo); });
+	benchmark("  convolveSeparableFixed<Binomial5, Binomial5>", repeats, [&] { convolveSeparableFixed<Binomial5, Binomial5>(f, fo); });
+
+	cout << "float, 3x3 Laplacian\n";
+	Image<float> laplacian(ImageRef(3, 3));
+	laplacian.zero();
+	laplacian[0][1] = laplacian[1][0] = laplacian[1][2] = laplacian[2][1] = 1;
+	laplacian[1][1] = -4;
+	benchmark("  convolve (runtime kernel, direct)", repeats, [&] { convolve(f, laplacian, fo, ConvolutionMethod::Direct); });
+	benchmark("  convolveFixed<Laplacian3x3>", repeats, [&] { convolveFixed<Laplacian3x3>(f, fo); });
+
+	cout << "byte to short, Sobel x\n";
+	Image<short[2]> grad(size);
+	benchmark("  gradient (central differences, both axes)", repeats, [&] { gradient(b, grad); });
+	benchmark("  convolveSeparableFixed<Difference3, Binomial3>", repeats, [&] { convolveSeparableFixed<Difference3, Binomial3>(b, so); });
+
+	cout << "Rgb<byte>, Gaussian\n";
+	benchmark("  generic convolveGaussian (sigma=1)", repeats, [&] { convolveGaussian<Rgb<byte>>(c, co, 1.0, 2.0); });
+	benchmark("  interleaved convolveGaussian (sigma=1)", repeats, [&] { convolveGaussian(c, co, 1.0, 2.0); });
+	benchmark("  convolveSeparableFixed<Binomial5, Binomial5>", repeats, [&] { convolveSeparableFixed<Binomial5, Binomial5>(c, co); });
+
+	cout << "Rgb<byte>, 5x5 box\n";
+	benchmark("  generic convolveWithBox", repeats, [&] { convolveWithBox<Rgb<byte>>(c, co, ImageRef(2, 2)); });
+	benchmark("  interleaved convolveWithBox", repeats, [&] { convolveWithBox(c, co, ImageRef(2, 2)); });
+}
@@ -0,0 +1,116 @@
+#include "test_utility.h"
+
+#include <cvd/camera.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using TooN::makeVector;
+using CVD::Testing::assert_near;
+using CVD::Testing::assert_vector_equal;
+using TooN::Vector;
+
+void assert_close(double expected, double actual, double tolerance, const std::string& what)
+{
+	assert_near(expected, actual, tolerance * std::max(1.0, std::abs(expected)), what);
+}
+
+// The batch functions give the same points as projecting one point at a
+// time, derivatives which match numerical ones, and work in place.
+template <class Camera>
+void check(const Camera& camera, const std::string& name, std::mt19937& engine)
+{
+	for(int n : { 0, 1, 63, 64, 150 })
+	{
+		const std::string what = name + ", " + std::to_string(n) + " points";
+		std::uniform_real_distribution<double> d(-0.6, 0.6);
+		std::vector<double> x(n), y(n);
+		for(int i = 0; i < n; i++)
+		{
+			x[i] = d(engine);
+			y[i] = d(engine);
+		}
+		if(n > 0)
+			x[0] = y[0] = 0;
+
+		std::vector<double> u(n), v(n), J(4 * n);
+		camera.project(x.data(), y.data(), n, u.data(), v.data(), J.data());
+
+		std::vector<double> xx(n), yy(n), K(4 * n);
+		camera.unproject(u.data(), v.data(), n, xx.data(), yy.data(), K.data());
+
+		for(int i = 0; i < n; i++)
+		{
+			const Vector<2> p = makeVector(x[i], y[i]);
+			const Vector<2> im = camera.project(p);
+			assert_close(im[0], u[i], 1e-12, what + ": project");
+			assert_close(im[1], v[i], 1e-12, what + ": project");
+
+			const double h = 1e-6;
+			const Vector<2> dx = (camera.project(p + makeVector(h, 0)) - camera.project(p - makeVector(h, 0))) / (2 * h);
+			const Vector<2> dy = (camera.project(p + makeVector(0, h)) - camera.project(p - makeVector(0, h))) / (2 * h);
+			assert_close(dx[0], J[i], 1e-6, what + ": derivative of project");
+			assert_close(dy[0], J[n + i], 1e-6, what + ": derivative of project");
+			assert_close(dx[1], J[2 * n + i], 1e-6, what + ": derivative of project");
+			assert_close(dy[1], J[3 * n + i], 1e-6, what + ": derivative of project");
+
+			const Vector<2> cam = camera.unproject(makeVector(u[i], v[i]));
+			assert_close(cam[0], xx[i], 1e-12, what + ": unproject");
+			assert_close(cam[1], yy[i], 1e-12, what + ": unproject");
+
+			// The derivatives of unprojection and projection are inverses.
+			const double a = K[i] * J[i] + K[n + i] * J[2 * n + i], b = K[i] * J[n + i] + K[n + i] * J[3 * n + i];
+			const double c = K[2 * n + i] * J[i] + K[3 * n + i] * J[2 * n + i], e = K[2 * n + i] * J[n + i] + K[3 * n + i] * J[3 * n + i];
+			assert_close(1, a, 1e-6, what + ": derivative of unproject");
+			assert_close(0, b, 1e-6, what + ": derivative of unproject");
+			assert_close(0, c, 1e-6, what + ": derivative of unproject");
+			assert_close(1, e, 1e-6, what + ": derivative of unproject");
+		}
+
+		// In place, and without derivatives.
+		std::vector<double> px = x, py = y;
+		camera.project(px.data(), py.data(), n, px.data(), py.data());
+		assert_vector_equal(u, px, what + ": project in place");
+		assert_vector_equal(v, py, what + ": project in place");
+		camera.unproject(px.data(), py.data(), n, px.data(), py.data());
+		assert_vector_equal(xx, px, what + ": unproject in place");
+		assert_vector_equal(yy, py, what + ": unproject in place");
+	}
+}
+
+int main()
+{
+	std::mt19937 engine;
+
+	CVD::Camera::Linear linear;
+	linear.get_parameters() = makeVector(500, 480, 320, 240);
+	check(linear, "Linear", engine);
+
+	CVD::Camera::Cubic cubic;
+	cubic.get_parameters() = makeVector(500, 480, 320, 240, -0.1);
+	check(cubic, "Cubic", engine);
+
+	CVD::Camera::Quintic quintic;
+	quintic.get_parameters() = makeVector(500, 480, 320, 240, -0.2, 0.05);
+	check(quintic, "Quintic", engine);
+
+	CVD::Camera::Harris harris;
+	harris.get_parameters() = makeVector(500, 480, 320, 240, 0.1);
+	check(harris, "Harris", engine);
+
+	CVD::Camera::SquareHarris square;
+	square.get_parameters() = makeVector(500, 0, 320, 240, -0.2);
+	check(square, "SquareHarris", engine);
+
+	CVD::Camera::ArcTan arctan;
+	arctan.get_parameters() = makeVector(500, 480, 320, 240, 0.8);
+	check(arctan, "ArcTan", engine);
+
+	CVD::Camera::OldCameraAdapter<CVD::Camera::Harris> adapted;
+	adapted.get_parameters() = harris.get_parameters();
+	check(adapted, "OldCameraAdapter<Harris>", engine);
+}
@@ -0,0 +1,187 @@
+#include "test_utility.h"
+
+#include <cvd/canny.h>
+#include <cvd/vision_exceptions.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using CVD::BasicImage;
+using CVD::Image;
+using CVD::ImageRef;
+using CVD::Testing::assert_equal;
+using CVD::Testing::assert_image_equal;
+
+// Sobel gradients, nonmaximal suppression along the nearest of four
+// directions, then a flood over the whole image from the strong pixels.
+Image<CVD::byte> naive_canny(const BasicImage<CVD::byte>& im, int lower, int upper)
+{
+	const ImageRef size = im.size();
+	Image<long long> mag(size, 0);
+	Image<int> bin(size, 0);
+	for(int y = 1; y < size.y - 1; y++)
+		for(int x = 1; x < size.x - 1; x++)
+		{
+			const int gx = im[y - 1][x + 1] + 2 * im[y][x + 1] + im[y + 1][x + 1] - im[y - 1][x - 1] - 2 * im[y][x - 1] - im[y + 1][x - 1];
+			const int gy = im[y + 1][x - 1] + 2 * im[y + 1][x] + im[y + 1][x + 1] - im[y - 1][x - 1] - 2 * im[y - 1][x] - im[y - 1][x + 1];
+			mag[y][x] = static_cast<long long>(gx) * gx + static_cast<long long>(gy) * gy;
+
+			// 0: horizontal, 1: (x-1, y-1) to (x+1, y+1), 2: vertical, 3: the other diagonal.
+			const long long ax = std::abs(gx), ay = std::abs(gy);
+			if(ay * 32768 < 13573 * ax)
+				bin[y][x] = 0;
+			else if(ax * 32768 < 13573 * ay)
+				bin[y][x] = 2;
+			else
+				bin[y][x] = (gx < 0) == (gy < 0) ? 1 : 3;
+		}
+
+	const ImageRef before[] = { ImageRef(-1, 0), ImageRef(-1, -1), ImageRef(0, -1), ImageRef(1, -1) };
+	const long long lower2 = static_cast<long long>(lower) * lower, upper2 = static_cast<long long>(upper) * upper;
+	Image<CVD::byte> edges(size, 0);
+	std::vector<ImageRef> stack;
+	for(int y = 1; y < size.y - 1; y++)
+		for(int x = 1; x < size.x - 1; x++)
+		{
+			const ImageRef p(x, y);
+			const ImageRef d = before[bin[p]];
+			const long long m = mag[p];
+			if(m > mag[p + d] && m >= mag[p - d] && m > lower2)
+				edges[p] = m > upper2 ? 2 : 1;
+			if(edges[p] == 2)
+				stack.push_back(p);
+		}
+
+	while(!stack.empty())
+	{
+		const ImageRef p = stack.back();
+		stack.pop_back();
+		edges[p] = 255;
+		for(int dy = -1; dy <= 1; dy++)
+			for(int dx = -1; dx <= 1; dx++)
+			{
+				const ImageRef q = p + ImageRef(dx, dy);
+				if(edges[q] == 1)
+				{
+					edges[q] = 2;
+					stack.push_back(q);
+				}
+			}
+	}
+
+	for(CVD::byte& e : edges)
+		e = e == 255 ? 255 : 0;
+	return edges;
+}
+
+void check(const BasicImage<CVD::byte>& im, int lower, int upper, const std::string& name)
+{
+	const std::string what = name + ", thresholds " + std::to_string(lower) + ", " + std::to_string(upper);
+	const Image<CVD::byte> expected = naive_canny(im, lower, upper);
+
+	Image<CVD::byte> edges(im.size(), 7);
+	CVD::canny_edges(im, edges, lower, upper);
+	assert_image_equal(expected, edges, what);
+
+	Image<CVD::byte> in_place(im.size());
+	in_place.copy_from(im);
+	CVD::canny_edges(in_place, in_place, lower, upper);
+	assert_image_equal(expected, in_place, "in place, " + what);
+}
+
+// Random values smoothed with a box filter a few times, so that there are
+// long connected edges with both strong and weak parts.
+Image<CVD::byte> smooth_noise(ImageRef size, std::mt19937& engine)
+{
+	Image<int> a(size), b(size);
+	for(int& p : a)
+		p = static_cast<int>(engine() % 256);
+
+	for(int pass = 0; pass < 3; pass++)
+	{
+		for(int y = 0; y < size.y; y++)
+			for(int x = 0; x < size.x; x++)
+			{
+				int sum = 0, n = 0;
+				for(int dy = -1; dy <= 1; dy++)
+					for(int dx = -1; dx <= 1; dx++)
+						if(a.in_image(ImageRef(x + dx, y + dy)))
+						{
+							sum += a[y + dy][x + dx];
+							n++;
+						}
+				b[y][x] = sum / n;
+			}
+		a.copy_from(b);
+	}
+
+	// Stretch the contrast back out.
+	Image<CVD::byte> out(size);
+	for(int y = 0; y < size.y; y++)
+		for(int x = 0; x < size.x; x++)
+			out[y][x] = static_cast<CVD::byte>(std::min(255, std::max(0, (a[y][x] - 128) * 4 + 128)));
+	return out;
+}
+
+int main()
+{
+	std::mt19937 engine;
+
+	const ImageRef sizes[] = { ImageRef(1, 1), ImageRef(2, 9), ImageRef(9, 2), ImageRef(3, 3), ImageRef(5, 4), ImageRef(67, 45), ImageRef(150, 97), ImageRef(33, 400) };
+	for(ImageRef size : sizes)
+	{
+		const Image<CVD::byte> im = smooth_noise(size, engine);
+		const std::string name = "noise, " + std::to_string(size.x) + "x" + std::to_string(size.y);
+		check(im, 10, 40, name);
+		check(im, 30, 120, name);
+		check(im, 0, 0, name);
+		check(im, 50, 50, name);
+	}
+
+	// Unsmoothed noise, with edges everywhere.
+	Image<CVD::byte> noise(ImageRef(130, 70));
+	for(CVD::byte& p : noise)
+		p = static_cast<CVD::byte>(engine() % 256);
+	check(noise, 100, 600, "raw noise");
+	check(noise, 1100, 1200, "raw noise, large thresholds");
+
+	// Shapes with edges in every direction, ridges two pixels wide and a
+	// long spiral, whose edge crosses many rows.
+	Image<CVD::byte> shapes(ImageRef(120, 300), 20);
+	for(int y = 0; y < shapes.size().y; y++)
+		for(int x = 0; x < shapes.size().x; x++)
+		{
+			const double dx = x - 60, dy = y - 150;
+			const double r = std::sqrt(dx * dx + dy * dy), a = std::atan2(dy, dx);
+			if(std::fmod(r - 6 * a + 100, 38) < 19)
+				shapes[y][x] = 200;
+			if(x % 30 == 10 || x % 30 == 11)
+				shapes[y][x] = 120;
+		}
+	check(shapes, 20, 300, "shapes");
+	check(shapes, 200, 900, "shapes, large thresholds");
+
+	const Image<CVD::byte> flat(ImageRef(40, 40), 77);
+	check(flat, 0, 0, "flat");
+
+	int thrown = 0;
+	for(int t = 0; t < 3; t++)
+		try
+		{
+			Image<CVD::byte> edges(ImageRef(10, 10 + (t == 0)));
+			CVD::canny_edges(flat.sub_image(ImageRef(0, 0), ImageRef(10, 10)), edges, t == 1 ? -1 : 20, t == 2 ? 10 : 20);
+		}
+		catch(const CVD::Exceptions::Vision::IncompatibleImageSizes&)
+		{
+			thrown += t == 0;
+		}
+		catch(const CVD::Exceptions::Vision::BadInput&)
+		{
+			thrown += t > 0;
+		}
+	assert_equal(3, thrown, "bad arguments accepted");
+}
@@ -0,0 +1,204 @@
+#include "test_utility.h"
+
+#include <cvd/connected_components.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+using CVD::BasicImage;
+using CVD::Connectivity;
+using CVD::Image;
+using CVD::ImageRef;
+using CVD::Testing::assert_equal;
+using CVD::Testing::assert_image_equal;
+using CVD::Testing::assert_near;
+
+// Flood fill from each unlabelled pixel in raster order, joining neighbours with
+// the same non-zero value.
+template <class T>
+Image<int> naive_labels(const BasicImage<T>& in, Connectivity connectivity)
+{
+	std::vector<ImageRef> neighbours = { ImageRef(1, 0), ImageRef(-1, 0), ImageRef(0, 1), ImageRef(0, -1) };
+	if(connectivity == Connectivity::Eight)
+		neighbours.insert(neighbours.end(), { ImageRef(1, 1), ImageRef(-1, 1), ImageRef(1, -1), ImageRef(-1, -1) });
+
+	Image<int> labels(in.size(), 0);
+	int count = 0;
+	for(int y = 0; y < in.size().y; y++)
+		for(int x = 0; x < in.size().x; x++)
+		{
+			if(in[y][x] == 0 || labels[y][x] != 0)
+				continue;
+
+			labels[y][x] = ++count;
+			std::vector<ImageRef> stack(1, ImageRef(x, y));
+			while(!stack.empty())
+			{
+				const ImageRef p = stack.back();
+				stack.pop_back();
+				for(const ImageRef& n : neighbours)
+				{
+					const ImageRef q = p + n;
+					if(in.in_image(q) && in[q] == in[p] && labels[q] == 0)
+					{
+						labels[q] = count;
+						stack.push_back(q);
+					}
+				}
+			}
+		}
+	return labels;
+}
+
+void check_close(double expected, double actual, const std::string& what)
+{
+	assert_near(expected, actual, 1e-6 * std::max(1.0, std::abs(expected)), what);
+}
+
+// Remove the components outside the area limits from a labelling, renumber the
+// rest, and check the statistics against sums over the pixels of each.
+void check_statistics(const BasicImage<int>& all, const BasicImage<CVD::byte>& grey, int min_area, int max_area, const BasicImage<int>& labels, const CVD::ComponentStatistics& stats, const std::string& name)
+{
+	std::vector<int> area;
+	for(int l : all)
+		if(l > 0)
+		{
+			area.resize(std::max<size_t>(area.size(), l));
+			area[l - 1]++;
+		}
+
+	std::vector<int> number(area.size());
+	int count = 0;
+	for(size_t i = 0; i < area.size(); i++)
+		number[i] = area[i] >= min_area && area[i] <= max_area ? ++count : 0;
+
+	Image<int> expected(all.size());
+	for(int y = 0; y < all.size().y; y++)
+		for(int x = 0; x < all.size().x; x++)
+			expected[y][x] = all[y][x] ? number[all[y][x] - 1] : 0;
+	assert_image_equal(expected, labels, "filtered labels, " + name);
+
+	assert_equal(static_cast<size_t>(count), stats.size(), "number of statistics, " + name);
+	assert_equal(stats.size(), stats.intensity.size(), "number of intensity statistics, " + name);
+
+	struct Sums
+	{
+		double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0, syy = 0;
+		double w = 0, wx = 0, wy = 0, wxx = 0, wxy = 0, wyy = 0;
+		ImageRef lo = ImageRef(INT_MAX, INT_MAX), hi = ImageRef(-1, -1);
+	};
+	std::vector<Sums> sums(count);
+	for(int y = 0; y < all.size().y; y++)
+		for(int x = 0; x < all.size().x; x++)
+			if(labels[y][x] > 0)
+			{
+				Sums& m = sums[labels[y][x] - 1];
+				m.n++;
+				m.sx += x;
+				m.sy += y;
+				m.sxx += x * x;
+				m.sxy += x * y;
+				m.syy += y * y;
+				const double g = grey[y][x];
+				m.w += g;
+				m.wx += g * x;
+				m.wy += g * y;
+				m.wxx += g * x * x;
+				m.wxy += g * x * y;
+				m.wyy += g * y * y;
+				m.lo = ImageRef(std::min(m.lo.x, x), std::min(m.lo.y, y));
+				m.hi = ImageRef(std::max(m.hi.x, x), std::max(m.hi.y, y));
+			}
+
+	for(size_t i = 0; i < sums.size(); i++)
+	{
+		const Sums& m = sums[i];
+		const std::string what = "statistics of component " + std::to_string(i + 1) + ", " + name;
+		assert_equal(static_cast<int>(m.n), stats.area[i], what + ", area");
+		assert_equal(m.lo, stats.top_left[i], what + ", top left");
+		assert_equal(m.hi, stats.bottom_right[i], what + ", bottom right");
+		const double cx = m.sx / m.n, cy = m.sy / m.n;
+		check_close(cx, stats.centroid_x[i], what);
+		check_close(cy, stats.centroid_y[i], what);
+		check_close(m.sxx / m.n - cx * cx, stats.xx[i], what);
+		check_close(m.sxy / m.n - cx * cy, stats.xy[i], what);
+		check_close(m.syy / m.n - cy * cy, stats.yy[i], what);
+		check_close(m.w, stats.intensity[i], what);
+		if(m.w > 0)
+		{
+			const double wcx = m.wx / m.w, wcy = m.wy / m.w;
+			check_close(wcx, stats.weighted_centroid_x[i], what);
+			check_close(wcy, stats.weighted_centroid_y[i], what);
+			check_close(m.wxx / m.w - wcx * wcx, stats.weighted_xx[i], what);
+			check_close(m.wxy / m.w - wcx * wcy, stats.weighted_xy[i], what);
+			check_close(m.wyy / m.w - wcy * wcy, stats.weighted_yy[i], what);
+		}
+	}
+}
+
+void check(ImageRef size, int density, int values, std::mt19937& engine)
+{
+	const std::string name = std::to_string(size.x) + "x" + std::to_string(size.y) + ", density " + std::to_string(density);
+
+	Image<CVD::byte> in(size);
+	Image<int> values_in(size);
+	for(int y = 0; y < size.y; y++)
+		for(int x = 0; x < size.x; x++)
+		{
+			const bool on = static_cast<int>(engine() % 100) < density;
+			values_in[y][x] = on ? 1 + static_cast<int>(engine() % values) : 0;
+			in[y][x] = on ? 255 : 0;
+		}
+	const CVD::BinaryImage binary(in);
+
+	for(Connectivity c : { Connectivity::Four, Connectivity::Eight })
+	{
+		const std::string cname = name + (c == Connectivity::Four ? ", 4 way" : ", 8 way");
+		Image<int> labels(size);
+
+		const Image<int> expected = naive_labels(in, c);
+		CVD::connected_components(in, labels, c);
+		assert_image_equal(expected, labels, "connected_components, " + cname);
+
+		labels.fill(-1);
+		CVD::connected_components(binary, labels, c);
+		assert_image_equal(expected, labels, "connected_components of a BinaryImage, " + cname);
+
+		Image<CVD::byte> grey(size);
+		for(auto& p : grey)
+			p = static_cast<CVD::byte>(engine() % 256);
+		CVD::ComponentStatistics stats;
+		CVD::ComponentFilter filter;
+		filter.min_area = 3;
+		if(c == Connectivity::Four)
+			filter.max_area = 200;
+		CVD::connected_components(binary, grey, labels, stats, c, filter);
+		check_statistics(expected, grey, filter.min_area, filter.max_area, labels, stats, "connected_components with statistics, " + cname);
+
+		// In place on a label image.
+		labels.copy_from(values_in);
+		CVD::connected_regions(labels, labels, c);
+		assert_image_equal(naive_labels(values_in, c), labels, "connected_regions, " + cname);
+	}
+}
+
+int main()
+{
+	std::mt19937 engine;
+	check(ImageRef(1, 1), 50, 1, engine);
+	check(ImageRef(70, 1), 50, 2, engine);
+	check(ImageRef(1, 70), 50, 2, engine);
+	check(ImageRef(93, 61), 10, 2, engine);
+	check(ImageRef(93, 61), 50, 3, engine);
+	check(ImageRef(130, 90), 70, 2, engine);
+	check(ImageRef(64, 64), 100, 1, engine);
+	check(ImageRef(64, 64), 0, 1, engine);
+
+	// Tall enough to be labelled in several stripes, which must be joined.
+	check(ImageRef(40, 700), 55, 2, engine);
+	check(ImageRef(300, 530), 60, 1, engine);
+}
@@ -2,12 +2,331 @@
 
 #include <cvd/convolution.h>
 #include <cvd/image.h>
+#include <cvd/rgb.h>
+#include <cvd/rgba.h>
+
+#include "test_utility.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
 
 using namespace CVD;
 
+// Reference correlation with edge clamping.
+Image<float> naive_correlate(const BasicImage<float>& in, const BasicImage<float>& k)
+{
+	Image<float> out(in.size());
+	const ImageRef r = k.size() / 2;
+	for(int y = 0; y < in.size().y; y++)
+		for(int x = 0; x < in.size().x; x++)
+		{
+			double sum = 0;
+			for(int j = 0; j < k.size().y; j++)
+				for(int i = 0; i < k.size().x; i++)
+				{
+					int yy = std::min(std::max(y + j - r.y, 0), in.size().y - 1);
+					int xx = std::min(std::max(x + i - r.x, 0), in.size().x - 1);
+					sum += k[j][i] * in[yy][xx];
+				}
+			out[y][x] = static_cast<float>(sum);
+		}
+	return out;
+}
+
+bool check_close(const BasicImage<float>& a, const BasicImage<float>& b, const char* what)
+{
+	for(int y = 0; y < a.size().y; y++)
+		for(int x = 0; x < a.size().x; x++)
+			if(std::abs(a[y][x] - b[y][x]) > 1e-3)
+			{
+				std::cerr << what << ": mismatch at " << ImageRef(x, y) << ": " << a[y][x] << " " << b[y][x] << "\n";
+				return false;
+			}
+	return true;
+}
+
+// One pass of a fixed kernel in double precision, along x or y, with edge
+// clamping. Integer results are rounded half away from zero, as the fixed
+// kernels do.
+template <class K>
+Image<double> reference_pass(const BasicImage<double>& in, bool along_x, bool round)
+{
+	Image<double> out(in.size());
+	for(int y = 0; y < in.size().y; y++)
+		for(int x = 0; x < in.size().x; x++)
+		{
+			double sum = 0;
+			for(int k = 0; k < K::size; k++)
+			{
+				const int xx = along_x ? std::min(std::max(x + k - K::radius, 0), in.size().x - 1) : x;
+				const int yy = along_x ? y : std::min(std::max(y + k - K::radius, 0), in.size().y - 1);
+				sum += K::coefficients[k] * in[yy][xx];
+			}
+			out[y][x] = round ? std::round(sum / K::divisor) : sum / K::divisor;
+		}
+	return out;
+}
+
+template <class K>
+Image<double> reference_2d(const BasicImage<double>& in)
+{
+	Image<double> out(in.size());
+	for(int y = 0; y < in.size().y; y++)
+		for(int x = 0; x < in.size().x; x++)
+		{
+			double sum = 0;
+			for(int j = 0; j < K::height; j++)
+				for(int i = 0; i < K::width; i++)
+				{
+					const int yy = std::min(std::max(y + j - K::height / 2, 0), in.size().y - 1);
+					const int xx = std::min(std::max(x + i - K::width / 2, 0), in.size().x - 1);
+					sum += K::coefficients[j * K::width + i] * in[yy][xx];
+				}
+			out[y][x] = std::round(sum / K::divisor);
+		}
+	return out;
+}
+
+// Component c of each pixel of an image, as doubles.
+template <class P>
+Image<double> component(const BasicImage<P>& in, int c)
+{
+	typedef typename Pixel::Component<P>::type C;
+	Image<double> out(in.size());
+	for(int y = 0; y < in.size().y; y++)
+		for(int x = 0; x < in.size().x; x++)
+			out[y][x] = reinterpret_cast<const C*>(in[y])[x * Pixel::Component<P>::count + c];
+	return out;
+}
+
+// Checks the integer results of a fixed kernel, component by component,
+// against the reference saturated to the output type.
+template <class D>
+void check_saturated(const BasicImage<D>& result, const std::vector<Image<double>>& expected, const std::string& what)
+{
+	typedef typename Pixel::Component<D>::type C;
+	for(size_t c = 0; c < expected.size(); c++)
+	{
+		const Image<double> actual = component(result, static_cast<int>(c));
+		for(int y = 0; y < actual.size().y; y++)
+			for(int x = 0; x < actual.size().x; x++)
+			{
+				const double e = std::min<double>(std::max<double>(expected[c][y][x], std::numeric_limits<C>::min()), std::numeric_limits<C>::max());
+				Testing::assert_equal(e, actual[y][x], what + " at " + std::to_string(x) + ", " + std::to_string(y));
+			}
+	}
+}
+
+// Integer pixels, with random components in [lo, hi].
+template <class S, class D, class KX, class KY, class K2>
+void check_fixed_integer(std::mt19937& engine, int lo, int hi, const std::string& name)
+{
+	typedef typename Pixel::Component<S>::type C;
+	const int N = Pixel::Component<S>::count;
+	std::uniform_int_distribution<int> value(lo, hi);
+
+	Image<S> in(ImageRef(29, 13));
+	for(int y = 0; y < in.size().y; y++)
+		for(int x = 0; x < in.size().x * N; x++)
+			reinterpret_cast<C*>(in[y])[x] = static_cast<C>(value(engine));
+
+	std::vector<Image<double>> separable, kernel_2d;
+	for(int c = 0; c < N; c++)
+	{
+		const Image<double> plane = component(in, c);
+		separable.push_back(reference_pass<KX>(reference_pass<KY>(plane, false, true), true, true));
+		kernel_2d.push_back(reference_2d<K2>(plane));
+	}
+
+	Image<D> result(in.size());
+	convolveSeparableFixed<KX, KY>(in, result);
+	check_saturated(result, separable, name + ", fixed separable");
+	convolveFixed<K2>(in, result);
+	check_saturated(result, kernel_2d, name + ", fixed 2D");
+}
+
+// The interleaved byte colour filters against the generic templates. The box
+// filter gives exactly the same results. The Gaussian adds up in a different
+// order, so it may differ by one, rarely, where the sum is very close to a
+// half. The generic Gaussian gives wrong results for images less than twice
+// its radius wide or high, so the images are larger than that.
+template <class P>
+void check_colour_bytes(std::mt19937& engine, const std::string& name)
+{
+	const int channels = Pixel::Component<P>::count;
+	for(ImageRef s : { ImageRef(40, 30), ImageRef(131, 21), ImageRef(23, 64) })
+	{
+		const std::string size = name + ", " + std::to_string(s.x) + "x" + std::to_string(s.y);
+		Image<P> in(s), generic(s), interleaved(s);
+		for(auto& p : in)
+			for(int c = 0; c < channels; c++)
+				Pixel::Component<P>::get(p, c) = static_cast<byte>(engine());
+
+		for(double sigma : { 0.7, 1.5, 3.0 })
+		{
+			convolveGaussian<P>(in, generic, sigma);
+			convolveGaussian(in, interleaved, sigma);
+			int off_by_one = 0;
+			for(int y = 0; y < s.y; y++)
+				for(int x = 0; x < s.x; x++)
+					for(int c = 0; c < channels; c++)
+					{
+						const int g = Pixel::Component<P>::get(generic[y][x], c);
+						const int i = Pixel::Component<P>::get(interleaved[y][x], c);
+						if(std::abs(g - i) > 1)
+							Testing::assert_equal(g, i, size + ", Gaussian, sigma " + std::to_string(sigma) + " at " + std::to_string(x) + ", " + std::to_string(y));
+						off_by_one += g != i;
+					}
+			if(off_by_one * 1000 > s.area() * channels)
+				Testing::assert_equal(0, off_by_one, size + ", Gaussian, sigma " + std::to_string(sigma) + ", components which differ by one");
+		}
+
+		for(ImageRef hwin : { ImageRef(2, 1), ImageRef(0, 3), ImageRef(3, 3) })
+		{
+			convolveWithBox<P>(in, generic, hwin);
+			convolveWithBox(in, interleaved, hwin);
+			Testing::assert_image_equal(generic, interleaved, size + ", box " + std::to_string(hwin.x) + "x" + std::to_string(hwin.y));
+		}
+	}
+}
+
+bool check_close_rgb(const BasicImage<Rgb<float>>& a, const BasicImage<Rgb<float>>& b, const char* what)
+{
+	for(int y = 0; y < a.size().y; y++)
+		for(int x = 0; x < a.size().x; x++)
+		{
+			const Rgb<float> d = a[y][x] - b[y][x];
+			if(std::abs(d.red) + std::abs(d.green) + std::abs(d.blue) > 1e-5)
+			{
+				std::cerr << what << ": mismatch at " << ImageRef(x, y) << ": " << a[y][x] << " " << b[y][x] << "\n";
+				return false;
+			}
+		}
+	return true;
+}
+
 int main(int, char**)
 {
 	Image<float> img(ImageRef(2, 5));
 	Image<float> out(img.size());
 	convolveGaussian(img, out, 1.0);
+
+	std::mt19937 engine;
+	std::uniform_real_distribution<float> value(-1, 1);
+
+	const ImageRef sizes[] = { ImageRef(1, 1), ImageRef(37, 23), ImageRef(130, 70) };
+	const ImageRef kernels[] = { ImageRef(1, 1), ImageRef(3, 5), ImageRef(9, 9), ImageRef(21, 15) };
+
+	for(ImageRef s : sizes)
+		for(ImageRef ks : kernels)
+		{
+			Image<float> in(s), k(ks), flipped(ks);
+			for(auto& p : in)
+				p = value(engine);
+			for(auto& p : k)
+				p = value(engine);
+			for(int j = 0; j < ks.y; j++)
+				for(int i = 0; i < ks.x; i++)
+					flipped[ks.y - 1 - j][ks.x - 1 - i] = k[j][i];
+
+			Image<float> expected = naive_correlate(in, k);
+			Image<float> expected_conv = naive_correlate(in, flipped);
+			Image<float> result(s);
+
+			correlate(in, k, result, ConvolutionMethod::Direct);
+			if(!check_close(expected, result, "direct correlation"))
+				return 1;
+
+			correlate(in, k, result, ConvolutionMethod::FFT);
+			if(!check_close(expected, result, "FFT correlation"))
+				return 1;
+
+			convolve(in, k, result, ConvolutionMethod::FFT);
+			if(!check_close(expected_conv, result, "FFT convolution"))
+				return 1;
+
+			convolve(in, k, result);
+			if(!check_close(expected_conv, result, "convolution"))
+				return 1;
+		}
+
+	// Kernels larger than the largest FFT tile normally used.
+	for(ImageRef ks : { ImageRef(1025, 3), ImageRef(3, 1101) })
+	{
+		const ImageRef s(ks.x > ks.y ? ImageRef(40, 6) : ImageRef(5, 30));
+		Image<float> in(s), k(ks), result(s);
+		for(auto& p : in)
+			p = value(engine);
+		for(auto& p : k)
+			p = value(engine) / 100;
+
+		Image<float> expected = naive_correlate(in, k);
+		for(ConvolutionMethod method : { ConvolutionMethod::Automatic, ConvolutionMethod::Direct, ConvolutionMethod::FFT })
+		{
+			correlate(in, k, result, method);
+			if(!check_close(expected, result, "large kernel correlation"))
+				return 1;
+		}
+	}
+
+	// Compile time kernels against the reference.
+	{
+		Image<float> in(ImageRef(41, 17)), result(in.size()), k(ImageRef(5, 3));
+		for(auto& p : in)
+			p = value(engine);
+
+		const float b5[] = { 1, 4, 6, 4, 1 }, b3[] = { 1, 2, 1 };
+		for(int j = 0; j < 3; j++)
+			for(int i = 0; i < 5; i++)
+				k[j][i] = b5[i] * b3[j] / 64;
+
+		convolveSeparableFixed<FixedKernels::Binomial5, FixedKernels::Binomial3>(in, result);
+		if(!check_close(naive_correlate(in, k), result, "fixed separable"))
+			return 1;
+
+		Image<float> laplacian(ImageRef(3, 3));
+		for(int j = 0; j < 3; j++)
+			for(int i = 0; i < 3; i++)
+				laplacian[j][i] = (i == 1 && j == 1) ? -4 : (i == 1 || j == 1) ? 1 : 0;
+
+		convolveFixed<FixedKernels::Laplacian3x3>(in, result);
+		if(!check_close(naive_correlate(in, laplacian), result, "fixed 2D"))
+			return 1;
+	}
+
+	// Integer kernels round each pass and saturate the result. The Laplacian
+	// and the gain of 4 of Gain4 go beyond the range of the output.
+	using namespace FixedKernels;
+	typedef FixedKernel<1, 1, 2, 1> Gain4;
+	check_fixed_integer<byte, byte, Binomial5, Gaussian5, Laplacian3x3>(engine, 0, 255, "byte");
+	check_fixed_integer<byte, short, Difference3, Binomial3, Box3x3>(engine, 0, 255, "byte to short");
+	check_fixed_integer<short, short, Scharr3, Gain4, Laplacian3x3>(engine, -32768, 32767, "short");
+	check_fixed_integer<Rgb<byte>, Rgb<byte>, Binomial3, Binomial5, Laplacian3x3>(engine, 0, 255, "Rgb<byte>");
+
+	// The interleaved colour filters against the generic templates.
+	{
+		Image<Rgb<float>> in(ImageRef(40, 30)), generic(in.size()), interleaved(in.size());
+		for(auto& p : in)
+			p = Rgb<float>(value(engine), value(engine), value(engine));
+
+		convolveGaussian<Rgb<float>>(in, generic, 1.5);
+		convolveGaussian(in, interleaved, 1.5);
+		if(!check_close_rgb(generic, interleaved, "colour Gaussian"))
+			return 1;
+
+		generic.copy_from(in);
+		interleaved.copy_from(in);
+		convolveWithBox<Rgb<float>>(in, generic, ImageRef(2, 1));
+		convolveWithBox(in, interleaved, ImageRef(2, 1));
+		if(!check_close_rgb(generic, interleaved, "colour box"))
+			return 1;
+	}
+
+	check_colour_bytes<Rgb<byte>>(engine, "Rgb<byte>");
+	check_colour_bytes<Rgba<byte>>(engine, "Rgba<byte>");
 }
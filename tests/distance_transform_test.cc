@@ -1,6 +1,10 @@
 #include <cvd/convert_image.h>
 #include <cvd/distance_transform.h>
 #include <cvd/image_io.h>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
 #include <random>
 #include <utility>
 using namespace CVD;
@@ -11,10 +15,130 @@ using std::endl;
 using std::mt19937;
 using std::uniform_int_distribution;
 
+// Compare against the distance to every point.
+bool check_brute_force(ImageRef s, int points, mt19937& engine)
+{
+	Image<byte> in(s, 0);
+	uniform_int_distribution<int> rand_x(0, s.x - 1);
+	uniform_int_distribution<int> rand_y(0, s.y - 1);
+	std::vector<ImageRef> p;
+	for(int i = 0; i < points; i++)
+	{
+		p.push_back(ImageRef(rand_x(engine), rand_y(engine)));
+		in[p.back()] = 1;
+	}
+
+	Image<int> out(s);
+	Image<float> out_float(s);
+	euclidean_distance_transform_sq(in, out);
+	euclidean_distance_transform_sq(in, out_float);
+
+	for(ImageRef q(-1, 0); q.next(s);)
+	{
+		int best = static_cast<int>(s.mag_squared());
+		for(const ImageRef& r : p)
+			best = std::min(best, static_cast<int>((q - r).mag_squared()));
+		if(out[q] != best || out_float[q] != best)
+		{
+			cerr << "Error: distance at " << q << " is " << out[q] << " and " << out_float[q] << " not " << best << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// Compare the truncated transform and the raster scan metrics against the
+// distance to every point, and shortest paths through the chamfer steps.
+bool check_metrics(ImageRef s, int points, int max_distance, mt19937& engine)
+{
+	Image<byte> in(s, 0);
+	uniform_int_distribution<int> rand_x(0, s.x - 1);
+	uniform_int_distribution<int> rand_y(0, s.y - 1);
+	std::vector<ImageRef> p;
+	for(int i = 0; i < points; i++)
+	{
+		p.push_back(ImageRef(rand_x(engine), rand_y(engine)));
+		in[p.back()] = 1;
+	}
+
+	Image<int> out(s);
+	Image<float> out_float(s);
+	euclidean_distance_transform_sq(in, out, max_distance);
+	Image<float> root = euclidean_distance_transform(in, max_distance);
+	for(ImageRef q(-1, 0); q.next(s);)
+	{
+		int best = max_distance * max_distance;
+		for(const ImageRef& r : p)
+			best = std::min(best, static_cast<int>((q - r).mag_squared()));
+		if(out[q] != best || std::abs(root[q] - std::sqrt(static_cast<float>(best))) > 1e-4f)
+		{
+			cerr << "Error: truncated distance at " << q << " is " << out[q] << " not " << best << endl;
+			return false;
+		}
+	}
+
+	struct Step
+	{
+		ImageRef d;
+		int cost;
+	};
+	const std::vector<std::pair<DistanceMetric, std::vector<Step>>> metrics = {
+		{ DistanceMetric::CityBlock, { { ImageRef(1, 0), 1 }, { ImageRef(0, 1), 1 } } },
+		{ DistanceMetric::Chessboard, { { ImageRef(1, 0), 1 }, { ImageRef(0, 1), 1 }, { ImageRef(1, 1), 1 }, { ImageRef(1, -1), 1 } } },
+		{ DistanceMetric::Chamfer34, { { ImageRef(1, 0), 3 }, { ImageRef(0, 1), 3 }, { ImageRef(1, 1), 4 }, { ImageRef(1, -1), 4 } } },
+		{ DistanceMetric::Chamfer5711, { { ImageRef(1, 0), 5 }, { ImageRef(0, 1), 5 }, { ImageRef(1, 1), 7 }, { ImageRef(1, -1), 7 }, { ImageRef(2, 1), 11 }, { ImageRef(2, -1), 11 }, { ImageRef(1, 2), 11 }, { ImageRef(1, -2), 11 } } },
+	};
+
+	for(const auto& m : metrics)
+	{
+		// Dijkstra from all of the points at once
+		Image<int> expected(s, std::numeric_limits<int>::max());
+		std::priority_queue<std::pair<int, ImageRef>, std::vector<std::pair<int, ImageRef>>, std::greater<std::pair<int, ImageRef>>> queue;
+		for(const ImageRef& r : p)
+		{
+			expected[r] = 0;
+			queue.push({ 0, r });
+		}
+		while(!queue.empty())
+		{
+			const auto top = queue.top();
+			queue.pop();
+			if(top.first != expected[top.second])
+				continue;
+			for(const Step& step : m.second)
+				for(const ImageRef& d : { step.d, -step.d })
+				{
+					const ImageRef n = top.second + d;
+					if(expected.in_image(n) && top.first + step.cost < expected[n])
+					{
+						expected[n] = top.first + step.cost;
+						queue.push({ expected[n], n });
+					}
+				}
+		}
+
+		distance_transform(in, out, m.first);
+		out_float = distance_transform(in, m.first);
+		for(ImageRef q(-1, 0); q.next(s);)
+			if(out[q] != expected[q] || out_float[q] != expected[q])
+			{
+				cerr << "Error: distance with metric " << static_cast<int>(m.first) << " at " << q << " is " << out[q] << " not " << expected[q] << endl;
+				return false;
+			}
+	}
+	return true;
+}
+
 int main()
 {
 
 	mt19937 engine;
+	if(!check_brute_force(ImageRef(37, 23), 5, engine) || !check_brute_force(ImageRef(130, 71), 40, engine) || !check_brute_force(ImageRef(1, 50), 2, engine) || !check_brute_force(ImageRef(50, 1), 2, engine))
+		return 1;
+
+	if(!check_metrics(ImageRef(37, 23), 5, 6, engine) || !check_metrics(ImageRef(130, 71), 40, 10, engine) || !check_metrics(ImageRef(90, 80), 3, 1000, engine) || !check_metrics(ImageRef(64, 48), 12, 0, engine) || !check_metrics(ImageRef(1, 50), 2, 7, engine) || !check_metrics(ImageRef(50, 1), 2, 7, engine))
+		return 1;
+
 	uniform_int_distribution<int> rand_size(50, 1050);
 	//Generate some random point sets.
 	for(int i = 0; i < 100; i++)
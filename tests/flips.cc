@@ -4,7 +4,10 @@
 #include <cvd/vision.h>
 
 #include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <random>
+#include <string>
 
 using CVD::Image;
 using CVD::ImageRef;
@@ -12,6 +15,71 @@ using CVD::Testing::assert_equal;
 using CVD::Testing::assert_image_equal;
 using CVD::Testing::init;
 
+template <class T>
+void check_same(const CVD::BasicImage<T>& expected, const CVD::BasicImage<T>& actual, const std::string& what)
+{
+	if(expected.size() != actual.size())
+	{
+		std::cerr << what << ": wrong size\n";
+		exit(EXIT_FAILURE);
+	}
+	for(int y = 0; y < expected.size().y; y++)
+		if(memcmp(expected[y], actual[y], sizeof(T) * expected.size().x) != 0)
+		{
+			std::cerr << what << ": wrong row " << y << "\n";
+			exit(EXIT_FAILURE);
+		}
+}
+
+// Transposes and rotations of images, and of parts of larger ones, are the
+// same as moving each pixel.
+template <class T>
+void check_rotations(std::mt19937& eng, const std::string& name)
+{
+	const ImageRef sizes[] = { ImageRef(0, 0), ImageRef(0, 3), ImageRef(1, 1), ImageRef(5, 1), ImageRef(17, 33), ImageRef(64, 64), ImageRef(131, 70), ImageRef(300, 9) };
+	for(ImageRef size : sizes)
+	{
+		const std::string what = name + ", " + std::to_string(size.x) + "x" + std::to_string(size.y);
+		Image<T> whole(size + ImageRef(3, 2));
+		unsigned char* p = reinterpret_cast<unsigned char*>(whole.data());
+		for(size_t i = 0; i < sizeof(T) * whole.size().area(); i++)
+			p[i] = static_cast<unsigned char>(eng());
+		const CVD::BasicImage<T> in = whole.sub_image(ImageRef(2, 1), size);
+
+		Image<T> transposed(size.transpose()), clockwise(size.transpose()), half(size), anticlockwise(size.transpose());
+		for(int y = 0; y < size.y; y++)
+			for(int x = 0; x < size.x; x++)
+			{
+				transposed[x][y] = in[y][x];
+				clockwise[x][size.y - 1 - y] = in[y][x];
+				half[size.y - 1 - y][size.x - 1 - x] = in[y][x];
+				anticlockwise[size.x - 1 - x][y] = in[y][x];
+			}
+
+		check_same<T>(transposed, CVD::transpose(in), what + ", transpose");
+		check_same<T>(clockwise, CVD::rotate90(in), what + ", rotate90");
+		check_same<T>(half, CVD::rotate180(in), what + ", rotate180");
+		check_same<T>(anticlockwise, CVD::rotate270(in), what + ", rotate270");
+
+		// In to part of a larger image.
+		Image<T> larger(size.transpose() + ImageRef(4, 1));
+		CVD::rotate90(in, larger.sub_image(ImageRef(1, 1), size.transpose()));
+		check_same<T>(clockwise, larger.sub_image(ImageRef(1, 1), size.transpose()), what + ", rotate90 in to a sub image");
+	}
+
+	Image<T> in(ImageRef(4, 3)), wrong(ImageRef(4, 3));
+	bool thrown = false;
+	try
+	{
+		CVD::rotate90(in, wrong);
+	}
+	catch(const CVD::Exceptions::Vision::IncompatibleImageSizes&)
+	{
+		thrown = true;
+	}
+	assert_equal(true, thrown, name + ": rotate90 accepted the wrong size");
+}
+
 int main()
 {
 	Image<int> a = init({ { 1, 2 }, { 3, 4 } });
@@ -34,6 +102,15 @@ int main()
 	CVD::Internal::recursiveTranspose(a, b, 1);
 	assert_image_equal(init({ { 1, 3, 5 }, { 2, 4, 6 } }), b, "Recursive transpose failed (small)");
 
+	////////////////////////////////////////////////////////////////////////////////
+	std::mt19937 rotation_engine;
+	check_rotations<uint8_t>(rotation_engine, "uint8_t");
+	check_rotations<uint16_t>(rotation_engine, "uint16_t");
+	check_rotations<float>(rotation_engine, "float");
+	check_rotations<CVD::Rgba<uint8_t>>(rotation_engine, "Rgba<uint8_t>");
+	check_rotations<CVD::Rgb<uint8_t>>(rotation_engine, "Rgb<uint8_t>");
+	check_rotations<double>(rotation_engine, "double");
+
 	////////////////////////////////////////////////////////////////////////////////
 	const int N = 100;
 	const int R = 10;
@@ -0,0 +1,145 @@
+#include "test_utility.h"
+
+#include <cvd/haar.h>
+
+#include <cmath>
+#include <random>
+#include <string>
+
+using CVD::BasicImage;
+using CVD::Image;
+using CVD::ImageRef;
+using CVD::Testing::assert_equal;
+using CVD::Testing::assert_image_equal;
+using CVD::Testing::assert_near;
+
+template <class T>
+Image<T> copy_of(const BasicImage<T>& in)
+{
+	Image<T> out(in.size());
+	out.copy_from(in);
+	return out;
+}
+
+template <class T>
+void check_close(const BasicImage<T>& a, const BasicImage<T>& b, double tolerance, const std::string& what)
+{
+	for(int y = 0; y < a.size().y; y++)
+		for(int x = 0; x < a.size().x; x++)
+			assert_near(a[y][x], b[y][x], static_cast<T>(tolerance), what + ": difference at " + std::to_string(x) + "," + std::to_string(y));
+}
+
+// One level at a time from the definition: rows then columns of the top left block.
+template <class T, class F>
+Image<T> naive(const BasicImage<T>& in, int levels, F butterfly)
+{
+	Image<T> out = copy_of(in);
+	for(int l = 0; l < levels; l++)
+	{
+		const int w = in.size().x >> l;
+		const int h = in.size().y >> l;
+		Image<T> tmp(ImageRef(w, h));
+		for(int y = 0; y < h; y++)
+			for(int i = 0; i < w / 2; i++)
+				butterfly(out[y][2 * i], out[y][2 * i + 1], tmp[y][i], tmp[y][w / 2 + i]);
+		for(int x = 0; x < w; x++)
+			for(int i = 0; i < h / 2; i++)
+				butterfly(tmp[2 * i][x], tmp[2 * i + 1][x], out[i][x], out[h / 2 + i][x]);
+	}
+	return out;
+}
+
+void check_float(ImageRef size, int levels, std::mt19937& engine)
+{
+	const std::string name = std::to_string(size.x) + "x" + std::to_string(size.y) + ", " + std::to_string(levels) + " levels";
+	Image<double> in(size);
+	for(auto& p : in)
+		p = std::uniform_real_distribution<double>(-10, 10)(engine);
+
+	Image<double> out = copy_of(in);
+	CVD::haar2D(out, levels);
+	const Image<double> expected = naive(in, levels, [](double a, double b, double& s, double& d) {
+		s = (a + b) * M_SQRT1_2;
+		d = (a - b) * M_SQRT1_2;
+	});
+	check_close(expected, out, 1e-9, "haar2D, " + name);
+
+	CVD::inv_haar2D(out, levels);
+	check_close(in, out, 1e-9, "inv_haar2D, " + name);
+}
+
+template <class T>
+void check_integer(ImageRef size, int levels, int range, std::mt19937& engine)
+{
+	const std::string name = std::to_string(size.x) + "x" + std::to_string(size.y) + ", " + std::to_string(levels) + " levels";
+	Image<T> in(size);
+	for(auto& p : in)
+		p = static_cast<T>(std::uniform_int_distribution<int>(-range, range)(engine));
+
+	Image<T> out = copy_of(in);
+	CVD::integer_haar2D(out, levels);
+	const Image<T> expected = naive(in, levels, [](T a, T b, T& s, T& d) {
+		d = a - b;
+		s = static_cast<T>(std::floor((a + b) / 2.0));
+	});
+	assert_image_equal(expected, out, "integer_haar2D, " + name);
+
+	CVD::inv_integer_haar2D(out, levels);
+	assert_image_equal(in, out, "inv_integer_haar2D, " + name);
+}
+
+// The full transform should match the iterator version, which leaves the
+// last sample alone where a side is odd.
+void check_full(ImageRef size, std::mt19937& engine)
+{
+	const std::string name = std::to_string(size.x) + "x" + std::to_string(size.y);
+	Image<float> in(size);
+	for(auto& p : in)
+		p = std::uniform_real_distribution<float>(0, 1)(engine);
+
+	Image<float> expected = copy_of(in);
+	CVD::haar2D(expected.data(), size.x, size.y);
+
+	Image<float> out = copy_of(in);
+	CVD::haar2D(out);
+	assert_image_equal(expected, out, "haar2D, " + name);
+
+	CVD::inv_haar2D(out);
+	check_close(in, out, 1e-5, "inv_haar2D, " + name);
+}
+
+int main()
+{
+	std::mt19937 engine;
+
+	for(ImageRef size : { ImageRef(1, 1), ImageRef(16, 1), ImageRef(1, 8), ImageRef(32, 32), ImageRef(256, 64), ImageRef(8, 128), ImageRef(7, 1), ImageRef(12, 10), ImageRef(45, 30), ImageRef(100, 3) })
+		check_full(size, engine);
+
+	check_float(ImageRef(48, 40), 3, engine);
+	check_float(ImageRef(200, 6), 1, engine);
+	check_float(ImageRef(7, 5), 0, engine);
+	check_float(ImageRef(256, 128), 7, engine);
+
+	check_integer<int>(ImageRef(96, 80), 4, 100000, engine);
+	check_integer<int>(ImageRef(130, 2), 1, 255, engine);
+	check_integer<short>(ImageRef(64, 64), 6, 255, engine);
+
+	Image<float> square(ImageRef(32, 32));
+	for(auto& p : square)
+		p = std::uniform_real_distribution<float>(0, 1)(engine);
+	Image<float> full = copy_of(square);
+	CVD::haar2D(full);
+	CVD::haar2D(square, 5);
+	assert_image_equal(full, square, "haar2D with all levels");
+
+	bool thrown = false;
+	try
+	{
+		CVD::haar2D(square, 6);
+	}
+	catch(const CVD::Exceptions::Vision::BadInput&)
+	{
+		thrown = true;
+	}
+	assert_equal(true, thrown, "haar2D with too many levels did not throw");
+}
@@ -0,0 +1,109 @@
+#include "test_utility.h"
+
+#include <cvd/vision.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <type_traits>
+
+using CVD::BasicImage;
+using CVD::Image;
+using CVD::ImageRef;
+using CVD::Rgb;
+using CVD::Rgba;
+using CVD::Testing::assert_equal;
+using CVD::Testing::assert_image_equal;
+
+// The specialised versions give exactly what the generic ones do, including on
+// images which are part of a larger one.
+template <class T>
+void check(std::mt19937& engine, const std::string& name)
+{
+	const ImageRef sizes[] = { ImageRef(0, 0), ImageRef(1, 1), ImageRef(2, 3), ImageRef(7, 5), ImageRef(131, 67), ImageRef(200, 9) };
+	for(ImageRef size : sizes)
+	{
+		const std::string what = name + ", " + std::to_string(size.x) + "x" + std::to_string(size.y);
+		Image<T> whole(size + ImageRef(3, 2));
+		unsigned char* p = reinterpret_cast<unsigned char*>(whole.data());
+		for(size_t i = 0; i < sizeof(T) * whole.size().area(); i++)
+			p[i] = static_cast<unsigned char>(engine());
+		if constexpr(std::is_same<T, float>::value)
+			for(float& f : whole)
+				f = static_cast<float>(engine() % 100000) / 7;
+		const BasicImage<T> in = whole.sub_image(ImageRef(1, 1), size);
+
+		Image<T> half(size / 2), expected(size / 2);
+		CVD::halfSample(in, half);
+		CVD::halfSample<T>(in, expected);
+		assert_image_equal(expected, half, what + ": halfSample differs");
+
+		Image<T> two_thirds(size / 3 * 2), expected_two_thirds(size / 3 * 2);
+		CVD::twoThirdsSample(in, two_thirds);
+		CVD::twoThirdsSample<T>(in, expected_two_thirds);
+		assert_image_equal(expected_two_thirds, two_thirds, what + ": twoThirdsSample differs");
+	}
+
+	Image<T> in(ImageRef(8, 8)), wrong(ImageRef(4, 3));
+	bool thrown = false;
+	try
+	{
+		CVD::halfSample(in, wrong);
+	}
+	catch(const CVD::Exceptions::Vision::IncompatibleImageSizes&)
+	{
+		thrown = true;
+	}
+	assert_equal(true, thrown, name + ": halfSample accepted the wrong size");
+}
+
+// Each cell of a Bayer image becomes a pixel of its red, the rounded average
+// of its greens, and its blue, where (rx, ry) is the red pixel in the cell.
+template <class B, class S>
+void check_bayer(std::mt19937& engine, int rx, int ry, const std::string& name)
+{
+	const ImageRef size(37, 21);
+	Image<B> in(size);
+	for(B& p : in)
+		p = static_cast<S>(engine());
+	Image<Rgb<S>> out(size / 2);
+	CVD::halfSample(in, out);
+
+	for(int y = 0; y < out.size().y; y++)
+		for(int x = 0; x < out.size().x; x++)
+		{
+			const int r = in[2 * y + ry][2 * x + rx];
+			const int g = (in[2 * y + ry][2 * x + 1 - rx] + in[2 * y + 1 - ry][2 * x + rx] + 1) / 2;
+			const int b = in[2 * y + 1 - ry][2 * x + 1 - rx];
+			assert_equal(Rgb<S>(static_cast<S>(r), static_cast<S>(g), static_cast<S>(b)), out[y][x], name + ": wrong pixel at " + std::to_string(x) + ", " + std::to_string(y));
+		}
+}
+
+int main()
+{
+	std::mt19937 engine;
+	check<Rgb<CVD::byte>>(engine, "Rgb<byte>");
+	check<Rgba<CVD::byte>>(engine, "Rgba<byte>");
+	check<unsigned short>(engine, "unsigned short");
+	check<float>(engine, "float");
+
+	check_bayer<CVD::bayer_rggb, CVD::byte>(engine, 0, 0, "rggb");
+	check_bayer<CVD::bayer_grbg, CVD::byte>(engine, 1, 0, "grbg");
+	check_bayer<CVD::bayer_gbrg, CVD::byte>(engine, 0, 1, "gbrg");
+	check_bayer<CVD::bayer_bggr, CVD::byte>(engine, 1, 1, "bggr");
+	check_bayer<CVD::bayer_rggb16, unsigned short>(engine, 0, 0, "rggb16");
+	check_bayer<CVD::bayer_grbg16, unsigned short>(engine, 1, 0, "grbg16");
+	check_bayer<CVD::bayer_gbrg16, unsigned short>(engine, 0, 1, "gbrg16");
+	check_bayer<CVD::bayer_bggr16, unsigned short>(engine, 1, 1, "bggr16");
+
+	// Repeated half sampling gives the same as the generic version.
+	Image<Rgb<CVD::byte>> im(ImageRef(64, 48));
+	for(Rgb<CVD::byte>& p : im)
+		p = Rgb<CVD::byte>(static_cast<CVD::byte>(engine()), static_cast<CVD::byte>(engine()), static_cast<CVD::byte>(engine()));
+	Image<Rgb<CVD::byte>> once(ImageRef(32, 24)), twice(ImageRef(16, 12));
+	CVD::halfSample<Rgb<CVD::byte>>(im, once);
+	CVD::halfSample<Rgb<CVD::byte>>(once, twice);
+	assert_image_equal<Rgb<CVD::byte>>(twice, CVD::halfSample(im, 2), "halfSample with octaves differs");
+}
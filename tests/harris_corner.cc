@@ -0,0 +1,62 @@
+#include "test_utility.h"
+
+#include <cvd/harris_corner.h>
+
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using CVD::BasicImage;
+using CVD::Image;
+using CVD::ImageRef;
+using CVD::Testing::assert_equal;
+
+typedef std::vector<std::pair<float, ImageRef>> Corners;
+
+// The streaming detector should give exactly the corners, scores and order
+// of the detector with intermediate images.
+template <class Score, class B>
+void check(const BasicImage<B>& im, unsigned int N, float blur, const std::string& name)
+{
+	Corners expected, corners;
+	Image<float> xx(im.size()), xy(im.size()), yy(im.size());
+	CVD::harrislike_corner_detect<Score, CVD::Harris::PairInserter>(im, expected, N, blur, 3.0f, xx, xy, yy);
+	CVD::harrislike_corner_detect<Score, CVD::Harris::PairInserter>(im, corners, N, blur, 3.0f);
+
+	const std::string what = name + ", N = " + std::to_string(N) + ", blur = " + std::to_string(blur);
+	assert_equal(expected.size(), corners.size(), "number of corners, " + what);
+	for(size_t i = 0; i < corners.size(); i++)
+	{
+		assert_equal(expected[i].second, corners[i].second, "corner " + std::to_string(i) + ", " + what);
+		assert_equal(expected[i].first, corners[i].first, "score of corner " + std::to_string(i) + ", " + what);
+	}
+}
+
+template <class B>
+void check_all(ImageRef size, std::mt19937& engine)
+{
+	Image<B> im(size);
+	// Smooth blobs on noise, so there are both strong and weak corners.
+	for(int y = 0; y < size.y; y++)
+		for(int x = 0; x < size.x; x++)
+			im[y][x] = static_cast<B>(((x / 7 + y / 5) % 3) * 60 + engine() % 40);
+
+	const std::string name = std::to_string(size.x) + "x" + std::to_string(size.y);
+	for(float blur : { 0.3f, 0.7f, 1.0f, 1.5f, 2.0f, 2.5f })
+		for(unsigned int N : { 0u, 1u, 25u, 100000u })
+		{
+			check<CVD::Harris::HarrisScore>(im, N, blur, name);
+			check<CVD::Harris::ShiTomasiScore>(im, N, blur, name);
+		}
+}
+
+int main()
+{
+	std::mt19937 engine;
+	for(ImageRef size : { ImageRef(3, 3), ImageRef(6, 40), ImageRef(40, 6), ImageRef(13, 14), ImageRef(97, 61), ImageRef(200, 150) })
+	{
+		check_all<CVD::byte>(size, engine);
+		check_all<float>(size, engine);
+	}
+}
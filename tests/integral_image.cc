@@ -0,0 +1,117 @@
+#include "test_utility.h"
+
+#include <cvd/integral_image.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+using CVD::BasicImage;
+using CVD::Image;
+using CVD::ImageRef;
+using CVD::Testing::assert_equal;
+using CVD::Testing::assert_image_equal;
+
+template <class D, class S>
+D naive_sum(const BasicImage<S>& in, ImageRef top_left, ImageRef size, bool squared)
+{
+	D sum = 0;
+	for(int y = top_left.y; y < top_left.y + size.y; y++)
+		for(int x = top_left.x; x < top_left.x + size.x; x++)
+			sum += squared ? static_cast<D>(in[y][x]) * in[y][x] : static_cast<D>(in[y][x]);
+	return sum;
+}
+
+template <class D, class S>
+D naive_tilted(const BasicImage<S>& in, int x, int y)
+{
+	D sum = 0;
+	for(int yy = 0; yy <= y; yy++)
+		for(int xx = 0; xx < in.size().x; xx++)
+			if(std::abs(x - xx) <= y - yy)
+				sum += in[yy][xx];
+	return sum;
+}
+
+template <class S, class D>
+void check(ImageRef size, std::mt19937& engine)
+{
+	const std::string name = std::to_string(size.x) + "x" + std::to_string(size.y);
+
+	Image<S> in(size);
+	for(auto& p : in)
+		p = static_cast<S>(engine() % 256);
+
+	Image<D> expected(size), expected_squared(size), expected_tilted(size);
+	for(int y = 0; y < size.y; y++)
+		for(int x = 0; x < size.x; x++)
+		{
+			expected[y][x] = naive_sum<D>(in, ImageRef(0, 0), ImageRef(x + 1, y + 1), false);
+			expected_squared[y][x] = naive_sum<D>(in, ImageRef(0, 0), ImageRef(x + 1, y + 1), true);
+			expected_tilted[y][x] = naive_tilted<D>(in, x, y);
+		}
+
+	Image<D> integral = CVD::integral_image(in);
+	Image<D> squared = CVD::integral_image_squared(in);
+	Image<D> tilted = CVD::tilted_integral_image(in);
+	assert_image_equal(expected, integral, "integral_image, " + name);
+	assert_image_equal(expected_squared, squared, "integral_image_squared, " + name);
+	assert_image_equal(expected_tilted, tilted, "tilted_integral_image, " + name);
+
+	// Rectangles of every position for a few sizes, one at a time, in a batch and densely.
+	for(ImageRef r : { ImageRef(1, 1), ImageRef(3, 2), ImageRef(size.x, 1), ImageRef(1, size.y), size })
+	{
+		if(r.x > size.x || r.y > size.y)
+			continue;
+
+		std::vector<ImageRef> corners;
+		Image<D> naive(size - r + ImageRef(1, 1));
+		for(int y = 0; y + r.y <= size.y; y++)
+			for(int x = 0; x + r.x <= size.x; x++)
+			{
+				corners.push_back(ImageRef(x, y));
+				naive[y][x] = naive_sum<D>(in, ImageRef(x, y), r, false);
+				assert_equal(naive[y][x], CVD::rectangle_sum(integral, ImageRef(x, y), r), "rectangle_sum at " + std::to_string(x) + "," + std::to_string(y) + ", " + name);
+			}
+
+		std::vector<D> sums;
+		CVD::rectangle_sums(integral, corners, r, sums);
+		assert_equal(corners.size(), sums.size(), "rectangle_sums of a list, " + name);
+		for(size_t i = 0; i < corners.size(); i++)
+			assert_equal(naive[corners[i]], sums[i], "rectangle_sums of a list, " + name);
+
+		Image<D> dense(naive.size());
+		CVD::rectangle_sums(integral, r, dense);
+		assert_image_equal(naive, dense, "rectangle_sums of every position, " + name);
+	}
+
+	// Tilted rectangles, including ones cut by the sides and top of the image
+	for(int y = -3; y < size.y; y++)
+		for(int x = -3; x < size.x + 3; x++)
+			for(int width = 1; width <= 3; width++)
+				for(int height = 1; height <= 3; height++)
+				{
+					if(y + width + height - 1 >= size.y)
+						continue;
+					D sum = 0;
+					for(int i = 0; i < width; i++)
+						for(int j = 0; j < height; j++)
+							for(int k = 0; k < 2; k++)
+							{
+								const ImageRef p(x + i - j, y + i + j + k);
+								if(in.in_image(p))
+									sum += in[p];
+							}
+					assert_equal(sum, CVD::tilted_rectangle_sum(tilted, ImageRef(x, y), width, height), "tilted_rectangle_sum at " + std::to_string(x) + "," + std::to_string(y) + ", " + name);
+				}
+}
+
+int main()
+{
+	std::mt19937 engine;
+	for(ImageRef size : { ImageRef(1, 1), ImageRef(1, 9), ImageRef(9, 1), ImageRef(2, 7), ImageRef(17, 13), ImageRef(40, 150) })
+	{
+		check<CVD::byte, int>(size, engine);
+		check<float, double>(size, engine);
+	}
+}
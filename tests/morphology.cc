@@ -0,0 +1,211 @@
+#include "test_utility.h"
+
+#include <cvd/binary_image.h>
+#include <cvd/connected_components.h>
+#include <cvd/distance_transform.h>
+#include <cvd/morphology.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+
+using CVD::BasicImage;
+using CVD::Image;
+using CVD::ImageRef;
+using CVD::Testing::assert_equal;
+using CVD::Testing::assert_image_equal;
+namespace Morphology = CVD::Morphology;
+
+// The general histogram based morphology() serves as the reference.
+template <class T>
+void check(ImageRef size, ImageRef lo, ImageRef hi, std::mt19937& engine)
+{
+	std::uniform_int_distribution<int> value(0, 255);
+	Image<T> in(size), expected(size), actual(size);
+	for(auto& p : in)
+		p = static_cast<T>(value(engine));
+
+	std::vector<ImageRef> selem;
+	for(int y = lo.y; y <= hi.y; y++)
+		for(int x = lo.x; x <= hi.x; x++)
+			selem.push_back(ImageRef(x, y));
+
+	const std::string name = "rectangle from " + std::to_string(lo.x) + "," + std::to_string(lo.y) + " to " + std::to_string(hi.x) + "," + std::to_string(hi.y);
+
+	CVD::morphology<Morphology::Erode<T>, T>(in, selem, Morphology::Erode<T>(), expected);
+	CVD::erodeRectangle(in, lo, hi, actual);
+	assert_image_equal(expected, actual, "erodeRectangle, " + name);
+
+	CVD::morphology<Morphology::Dilate<T>, T>(in, selem, Morphology::Dilate<T>(), expected);
+	CVD::dilateRectangle(in, lo, hi, actual);
+	assert_image_equal(expected, actual, "dilateRectangle, " + name);
+
+	// Automatic selection, in place.
+	actual.copy_from(in);
+	CVD::morphology(actual, selem, Morphology::Dilate<T>(), actual);
+	assert_image_equal(expected, actual, "morphology with a rectangle, " + name);
+
+	// Opening is anti-extensive and idempotent.
+	Image<T> opened(size);
+	CVD::openRectangle(in, lo, hi, opened);
+	CVD::openRectangle(opened, lo, hi, actual);
+	assert_image_equal(opened, actual, "openRectangle is not idempotent, " + name);
+	for(int y = 0; y < size.y; y++)
+		for(int x = 0; x < size.x; x++)
+			assert_equal(true, opened[y][x] <= in[y][x], "openRectangle is not anti-extensive at " + std::to_string(x) + "," + std::to_string(y) + ", " + name);
+}
+
+// Sort the cropped window. For an even number of pixels, Morphology::Median takes the
+// upper of the two middle values.
+template <class T>
+Image<T> naive_median(const BasicImage<T>& in, int r)
+{
+	Image<T> out(in.size());
+	for(int y = 0; y < in.size().y; y++)
+		for(int x = 0; x < in.size().x; x++)
+		{
+			std::vector<T> v;
+			for(int j = std::max(0, y - r); j <= std::min(in.size().y - 1, y + r); j++)
+				for(int i = std::max(0, x - r); i <= std::min(in.size().x - 1, x + r); i++)
+					v.push_back(in[j][i]);
+			std::sort(v.begin(), v.end());
+			out[y][x] = v[v.size() / 2];
+		}
+	return out;
+}
+
+void check_median(int r, std::mt19937& engine)
+{
+	const std::string name = "radius " + std::to_string(r);
+
+	Image<CVD::byte> in(ImageRef(53, 41)), out(in.size());
+	for(auto& p : in)
+		p = static_cast<CVD::byte>(engine() % 256);
+	CVD::median_filter(in, r, out);
+	assert_image_equal(naive_median(in, r), out, "byte median_filter, " + name);
+
+	std::vector<ImageRef> square;
+	for(int y = -r; y <= r; y++)
+		for(int x = -r; x <= r; x++)
+			square.push_back(ImageRef(x, y));
+	CVD::morphology<Morphology::Median<CVD::byte>, CVD::byte>(in, square, Morphology::Median<CVD::byte>(), out);
+	assert_image_equal(naive_median(in, r), out, "histogram median, " + name);
+
+	for(int bits : { 12, 16 })
+	{
+		Image<unsigned short> in16(ImageRef(70, 33)), out16(in16.size());
+		for(auto& p : in16)
+			p = static_cast<unsigned short>(engine() % (1 << bits));
+		CVD::median_filter(in16, r, out16, bits);
+		assert_image_equal(naive_median(in16, r), out16, std::to_string(bits) + " bit median_filter, " + name);
+	}
+
+	// Values which do not fit in the bits are taken as the largest which does.
+	for(int bits : { 4, 10 })
+	{
+		Image<unsigned short> in16(ImageRef(40, 21)), clamped(in16.size()), out16(in16.size());
+		for(int y = 0; y < in16.size().y; y++)
+			for(int x = 0; x < in16.size().x; x++)
+			{
+				in16[y][x] = static_cast<unsigned short>(engine() % (4 << bits));
+				clamped[y][x] = std::min(in16[y][x], static_cast<unsigned short>((1 << bits) - 1));
+			}
+		CVD::median_filter(in16, r, out16, bits);
+		assert_image_equal(naive_median(clamped, r), out16, std::to_string(bits) + " bit median_filter of larger values, " + name);
+	}
+}
+
+// Erosion or dilation of a 0/255 image, by direct evaluation of the cropped window.
+Image<CVD::byte> naive_binary(const BasicImage<CVD::byte>& in, ImageRef lo, ImageRef hi, bool erode)
+{
+	Image<CVD::byte> out(in.size());
+	for(int y = 0; y < in.size().y; y++)
+		for(int x = 0; x < in.size().x; x++)
+		{
+			bool v = erode;
+			for(int j = y + lo.y; j <= y + hi.y; j++)
+				for(int i = x + lo.x; i <= x + hi.x; i++)
+					if(in.in_image(ImageRef(i, j)))
+						v = erode ? v && in[j][i] : v || in[j][i];
+			out[y][x] = v ? 255 : 0;
+		}
+	return out;
+}
+
+void check_binary(ImageRef size, ImageRef lo, ImageRef hi, int density, std::mt19937& engine)
+{
+	const std::string name = std::to_string(size.x) + "x" + std::to_string(size.y) + " rectangle from " + std::to_string(lo.x) + "," + std::to_string(lo.y) + " to " + std::to_string(hi.x) + "," + std::to_string(hi.y);
+
+	Image<CVD::byte> in(size), unpacked(size);
+	size_t area = 0;
+	for(auto& p : in)
+	{
+		p = static_cast<CVD::byte>(engine() % 100);
+		area += p >= density;
+	}
+
+	const CVD::BinaryImage b(in, static_cast<CVD::byte>(density - 1));
+	assert_equal(area, b.count(), "BinaryImage::count, " + name);
+
+	CVD::binary_unpack(b, unpacked);
+	for(auto& p : in)
+		p = p >= density ? 255 : 0;
+	assert_image_equal(in, unpacked, "binary_threshold, " + name);
+
+	CVD::BinaryImage out;
+	CVD::erodeRectangle(b, lo, hi, out);
+	CVD::binary_unpack(out, unpacked);
+	assert_image_equal(naive_binary(in, lo, hi, true), unpacked, "binary erodeRectangle, " + name);
+
+	out = b;
+	CVD::dilateRectangle(out, lo, hi, out);
+	CVD::binary_unpack(out, unpacked);
+	assert_image_equal(naive_binary(in, lo, hi, false), unpacked, "binary dilateRectangle in place, " + name);
+
+	// Logical operations must keep the padding clear for count() to work.
+	const size_t both = (b & out).count();
+	assert_equal(static_cast<size_t>(size.area()) - area, (~b).count(), "BinaryImage operator~, " + name);
+	assert_equal(area + out.count() - 2 * both, (b ^ out).count(), "BinaryImage operator^, " + name);
+	assert_equal(area + out.count() - both, (b | out).count(), "BinaryImage operator|, " + name);
+
+	if(area == 0)
+		return;
+
+	Image<int> expected_dt(size), dt(size);
+	CVD::euclidean_distance_transform_sq(in, expected_dt);
+	CVD::euclidean_distance_transform_sq(b, dt);
+	assert_image_equal(expected_dt, dt, "euclidean_distance_transform_sq of a BinaryImage, " + name);
+
+	std::vector<ImageRef> points;
+	for(int y = 0; y < size.y; y++)
+		for(int x = 0; x < size.x; x++)
+			if(in[y][x])
+				points.push_back(ImageRef(x, y));
+	std::vector<std::vector<ImageRef>> expected_cc, cc;
+	CVD::connected_components(points, expected_cc);
+	CVD::connected_components(b, cc);
+	assert_equal(true, expected_cc == cc, "connected_components of a BinaryImage, " + name);
+}
+
+int main()
+{
+	std::mt19937 engine;
+
+	check<CVD::byte>(ImageRef(37, 29), ImageRef(-2, -1), ImageRef(2, 3), engine);
+	check<CVD::byte>(ImageRef(37, 29), ImageRef(-7, 0), ImageRef(7, 0), engine);
+	check<CVD::byte>(ImageRef(37, 29), ImageRef(0, -5), ImageRef(0, 4), engine);
+	check<CVD::byte>(ImageRef(5, 70), ImageRef(-3, -3), ImageRef(3, 3), engine);
+	check<CVD::byte>(ImageRef(100, 40), ImageRef(-1, -20), ImageRef(1, 20), engine);
+	check<unsigned short>(ImageRef(64, 50), ImageRef(-4, -9), ImageRef(4, 9), engine);
+	check<float>(ImageRef(37, 29), ImageRef(-1, -1), ImageRef(3, 2), engine);
+
+	for(int r : { 0, 1, 2, 5, 13 })
+		check_median(r, engine);
+
+	check_binary(ImageRef(130, 37), ImageRef(-2, -1), ImageRef(2, 3), 50, engine);
+	check_binary(ImageRef(64, 20), ImageRef(-70, 0), ImageRef(3, 0), 90, engine);
+	check_binary(ImageRef(200, 30), ImageRef(-67, -2), ImageRef(66, 1), 98, engine);
+	check_binary(ImageRef(77, 50), ImageRef(3, -9), ImageRef(9, -4), 70, engine);
+	check_binary(ImageRef(1, 9), ImageRef(0, -1), ImageRef(0, 1), 50, engine);
+	check_binary(ImageRef(150, 20), ImageRef(-5, -5), ImageRef(5, 5), 101, engine);
+}
@@ -0,0 +1,239 @@
+#include "test_utility.h"
+
+#include <cvd/nonmax_suppression.h>
+#include <cvd/vision_exceptions.h>
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using CVD::BasicImage;
+using CVD::Image;
+using CVD::ImageRef;
+using CVD::Testing::assert_equal;
+using CVD::Testing::assert_image_equal;
+using CVD::Testing::assert_vector_equal;
+
+// Compare each pixel with every other pixel of its cropped window.
+template <class T>
+Image<CVD::byte> naive_nonmax(const BasicImage<T>& scores, int r, T threshold, bool strict)
+{
+	Image<CVD::byte> mask(scores.size(), 0);
+	for(int y = 0; y < scores.size().y; y++)
+		for(int x = 0; x < scores.size().x; x++)
+		{
+			const T s = scores[y][x];
+			bool is_max = s >= threshold;
+			for(int dy = -r; dy <= r && is_max; dy++)
+				for(int dx = -r; dx <= r && is_max; dx++)
+				{
+					const ImageRef p(x + dx, y + dy);
+					if((dx || dy) && scores.in_image(p))
+						is_max = strict ? s > scores[p] : s >= scores[p];
+				}
+			mask[y][x] = is_max ? 255 : 0;
+		}
+	return mask;
+}
+
+template <class T>
+void check(const BasicImage<T>& scores, int r, T threshold, const std::string& name)
+{
+	for(bool strict : { false, true })
+	{
+		const std::string what = name + ", radius " + std::to_string(r) + (strict ? ", strict" : "");
+		const Image<CVD::byte> expected = naive_nonmax(scores, r, threshold, strict);
+
+		Image<CVD::byte> mask(scores.size(), 7);
+		if(strict)
+			CVD::nonmax_suppression_strict(scores, r, mask, threshold);
+		else
+			CVD::nonmax_suppression(scores, r, mask, threshold);
+		assert_image_equal(expected, mask, "mask, " + what);
+
+		std::vector<std::pair<ImageRef, T>> maxima(3), expected_maxima;
+		if(strict)
+			CVD::nonmax_suppression_strict_with_scores(scores, r, maxima, threshold);
+		else
+			CVD::nonmax_suppression_with_scores(scores, r, maxima, threshold);
+
+		for(int y = 0; y < scores.size().y; y++)
+			for(int x = 0; x < scores.size().x; x++)
+				if(expected[y][x])
+					expected_maxima.push_back(std::make_pair(ImageRef(x, y), scores[y][x]));
+		assert_equal(expected_maxima.size(), maxima.size(), "number of maxima, " + what);
+		for(size_t i = 0; i < maxima.size(); i++)
+		{
+			assert_equal(expected_maxima[i].first, maxima[i].first, "list of maxima, " + what);
+			assert_equal(expected_maxima[i].second, maxima[i].second, "list of maxima, " + what);
+		}
+	}
+}
+
+template <class T, class Value>
+void check_sizes(Value value, T threshold, const std::string& type, std::mt19937& engine)
+{
+	const ImageRef sizes[] = { ImageRef(1, 1), ImageRef(1, 9), ImageRef(9, 1), ImageRef(4, 3), ImageRef(37, 29), ImageRef(101, 80) };
+	for(ImageRef size : sizes)
+	{
+		Image<T> scores(size);
+		for(T& s : scores)
+			s = value(engine);
+
+		const std::string name = type + ", " + std::to_string(size.x) + "x" + std::to_string(size.y);
+		for(int r : { 1, 2, 3, 4, 5, 8 })
+		{
+			check<T>(scores, r, std::numeric_limits<T>::lowest(), name);
+			check<T>(scores, r, threshold, name + ", thresholded");
+		}
+	}
+}
+
+// Order the corners by descending score, with ties in the order of the input.
+template <class T>
+std::vector<int> by_score(const std::vector<T>& scores)
+{
+	std::vector<int> order(scores.size());
+	for(size_t i = 0; i < order.size(); i++)
+		order[i] = static_cast<int>(i);
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return scores[a] > scores[b]; });
+	return order;
+}
+
+long long distance2(ImageRef a, ImageRef b)
+{
+	const long long dx = a.x - b.x, dy = a.y - b.y;
+	return dx * dx + dy * dy;
+}
+
+template <class T>
+std::vector<ImageRef> naive_anms(const std::vector<ImageRef>& corners, const std::vector<T>& scores, int count, double robustness)
+{
+	const std::vector<int> order = by_score(scores);
+	std::vector<std::pair<long long, int>> radii;
+	for(size_t i = 0; i < order.size(); i++)
+	{
+		long long r = std::numeric_limits<long long>::max();
+		for(size_t j = 0; j < corners.size(); j++)
+			if(robustness * scores[j] > scores[order[i]])
+				r = std::min(r, distance2(corners[j], corners[order[i]]));
+		radii.push_back(std::make_pair(-r, static_cast<int>(i)));
+	}
+	std::sort(radii.begin(), radii.end());
+
+	std::vector<ImageRef> selected;
+	for(size_t i = 0; i < radii.size() && static_cast<int>(i) < count; i++)
+		selected.push_back(corners[order[radii[i].second]]);
+	return selected;
+}
+
+template <class T>
+std::vector<ImageRef> naive_radius(const std::vector<ImageRef>& corners, const std::vector<T>& scores, int radius, size_t count)
+{
+	std::vector<ImageRef> selected;
+	for(int i : by_score(scores))
+	{
+		bool keep = selected.size() < count;
+		for(const ImageRef& s : selected)
+			keep = keep && distance2(s, corners[i]) > static_cast<long long>(radius) * radius;
+		if(keep)
+			selected.push_back(corners[i]);
+	}
+	return selected;
+}
+
+template <class T, class Value>
+void check_sparse(int n, ImageRef size, Value value, std::mt19937& engine)
+{
+	std::vector<ImageRef> corners;
+	std::vector<T> scores;
+	for(int i = 0; i < n; i++)
+	{
+		// Half the corners are in a cluster.
+		const ImageRef extent = i % 2 ? size : size / 8 + ImageRef(1, 1);
+		corners.push_back(ImageRef(static_cast<int>(engine() % extent.x), static_cast<int>(engine() % extent.y)));
+		scores.push_back(value(engine));
+	}
+
+	const std::string name = std::to_string(n) + " corners in " + std::to_string(size.x) + "x" + std::to_string(size.y);
+	std::vector<ImageRef> selected;
+
+	for(double robustness : { 1.0, 0.9 })
+	{
+		// Robustness is only meaningful for scores which are not negative.
+		if(robustness < 1 && n && *std::min_element(scores.begin(), scores.end()) < 0)
+			continue;
+
+		const std::vector<ImageRef> all = naive_anms(corners, scores, n, robustness);
+		for(int count : { 0, 1, 2, 10, 100, n - 1, n, n + 5 })
+		{
+			if(count < 0)
+				continue;
+			CVD::adaptive_nonmax_suppression(corners, scores, count, selected, robustness);
+			assert_vector_equal(std::vector<ImageRef>(all.begin(), all.begin() + std::min(count, n)), selected,
+			    "adaptive_nonmax_suppression, " + name + ", count " + std::to_string(count) + ", robustness " + std::to_string(robustness));
+		}
+	}
+
+	for(int radius : { 0, 1, 3, 10, 1000 })
+		for(size_t count : { size_t(5), std::numeric_limits<size_t>::max() })
+		{
+			CVD::radius_nonmax_suppression(corners, scores, radius, selected, count);
+			assert_vector_equal(naive_radius(corners, scores, radius, count), selected, "radius_nonmax_suppression, " + name + ", radius " + std::to_string(radius));
+		}
+}
+
+int main()
+{
+	std::mt19937 engine;
+
+	std::uniform_int_distribution<int> fast_scores(20, 40);
+	std::uniform_real_distribution<float> harris_scores(0, 1);
+	for(int n : { 0, 1, 2, 50, 700 })
+	{
+		check_sparse<int>(n, ImageRef(200, 150), [&](std::mt19937& e) { return fast_scores(e); }, engine);
+		check_sparse<float>(n, ImageRef(640, 30), [&](std::mt19937& e) { return harris_scores(e); }, engine);
+	}
+	check_sparse<int>(300, ImageRef(1, 1000), [&](std::mt19937& e) { return fast_scores(e); }, engine);
+
+	// Negative scores and ties between 0 and -0.
+	const float float_values[] = { -2.5f, -1.f, -0.f, 0.f, 0.5f, 1e30f };
+	check_sparse<float>(400, ImageRef(100, 100), [&](std::mt19937& e) { return float_values[e() % 6]; }, engine);
+
+	// Few values, so there are many ties.
+	std::uniform_int_distribution<int> few(0, 5);
+	check_sizes<int>([&](std::mt19937& e) { return few(e); }, 3, "int, few values", engine);
+	check_sizes<float>([&](std::mt19937& e) { return few(e) * 0.5f; }, 1.5f, "float, few values", engine);
+
+	std::uniform_int_distribution<int> many(-1000000, 1000000);
+	check_sizes<int>([&](std::mt19937& e) { return many(e); }, 0, "int", engine);
+	std::normal_distribution<float> normal;
+	check_sizes<float>([&](std::mt19937& e) { return normal(e); }, 0.5f, "float", engine);
+
+	// Constant scores, extreme values and a strip taller than one band.
+	Image<int> flat(ImageRef(20, 15), std::numeric_limits<int>::lowest());
+	check<int>(flat, 1, std::numeric_limits<int>::lowest(), "int, lowest value");
+	flat[7][3] = std::numeric_limits<int>::max();
+	check<int>(flat, 2, std::numeric_limits<int>::lowest(), "int, extreme values");
+
+	Image<float> tall(ImageRef(23, 300));
+	for(float& s : tall)
+		s = static_cast<float>(few(engine));
+	for(int r : { 1, 3, 20, 40 })
+		check<float>(tall, r, 1.f, "float, 23x300");
+
+	bool thrown = false;
+	try
+	{
+		Image<CVD::byte> mask(tall.size());
+		CVD::nonmax_suppression(tall, 0, mask);
+	}
+	catch(const CVD::Exceptions::Vision::BadInput&)
+	{
+		thrown = true;
+	}
+	assert_equal(true, thrown, "radius 0 accepted");
+}
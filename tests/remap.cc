@@ -0,0 +1,262 @@
+#include "test_utility.h"
+
+#include <cvd/remap.h>
+#include <cvd/vision.h>
+#include <cvd/vision_exceptions.h>
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef CVD_HAVE_TOON
+#include <cvd/camera.h>
+#endif
+
+using CVD::BasicImage;
+using CVD::Image;
+using CVD::ImageRef;
+using CVD::RemapFormat;
+using CVD::RemapTable;
+using CVD::Rgb;
+using CVD::Testing::assert_equal;
+using CVD::Testing::assert_image_equal;
+using CVD::Testing::assert_near;
+
+struct Point
+{
+	double x, y;
+};
+
+// The point rounded as the table stores it, the square around it and the
+// fractions across the square in 1/65536 of a pixel.
+struct Square
+{
+	int x, y, fx, fy;
+};
+
+Square square(Point p, ImageRef source, RemapFormat format)
+{
+	const double scale = format == RemapFormat::Fixed16 ? 65536 : 256;
+	const long long sx = std::llround(p.x * scale) * static_cast<long long>(65536 / scale);
+	const long long sy = std::llround(p.y * scale) * static_cast<long long>(65536 / scale);
+	Square s;
+	s.x = std::min(static_cast<int>(sx / 65536), source.x - 2);
+	s.y = std::min(static_cast<int>(sy / 65536), source.y - 2);
+	s.fx = static_cast<int>(sx - s.x * 65536LL);
+	s.fy = static_cast<int>(sy - s.y * 65536LL);
+	return s;
+}
+
+bool inside(Point p, ImageRef source)
+{
+	return source.x >= 2 && source.y >= 2 && p.x >= 0 && p.y >= 0 && p.x <= source.x - 1 && p.y <= source.y - 1;
+}
+
+int interpolate(Square s, int a, int b, int c, int d)
+{
+	const int wx = (s.fx + 128) / 256, wy = (s.fy + 128) / 256;
+	const int top = a * (256 - wx) + b * wx, bottom = c * (256 - wx) + d * wx;
+	return (top * (256 - wy) + bottom * wy + 32768) >> 16;
+}
+
+template <class T>
+void naive_remap(const BasicImage<T>& in, const BasicImage<Point>& points, RemapFormat format, BasicImage<T>& out, T default_value);
+
+template <>
+void naive_remap(const BasicImage<CVD::byte>& in, const BasicImage<Point>& points, RemapFormat format, BasicImage<CVD::byte>& out, CVD::byte default_value)
+{
+	for(int y = 0; y < out.size().y; y++)
+		for(int x = 0; x < out.size().x; x++)
+		{
+			const Point p = points[y][x];
+			if(!inside(p, in.size()))
+			{
+				out[y][x] = default_value;
+				continue;
+			}
+			const Square s = square(p, in.size(), format);
+			out[y][x] = static_cast<CVD::byte>(interpolate(s, in[s.y][s.x], in[s.y][s.x + 1], in[s.y + 1][s.x], in[s.y + 1][s.x + 1]));
+		}
+}
+
+template <>
+void naive_remap(const BasicImage<Rgb<CVD::byte>>& in, const BasicImage<Point>& points, RemapFormat format, BasicImage<Rgb<CVD::byte>>& out, Rgb<CVD::byte> default_value)
+{
+	for(int y = 0; y < out.size().y; y++)
+		for(int x = 0; x < out.size().x; x++)
+		{
+			const Point p = points[y][x];
+			if(!inside(p, in.size()))
+			{
+				out[y][x] = default_value;
+				continue;
+			}
+			const Square s = square(p, in.size(), format);
+			const Rgb<CVD::byte> a = in[s.y][s.x], b = in[s.y][s.x + 1], c = in[s.y + 1][s.x], d = in[s.y + 1][s.x + 1];
+			out[y][x] = Rgb<CVD::byte>(static_cast<CVD::byte>(interpolate(s, a.red, b.red, c.red, d.red)),
+			    static_cast<CVD::byte>(interpolate(s, a.green, b.green, c.green, d.green)),
+			    static_cast<CVD::byte>(interpolate(s, a.blue, b.blue, c.blue, d.blue)));
+		}
+}
+
+template <>
+void naive_remap(const BasicImage<float>& in, const BasicImage<Point>& points, RemapFormat format, BasicImage<float>& out, float default_value)
+{
+	for(int y = 0; y < out.size().y; y++)
+		for(int x = 0; x < out.size().x; x++)
+		{
+			const Point p = points[y][x];
+			if(!inside(p, in.size()))
+			{
+				out[y][x] = default_value;
+				continue;
+			}
+			const Square s = square(p, in.size(), format);
+			const double fx = s.fx / 65536.0, fy = s.fy / 65536.0;
+			out[y][x] = static_cast<float>((1 - fy) * ((1 - fx) * in[s.y][s.x] + fx * in[s.y][s.x + 1]) + fy * ((1 - fx) * in[s.y + 1][s.x] + fx * in[s.y + 1][s.x + 1]));
+		}
+}
+
+void compare(const BasicImage<float>& expected, const BasicImage<float>& actual, const std::string& what)
+{
+	for(int y = 0; y < expected.size().y; y++)
+		for(int x = 0; x < expected.size().x; x++)
+			assert_near(expected[y][x], actual[y][x], 1e-4f * std::max(1.f, std::abs(expected[y][x])), what + ": wrong value at " + std::to_string(x) + ", " + std::to_string(y));
+}
+
+template <class T>
+void compare(const BasicImage<T>& expected, const BasicImage<T>& actual, const std::string& what)
+{
+	assert_image_equal(expected, actual, what);
+}
+
+template <class T>
+void check(const BasicImage<T>& in, const BasicImage<Point>& points, T default_value, const std::string& name)
+{
+	for(RemapFormat format : { RemapFormat::Fixed16, RemapFormat::Split })
+	{
+		const std::string what = name + (format == RemapFormat::Fixed16 ? ", 16.16" : ", split");
+		RemapTable table(in.size(), points.size(), format);
+		for(int y = 0; y < points.size().y; y++)
+			for(int x = 0; x < points.size().x; x++)
+				table.set(ImageRef(x, y), points[y][x].x, points[y][x].y);
+
+		for(int y = 0; y < points.size().y; y++)
+			for(int x = 0; x < points.size().x; x++)
+				assert_equal(inside(points[y][x], in.size()), table.valid(ImageRef(x, y)), what + ": valid at " + std::to_string(x) + ", " + std::to_string(y));
+
+		Image<T> expected(points.size()), out(points.size());
+		naive_remap(in, points, format, expected, default_value);
+		CVD::remap(in, table, out, default_value);
+		compare(expected, out, what);
+	}
+}
+
+int main()
+{
+	std::mt19937 engine;
+
+	const ImageRef sizes[][2] = {
+		{ ImageRef(1, 1), ImageRef(5, 3) },
+		{ ImageRef(2, 2), ImageRef(7, 9) },
+		{ ImageRef(1, 8), ImageRef(4, 4) },
+		{ ImageRef(37, 23), ImageRef(150, 41) },
+		{ ImageRef(300, 20), ImageRef(64, 130) },
+	};
+	for(const auto& s : sizes)
+	{
+		const ImageRef source = s[0], size = s[1];
+
+		Image<CVD::byte> bytes(source);
+		Image<Rgb<CVD::byte>> colour(source);
+		Image<float> floats(source);
+		for(int y = 0; y < source.y; y++)
+			for(int x = 0; x < source.x; x++)
+			{
+				bytes[y][x] = static_cast<CVD::byte>(engine() % 256);
+				colour[y][x] = Rgb<CVD::byte>(static_cast<CVD::byte>(engine() % 256), static_cast<CVD::byte>(engine() % 256), static_cast<CVD::byte>(engine() % 256));
+				floats[y][x] = static_cast<float>(engine() % 10000) / 77;
+			}
+
+		// Points over and around the source, the corners and edges of it
+		// exactly, and points which are not numbers.
+		Image<Point> points(size);
+		std::uniform_real_distribution<double> ux(-2, source.x + 1), uy(-2, source.y + 1);
+		for(Point& p : points)
+		{
+			p.x = ux(engine);
+			p.y = uy(engine);
+			switch(engine() % 8)
+			{
+				case 0:
+					p.x = std::floor(p.x);
+					break;
+				case 1:
+					p.x = source.x - 1;
+					break;
+				case 2:
+					p.y = source.y - 1;
+					break;
+				case 3:
+					p.x = std::numeric_limits<double>::quiet_NaN();
+					break;
+			}
+		}
+
+		const std::string name = std::to_string(source.x) + "x" + std::to_string(source.y) + " to " + std::to_string(size.x) + "x" + std::to_string(size.y);
+		check<CVD::byte>(bytes, points, 9, "byte, " + name);
+		check<Rgb<CVD::byte>>(colour, points, Rgb<CVD::byte>(1, 2, 3), "Rgb, " + name);
+		check<float>(floats, points, -1.5f, "float, " + name);
+	}
+
+#ifdef CVD_HAVE_TOON
+	// Undistorting with a table is the same as warp().
+	{
+		Image<float> im(ImageRef(80, 60));
+		for(float& p : im)
+			p = static_cast<float>(engine() % 1000);
+		CVD::Camera::Quintic distorted;
+		distorted.get_parameters() = TooN::makeVector(60, 62, 40, 31, -0.1, 0.02);
+		CVD::Camera::Linear linear;
+		linear.get_parameters() = TooN::makeVector(55, 55, 45, 28);
+
+		const Image<float> expected = CVD::warp(im, distorted, ImageRef(90, 56), linear);
+		const RemapTable table = CVD::make_remap_table(distorted, im.size(), linear, ImageRef(90, 56));
+		Image<float> out(ImageRef(90, 56));
+		CVD::remap(im, table, out);
+		for(int y = 0; y < out.size().y; y++)
+			for(int x = 0; x < out.size().x; x++)
+			{
+				// warp() leaves the last row and column out, and samples
+				// with double coordinates.
+				const TooN::Vector<2> l = distorted.project(linear.unproject(TooN::makeVector(x, y)));
+				if(l[0] >= im.size().x - 2 || l[1] >= im.size().y - 2)
+					continue;
+				assert_near(expected[y][x], out[y][x], 0.05f, "remap differs from warp at " + std::to_string(x) + ", " + std::to_string(y));
+			}
+	}
+#endif
+
+	int thrown = 0;
+	try
+	{
+		const RemapTable table(ImageRef(40000, 10), ImageRef(10, 10));
+	}
+	catch(const CVD::Exceptions::Vision::BadInput&)
+	{
+		thrown++;
+	}
+	try
+	{
+		const RemapTable table(ImageRef(10, 10), ImageRef(10, 10));
+		Image<float> in(ImageRef(10, 11)), out(ImageRef(10, 10));
+		CVD::remap(in, table, out);
+	}
+	catch(const CVD::Exceptions::Vision::IncompatibleImageSizes&)
+	{
+		thrown++;
+	}
+	assert_equal(2, thrown, "bad arguments accepted");
+}
@@ -0,0 +1,173 @@
+#include "test_utility.h"
+
+#include <cvd/vision.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using CVD::BasicImage;
+using CVD::Image;
+using CVD::ImageRef;
+using CVD::ResampleKernel;
+using CVD::Rgb;
+using CVD::Testing::assert_equal;
+using CVD::Testing::assert_image_equal;
+using CVD::Testing::assert_near;
+
+double component(CVD::byte p, int) { return p; }
+double component(float p, int) { return p; }
+double component(Rgb<CVD::byte> p, int c) { return c == 0 ? p.red : c == 1 ? p.green : p.blue; }
+
+int channels(CVD::byte) { return 1; }
+int channels(float) { return 1; }
+int channels(Rgb<CVD::byte>) { return 3; }
+
+double kernel(ResampleKernel k, double x, double& support)
+{
+	const double pi = 3.14159265358979323846;
+	auto sinc = [pi](double t) { return t == 0 ? 1 : std::sin(pi * t) / (pi * t); };
+	x = std::abs(x);
+	switch(k)
+	{
+		case ResampleKernel::Box:
+			support = 0.5;
+			return x < 0.5 ? 1 : x == 0.5 ? 0.5 : 0;
+		case ResampleKernel::Triangle:
+			support = 1;
+			return x < 1 ? 1 - x : 0;
+		case ResampleKernel::Bicubic:
+			support = 2;
+			return x < 1 ? 1.5 * x * x * x - 2.5 * x * x + 1 : x < 2 ? -0.5 * x * x * x + 2.5 * x * x - 4 * x + 2 : 0;
+		default:
+			support = 3;
+			return x < 3 ? sinc(x) * sinc(x / 3) : 0;
+	}
+}
+
+// The normalised weights of the n input pixels for output i of m.
+std::vector<double> weights(ResampleKernel k, int n, int m, int i)
+{
+	const double scale = static_cast<double>(n) / m, stretch = std::max(1.0, scale);
+	const double c = (i + 0.5) * scale - 0.5;
+	std::vector<double> w(n);
+	double sum = 0, support;
+	for(int j = 0; j < n; j++)
+	{
+		w[j] = kernel(k, (j - c) / stretch, support);
+		sum += w[j];
+	}
+	if(sum == 0)
+	{
+		w[std::min(n - 1, std::max(0, static_cast<int>(std::floor(c + 0.5))))] = sum = 1;
+	}
+	for(double& v : w)
+		v /= sum;
+	return w;
+}
+
+template <class T>
+void check(const BasicImage<T>& in, ImageRef size, const std::string& name)
+{
+	for(ResampleKernel k : { ResampleKernel::Box, ResampleKernel::Triangle, ResampleKernel::Bicubic, ResampleKernel::Lanczos3 })
+	{
+		const std::string what = name + " to " + std::to_string(size.x) + "x" + std::to_string(size.y) + ", kernel " + std::to_string(static_cast<int>(k));
+		const Image<T> out = CVD::resample(in, size, k);
+
+		std::vector<std::vector<double>> wx(size.x);
+		for(int x = 0; x < size.x; x++)
+			wx[x] = weights(k, in.size().x, size.x, x);
+
+		for(int c = 0; c < channels(T()); c++)
+		{
+			// Filtered along the rows, then down the columns.
+			Image<double> across(ImageRef(size.x, in.size().y));
+			for(int j = 0; j < in.size().y; j++)
+				for(int x = 0; x < size.x; x++)
+				{
+					across[j][x] = 0;
+					for(int i = 0; i < in.size().x; i++)
+						across[j][x] += wx[x][i] * component(in[j][i], c);
+				}
+
+			for(int y = 0; y < size.y; y++)
+			{
+				const std::vector<double> wy = weights(k, in.size().y, size.y, y);
+				for(int x = 0; x < size.x; x++)
+				{
+					double v = 0;
+					for(int j = 0; j < in.size().y; j++)
+						v += wy[j] * across[j][x];
+
+					// Float arithmetic may round a byte the other way.
+					const std::string at = what + ": wrong value at " + std::to_string(x) + ", " + std::to_string(y);
+					if(std::is_same<T, float>::value)
+						assert_near(v, component(out[y][x], c), 1e-3 * std::max(1.0, std::abs(v)), at);
+					else
+						assert_near(std::min(255.0, std::max(0.0, v)), component(out[y][x], c), 0.5 + 1e-3, at);
+				}
+			}
+		}
+	}
+}
+
+int main()
+{
+	std::mt19937 engine;
+
+	const ImageRef sizes[] = { ImageRef(1, 1), ImageRef(3, 2), ImageRef(37, 23), ImageRef(16, 120) };
+	for(ImageRef source : sizes)
+	{
+		Image<CVD::byte> bytes(source);
+		Image<Rgb<CVD::byte>> colour(source);
+		Image<float> floats(source);
+		for(int y = 0; y < source.y; y++)
+			for(int x = 0; x < source.x; x++)
+			{
+				bytes[y][x] = static_cast<CVD::byte>(engine() % 256);
+				colour[y][x] = Rgb<CVD::byte>(static_cast<CVD::byte>(engine() % 256), static_cast<CVD::byte>(engine() % 256), static_cast<CVD::byte>(engine() % 256));
+				floats[y][x] = static_cast<float>(engine() % 10000) / 77;
+			}
+
+		// The same size, shrinking and enlarging by whole and other
+		// factors, and both at once.
+		const std::string name = std::to_string(source.x) + "x" + std::to_string(source.y);
+		const ImageRef targets[] = { source, ImageRef(1, 1), source * 2, ImageRef(source.x * 3 / 2 + 1, std::max(1, source.y / 3)), ImageRef(std::max(1, source.x / 5), source.y * 5 / 2) };
+		for(ImageRef size : targets)
+		{
+			check<CVD::byte>(bytes, size, "byte, " + name);
+			check<Rgb<CVD::byte>>(colour, size, "Rgb, " + name);
+			check<float>(floats, size, "float, " + name);
+		}
+
+		// Every kernel leaves an image the same size alone.
+		for(ResampleKernel k : { ResampleKernel::Box, ResampleKernel::Triangle, ResampleKernel::Bicubic, ResampleKernel::Lanczos3 })
+			assert_image_equal<CVD::byte>(bytes, CVD::resample(bytes, source, k), "resampling " + name + " to the same size changed it");
+	}
+
+	// Shrinking by two with a box averages squares of four pixels.
+	Image<float> im(ImageRef(10, 6));
+	for(float& p : im)
+		p = static_cast<float>(engine() % 100);
+	const Image<float> half = CVD::resample(im, ImageRef(5, 3), ResampleKernel::Box);
+	for(int y = 0; y < 3; y++)
+		for(int x = 0; x < 5; x++)
+			assert_near((im[2 * y][2 * x] + im[2 * y][2 * x + 1] + im[2 * y + 1][2 * x] + im[2 * y + 1][2 * x + 1]) / 4, half[y][x], 1e-4f, "box differs from averaging");
+
+	Image<float> empty;
+	bool thrown = false;
+	try
+	{
+		CVD::resample(empty, ImageRef(2, 2));
+	}
+	catch(const CVD::Exceptions::Vision::BadInput&)
+	{
+		thrown = true;
+	}
+	assert_equal(true, thrown, "resampling an empty image accepted");
+}
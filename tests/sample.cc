@@ -0,0 +1,200 @@
+#include "test_utility.h"
+
+#include <cvd/vision.h>
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+using CVD::BasicImage;
+using CVD::Image;
+using CVD::ImageRef;
+using CVD::SampleBorder;
+using CVD::Testing::assert_equal;
+using CVD::Testing::assert_near;
+
+template <class T>
+double pixel(const BasicImage<T>& im, int x, int y, SampleBorder border, double border_value)
+{
+	if(border == SampleBorder::Clamp)
+		return im[std::min(im.size().y - 1, std::max(0, y))][std::min(im.size().x - 1, std::max(0, x))];
+	return im.in_image(ImageRef(x, y)) ? im[y][x] : border_value;
+}
+
+// The bilinear value and its derivatives, leaving out pixels with no weight.
+template <class T>
+void naive_bilinear(const BasicImage<T>& im, double x, double y, SampleBorder border, double border_value, double& v, double& dx, double& dy)
+{
+	const int ix = static_cast<int>(std::floor(x)), iy = static_cast<int>(std::floor(y));
+	const double fx = x - ix, fy = y - iy;
+	const double a = pixel(im, ix, iy, border, border_value);
+	const double b = fx == 0 && ix + 1 == im.size().x ? a : pixel(im, ix + 1, iy, border, border_value);
+	const double c = fy == 0 && iy + 1 == im.size().y ? a : pixel(im, ix, iy + 1, border, border_value);
+	const double d = fx == 0 && ix + 1 == im.size().x ? c : fy == 0 && iy + 1 == im.size().y ? b : pixel(im, ix + 1, iy + 1, border, border_value);
+	v = (1 - fy) * ((1 - fx) * a + fx * b) + fy * ((1 - fx) * c + fx * d);
+	dx = (1 - fy) * (b - a) + fy * (d - c);
+	dy = (1 - fx) * (c - a) + fx * (d - b);
+}
+
+// As image_interpolate<Interpolate::Bicubic, T>.
+double r(double x)
+{
+	auto p = [](double f) { return f > 0 ? f * f * f : 0; };
+	return (p(x + 2) - 4 * p(x + 1) + 6 * p(x) - 4 * p(x - 1)) / 6;
+}
+
+template <class T>
+double naive_bicubic(const BasicImage<T>& im, double x, double y, SampleBorder border, double border_value)
+{
+	const int ix = static_cast<int>(std::floor(x)), iy = static_cast<int>(std::floor(y));
+	const double fx = x - ix, fy = y - iy;
+	double s = 0;
+	for(int m = -1; m < 3; m++)
+		for(int n = -1; n < 3; n++)
+			s += pixel(im, ix + m, iy + n, border, border_value) * r(m - fx) * r(fy - n);
+	return s;
+}
+
+void assert_close(double expected, float actual, const std::string& what)
+{
+	if(std::isnan(expected))
+		assert_equal(true, std::isnan(actual), what + ", not a number");
+	else
+		assert_near(expected, static_cast<double>(actual), 1e-3 * std::max(1.0, std::abs(expected)), what);
+}
+
+template <class T>
+void check(const BasicImage<T>& im, const std::vector<float>& x, const std::vector<float>& y, const std::string& name)
+{
+	const int n = static_cast<int>(x.size());
+	std::vector<float> values(n), dx(n), dy(n), plain(n), cubic(n);
+	for(SampleBorder border : { SampleBorder::Clamp, SampleBorder::Constant })
+		for(float border_value : { 0.f, 17.f, std::numeric_limits<float>::quiet_NaN() })
+		{
+			if(border == SampleBorder::Clamp && border_value != 0)
+				continue;
+			const std::string what = name + (border == SampleBorder::Clamp ? ", clamped" : ", border " + std::to_string(border_value));
+
+			CVD::sample_bilinear(im, x.data(), y.data(), n, plain.data(), border, border_value);
+			CVD::sample_bilinear_gradient(im, x.data(), y.data(), n, values.data(), dx.data(), dy.data(), border, border_value);
+			CVD::sample_bicubic(im, x.data(), y.data(), n, cubic.data(), border, border_value);
+
+			for(int i = 0; i < n; i++)
+			{
+				// Points far outside the image are all border.
+				const double cx = std::min(im.size().x + 4.0, std::max(-4.0, static_cast<double>(x[i])));
+				const double cy = std::min(im.size().y + 4.0, std::max(-4.0, static_cast<double>(y[i])));
+				const std::string at = what + ", at " + std::to_string(x[i]) + ", " + std::to_string(y[i]);
+
+				double v, ex, ey;
+				naive_bilinear(im, std::isnan(x[i]) ? -4 : cx, std::isnan(y[i]) ? -4 : cy, border, border_value, v, ex, ey);
+				assert_close(v, plain[i], "sample_bilinear, " + at);
+				assert_close(v, values[i], "sample_bilinear_gradient value, " + at);
+				assert_close(ex, dx[i], "sample_bilinear_gradient x, " + at);
+				assert_close(ey, dy[i], "sample_bilinear_gradient y, " + at);
+				assert_close(naive_bicubic(im, std::isnan(x[i]) ? -4 : cx, std::isnan(y[i]) ? -4 : cy, border, border_value), cubic[i], "sample_bicubic, " + at);
+			}
+		}
+}
+
+void check_fixed(const BasicImage<CVD::byte>& im, const std::vector<float>& x, const std::vector<float>& y, const std::string& name)
+{
+	const int n = static_cast<int>(x.size());
+	std::vector<CVD::byte> values(n);
+	for(SampleBorder border : { SampleBorder::Clamp, SampleBorder::Constant })
+	{
+		CVD::sample_bilinear(im, x.data(), y.data(), n, values.data(), border, CVD::byte(200));
+		for(int i = 0; i < n; i++)
+		{
+			if(std::isnan(x[i]) || std::isnan(y[i]) || std::abs(x[i]) > 1000 || std::abs(y[i]) > 1000)
+				continue;
+
+			const int ix = static_cast<int>(std::floor(x[i])), iy = static_cast<int>(std::floor(y[i]));
+			const int wx = static_cast<int>((x[i] - ix) * 256 + 0.5f), wy = static_cast<int>((y[i] - iy) * 256 + 0.5f);
+			double v, dx, dy;
+			naive_bilinear(im, ix + wx / 256.0, iy + wy / 256.0, border, 200, v, dx, dy);
+			assert_near(v, static_cast<double>(values[i]), 0.5 + 1e-9, "sample_bilinear to bytes, " + name + ", at " + std::to_string(x[i]) + ", " + std::to_string(y[i]));
+		}
+	}
+}
+
+int main()
+{
+	std::mt19937 engine;
+
+	const ImageRef sizes[] = { ImageRef(1, 1), ImageRef(1, 5), ImageRef(4, 1), ImageRef(2, 2), ImageRef(37, 23), ImageRef(200, 3) };
+	for(ImageRef size : sizes)
+	{
+		Image<CVD::byte> bytes(size);
+		Image<float> floats(size);
+		for(int y = 0; y < size.y; y++)
+			for(int x = 0; x < size.x; x++)
+			{
+				bytes[y][x] = static_cast<CVD::byte>(engine() % 256);
+				floats[y][x] = bytes[y][x] * 0.01f - 1;
+			}
+
+		// Points all over and around the image, whole numbers including the
+		// last row and column, and points which can not be sampled at all.
+		std::vector<float> x, y;
+		std::uniform_real_distribution<float> ux(-3, size.x + 3), uy(-3, size.y + 3);
+		for(int i = 0; i < 300; i++)
+		{
+			x.push_back(ux(engine));
+			y.push_back(uy(engine));
+		}
+		for(int j = 0; j < size.y; j++)
+			for(int i = 0; i < size.x; i++)
+			{
+				x.push_back(static_cast<float>(i));
+				y.push_back(static_cast<float>(j));
+			}
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		const float odd[][2] = { { nan, 0 }, { 0, nan }, { 1e30f, 0 }, { -1e30f, -1e30f }, { size.x - 1.f, 0.5f }, { 0.25f, size.y - 1.f } };
+		for(auto& p : odd)
+		{
+			x.push_back(p[0]);
+			y.push_back(p[1]);
+		}
+
+		const std::string name = std::to_string(size.x) + "x" + std::to_string(size.y);
+		check(bytes, x, y, "byte, " + name);
+		check(floats, x, y, "float, " + name);
+		check_fixed(bytes, x, y, name);
+	}
+
+	// Blocks of points well inside the image, which skip the edge checks,
+	// compared with sample().
+	Image<float> im(ImageRef(64, 48));
+	for(float& p : im)
+		p = static_cast<float>(engine() % 1000) / 7;
+	std::uniform_real_distribution<float> ux(2, 60), uy(2, 44);
+	std::vector<float> x(1000), y(1000), values(1000);
+	for(int i = 0; i < 1000; i++)
+	{
+		x[i] = ux(engine);
+		y[i] = uy(engine);
+	}
+	check(im, x, y, "float, inside");
+	CVD::sample_bilinear(im, x.data(), y.data(), 1000, values.data());
+	for(int i = 0; i < 1000; i++)
+		assert_close(CVD::sample<float>(im, x[i], y[i]), values[i], "sample_bilinear differs from sample");
+
+	Image<CVD::byte> empty;
+	CVD::sample_bilinear(empty, x.data(), y.data(), 1000, values.data(), SampleBorder::Constant, 3.f);
+	assert_equal(3.f, values[0], "sampling an empty image");
+	assert_equal(3.f, values[999], "sampling an empty image");
+
+	bool thrown = false;
+	try
+	{
+		CVD::sample_bilinear(empty, x.data(), y.data(), 1000, values.data());
+	}
+	catch(const CVD::Exceptions::Vision::BadInput&)
+	{
+		thrown = true;
+	}
+	assert_equal(true, thrown, "clamping to an empty image accepted");
+}
@@ -0,0 +1,120 @@
+#include "test_utility.h"
+
+#include <cvd/tensor_voting.h>
+#include <cvd/vision_exceptions.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using CVD::BasicImage;
+using CVD::Image;
+using CVD::ImageRef;
+using CVD::Testing::assert_equal;
+using CVD::Testing::assert_near;
+using TooN::Matrix;
+
+// Every interior pixel whose gradient is above the threshold votes with
+// the full kernel for its direction, clipped to the image.
+template <class C>
+Image<Matrix<2>> naive_vote(const BasicImage<C>& image, double sigma, double ratio, double threshold, double cutoff, unsigned int num_divs)
+{
+	const int radius = static_cast<int>(std::ceil(sigma * std::sqrt(-std::log(cutoff))));
+	Image<Matrix<2>> field(image.size(), Matrix<2>(TooN::Zeros));
+	for(int y = 1; y < image.size().y - 1; y++)
+		for(int x = 1; x < image.size().x - 1; x++)
+		{
+			const double gx = (static_cast<double>(image[y][x + 1]) - image[y][x - 1]) / 2;
+			const double gy = (static_cast<double>(image[y + 1][x]) - image[y - 1][x]) / 2;
+			const double scale = std::sqrt(gx * gx + gy * gy);
+			if(!(scale > threshold))
+				continue;
+
+			const unsigned int direction = CVD::TensorVoting::quantize_half_angle(M_PI / 2 + std::atan2(gy, gx), num_divs);
+			for(const auto& k : CVD::TensorVoting::compute_a_tensor_kernel(radius, cutoff, M_PI * direction / num_divs, sigma, ratio, 0))
+			{
+				const ImageRef p(x + k.first.x, y + k.first.y);
+				if(field.in_image(p))
+					for(int i = 0; i < 2; i++)
+						for(int j = 0; j < 2; j++)
+							field[p][i][j] += scale * k.second[i][j];
+			}
+		}
+	return field;
+}
+
+void compare(const BasicImage<Matrix<2>>& expected, const CVD::TensorField& field, const std::string& what)
+{
+	assert_equal(expected.size(), field.xx.size(), "size of field, " + what);
+	assert_equal(expected.size(), field.xy.size(), "size of field, " + what);
+	assert_equal(expected.size(), field.yy.size(), "size of field, " + what);
+
+	double largest = 1;
+	for(const Matrix<2>& m : expected)
+		largest = std::max(largest, std::max(std::abs(m[0][0]), std::abs(m[1][1])));
+
+	for(int y = 0; y < expected.size().y; y++)
+		for(int x = 0; x < expected.size().x; x++)
+		{
+			const Matrix<2>& m = expected[y][x];
+			const std::string at = what + ": wrong tensor at " + std::to_string(x) + ", " + std::to_string(y);
+			assert_near<double>(m[0][0], field.xx[y][x], 1e-5 * largest, at + ", xx");
+			assert_near<double>(m[0][1], field.xy[y][x], 1e-5 * largest, at + ", xy");
+			assert_near<double>(m[1][1], field.yy[y][x], 1e-5 * largest, at + ", yy");
+		}
+}
+
+int main()
+{
+	std::mt19937 engine;
+
+	const ImageRef sizes[] = { ImageRef(1, 1), ImageRef(2, 7), ImageRef(3, 3), ImageRef(9, 40), ImageRef(61, 47), ImageRef(20, 130) };
+	for(ImageRef size : sizes)
+	{
+		// Smooth stripes, with noise, so there are voters of every strength.
+		Image<CVD::byte> image(size);
+		Image<float> fimage(size);
+		for(int y = 0; y < size.y; y++)
+			for(int x = 0; x < size.x; x++)
+			{
+				image[y][x] = static_cast<CVD::byte>(128 + 100 * std::sin(x * 0.3 + y * 0.2) + engine() % 20);
+				fimage[y][x] = image[y][x] * 0.25f;
+			}
+
+		const std::string name = std::to_string(size.x) + "x" + std::to_string(size.y);
+		CVD::TensorField field;
+		CVD::dense_tensor_vote_gradients(image, 2, 0.5, field, 0.01, 64);
+		compare(naive_vote(image, 2, 0.5, 0, 0.01, 64), field, "dense, byte, " + name);
+		// The original skips the middle of the image, assuming that it is
+		// wider than the kernel.
+		if(size.x > 10)
+			compare(CVD::dense_tensor_vote_gradients(image, 2, 0.5, 0.01, 64), field, "dense_tensor_vote_gradients, byte, " + name);
+
+		CVD::dense_tensor_vote_gradients(fimage, 3.5, 1, field, 0.001, 256);
+		compare(naive_vote(fimage, 3.5, 1, 0, 0.001, 256), field, "dense, float, " + name);
+
+		for(double threshold : { 10., 40., 1000. })
+		{
+			CVD::sparse_tensor_vote_gradients(image, 1.5, 0.2, threshold, field, 0.01, 4096);
+			compare(naive_vote(image, 1.5, 0.2, threshold, 0.01, 4096), field, "sparse, byte, " + name + ", threshold " + std::to_string(threshold));
+
+			CVD::sparse_tensor_vote_gradients(fimage, 1.5, 0.2, threshold / 4, field, 0.01, 4096);
+			compare(naive_vote(fimage, 1.5, 0.2, threshold / 4, 0.01, 4096), field, "sparse, float, " + name + ", threshold " + std::to_string(threshold));
+		}
+	}
+
+	bool thrown = false;
+	try
+	{
+		CVD::TensorField field;
+		CVD::dense_tensor_vote_gradients(Image<CVD::byte>(ImageRef(5, 5), 0), 1, 1, field, 0.01, 0);
+	}
+	catch(const CVD::Exceptions::Vision::BadInput&)
+	{
+		thrown = true;
+	}
+	assert_equal(true, thrown, "no directions accepted");
+}
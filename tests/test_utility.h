@@ -109,6 +109,20 @@ namespace Testing
 		}
 	}
 
+	template <typename T>
+	void assert_near(T expected, T actual, T tolerance, std::string message = "")
+	{
+		if(!(std::abs(expected - actual) <= tolerance))
+		{
+			if(!message.empty())
+			{
+				std::cerr << message << "; ";
+			}
+			std::cerr << "expected " << expected << ", actual " << actual << ", tolerance " << tolerance << "\n";
+			exit(EXIT_FAILURE);
+		}
+	}
+
 	template <typename T>
 	void assert_near(Rgba<T> expected, Rgba<T> actual, std::string message = "")
 	{
@@ -0,0 +1,249 @@
+#include "test_utility.h"
+
+#include <cvd/vision.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <type_traits>
+
+using CVD::BasicImage;
+using CVD::Image;
+using CVD::ImageRef;
+using CVD::Rgb;
+using CVD::WarpInterpolation;
+using CVD::Testing::assert_equal;
+using CVD::Testing::assert_image_equal;
+using CVD::Testing::assert_near;
+
+// The map from the output to the input, as a homography. A point at or
+// behind the line at infinity is not a number.
+struct Map
+{
+	double H[3][3];
+
+	void at(int x, int y, double& px, double& py) const
+	{
+		const double w = H[2][0] * x + H[2][1] * y + H[2][2];
+		px = w > 0 ? (H[0][0] * x + H[0][1] * y + H[0][2]) / w : NAN;
+		py = w > 0 ? (H[1][0] * x + H[1][1] * y + H[1][2]) / w : NAN;
+	}
+};
+
+double pixel(const BasicImage<CVD::byte>& im, int x, int y, int)
+{
+	return im[std::min(im.size().y - 1, std::max(0, y))][std::min(im.size().x - 1, std::max(0, x))];
+}
+
+double pixel(const BasicImage<float>& im, int x, int y, int)
+{
+	return im[std::min(im.size().y - 1, std::max(0, y))][std::min(im.size().x - 1, std::max(0, x))];
+}
+
+double pixel(const BasicImage<Rgb<CVD::byte>>& im, int x, int y, int c)
+{
+	const Rgb<CVD::byte> p = im[std::min(im.size().y - 1, std::max(0, y))][std::min(im.size().x - 1, std::max(0, x))];
+	return c == 0 ? p.red : c == 1 ? p.green : p.blue;
+}
+
+double component(CVD::byte p, int) { return p; }
+double component(float p, int) { return p; }
+double component(Rgb<CVD::byte> p, int c) { return c == 0 ? p.red : c == 1 ? p.green : p.blue; }
+
+int channels(CVD::byte) { return 1; }
+int channels(float) { return 1; }
+int channels(Rgb<CVD::byte>) { return 3; }
+
+double bspline(double x)
+{
+	auto p = [](double f) { return f > 0 ? f * f * f : 0; };
+	return (p(x + 2) - 4 * p(x + 1) + 6 * p(x) - 4 * p(x - 1)) / 6;
+}
+
+bool inside(double x, double size)
+{
+	return x >= 0 && x <= size - 1;
+}
+
+// The value of channel c of the warped image at a point, and whether the
+// point is in the image.
+template <class T>
+bool naive(const BasicImage<T>& in, double px, double py, WarpInterpolation interpolation, int c, double& v)
+{
+	const int w = in.size().x, h = in.size().y;
+	if(interpolation == WarpInterpolation::Nearest)
+	{
+		const double ix = std::floor(px + 0.5), iy = std::floor(py + 0.5);
+		if(!(ix >= 0 && ix < w && iy >= 0 && iy < h))
+			return false;
+		v = pixel(in, static_cast<int>(ix), static_cast<int>(iy), c);
+		return true;
+	}
+
+	if(interpolation == WarpInterpolation::Bilinear && std::is_same<T, float>::value == false)
+	{
+		const double sx = std::floor(px * 256 + 0.5), sy = std::floor(py * 256 + 0.5);
+		if(!(sx >= 0 && sx <= (w - 1) * 256 && sy >= 0 && sy <= (h - 1) * 256))
+			return false;
+		const int ix = static_cast<int>(sx) >> 8, iy = static_cast<int>(sy) >> 8;
+		const int fx = static_cast<int>(sx) & 255, fy = static_cast<int>(sy) & 255;
+		const double top = pixel(in, ix, iy, c) * (256 - fx) + pixel(in, ix + 1, iy, c) * fx;
+		const double bottom = pixel(in, ix, iy + 1, c) * (256 - fx) + pixel(in, ix + 1, iy + 1, c) * fx;
+		v = std::floor((top * (256 - fy) + bottom * fy + 32768) / 65536);
+		return true;
+	}
+
+	if(!inside(px, w) || !inside(py, h))
+		return false;
+	const int ix = static_cast<int>(std::floor(px)), iy = static_cast<int>(std::floor(py));
+	const double fx = px - ix, fy = py - iy;
+	if(interpolation == WarpInterpolation::Bilinear)
+	{
+		v = (1 - fy) * ((1 - fx) * pixel(in, ix, iy, c) + fx * pixel(in, ix + 1, iy, c)) + fy * ((1 - fx) * pixel(in, ix, iy + 1, c) + fx * pixel(in, ix + 1, iy + 1, c));
+		return true;
+	}
+
+	v = 0;
+	for(int m = -1; m < 3; m++)
+		for(int n = -1; n < 3; n++)
+			v += pixel(in, ix + m, iy + n, c) * bspline(m - fx) * bspline(fy - n);
+	if(!std::is_same<T, float>::value)
+		v = std::floor(v + 0.5);
+	return true;
+}
+
+template <class T>
+void check(const BasicImage<T>& in, const Map& map, bool affine, ImageRef size, T default_value, const std::string& name)
+{
+	const double A[2][3] = { { map.H[0][0], map.H[0][1], map.H[0][2] }, { map.H[1][0], map.H[1][1], map.H[1][2] } };
+	for(WarpInterpolation interpolation : { WarpInterpolation::Nearest, WarpInterpolation::Bilinear, WarpInterpolation::Bicubic })
+	{
+		const std::string what = name + (interpolation == WarpInterpolation::Nearest ? ", nearest" : interpolation == WarpInterpolation::Bilinear ? ", bilinear" : ", bicubic");
+		Image<T> out(size);
+		const int outside = affine ? CVD::warp_affine(in, out, A, interpolation, default_value) : CVD::warp_homography(in, out, map.H, interpolation, default_value);
+
+		// Points which the output steps to are rounded in a different order, so
+		// any of the values of points very close by are accepted.
+		int least_outside = 0, most_outside = 0;
+		for(int y = 0; y < size.y; y++)
+			for(int x = 0; x < size.x; x++)
+			{
+				double px, py;
+				map.at(x, y, px, py);
+				bool some_inside = false, some_outside = false, right = true;
+				for(int c = 0; c < channels(default_value); c++)
+				{
+					bool matched = false;
+					for(double e : { 0.0, 1e-9, -1e-9 })
+						for(double f : { 0.0, 1e-9, -1e-9 })
+						{
+							double v;
+							const bool ok = naive(in, px + e * std::max(1.0, std::abs(px)), py + f * std::max(1.0, std::abs(py)), interpolation, c, v);
+							if(!ok)
+								v = component(default_value, c);
+							some_inside |= ok;
+							some_outside |= !ok;
+
+							// Float arithmetic may round a byte the other way.
+							const double tolerance = std::is_same<T, float>::value ? 1e-3 * std::max(1.0, std::abs(v)) : interpolation == WarpInterpolation::Bicubic ? 1 : 0;
+							matched |= std::abs(v - component(out[y][x], c)) <= tolerance;
+						}
+					right &= matched;
+				}
+				assert_equal(true, right, what + ": wrong value at " + std::to_string(x) + ", " + std::to_string(y));
+				least_outside += !some_inside;
+				most_outside += some_outside;
+			}
+		assert_equal(true, outside >= least_outside && outside <= most_outside,
+		    what + ": " + std::to_string(outside) + " pixels outside, not " + std::to_string(least_outside) + " to " + std::to_string(most_outside));
+	}
+}
+
+int main()
+{
+	std::mt19937 engine;
+
+	const ImageRef sizes[] = { ImageRef(1, 1), ImageRef(2, 3), ImageRef(37, 23), ImageRef(130, 20) };
+	for(ImageRef source : sizes)
+	{
+		Image<CVD::byte> bytes(source);
+		Image<Rgb<CVD::byte>> colour(source);
+		Image<float> floats(source);
+		for(int y = 0; y < source.y; y++)
+			for(int x = 0; x < source.x; x++)
+			{
+				bytes[y][x] = static_cast<CVD::byte>(engine() % 256);
+				colour[y][x] = Rgb<CVD::byte>(static_cast<CVD::byte>(engine() % 256), static_cast<CVD::byte>(engine() % 256), static_cast<CVD::byte>(engine() % 256));
+				floats[y][x] = static_cast<float>(engine() % 10000) / 77;
+			}
+
+		// The identity, which hits the last row and column exactly, and maps
+		// which go over and around the image.
+		std::uniform_real_distribution<double> d(-0.3, 0.3);
+		const Map maps[] = {
+			{ { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } } },
+			{ { { 0.5, 0, 0 }, { 0, 0.25, 0 }, { 0, 0, 1 } } },
+			{ { { 0.9 + d(engine), d(engine), -3 }, { d(engine), 1.1 + d(engine), -2 }, { 0, 0, 1 } } },
+			{ { { 1 + d(engine), d(engine), 2 }, { d(engine), 1 + d(engine), -1 }, { 0.01 * d(engine), 0.01 * d(engine), 1 } } },
+			{ { { 1, 0, 0 }, { 0, 1, 0 }, { 0.021, 0.013, -0.3 } } },
+		};
+		const ImageRef size(source.x + 50, source.y + 3);
+		for(const Map& map : maps)
+		{
+			const bool affine = map.H[2][0] == 0 && map.H[2][1] == 0 && map.H[2][2] == 1;
+			const std::string name = std::to_string(source.x) + "x" + std::to_string(source.y) + (affine ? ", affine" : ", homography");
+			check<CVD::byte>(bytes, map, affine, size, 9, "byte, " + name);
+			check<Rgb<CVD::byte>>(colour, map, affine, size, Rgb<CVD::byte>(1, 2, 3), "Rgb, " + name);
+			check<float>(floats, map, affine, size, -1.5f, "float, " + name);
+			if(affine)
+				check<float>(floats, map, false, size, -1.5f, "float, " + name + " as a homography");
+		}
+	}
+
+	// An empty image is all outside.
+	Image<float> empty, out(ImageRef(5, 4));
+	const double identity[2][3] = { { 1, 0, 0 }, { 0, 1, 0 } };
+	assert_equal(20, CVD::warp_affine(empty, out, identity, WarpInterpolation::Bilinear, 2.f), "warping an empty image");
+	assert_equal(2.f, out[3][4], "warping an empty image");
+
+#ifdef CVD_HAVE_TOON
+	// transform() is the same as sampling each point, apart from the last
+	// row and column, which it used to leave out, and points which round to
+	// either side of the edges.
+	{
+		const double e = 1e-6;
+		Image<float> in(ImageRef(40, 30)), warped(ImageRef(50, 35));
+		for(float& p : in)
+			p = static_cast<float>(engine() % 1000);
+		const TooN::Matrix<2> M = TooN::Data(0.8, 0.1, -0.2, 0.9);
+		const TooN::Vector<2> in_origin = TooN::makeVector(20, 15), out_origin = TooN::makeVector(25, 17);
+		CVD::transform(in, warped, M, in_origin, out_origin, -1.f);
+		for(int y = 0; y < warped.size().y; y++)
+			for(int x = 0; x < warped.size().x; x++)
+			{
+				const TooN::Vector<2> p = in_origin + M * (TooN::makeVector(x, y) - out_origin);
+				const bool ok = p[0] >= e && p[1] >= e && p[0] < in.size().x - 1 - e && p[1] < in.size().y - 1 - e;
+				if(ok)
+					assert_near(CVD::sample<float>(in, p[0], p[1]), warped[y][x], 1e-2f, "transform with a matrix differs from sample at " + std::to_string(x) + ", " + std::to_string(y));
+			}
+
+		const TooN::Matrix<3> H = TooN::Data(1.1, 0.1, 2, -0.05, 0.9, 1, 0.001, -0.002, 1);
+		CVD::transform(in, warped, H);
+		Image<float> negated(warped.size());
+		CVD::transform(in, negated, -1 * H);
+		assert_image_equal(warped, negated, "transform with a negated homography differs");
+		for(int y = 0; y < warped.size().y; y++)
+			for(int x = 0; x < warped.size().x; x++)
+			{
+				const TooN::Vector<2> p = TooN::project(H * TooN::makeVector(x - warped.size().x / 2, y - warped.size().y / 2, 1))
+				    + TooN::makeVector(in.size().x / 2, in.size().y / 2) - TooN::project(TooN::makeVector(H(0, 2), H(1, 2), H(2, 2)));
+				const bool ok = p[0] >= e && p[1] >= e && p[0] <= in.size().x - 2 && p[1] <= in.size().y - 2;
+				if(ok)
+					assert_near(CVD::sample<float>(in, p[0], p[1]), warped[y][x], 1e-2f, "transform with a homography differs from sample at " + std::to_string(x) + ", " + std::to_string(y));
+			}
+	}
+#endif
+}